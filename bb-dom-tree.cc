@@ -6,9 +6,15 @@
 // Created: 2019-10-28
 //
 
+#include "stats.h"
+
 #include "bb.h"
 
 
+static Stat dom_iters ("bb-dom-tree", "dom-iters",
+		       "Number of dominator-tree calculation fixed-point iterations");
+
+
 // Assert that this block is immediately dominated by DOM.
 //
 // DOM_TREE_NODE_MEMBER identifies which dominator tree node to use.
@@ -104,6 +110,11 @@ BB::remove_from_dominator_tree (DomTreeNode BB::*dom_tree_node_member)
 {
   BB *dominator = (this->*dom_tree_node_member).dominator;
 
+  // Our dominator mustn't be left pointing at us.
+  //
+  if (dominator)
+    (dominator->*dom_tree_node_member).dominatees.remove (this);
+
   for (auto dominee : (this->*dom_tree_node_member).dominatees)
     {
       (dominee->*dom_tree_node_member).dominator = dominator;
@@ -121,7 +132,7 @@ BB::remove_from_dominator_tree (DomTreeNode BB::*dom_tree_node_member)
 void
 BB::calc_doms (const std::list<BB *> &blocks,
 	       DomTreeNode BB::*dom_tree_node_member,
-	       std::list<BB *> BB::*pred_list_member)
+	       BlockList BB::*pred_list_member)
 {
   // Clear old dominator info.
   //
@@ -155,6 +166,8 @@ BB::calc_doms (const std::list<BB *> &blocks,
   while (change)
     {
       change = false;
+      ++dom_iters;
+
       for (auto block : blocks)
 	{
 	  // Remember the previous dominator set for BLOCK.
@@ -216,8 +229,8 @@ BB::calc_doms (const std::list<BB *> &blocks,
 void
 BB::extend_dominance_frontier (const BB *dom_tree_root,
 			       DomTreeNode BB::*dom_tree_node_member,
-			       std::list<BB *> BB::*succ_list_member,
-			       std::list<BB *> &frontier)
+			       BlockList BB::*succ_list_member,
+			       BlockList &frontier)
   const
 {
   // Basically just walk the dominator tree, seeing which successors
@@ -6,10 +6,14 @@
 // Created: 2019-11-02
 //
 
-#include <ostream>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
 
 #include "fun.h"
 #include "bb.h"
+#include "block-freq.h"
 
 #include "fun-text-writer.h"
 #include "insn-text-writer.h"
@@ -31,10 +35,11 @@ BBTextWriter::BBTextWriter (FunTextWriter &_fun_writer)
 void
 BBTextWriter::write (BB *block, BB *next_block)
 {
-  std::ostream &out = fun_writer.output_stream ();
+  OutputBuffer &out = fun_writer.output_buffer ();
   InsnTextWriter &insn_writer = fun_writer.insn_writer;
 
-  out << fun_writer.block_label (block) << "\n";
+  fun_writer.write_block_label (block);
+  out << '\n';
 
   Fun *fun = block->fun ();
 
@@ -43,20 +48,39 @@ BBTextWriter::write (BB *block, BB *next_block)
   if (block == fun->exit_block ())
     out << "   # exit\n";
 
-  if (! block->predecessors ().empty ())
-    out << "   # preds: "
-	<< fun_writer.block_list_labels (block->predecessors ())
+  // With a profile, counts are more informative than frequencies.
+  //
+  const EdgeProfile::FunCounts *profile_counts = fun_writer.profile_counts;
+  const BlockFreq *block_freq = fun_writer.block_freq;
+  if (profile_counts)
+    out << "   # count: "
+	<< std::llround (block_freq->freq (block) * profile_counts->calls)
 	<< '\n';
+  else if (block_freq)
+    {
+      char freq_buf[32];
+      std::snprintf (freq_buf, sizeof freq_buf, "%.4g",
+		     block_freq->freq (block));
+      out << "   # freq: " << freq_buf << '\n';
+    }
+
+  if (! block->predecessors ().empty ())
+    {
+      out << "   # preds: ";
+      fun_writer.write_block_list_labels (block->predecessors ());
+      out << '\n';
+    }
 
   BB *dom = block->dominator ();
   if (dom)
     {
-      out << "   # dominator: "
-	  << fun_writer.block_label (dom)
-	  << '\n';
-      out << "   # dominance frontier: "
-	  << fun_writer.block_list_labels (block->dominance_frontier ())
-	  << '\n';
+      out << "   # dominator: ";
+      fun_writer.write_block_label (dom);
+      out << '\n';
+
+      out << "   # dominance frontier: ";
+      fun_writer.write_block_list_labels (block->dominance_frontier ());
+      out << '\n';
     }
 
   for (auto insn : block->insns ())
@@ -67,17 +91,42 @@ BBTextWriter::write (BB *block, BB *next_block)
     }
 
   if (block->fall_through () && block->fall_through () != next_block)
-    out << "   goto " << fun_writer.block_label (block->fall_through ()) << '\n';
+    {
+      out << "   goto ";
+      fun_writer.write_block_label (block->fall_through ());
+      out << '\n';
+    }
 
   BB *rev_dom = block->post_dominator ();
   if (rev_dom)
-    out << "   # post-dominator: "
-	<< fun_writer.block_label (rev_dom)
-	<< '\n';
+    {
+      out << "   # post-dominator: ";
+      fun_writer.write_block_label (rev_dom);
+      out << '\n';
+    }
 
   if (! block->successors ().empty ())
-    out << "   # succs: "
-	<< fun_writer.block_list_labels (block->successors ())
-	<< '\n';
+    {
+      out << "   # succs: ";
+      fun_writer.write_block_list_labels (block->successors ());
+      out << '\n';
+
+      if (profile_counts)
+	{
+	  out << "   # succ counts: ";
+	  std::vector<BB *> succs;
+	  for (auto succ : block->successors ())
+	    if (std::find (succs.begin (), succs.end (), succ) == succs.end ())
+	      {
+		out << (succs.empty () ? "" : ", ");
+		fun_writer.write_block_label (succ);
+		out << ' '
+		    << std::llround (block_freq->edge_freq (block, succ)
+				     * profile_counts->calls);
+		succs.push_back (succ);
+	      }
+	  out << '\n';
+	}
+    }
 }
 
@@ -141,6 +141,22 @@ BB::prepend_insn (Insn *insn)
   insn->set_block (this);
 }
 
+// Add the instruction INSN to this block, just before POS, an
+// iterator into the list returned by insns (which may be its end).
+//
+void
+BB::insert_insn (BB::InsnList::const_iterator pos, Insn *insn)
+{
+  BB *old_block = insn->block ();
+
+  if (old_block)
+    old_block->remove_insn (insn);
+
+  _insns.insert (pos, insn);
+
+  insn->set_block (this);
+}
+
 // Remove the instruction INSN from this block.
 //
 void
@@ -213,3 +229,38 @@ BB::change_successor (BB *from, BB *to)
   if (! _insns.empty ())
     _insns.back ()->change_branch_target (from, to);
 }
+
+
+// Reorder this block's successor and predecessor lists to be SUCCS
+// and PREDS, without any checking.  The caller must make sure they
+// contain exactly the same blocks as the current lists, possibly in a
+// different order.
+//
+void
+BB::reorder_edges (BlockList &&succs, BlockList &&preds)
+{
+  _succs = std::move (succs);
+  _preds = std::move (preds);
+}
+
+
+// Set this block's dominator-tree state directly, without any
+// checking:  DOM is its immediate dominator, DEPTH its depth in the
+// dominator tree, and DOMINATEES the blocks it immediately
+// dominates.  POST_DOM, POST_DEPTH, and POST_DOMINATEES are the
+// same for the post-dominator tree.
+//
+void
+BB::restore_dominators (BB *dom, unsigned depth,
+			BlockList &&dominatees,
+			BB *post_dom, unsigned post_depth,
+			BlockList &&post_dominatees)
+{
+  fwd_dom_tree_node.dominator = dom;
+  fwd_dom_tree_node.depth = depth;
+  fwd_dom_tree_node.dominatees = std::move (dominatees);
+
+  bwd_dom_tree_node.dominator = post_dom;
+  bwd_dom_tree_node.depth = post_depth;
+  bwd_dom_tree_node.dominatees = std::move (post_dominatees);
+}
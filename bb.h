@@ -12,6 +12,8 @@
 #include <algorithm>
 #include <list>
 
+#include "mem-account.h"
+
 
 class Fun;
 class Insn;
@@ -23,6 +25,14 @@ class BB
 {
 public:
 
+  MEM_ACCOUNTED (BB);
+
+  // Lists of blocks and instructions which are part of a block; their
+  // storage is charged to the BB account.
+  //
+  typedef std::list<BB *, MemAccountAllocator<BB *, BB>> BlockList;
+  typedef std::list<Insn *, MemAccountAllocator<Insn *, BB>> InsnList;
+
   // Make a new block in function FUN.
   //
   BB (Fun *fun);
@@ -99,7 +109,7 @@ public:
   // Return a reference to a read-only list containing blocks
   // immediately dominated by this block.
   //
-  const std::list<BB *> &dominatees () const
+  const BlockList &dominatees () const
   {
     return fwd_dom_tree_node.dominatees;
   }
@@ -111,7 +121,7 @@ public:
   // Return a reference to a read-only list containing blocks
   // immediately post-dominated by this block.
   //
-  const std::list<BB *> &post_dominatees () const
+  const BlockList &post_dominatees () const
   {
     return bwd_dom_tree_node.dominatees;
   }
@@ -136,9 +146,9 @@ public:
   // immediate successors of some block dominated by this block, but
   // are not dominated by this block themselves.
   //
-  std::list<BB *> dominance_frontier () const
+  BlockList dominance_frontier () const
   {
-    std::list<BB *> frontier;
+    BlockList frontier;
     extend_dominance_frontier (this,
 			       &BB::fwd_dom_tree_node, &BB::_succs,
 			       frontier);
@@ -182,6 +192,11 @@ public:
   //
   void prepend_insn (Insn *insn);
 
+  // Add the instruction INSN to this block, just before POS, an
+  // iterator into the list returned by insns (which may be its end).
+  //
+  void insert_insn (InsnList::const_iterator pos, Insn *insn);
+
   // Remove the instruction INSN from this block.
   //
   void remove_insn (Insn *insn);
@@ -190,18 +205,18 @@ public:
   // Return a reference to a read-only list containing the predecessor
   // blocks of this block.
   //
-  const std::list<BB *> &predecessors () const { return _preds; }
+  const BlockList &predecessors () const { return _preds; }
 
   // Return a reference to a read-only list containing the successor
   // blocks of this block.
   //
-  const std::list<BB *> &successors () const { return _succs; }
+  const BlockList &successors () const { return _succs; }
 
 
   // Return a reference to a read-only list containing the
   // instructions in this block.
   //
-  const std::list<Insn *> &insns () const { return _insns; }
+  const InsnList &insns () const { return _insns; }
 
 
   // Replace FROM in the successors of this block with TO.  TO may be
@@ -210,6 +225,37 @@ public:
   void change_successor (BB *from, BB *to);
 
 
+  //
+  // Restoring saved state.  These methods are for use by readers of
+  // saved IR (see ProgBinReader), to restore order-dependent state
+  // exactly.
+  //
+
+  // Reorder this block's successor and predecessor lists to be SUCCS
+  // and PREDS, without any checking.  The caller must make sure they
+  // contain exactly the same blocks as the current lists, possibly in
+  // a different order.
+  //
+  void reorder_edges (BlockList &&succs, BlockList &&preds);
+
+  // Set this block's dominator-tree state directly, without any
+  // checking:  DOM is its immediate dominator, DEPTH its depth in the
+  // dominator tree, and DOMINATEES the blocks it immediately
+  // dominates.  POST_DOM, POST_DEPTH, and POST_DOMINATEES are the
+  // same for the post-dominator tree.
+  //
+  void restore_dominators (BB *dom, unsigned depth,
+			   BlockList &&dominatees,
+			   BB *post_dom, unsigned post_depth,
+			   BlockList &&post_dominatees);
+
+  // Return the depth of this block in the dominator / post-dominator
+  // tree, with the root as 0.
+  //
+  unsigned dominator_depth () const { return fwd_dom_tree_node.depth; }
+  unsigned post_dominator_depth () const { return bwd_dom_tree_node.depth; }
+
+
 private:
 
   // Unique block number, assigned at block creation time.
@@ -218,7 +264,7 @@ private:
 
   // Instructions in this block;
   //
-  std::list<Insn *> _insns;
+  InsnList _insns;
 
   // Where control-flow in this block goes if execution runs off the
   // end of it.
@@ -232,11 +278,11 @@ private:
 
   // Predecessor blocks of this block.
   //
-  std::list<BB *> _preds;
+  BlockList _preds;
 
   // Successor blocks of this block.
   //
-  std::list<BB *> _succs;
+  BlockList _succs;
 
 
   //
@@ -254,7 +300,7 @@ private:
 
     // Children in dominator tree.
     //
-    std::list<BB *> dominatees;
+    BlockList dominatees;
 
     // Depth in the dominator tree, with the root as 0.
     //
@@ -323,7 +369,7 @@ private:
   //
   static void calc_doms (const std::list<BB *> &blocks,
 			 DomTreeNode BB::*dom_tree_node_member,
-			 std::list<BB *> BB::*pred_list_member);
+			 BlockList BB::*pred_list_member);
 
 
   // Helper method used by BB::dominance_frontier method.
@@ -338,8 +384,8 @@ private:
   //
   void extend_dominance_frontier (const BB *dom_tree_root,
 				  DomTreeNode BB::*dom_tree_node_member,
-				  std::list<BB *> BB::*succ_list_member,
-				  std::list<BB *> &frontier)
+				  BlockList BB::*succ_list_member,
+				  BlockList &frontier)
     const;
 
 
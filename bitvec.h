@@ -20,7 +20,9 @@ class Bitvec
 {
 public:
 
-  Bitvec (unsigned size);
+  // Make a bit vector able to hold SIZE bits, all clear.
+  //
+  Bitvec (unsigned size) : words ((size + WordsPerWord - 1) / WordsPerWord) { }
 
   bool get (unsigned index) const
   {
@@ -46,6 +48,20 @@ public:
   bool operator[] (unsigned index) const { return get (index); }
   Bitvec &operator|= (const Bitvec &other) { set (other); return *this; }
 
+  bool operator== (const Bitvec &other) const { return words == other.words; }
+  bool operator!= (const Bitvec &other) const { return words != other.words; }
+
+  // Call FUN with the index of each bit set, in increasing order.
+  //
+  template<typename F>
+  void for_each (F fun) const
+  {
+    unsigned nwords = words.size ();
+    for (unsigned i = 0; i < nwords; i++)
+      for (Word word = words[i]; word; word &= word - 1)
+	fun (i * WordsPerWord + lowest_bit_pos (word));
+  }
+
   // Return the number of bits set.
   //
   unsigned count () const;
@@ -67,7 +83,15 @@ private:
   }
   Word bit_mask (unsigned index) const
   {
-    return 1 << bit_pos (index);
+    return Word (1) << bit_pos (index);
+  }
+
+  // Return the position of the lowest bit set in WORD, which must not
+  // be zero.
+  //
+  static unsigned lowest_bit_pos (Word word)
+  {
+    return __builtin_ctzll (word);
   }
   
 
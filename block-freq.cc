@@ -0,0 +1,443 @@
+// block-freq.cc -- Static estimation of IR block execution frequencies
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#include <algorithm>
+#include <utility>
+
+#include "check-assertion.h"
+#include "trace.h"
+
+#include "fun.h"
+#include "bb.h"
+
+#include "block-freq.h"
+
+
+// Probabilities predicted by each heuristic for the edge it favors,
+// from Ball and Larus, "Branch Prediction for Free".
+//
+static constexpr double LOOP_BRANCH_PROB = 0.88;
+static constexpr double LOOP_EXIT_PROB = 0.80;
+static constexpr double LOOP_HEADER_PROB = 0.75;
+static constexpr double RETURN_PROB = 0.72;
+
+// The highest probability of going around a loop again which is
+// believed, so loops which never seem to exit still have a finite
+// frequency.
+//
+static constexpr double MAX_CYCLIC_PROB = 0.999;
+
+
+// Estimate frequencies for FUN.
+//
+BlockFreq::BlockFreq (Fun *fun)
+{
+  TRACE_SPAN ("BlockFreq");
+
+  find_loops (fun);
+  calc_probs (fun);
+
+  // Inner loops come after the loops containing them.
+  //
+  for (unsigned i = _loops.size (); i > 0; i--)
+    propagate (_loops[i - 1].header, i - 1);
+
+  if (fun->entry_block ())
+    propagate (fun->entry_block (), -1);
+}
+
+// Use the frequencies in COUNTS, which must be for FUN's flow graph
+// (see EdgeProfile::find), instead of estimating them.  Branch
+// probabilities are still estimated for blocks never executed.
+//
+BlockFreq::BlockFreq (Fun *fun, const EdgeProfile::FunCounts &counts)
+{
+  TRACE_SPAN ("BlockFreq");
+
+  find_loops (fun);
+  calc_probs (fun);
+
+  // _edges is in the same order as EdgeProfile::edges.
+  //
+  check_assertion (counts.edge_counts.size () == _edges.size (),
+		   "Profile doesn't match function");
+
+  if (counts.calls == 0)
+    return;
+
+  std::vector<std::uint64_t> in_counts (_blocks.size ());
+  std::vector<std::uint64_t> out_counts (_blocks.size ());
+  for (unsigned i = 0; i < _edges.size (); i++)
+    {
+      in_counts[_edges[i].to->num ()] += counts.edge_counts[i];
+      out_counts[_edges[i].from->num ()] += counts.edge_counts[i];
+    }
+  if (fun->entry_block ())
+    in_counts[fun->entry_block ()->num ()] += counts.calls;
+
+  double calls = counts.calls;
+  for (unsigned i = 0; i < _edges.size (); i++)
+    {
+      Edge &edge = _edges[i];
+      std::uint64_t from_count = out_counts[edge.from->num ()];
+
+      edge.freq = counts.edge_counts[i] / calls;
+      if (from_count != 0)
+	edge.prob = double (counts.edge_counts[i]) / from_count;
+    }
+
+  for (auto block : fun->blocks ())
+    info (block).freq = in_counts[block->num ()] / calls;
+}
+
+
+// Find edges, a reverse post-order, and loops.
+//
+void
+BlockFreq::find_loops (Fun *fun)
+{
+  _blocks.resize (fun->max_block_num () + 1);
+
+  for (auto block : fun->blocks ())
+    for (auto succ : block->successors ())
+      {
+	BlockInfo &block_info = info (block);
+	if (std::none_of (block_info.out_edges.begin (),
+			  block_info.out_edges.end (),
+			  [this, succ] (unsigned edge)
+			  {
+			    return _edges[edge].to == succ;
+			  }))
+	  {
+	    block_info.out_edges.push_back (_edges.size ());
+	    info (succ).in_edges.push_back (_edges.size ());
+	    _edges.push_back (Edge { block, succ });
+	  }
+      }
+
+  if (! fun->entry_block ())
+    return;
+
+  // Search depth-first from the entry block, recording the range of
+  // pre-order numbers of the blocks searched from each block, so that
+  // loop bodies can be limited to them.
+  //
+  std::vector<unsigned> preorder (_blocks.size ()), last_desc (_blocks.size ());
+  std::vector<bool> visited (_blocks.size ()), finished (_blocks.size ());
+  std::vector<BB *> post_order;
+  std::vector<BB *> headers;
+  std::vector<bool> is_header (_blocks.size ());
+
+  std::vector<std::pair<BB *, unsigned>> stack;
+  unsigned num_visited = 0;
+  auto visit = [&] (BB *block)
+    {
+      visited[block->num ()] = true;
+      preorder[block->num ()] = num_visited++;
+      stack.emplace_back (block, 0);
+    };
+
+  visit (fun->entry_block ());
+  while (! stack.empty ())
+    {
+      auto &[block, next_edge] = stack.back ();
+      const std::vector<unsigned> &out_edges = info (block).out_edges;
+
+      if (next_edge == out_edges.size ())
+	{
+	  finished[block->num ()] = true;
+	  last_desc[block->num ()] = num_visited - 1;
+	  post_order.push_back (block);
+	  stack.pop_back ();
+	  continue;
+	}
+
+      Edge &edge = _edges[out_edges[next_edge++]];
+      unsigned succ_num = edge.to->num ();
+      if (! visited[succ_num])
+	visit (edge.to);
+      else if (! finished[succ_num])
+	{
+	  edge.back = true;
+	  if (! is_header[succ_num])
+	    {
+	      is_header[succ_num] = true;
+	      headers.push_back (edge.to);
+	    }
+	}
+    }
+
+  _rpo.assign (post_order.rbegin (), post_order.rend ());
+  for (unsigned i = 0; i < _rpo.size (); i++)
+    info (_rpo[i]).rpo = i;
+
+  // Find the body of each loop by searching backwards from the sources
+  // of its back edges.
+  //
+  std::vector<std::vector<BB *>> bodies;
+  std::vector<BB *> body_marks (_blocks.size ());
+  for (auto header : headers)
+    {
+      unsigned first = preorder[header->num ()];
+      unsigned last = last_desc[header->num ()];
+
+      // A block is in this loop's body if its mark is the header.
+      //
+      std::vector<BB *> body { header };
+      body_marks[header->num ()] = header;
+
+      for (auto edge : info (header).in_edges)
+	if (_edges[edge].back)
+	  {
+	    BB *latch = _edges[edge].from;
+	    if (body_marks[latch->num ()] != header)
+	      {
+		body_marks[latch->num ()] = header;
+		body.push_back (latch);
+	      }
+	  }
+
+      for (unsigned i = 1; i < body.size (); i++)
+	for (auto edge : info (body[i]).in_edges)
+	  {
+	    BB *pred = _edges[edge].from;
+	    unsigned pred_num = pred->num ();
+	    if (visited[pred_num] && body_marks[pred_num] != header
+		&& preorder[pred_num] >= first && preorder[pred_num] <= last)
+	      {
+		body_marks[pred_num] = header;
+		body.push_back (pred);
+	      }
+	  }
+
+      bodies.push_back (std::move (body));
+    }
+
+  // Loops containing others are bigger, so putting loops in order of
+  // decreasing size puts outer loops first, and then giving each
+  // block in a loop that loop's index leaves it with its innermost
+  // loop.
+  //
+  std::vector<unsigned> order (bodies.size ());
+  for (unsigned i = 0; i < order.size (); i++)
+    order[i] = i;
+  std::stable_sort (order.begin (), order.end (),
+		    [&] (unsigned loop1, unsigned loop2)
+		    {
+		      return bodies[loop1].size () > bodies[loop2].size ();
+		    });
+
+  for (auto body_idx : order)
+    {
+      std::vector<BB *> &body = bodies[body_idx];
+      std::sort (body.begin (), body.end (),
+		 [this] (BB *block1, BB *block2)
+		 {
+		   return info (block1).rpo < info (block2).rpo;
+		 });
+
+      Loop loop { body[0], std::move (body) };
+      loop.parent = info (loop.header).loop;
+      if (loop.parent >= 0)
+	loop.depth = _loops[loop.parent].depth + 1;
+
+      for (auto block : loop.blocks)
+	info (block).loop = _loops.size ();
+
+      _loops.push_back (std::move (loop));
+    }
+}
+
+
+// Give each edge a probability.
+//
+void
+BlockFreq::calc_probs (Fun *fun)
+{
+  BB *exit_block = fun->exit_block ();
+
+  for (auto block : _rpo)
+    {
+      const std::vector<unsigned> &out_edges = info (block).out_edges;
+
+      if (out_edges.size () != 2)
+	{
+	  for (auto edge : out_edges)
+	    _edges[edge].prob = 1.0 / out_edges.size ();
+	  continue;
+	}
+
+      Edge &edge0 = _edges[out_edges[0]], &edge1 = _edges[out_edges[1]];
+
+      // Combine the prediction of each heuristic which distinguishes
+      // the two edges into the probability of EDGE0 using
+      // Dempster-Shafer theory.
+      //
+      double prob = 0.5;
+      auto predict = [&prob] (bool cond0, bool cond1, double cond_prob)
+	{
+	  if (cond0 == cond1)
+	    return;
+	  double pred = cond0 ? cond_prob : 1 - cond_prob;
+	  prob = prob * pred / (prob * pred + (1 - prob) * (1 - pred));
+	};
+
+      predict (edge0.back, edge1.back, LOOP_BRANCH_PROB);
+
+      int loop = info (block).loop;
+      if (loop >= 0)
+	predict (in_loop (edge0.to, loop), in_loop (edge1.to, loop),
+		 LOOP_EXIT_PROB);
+
+      auto enters_loop = [this] (const Edge &edge)
+	{
+	  int loop = info (edge.to).loop;
+	  return (! edge.back && loop >= 0 && _loops[loop].header == edge.to);
+	};
+      predict (enters_loop (edge0), enters_loop (edge1), LOOP_HEADER_PROB);
+
+      predict (edge0.to != exit_block, edge1.to != exit_block, RETURN_PROB);
+
+      edge0.prob = prob;
+      edge1.prob = 1 - prob;
+    }
+}
+
+
+// Propagate frequencies from HEADER through the blocks of the loop
+// with index LOOP in _loops, or through the whole function if LOOP is
+// -1.
+//
+// Blocks are visited in reverse post-order, which is a topological
+// order ignoring back edges.  The frequency of each block is the sum
+// of the frequencies of its incoming edges, scaled by how often it
+// repeats if it's the header of an inner loop, for which the back
+// edge probabilities have already been calculated.
+//
+void
+BlockFreq::propagate (BB *header, int loop)
+{
+  for (auto block : loop < 0 ? _rpo : _loops[loop].blocks)
+    {
+      if (! in_loop (block, loop))
+	continue;
+
+      BlockInfo &block_info = info (block);
+
+      double freq = 0, cyclic_prob = 0;
+      for (auto edge_idx : block_info.in_edges)
+	{
+	  const Edge &edge = _edges[edge_idx];
+	  if (! in_loop (edge.from, loop) || info (edge.from).rpo < 0)
+	    continue;
+
+	  if (edge.back)
+	    cyclic_prob += edge.back_prob;
+	  else
+	    freq += edge.freq;
+	}
+
+      if (block == header)
+	freq = 1;
+      if (block != header || loop < 0)
+	freq /= 1 - std::min (cyclic_prob, MAX_CYCLIC_PROB);
+
+      block_info.freq = freq;
+
+      for (auto edge_idx : block_info.out_edges)
+	{
+	  Edge &edge = _edges[edge_idx];
+	  edge.freq = freq * edge.prob;
+	  if (loop >= 0 && edge.back && edge.to == header)
+	    edge.back_prob = edge.freq;
+	}
+    }
+}
+
+
+// Return true if BLOCK is in the loop with index LOOP in _loops; any
+// block is in loop -1.
+//
+bool
+BlockFreq::in_loop (const BB *block, int loop) const
+{
+  if (loop < 0)
+    return true;
+
+  for (int l = info (block).loop; l >= 0; l = _loops[l].parent)
+    if (l == loop)
+      return true;
+
+  return false;
+}
+
+
+// Return the estimated number of times BLOCK is executed per call of
+// the function.  This is zero for unreachable blocks.
+//
+double
+BlockFreq::freq (const BB *block) const
+{
+  return info (block).freq;
+}
+
+// Return the estimated number of times control passes from FROM to its
+// successor TO per call of the function.
+//
+double
+BlockFreq::edge_freq (const BB *from, const BB *to) const
+{
+  return edge (from, to).freq;
+}
+
+// Return the estimated probability that control passes from FROM to
+// its successor TO when FROM is executed.
+//
+double
+BlockFreq::prob (const BB *from, const BB *to) const
+{
+  return edge (from, to).prob;
+}
+
+// Return the number of loops containing BLOCK.
+//
+unsigned
+BlockFreq::loop_depth (const BB *block) const
+{
+  int loop = info (block).loop;
+  return loop < 0 ? 0 : _loops[loop].depth + 1;
+}
+
+
+// Return the edge from FROM to TO.
+//
+const BlockFreq::Edge &
+BlockFreq::edge (const BB *from, const BB *to) const
+{
+  for (auto edge_idx : info (from).out_edges)
+    if (_edges[edge_idx].to == to)
+      return _edges[edge_idx];
+
+  check_assertion (false, "No edge between blocks");
+  return _edges[0];
+}
+
+
+// Return the information about BLOCK.
+//
+const BlockFreq::BlockInfo &
+BlockFreq::info (const BB *block) const
+{
+  return _blocks[block->num ()];
+}
+
+BlockFreq::BlockInfo &
+BlockFreq::info (const BB *block)
+{
+  return _blocks[block->num ()];
+}
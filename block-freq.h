@@ -0,0 +1,185 @@
+// block-freq.h -- Static estimation of IR block execution frequencies
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#ifndef __BLOCK_FREQ_H__
+#define __BLOCK_FREQ_H__
+
+#include <vector>
+
+#include "edge-profile.h"
+
+
+class Fun;
+class BB;
+
+
+// Estimated execution frequencies of the blocks in a function, and of
+// the control-flow edges between them, relative to one call of the
+// function, without running it.
+//
+// Loops are found using a depth-first search from the entry block:
+// the target of every edge back to a block still being searched is a
+// loop header, and its loop is the blocks searched from the header
+// which can reach the source of such an edge.
+//
+// Each conditional branch is given a probability by combining the
+// predictions of Ball and Larus's loop heuristics (loop back edges are
+// usually taken, loop exits usually not, and loop headers usually
+// entered) and their return heuristic (paths to the exit block are
+// less likely), as described by Wu and Larus in "Static Branch
+// Frequency and Program Profile Analysis".  Frequencies are then
+// propagated from the entry block in topological order, treating each
+// loop, innermost first, as a single block which repeats according to
+// the probability of its back edges.
+//
+// Alternatively, frequencies can be taken from measured counts in an
+// EdgeProfile, for which loops are still found, but not used.
+//
+// The function must not be changed while this exists.
+//
+class BlockFreq
+{
+public:
+
+  // Estimate frequencies for FUN.
+  //
+  BlockFreq (Fun *fun);
+
+  // Use the frequencies in COUNTS, which must be for FUN's flow graph
+  // (see EdgeProfile::find), instead of estimating them.  Branch
+  // probabilities are still estimated for blocks never executed.
+  //
+  BlockFreq (Fun *fun, const EdgeProfile::FunCounts &counts);
+
+
+  // Return the estimated number of times BLOCK is executed per call of
+  // the function.  This is zero for unreachable blocks.
+  //
+  double freq (const BB *block) const;
+
+  // Return the estimated number of times control passes from FROM to
+  // its successor TO per call of the function.
+  //
+  double edge_freq (const BB *from, const BB *to) const;
+
+  // Return the estimated probability that control passes from FROM
+  // to its successor TO when FROM is executed.
+  //
+  double prob (const BB *from, const BB *to) const;
+
+  // Return the number of loops containing BLOCK.
+  //
+  unsigned loop_depth (const BB *block) const;
+
+
+private:
+
+  // A control-flow edge.  A block's fall-through and branch target
+  // may be the same block, in which case there's only one edge.
+  //
+  struct Edge
+  {
+    BB *from, *to;
+
+    // True if this goes back to a block being searched when it was
+    // found, so ends a trip around a loop.
+    //
+    bool back = false;
+
+    double prob = 0, freq = 0;
+
+    // The frequency of this back edge, relative to one entry into
+    // the loop it closes.
+    //
+    double back_prob = 0;
+  };
+
+  // A loop.
+  //
+  struct Loop
+  {
+    BB *header;
+
+    // The blocks in this loop, including those in inner loops, in
+    // reverse post-order, so starting with the header.
+    //
+    std::vector<BB *> blocks;
+
+    // The index in _loops of the innermost loop containing this one,
+    // or -1.
+    //
+    int parent = -1;
+
+    unsigned depth = 0;
+  };
+
+  // Information about each block.
+  //
+  struct BlockInfo
+  {
+    // The block's position in reverse post-order, or -1 if it's
+    // unreachable.
+    //
+    int rpo = -1;
+
+    // Indices in _edges of edges into and out of this block.
+    //
+    std::vector<unsigned> in_edges, out_edges;
+
+    // The index in _loops of the innermost loop containing this
+    // block, or -1.
+    //
+    int loop = -1;
+
+    double freq = 0;
+  };
+
+
+  // Find edges, a reverse post-order, and loops.
+  //
+  void find_loops (Fun *fun);
+
+  // Give each edge a probability.
+  //
+  void calc_probs (Fun *fun);
+
+  // Propagate frequencies from HEADER through the blocks of the loop
+  // with index LOOP in _loops, or through the whole function if LOOP
+  // is -1.
+  //
+  void propagate (BB *header, int loop);
+
+  // Return true if BLOCK is in the loop with index LOOP in _loops; any
+  // block is in loop -1.
+  //
+  bool in_loop (const BB *block, int loop) const;
+
+  // Return the edge from FROM to TO.
+  //
+  const Edge &edge (const BB *from, const BB *to) const;
+
+  // Return the information about BLOCK.
+  //
+  const BlockInfo &info (const BB *block) const;
+  BlockInfo &info (const BB *block);
+
+
+  std::vector<Edge> _edges;
+  std::vector<Loop> _loops;
+
+  // Per-block information, indexed by block number.
+  //
+  std::vector<BlockInfo> _blocks;
+
+  // Reachable blocks in reverse post-order.
+  //
+  std::vector<BB *> _rpo;
+};
+
+
+#endif // __BLOCK_FREQ_H__
@@ -20,6 +20,8 @@ class CalcInsn : public Insn
 {
 public:
 
+  MEM_ACCOUNTED (CalcInsn);
+
   enum class Op { NONE, ADD, SUB, MUL, DIV, NEG };
 
 
@@ -0,0 +1,257 @@
+// char-scan.h -- Fast scanning of character runs
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#ifndef __CHAR_SCAN_H__
+#define __CHAR_SCAN_H__
+
+#if defined (__AVX2__) || defined (__SSE4_2__)
+# include <immintrin.h>
+#endif
+
+
+// Each of the following functions returns a pointer to the first
+// character in the range [BEG, END) which is not in a particular
+// class of characters, or END if all of them are.
+//
+// When available, AVX2 or SSE4.2 instructions are used to classify
+// many characters at once; the remainder, and everything on other
+// machines, is handled a character at a time.  Because most tokens
+// are short, the first character is always checked directly before
+// bothering with vector code.
+//
+
+
+// Return true if CH is a whitespace character.
+//
+static inline bool
+char_scan_is_whitespace (char ch)
+{
+  return ch == ' ' || ch == '\t' || ch == '\n';
+}
+
+// Return true if CH is a decimal digit.
+//
+static inline bool
+char_scan_is_digit (char ch)
+{
+  return ch >= '0' && ch <= '9';
+}
+
+// Return true if CH can continue an identifier.
+//
+static inline bool
+char_scan_is_id_char (char ch)
+{
+  return
+    ch == '_'
+    || (ch >= 'a' && ch <= 'z')
+    || (ch >= 'A' && ch <= 'Z')
+    || (ch >= '0' && ch <= '9');
+}
+
+
+#if defined (__AVX2__)
+
+// Number of characters classified in each vector step.
+//
+static const unsigned CHAR_SCAN_VEC_LEN = 32;
+
+// Return a bit-mask with a bit set for each of the CHAR_SCAN_VEC_LEN
+// characters at P which is a whitespace character.
+//
+static inline unsigned
+char_scan_whitespace_mask (const char *p)
+{
+  __m256i chars = _mm256_loadu_si256 (reinterpret_cast<const __m256i *> (p));
+  __m256i ws
+    = _mm256_or_si256 (_mm256_or_si256 (
+			 _mm256_cmpeq_epi8 (chars, _mm256_set1_epi8 (' ')),
+			 _mm256_cmpeq_epi8 (chars, _mm256_set1_epi8 ('\t'))),
+		       _mm256_cmpeq_epi8 (chars, _mm256_set1_epi8 ('\n')));
+  return _mm256_movemask_epi8 (ws);
+}
+
+// Return a vector with all bits set in each byte of CHARS whose
+// unsigned value, minus LOW, is less than or equal to SPAN.
+//
+static inline __m256i
+char_scan_in_range (__m256i chars, char low, char span)
+{
+  __m256i offs = _mm256_sub_epi8 (chars, _mm256_set1_epi8 (low));
+  return _mm256_cmpeq_epi8 (_mm256_min_epu8 (offs, _mm256_set1_epi8 (span)), offs);
+}
+
+// Return a bit-mask with a bit set for each of the CHAR_SCAN_VEC_LEN
+// characters at P which is a decimal digit.
+//
+static inline unsigned
+char_scan_digit_mask (const char *p)
+{
+  __m256i chars = _mm256_loadu_si256 (reinterpret_cast<const __m256i *> (p));
+  return _mm256_movemask_epi8 (char_scan_in_range (chars, '0', 9));
+}
+
+// Return a bit-mask with a bit set for each of the CHAR_SCAN_VEC_LEN
+// characters at P which can continue an identifier.
+//
+static inline unsigned
+char_scan_id_char_mask (const char *p)
+{
+  __m256i chars = _mm256_loadu_si256 (reinterpret_cast<const __m256i *> (p));
+
+  // Setting bit 5 folds upper-case letters into lower-case, and
+  // doesn't affect whether any other character is a letter.
+  //
+  __m256i folded = _mm256_or_si256 (chars, _mm256_set1_epi8 (0x20));
+
+  __m256i id_chars
+    = _mm256_or_si256 (_mm256_or_si256 (
+			 char_scan_in_range (folded, 'a', 25),
+			 char_scan_in_range (chars, '0', 9)),
+		       _mm256_cmpeq_epi8 (chars, _mm256_set1_epi8 ('_')));
+  return _mm256_movemask_epi8 (id_chars);
+}
+
+#elif defined (__SSE4_2__)
+
+// Number of characters classified in each vector step.
+//
+static const unsigned CHAR_SCAN_VEC_LEN = 16;
+
+// Return a bit-mask with a bit set for each of the CHAR_SCAN_VEC_LEN
+// characters at P which is in the character set or ranges in SET,
+// which contains SET_LEN characters.  MODE is either
+// _SIDD_CMP_EQUAL_ANY or _SIDD_CMP_RANGES.
+//
+template<int MODE>
+static inline unsigned
+char_scan_set_mask (const char *p, __m128i set, int set_len)
+{
+  __m128i chars = _mm_loadu_si128 (reinterpret_cast<const __m128i *> (p));
+  __m128i mask
+    = _mm_cmpestrm (set, set_len, chars, CHAR_SCAN_VEC_LEN,
+		    _SIDD_UBYTE_OPS | MODE | _SIDD_BIT_MASK);
+  return _mm_cvtsi128_si32 (mask);
+}
+
+static inline unsigned
+char_scan_whitespace_mask (const char *p)
+{
+  return char_scan_set_mask<_SIDD_CMP_EQUAL_ANY>
+    (p, _mm_setr_epi8 (' ', '\t', '\n', 0, 0, 0, 0, 0,
+		       0, 0, 0, 0, 0, 0, 0, 0),
+     3);
+}
+
+static inline unsigned
+char_scan_digit_mask (const char *p)
+{
+  return char_scan_set_mask<_SIDD_CMP_RANGES>
+    (p, _mm_setr_epi8 ('0', '9', 0, 0, 0, 0, 0, 0,
+		       0, 0, 0, 0, 0, 0, 0, 0),
+     2);
+}
+
+static inline unsigned
+char_scan_id_char_mask (const char *p)
+{
+  return char_scan_set_mask<_SIDD_CMP_RANGES>
+    (p, _mm_setr_epi8 ('a', 'z', 'A', 'Z', '0', '9', '_', '_',
+		       0, 0, 0, 0, 0, 0, 0, 0),
+     8);
+}
+
+#endif // __SSE4_2__
+
+
+#if defined (__AVX2__) || defined (__SSE4_2__)
+
+// Scan [BEG, END) for the first character not in a class, using
+// IS_IN_CLASS to test single characters, and CLASS_MASK to test
+// CHAR_SCAN_VEC_LEN characters at once.
+//
+template<bool (*IS_IN_CLASS) (char), unsigned (*CLASS_MASK) (const char *)>
+static inline const char *
+char_scan_span (const char *beg, const char *end)
+{
+  const char *p = beg;
+
+  if (p == end || ! IS_IN_CLASS (*p))
+    return p;
+
+  while (end - p >= static_cast<long> (CHAR_SCAN_VEC_LEN))
+    {
+      unsigned not_in_class = ~CLASS_MASK (p);
+      if (CHAR_SCAN_VEC_LEN < 32)
+	not_in_class &= (1u << (CHAR_SCAN_VEC_LEN % 32)) - 1;
+      if (not_in_class)
+	return p + __builtin_ctz (not_in_class);
+      p += CHAR_SCAN_VEC_LEN;
+    }
+
+  while (p != end && IS_IN_CLASS (*p))
+    p++;
+
+  return p;
+}
+
+#else // ! (__AVX2__ || __SSE4_2__)
+
+template<bool (*IS_IN_CLASS) (char)>
+static inline const char *
+char_scan_span (const char *beg, const char *end)
+{
+  const char *p = beg;
+  while (p != end && IS_IN_CLASS (*p))
+    p++;
+  return p;
+}
+
+#endif
+
+
+#if defined (__AVX2__) || defined (__SSE4_2__)
+# define CHAR_SCAN_SPAN(class_name, beg, end) \
+  char_scan_span<char_scan_is_ ## class_name, char_scan_ ## class_name ## _mask> (beg, end)
+#else
+# define CHAR_SCAN_SPAN(class_name, beg, end) \
+  char_scan_span<char_scan_is_ ## class_name> (beg, end)
+#endif
+
+
+// Return a pointer to the first non-whitespace character in
+// [BEG, END), or END if there is none.
+//
+static inline const char *
+scan_whitespace (const char *beg, const char *end)
+{
+  return CHAR_SCAN_SPAN (whitespace, beg, end);
+}
+
+// Return a pointer to the first character in [BEG, END) which is not
+// a decimal digit, or END if there is none.
+//
+static inline const char *
+scan_digits (const char *beg, const char *end)
+{
+  return CHAR_SCAN_SPAN (digit, beg, end);
+}
+
+// Return a pointer to the first character in [BEG, END) which cannot
+// continue an identifier, or END if there is none.
+//
+static inline const char *
+scan_id_chars (const char *beg, const char *end)
+{
+  return CHAR_SCAN_SPAN (id_char, beg, end);
+}
+
+#undef CHAR_SCAN_SPAN
+
+
+#endif // __CHAR_SCAN_H__
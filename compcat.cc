@@ -1,51 +1,1520 @@
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
 #include <iostream>
+#include <fstream>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "trace.h"
+#include "perf-counters.h"
+#include "mem-account.h"
+#include "parallel-for.h"
+#include "work-pool.h"
+#include "stats.h"
 
 #include "fun.h"
 #include "prog.h"
 #include "prog-text-writer.h"
+#include "prog-bin-writer.h"
 
+#include "file-contents.h"
 #include "file-src-context.h"
 #include "src-file-input.h"
 #include "prog-text-reader.h"
+#include "prog-bin-reader.h"
 
-int main (int argc, const char *const *argv)
+#include "fun-cache.h"
+#include "fun-interp.h"
+#include "fun-vm.h"
+#include "fun-jit.h"
+#include "edge-profile.h"
+#include "edge-counters.h"
+#include "request-server.h"
+
+
+// A description of the passes run by optimize_fun, for cache keys.
+//
+static const char OPT_PIPELINE[]
+  = "combine_blocks remove_unreachable update_dominators"
+    " update_post_dominators convert_to_ssa_form propagate_through_copies"
+    " convert_from_ssa_form remove_useless_copies";
+
+// Optimize the function FUN, called NAME.  If NUM_REGS is non-zero,
+// then allocate registers for a machine with that many.
+//
+static void
+optimize_fun (const std::string &name, Fun *fun, unsigned num_regs)
 {
-  if (argc != 2)
+  TRACE_SPAN ("optimize", name);
+
+  fun->combine_blocks ();
+  fun->remove_unreachable ();
+
+  fun->update_dominators ();
+  fun->update_post_dominators ();
+
+  fun->convert_to_ssa_form ();
+  fun->propagate_through_copies ();
+  fun->convert_from_ssa_form ();
+
+  fun->remove_useless_copies ();
+
+  if (num_regs)
+    fun->allocate_registers (num_regs);
+}
+
+
+// Encoding a function to find its cache key and reading its cache
+// entry take about as long as optimizing and writing a function with
+// this many instructions, so smaller ones aren't worth caching.
+//
+static constexpr std::size_t MIN_CACHED_FUN_INSNS = 40;
+
+// If the function FUN called NAME is worth caching, set KEY to its
+// cache key, starting from CACHE_SALT, and return true; otherwise
+// return false.  Functions with fewer than MIN_CACHED_FUN_INSNS
+// instructions aren't worth caching.
+//
+static bool
+fun_cache_key (const std::string &name, Fun *fun,
+	       const FunCache::Key &cache_salt, FunCache::Key &key)
+{
+  std::size_t num_insns = 0;
+  for (auto block : fun->blocks ())
+    num_insns += block->insns ().size ();
+  if (num_insns < MIN_CACHED_FUN_INSNS)
+    return false;
+
+  // The binary encoding of the unoptimized function is a canonical
+  // representation of it.
+  //
+  key = FunCache::key (cache_salt, name, ProgBinWriter::encode_fun (fun));
+
+  return true;
+}
+
+// Return the output for the function FUN called NAME, as it is now:
+// its text representation, with blocks ordered according to LAYOUT,
+// and annotated with any counts for it in PROFILE if that's non-zero,
+// or if WRITE_BIN is true, its binary encoding.
+//
+static std::string
+encode_fun_output (const std::string &name, Fun *fun, bool write_bin,
+		   FunTextWriter::Layout layout, const EdgeProfile *profile)
+{
+  if (write_bin)
+    return ProgBinWriter::encode_fun (fun);
+
+  ProgTextWriter fun_writer;
+  fun_writer.set_block_layout (layout);
+  fun_writer.set_profile (profile);
+  fun_writer.write_fun (name, fun);
+  return std::string (fun_writer.out ().contents ());
+}
+
+// Return the output for the function FUN called NAME, as for
+// encode_fun_output.  If OPTIMIZE is true, FUN is optimized first,
+// with registers allocated if NUM_REGS is non-zero.
+//
+// If CACHE is non-zero, and it holds the output for a function
+// identical to FUN, that is returned without optimizing; otherwise
+// the new output is added to the cache if FUN is worth caching.
+// CACHE_SALT is the starting point for cache keys, describing the
+// other arguments.
+//
+static std::string
+fun_output (const std::string &name, Fun *fun, bool optimize,
+	    unsigned num_regs, bool write_bin, FunTextWriter::Layout layout,
+	    const EdgeProfile *profile,
+	    FunCache *cache, const FunCache::Key &cache_salt)
+{
+  FunCache::Key key;
+  if (cache && ! fun_cache_key (name, fun, cache_salt, key))
+    cache = 0;
+
+  std::string output;
+  if (cache && cache->lookup (key, output))
+    return output;
+
+  if (optimize)
+    optimize_fun (name, fun, num_regs);
+
+  output = encode_fun_output (name, fun, write_bin, layout, profile);
+
+  if (cache)
+    cache->store (key, output);
+
+  return output;
+}
+
+
+// Return a string identifying this build of the program, for cache
+// keys.  This uses the executable's identity and modification time,
+// so any rebuild invalidates cached results.
+//
+static std::string
+tool_id ()
+{
+  std::string id ("compcat");
+
+  struct stat stat_buf;
+  if (stat ("/proc/self/exe", &stat_buf) == 0)
     {
-      std::cerr << "Usage: " << argv[0] << " SRC_FILE\n";
-      return 1;
+      id += ' ';
+      id += std::to_string (stat_buf.st_dev);
+      id += ':';
+      id += std::to_string (stat_buf.st_ino);
+      id += ' ';
+      id += std::to_string (stat_buf.st_size);
+      id += ' ';
+      id += std::to_string (stat_buf.st_mtim.tv_sec);
+      id += '.';
+      id += std::to_string (stat_buf.st_mtim.tv_nsec);
     }
 
-  try
+  return id;
+}
+
+
+// Parse SIZE, a number of bytes optionally followed by a K, M, or G
+// suffix, store the result in BYTES, and return true.  If SIZE is
+// invalid, return false.
+//
+static bool
+parse_size (const char *size, std::uint64_t &bytes)
+{
+  char *end;
+  bytes = std::strtoull (size, &end, 10);
+
+  if (end == size)
+    return false;
+
+  switch (*end)
+    {
+    case 'G': bytes <<= 10; [[fallthrough]];
+    case 'M': bytes <<= 10; [[fallthrough]];
+    case 'K': bytes <<= 10; end++; break;
+    }
+
+  return *end == '\0';
+}
+
+
+// An input file, and where its output goes.
+//
+struct Input
+{
+  std::string src_file_name;
+
+  // Output file name, or empty to use the default.
+  //
+  std::string out_file_name;
+};
+
+// Options controlling what compcat does.
+//
+struct Options
+{
+  std::vector<Input> inputs;
+
+  // If non-empty, the default output for each input is a file of the
+  // same name in this directory, instead of standard output.
+  //
+  std::string output_dir;
+
+  std::string trace_file_name;
+  bool print_stats = false;
+  bool print_perf = false;
+  bool perf_counters = true;
+  bool print_mem = false;
+  bool read_bin = false, write_bin = false;
+  bool optimize = true;
+
+  // If non-zero, allocate registers for a machine with this many.
+  //
+  unsigned regalloc_regs = 0;
+
+  // How to order blocks in text output.
+  //
+  FunTextWriter::Layout block_layout = FunTextWriter::Layout::DEPTH_FIRST;
+
+  // If non-zero, a profile used to annotate text output, and for
+  // block layout.
+  //
+  std::shared_ptr<const EdgeProfile> profile;
+  bool stream = false;
+
+  // Number of threads to use, or zero to use the default.
+  //
+  unsigned num_threads = 0;
+
+  std::string cache_dir;
+  std::uint64_t cache_size = std::uint64_t (1) << 30;
+
+  // If non-empty, act as a server listening on this socket.
+  //
+  std::string serve_socket_name;
+
+  // If non-empty, ask the server listening on this socket to do the
+  // work.
+  //
+  std::string client_socket_name;
+
+  // If non-empty, instead of writing the program, run the function
+  // with this name on the arguments RUN_ARGS, stopping after
+  // RUN_LIMIT instructions if that's non-zero.  The engine RUN_ENGINE
+  // is checked against the reference interpreter, and timed over
+  // RUN_REPEAT calls if that's non-zero.
+  //
+  std::string run_fun;
+  std::vector<int> run_args;
+  std::uint64_t run_limit = 0;
+  std::string run_engine = "interp";
+  unsigned run_repeat = 0;
+
+  // If non-empty, count how often each edge of the --run function is
+  // followed, and add the counts to the profile in this file.
+  //
+  std::string profile_gen;
+};
+
+
+// Add the inputs listed in the response file FILE_NAME to INPUTS.
+// Each non-blank line holds an input file name, optionally followed
+// by whitespace and an output file name.
+//
+static void
+read_response_file (const std::string &file_name, std::vector<Input> &inputs)
+{
+  FileContents contents (file_name);
+  std::string_view data = contents.view ();
+
+  auto is_space = [] (char ch) { return ch == ' ' || ch == '\t' || ch == '\r'; };
+
+  while (! data.empty ())
+    {
+      std::size_t eol = data.find ('\n');
+      std::string_view line = data.substr (0, eol);
+      data.remove_prefix (eol == data.npos ? data.size () : eol + 1);
+
+      // Split the line into whitespace-separated words.
+      //
+      std::vector<std::string_view> words;
+      for (;;)
+	{
+	  while (! line.empty () && is_space (line.front ()))
+	    line.remove_prefix (1);
+	  if (line.empty ())
+	    break;
+
+	  std::size_t len = 0;
+	  while (len < line.size () && ! is_space (line[len]))
+	    len++;
+	  words.push_back (line.substr (0, len));
+	  line.remove_prefix (len);
+	}
+
+      if (words.empty ())
+	continue;
+      if (words.size () > 2)
+	throw std::runtime_error (file_name + ": Invalid line: "
+				  + std::string (words[0]) + " ...");
+
+      Input input;
+      input.src_file_name = words[0];
+      if (words.size () == 2)
+	input.out_file_name = words[1];
+      inputs.push_back (input);
+    }
+}
+
+
+// Parse the --run argument SPEC, "FUN:ARG,...", into OPTS.  Return
+// false if it's invalid.
+//
+static bool
+parse_run_spec (const std::string &spec, Options &opts)
+{
+  std::size_t colon = spec.find (':');
+  opts.run_fun = spec.substr (0, colon);
+  if (opts.run_fun.empty ())
+    return false;
+
+  opts.run_args.clear ();
+  if (colon == std::string::npos || colon + 1 == spec.size ())
+    return true;
+
+  const char *p = spec.c_str () + colon + 1;
+  for (;;)
+    {
+      char *end;
+      errno = 0;
+      long arg = std::strtol (p, &end, 0);
+      if (end == p || errno != 0 || arg < INT_MIN || arg > INT_MAX)
+	return false;
+
+      opts.run_args.push_back (arg);
+
+      if (*end == '\0')
+	return true;
+      if (*end != ',')
+	return false;
+      p = end + 1;
+    }
+}
+
+
+// Parse the command-line arguments ARGS (not including the program
+// name) into OPTS, and return true, or return false if they're
+// invalid.  An argument "@FILE" adds the inputs listed in the
+// response file FILE.
+//
+static bool
+parse_args (const std::vector<std::string> &args, Options &opts)
+{
+  for (unsigned i = 0; i < args.size (); i++)
+    {
+      const std::string &arg = args[i];
+      bool has_val = i + 1 < args.size ();
+
+      if (arg == "--stats")
+	opts.print_stats = true;
+      else if (arg == "--perf")
+	opts.print_perf = true;
+      else if (arg == "--perf-times")
+	{
+	  opts.print_perf = true;
+	  opts.perf_counters = false;
+	}
+      else if (arg == "--mem-breakdown")
+	opts.print_mem = true;
+      else if (arg == "--read-bin")
+	opts.read_bin = true;
+      else if (arg == "--write-bin")
+	opts.write_bin = true;
+      else if (arg == "--no-opt")
+	opts.optimize = false;
+      else if (arg == "--regalloc" && has_val)
+	{
+	  char *end;
+	  opts.regalloc_regs = std::strtoul (args[++i].c_str (), &end, 10);
+	  if (*end != '\0' || opts.regalloc_regs < 2)
+	    return false;
+	}
+      else if (arg == "--layout" && has_val)
+	{
+	  const std::string &layout = args[++i];
+	  if (layout == "dfs")
+	    opts.block_layout = FunTextWriter::Layout::DEPTH_FIRST;
+	  else if (layout == "freq")
+	    opts.block_layout = FunTextWriter::Layout::FREQUENCY;
+	  else
+	    return false;
+	}
+      else if (arg == "--profile-use" && has_val)
+	{
+	  std::shared_ptr<EdgeProfile> profile (new EdgeProfile);
+	  profile->read (args[++i]);
+	  opts.profile = profile;
+	}
+      else if (arg == "--profile-gen" && has_val)
+	opts.profile_gen = args[++i];
+      else if (arg == "--stream")
+	opts.stream = true;
+      else if (arg == "--jobs" && has_val)
+	{
+	  opts.num_threads = std::atoi (args[++i].c_str ());
+	  if (opts.num_threads == 0)
+	    return false;
+	}
+      else if (arg == "--cache" && has_val)
+	opts.cache_dir = args[++i];
+      else if (arg == "--cache-size" && has_val)
+	{
+	  if (! parse_size (args[++i].c_str (), opts.cache_size))
+	    return false;
+	}
+      else if (arg == "--trace" && has_val)
+	opts.trace_file_name = args[++i];
+      else if ((arg == "--output-dir" || arg == "-d") && has_val)
+	opts.output_dir = args[++i];
+      else if (arg == "--serve" && has_val)
+	opts.serve_socket_name = args[++i];
+      else if (arg == "--client" && has_val)
+	opts.client_socket_name = args[++i];
+      else if (arg == "--run" && has_val)
+	{
+	  if (! parse_run_spec (args[++i], opts))
+	    return false;
+	}
+      else if (arg == "--run-limit" && has_val)
+	{
+	  char *end;
+	  opts.run_limit = std::strtoull (args[++i].c_str (), &end, 10);
+	  if (*end != '\0' || opts.run_limit == 0)
+	    return false;
+	}
+      else if (arg == "--engine" && has_val)
+	{
+	  opts.run_engine = args[++i];
+	  if (opts.run_engine != "interp" && opts.run_engine != "vm"
+	      && opts.run_engine != "jit")
+	    return false;
+	}
+      else if (arg == "--run-repeat" && has_val)
+	{
+	  char *end;
+	  opts.run_repeat = std::strtoul (args[++i].c_str (), &end, 10);
+	  if (*end != '\0' || opts.run_repeat == 0)
+	    return false;
+	}
+      else if (arg.size () > 1 && arg[0] == '-')
+	return false;
+      else if (arg.size () > 1 && arg[0] == '@')
+	read_response_file (arg.substr (1), opts.inputs);
+      else
+	opts.inputs.push_back (Input { arg, std::string () });
+    }
+
+  // A server gets its input files from requests, anything else needs
+  // at least one.
+  //
+  if (! opts.serve_socket_name.empty ())
+    return (opts.inputs.empty () && opts.client_socket_name.empty ()
+	    && ! opts.print_stats && ! opts.print_perf && ! opts.print_mem
+	    && opts.trace_file_name.empty () && opts.run_fun.empty ());
+  if (opts.inputs.empty ())
+    return false;
+
+  // Register allocation is done as the last optimization pass.
+  //
+  if (opts.regalloc_regs && ! opts.optimize)
+    return false;
+
+  // Annotations only appear in text, and profiles are collected by
+  // running a function.
+  //
+  if ((opts.profile && opts.write_bin)
+      || (! opts.profile_gen.empty () && opts.run_fun.empty ()))
+    return false;
+
+  // Running a function prints its results on standard output.
+  //
+  if (! opts.run_fun.empty ()
+      && (opts.inputs.size () != 1 || ! opts.output_dir.empty ()
+	  || ! opts.inputs[0].out_file_name.empty ()))
+    return false;
+
+  // Output from several inputs can only be concatenated on standard
+  // output if it's text, and not streamed.
+  //
+  if (opts.inputs.size () > 1 && opts.output_dir.empty ()
+      && (opts.write_bin || opts.stream))
+    for (auto &input : opts.inputs)
+      if (input.out_file_name.empty ())
+	return false;
+
+  return true;
+}
+
+
+// Return the function cache requested by OPTS, or zero if none was.
+//
+static std::unique_ptr<FunCache>
+make_cache (const Options &opts)
+{
+  if (opts.cache_dir.empty ())
+    return 0;
+
+  return std::make_unique<FunCache> (opts.cache_dir, opts.cache_size);
+}
+
+// Return the starting point for the cache keys of functions processed
+// as directed by OPTS.
+//
+static FunCache::Key
+cache_salt (const Options &opts)
+{
+  // The executable can't change while we're running, so its identity
+  // only needs to be found once.
+  //
+  static const std::string id = tool_id ();
+
+  // Everything besides the function itself which affects the
+  // output.
+  //
+  std::string salt = id;
+  salt += '\n';
+  salt += opts.optimize ? OPT_PIPELINE : "no-opt";
+  if (opts.regalloc_regs)
+    salt += " allocate_registers " + std::to_string (opts.regalloc_regs);
+  salt += '\n';
+  salt += opts.write_bin ? "bin" : "text";
+  if (! opts.write_bin
+      && opts.block_layout == FunTextWriter::Layout::FREQUENCY)
+    salt += " freq-layout";
+  if (opts.profile)
+    {
+      salt += "\nprofile\n";
+      salt += opts.profile->text ();
+    }
+
+  return FunCache::salt_key (salt);
+}
+
+
+// Return the contents of the input file SRC_FILE_NAME, or of the file
+// open on SRC_FD if that's not negative, to be processed as directed
+// by OPTS.  Streamed text is read strictly front to back, so a file
+// which can't be memory-mapped is left for the reader to read a
+// buffer at a time, instead of being read into memory all at once.
+//
+static std::unique_ptr<FileContents>
+input_contents (const Options &opts, const std::string &src_file_name,
+		int src_fd = -1)
+{
+  bool defer_read = opts.stream && ! opts.read_bin && opts.run_fun.empty ();
+
+  if (src_fd >= 0)
+    return std::make_unique<FileContents> (src_fd, src_file_name, defer_read);
+  else
+    return std::make_unique<FileContents> (src_file_name, defer_read);
+}
+
+
+// Read the program in the file SRC_FILE_NAME, whose contents are
+// CONTENTS, in the format given by OPTS, using up to NUM_THREADS
+// threads, and return it.
+//
+static Prog *
+read_prog (const Options &opts, const std::string &src_file_name,
+	   std::unique_ptr<FileContents> contents, unsigned num_threads)
+{
+  if (opts.read_bin)
+    {
+      ProgBinReader prog_reader (contents->view (), src_file_name);
+      return prog_reader.read ();
+    }
+  else
     {
       FileSrcContext src_context;
-      SrcFileInput inp (argv[1], src_context);
+      SrcFileInput inp (std::move (contents), src_file_name, src_context);
       ProgTextReader prog_reader (inp);
-      std::unique_ptr<Prog> prog (prog_reader.read ());
+      return prog_reader.read_parallel (num_threads);
+    }
+}
+
+
+// Run the function OPTS.run_fun in the program in the file
+// SRC_FILE_NAME, whose contents are CONTENTS, on the arguments
+// OPTS.run_args, and print its results and dynamic counts to standard
+// output.  The function is optimized first unless OPTS says not to,
+// so comparing counts shows the effect of optimization.
+//
+// The counts come from the reference interpreter; any other engine
+// requested is checked against it, and if OPTS.run_repeat is
+// non-zero, the engine is timed over that many calls.
+//
+// If OPTS.profile_gen is non-empty, edge counters are added to the
+// function before it's run, which are included in the dynamic counts,
+// and the edge counts from the first call are added to the profile in
+// that file.
+//
+static void
+run_fun (const Options &opts, const std::string &src_file_name,
+	 std::unique_ptr<FileContents> contents, unsigned num_threads)
+{
+  std::unique_ptr<Prog> prog
+    (read_prog (opts, src_file_name, std::move (contents), num_threads));
+
+  Fun *fun = prog->fun (opts.run_fun);
+  if (! fun)
+    throw std::runtime_error (src_file_name + ": No function called \""
+			      + opts.run_fun + "\"");
+
+  if (opts.optimize)
+    optimize_fun (opts.run_fun, fun, opts.regalloc_regs);
+
+  std::unique_ptr<EdgeCounters> counters;
+  if (! opts.profile_gen.empty ())
+    counters.reset (new EdgeCounters (fun));
+
+  FunInterp interp (fun);
+  interp.set_max_insns (opts.run_limit);
+
+  std::vector<int> results = interp.run (opts.run_args);
+  std::uint64_t insns = interp.insns ();
+
+  std::function<std::vector<int> ()> call
+    = [&] () { return interp.run (opts.run_args); };
+
+  std::unique_ptr<FunVM> vm;
+  if (opts.run_engine == "vm")
+    {
+      vm.reset (new FunVM (fun));
+      vm->set_max_jumps (opts.run_limit);
+      call = [&] () { return vm->run (opts.run_args); };
+    }
+
+  // The JIT needs a function not in SSA form, which the optimizer
+  // leaves it in anyway.
+  //
+  std::unique_ptr<FunJIT> jit;
+  if (opts.run_engine == "jit")
+    {
+      jit.reset (new FunJIT (fun));
+      jit->set_max_jumps (opts.run_limit);
+      call = [&] () { return jit->run (opts.run_args); };
+    }
+
+  if (opts.run_engine != "interp" && call () != results)
+    throw std::runtime_error ("Results from the " + opts.run_engine
+			      + " engine differ from the interpreter's");
+
+  if (counters)
+    {
+      counters->add_call (results);
+      results.resize (counters->first_counter_result ());
+
+      EdgeProfile::FunCounts counts = counters->counts ();
+      EdgeProfile profile;
+      if (access (opts.profile_gen.c_str (), F_OK) == 0)
+	profile.read (opts.profile_gen);
+      profile.add (opts.run_fun, counts);
+      profile.write (opts.profile_gen);
+    }
+
+  std::cout << opts.run_fun << " (";
+  for (unsigned i = 0; i < opts.run_args.size (); i++)
+    std::cout << (i == 0 ? "" : ", ") << opts.run_args[i];
+  std::cout << ") =";
+  for (unsigned i = 0; i < results.size (); i++)
+    std::cout << (i == 0 ? " " : ", ") << results[i];
+  std::cout << '\n';
 
-      for (auto [_, fun] : prog->functions ())
+  std::cout << "insns:              " << interp.insns () << '\n'
+	    << "block visits:       " << interp.block_visits () << '\n'
+	    << "branches taken:     " << interp.branches_taken () << '\n'
+	    << "branches not taken: " << interp.branches_not_taken () << '\n';
+  if (counters)
+    std::cout << "edge counters:      " << counters->num_counters () << '\n';
+
+  if (opts.run_repeat)
+    {
+      auto start = std::chrono::steady_clock::now ();
+      for (unsigned i = 0; i < opts.run_repeat; i++)
+	call ();
+      auto end = std::chrono::steady_clock::now ();
+
+      double secs = std::chrono::duration<double> (end - start).count ();
+      std::cout << opts.run_engine << " time per call: "
+		<< secs / opts.run_repeat * 1e6 << " us, "
+		<< insns * opts.run_repeat / secs / 1e6 << "M insns/sec\n";
+    }
+}
+
+
+// Process the program in the file SRC_FILE_NAME, whose contents are
+// CONTENTS, as directed by OPTS, using up to NUM_THREADS threads, and
+// write the result to the file descriptor OUT_FD.  If CACHE is
+// non-zero, it's used to cache the output of each function.
+//
+static void
+process (const Options &opts, const std::string &src_file_name,
+	 std::unique_ptr<FileContents> contents,
+	 int out_fd, unsigned num_threads, FunCache *cache)
+{
+  bool write_bin = opts.write_bin, optimize = opts.optimize;
+  unsigned num_regs = opts.regalloc_regs;
+  FunTextWriter::Layout layout = opts.block_layout;
+  const EdgeProfile *profile = opts.profile.get ();
+
+  FunCache::Key salt;
+  if (cache)
+    salt = cache_salt (opts);
+
+  if (opts.stream)
+    {
+      // Read, optimize, write, and delete each function in turn,
+      // so that only one function is ever in memory.
+      //
+      ProgTextWriter text_writer (out_fd);
+      text_writer.set_block_layout (layout);
+      text_writer.set_profile (profile);
+      ProgBinWriter bin_writer (out_fd);
+
+      auto process_fun = [&] (const std::string &name, Fun *fun)
+	{
+	  std::unique_ptr<Fun> fun_holder (fun);
+
+	  if (cache)
+	    {
+	      std::string output
+		= fun_output (name, fun, optimize, num_regs, write_bin, layout,
+			      profile, cache, salt);
+	      if (write_bin)
+		bin_writer.add_encoded_fun (name, std::move (output));
+	      else
+		text_writer.out () << output;
+	      return;
+	    }
+
+	  if (optimize)
+	    optimize_fun (name, fun, num_regs);
+
+	  if (write_bin)
+	    bin_writer.add_fun (name, fun);
+	  else
+	    text_writer.write_fun (name, fun);
+	};
+
+      if (opts.read_bin)
+	{
+	  ProgBinReader prog_reader (contents->view (), src_file_name);
+	  prog_reader.read_funs (process_fun);
+	}
+      else
+	{
+	  FileSrcContext src_context;
+	  SrcFileInput inp (std::move (contents), src_file_name, src_context);
+	  ProgTextReader prog_reader (inp);
+	  prog_reader.read_funs ([&] (const std::string &name, Fun *fun)
+				 {
+				   // Errors can't refer to earlier functions.
+				   //
+				   inp.forget_previous_lines ();
+				   process_fun (name, fun);
+				 });
+	}
+
+      if (write_bin)
+	bin_writer.finish ();
+      else
+	text_writer.flush ();
+    }
+  else
+    {
+      std::unique_ptr<Prog> prog
+	(read_prog (opts, src_file_name, std::move (contents), num_threads));
+
+      if (cache)
+	{
+	  // Produce the output for each function in parallel, and
+	  // then write it in order.  If there are errors, the first
+	  // one in function order is reported, as it would be
+	  // without parallelism.
+	  //
+	  // All functions are looked up and optimized before any are
+	  // written, as in the uncached case; interleaving the two
+	  // scatters each function's allocations, and makes
+	  // optimizing much slower.
+	  //
+	  const std::vector<std::pair<std::string, Fun *>> &funs
+	    = prog->functions ();
+	  std::vector<std::string> outputs (funs.size ());
+	  std::vector<std::exception_ptr> errors (funs.size ());
+	  std::vector<FunCache::Key> keys (funs.size ());
+
+	  enum CacheState : char { UNCACHED, MISS, HIT };
+	  std::vector<CacheState> states (funs.size (), UNCACHED);
+
+	  parallel_for (funs.size (), num_threads, [&] (unsigned idx)
+	    {
+	      auto [name, fun] = funs[idx];
+	      try
+		{
+		  if (fun_cache_key (name, fun, salt, keys[idx]))
+		    states[idx]
+		      = cache->lookup (keys[idx], outputs[idx]) ? HIT : MISS;
+		  if (states[idx] != HIT && optimize)
+		    optimize_fun (name, fun, num_regs);
+		}
+	      catch (std::runtime_error &)
+		{
+		  errors[idx] = std::current_exception ();
+		}
+	    });
+
+	  parallel_for (funs.size (), num_threads, [&] (unsigned idx)
+	    {
+	      if (states[idx] != MISS || errors[idx])
+		return;
+
+	      auto [name, fun] = funs[idx];
+	      outputs[idx]
+		= encode_fun_output (name, fun, write_bin, layout, profile);
+	      cache->store (keys[idx], outputs[idx]);
+	    });
+
+	  for (auto &error : errors)
+	    if (error)
+	      std::rethrow_exception (error);
+
+	  // Functions that aren't cached are written directly.
+	  //
+	  if (write_bin)
+	    {
+	      ProgBinWriter prog_writer (out_fd);
+	      for (unsigned idx = 0; idx < funs.size (); idx++)
+		if (states[idx] == UNCACHED)
+		  prog_writer.add_fun (funs[idx].first, funs[idx].second);
+		else
+		  prog_writer.add_encoded_fun (funs[idx].first,
+					       std::move (outputs[idx]));
+	      prog_writer.finish ();
+	    }
+	  else
+	    {
+	      ProgTextWriter prog_writer (out_fd);
+	      prog_writer.set_block_layout (layout);
+	      prog_writer.set_profile (profile);
+	      for (unsigned idx = 0; idx < funs.size (); idx++)
+		if (states[idx] == UNCACHED)
+		  prog_writer.write_fun (funs[idx].first, funs[idx].second);
+		else
+		  prog_writer.out () << outputs[idx];
+	      prog_writer.flush ();
+	    }
+	}
+      else
+	{
+	  if (optimize)
+	    for (auto [name, fun] : prog->functions ())
+	      optimize_fun (name, fun, num_regs);
+
+	  if (write_bin)
+	    {
+	      ProgBinWriter prog_writer (out_fd);
+	      prog_writer.write (&*prog);
+	    }
+	  else
+	    {
+	      ProgTextWriter prog_writer (out_fd);
+	      prog_writer.set_block_layout (layout);
+	      prog_writer.set_profile (profile);
+	      prog_writer.write_parallel (&*prog, num_threads);
+	    }
+	}
+    }
+}
+
+
+// Handle a server request with the command-line arguments ARGS,
+// reading input from the file descriptor SRC_FD, and writing output
+// to OUT_FD.  Error messages are stored in ERRORS, and the exit
+// status is returned, just as if compcat had been run directly.
+//
+// If CACHE is non-zero, it's the server's function cache, which is
+// used by all requests.  A request's own cache options are ignored,
+// so that the cache is set up only once, when the server starts.
+//
+static int
+handle_request (const std::vector<std::string> &args, int src_fd, int out_fd,
+		std::string &errors, FunCache *cache)
+{
+  // Response files, profiles, and output files would be relative to
+  // the server's directory, so those are handled by the client.
+  //
+  Options opts;
+  for (auto &arg : args)
+    if ((arg.size () > 1 && arg[0] == '@') || arg == "--profile-use")
+      {
+	errors = "Invalid request\n";
+	return 1;
+      }
+  if (! parse_args (args, opts) || ! opts.serve_socket_name.empty ()
+      || ! opts.client_socket_name.empty ()
+      || opts.print_stats || opts.print_perf || opts.print_mem
+      || ! opts.trace_file_name.empty () || ! opts.run_fun.empty ()
+      || opts.inputs.size () != 1 || ! opts.output_dir.empty ()
+      || ! opts.inputs[0].out_file_name.empty ())
+    {
+      errors = "Invalid request\n";
+      return 1;
+    }
+
+  // Requests are already spread over the server's worker threads, so
+  // by default, each one only uses a single thread.
+  //
+  unsigned num_threads = opts.num_threads ? opts.num_threads : 1;
+
+  try
+    {
+      const std::string &src_file_name = opts.inputs[0].src_file_name;
+      std::unique_ptr<FileContents> contents
+	= input_contents (opts, src_file_name, src_fd);
+      process (opts, src_file_name, std::move (contents), out_fd, num_threads,
+	       cache);
+    }
+  catch (std::runtime_error &err)
+    {
+      errors = err.what ();
+      errors += '\n';
+    }
+
+  if (cache)
+    cache->evict ();
+
+  return 0;
+}
+
+
+// Ask the server listening on OPTS.client_socket_name to handle the
+// command-line arguments ARGS.  If it did, store the exit status in
+// STATUS, and return true.  If there's no server, or the request
+// can't be handled by one, return false, in which case the caller
+// should do the work itself.
+//
+static bool
+run_client (const Options &opts, const std::vector<std::string> &args,
+	    int &status)
+{
+  // Statistics, counters, memory accounting, and traces are collected
+  // per-process, so they only make sense locally, and running a
+  // function is always done locally.  A profile has already been
+  // read, and would be relative to the server's directory anyway.
+  //
+  if (opts.print_stats || opts.print_perf || opts.print_mem
+      || ! opts.trace_file_name.empty () || ! opts.run_fun.empty ()
+      || opts.profile)
+    return false;
+
+  // The server handles a single input written to standard output.
+  //
+  if (opts.inputs.size () != 1 || ! opts.output_dir.empty ()
+      || ! opts.inputs[0].out_file_name.empty ())
+    return false;
+  for (auto &arg : args)
+    if (arg.size () > 1 && arg[0] == '@')
+      return false;
+
+  // If the input can't be opened, let the local code report it.
+  //
+  const std::string &src_file_name = opts.inputs[0].src_file_name;
+  bool use_stdin = (src_file_name == "-");
+  int src_fd
+    = use_stdin ? 0 : open (src_file_name.c_str (), O_RDONLY | O_CLOEXEC);
+  if (src_fd < 0)
+    return false;
+
+  // Pass on everything but the --client option itself.
+  //
+  std::vector<std::string> server_args;
+  for (unsigned i = 0; i < args.size (); i++)
+    if (args[i] == "--client")
+      i++;
+    else
+      server_args.push_back (args[i]);
+
+  std::string errors;
+  bool handled;
+  try
+    {
+      handled
+	= RequestServer::send_request (opts.client_socket_name, server_args,
+				       src_fd, STDOUT_FILENO, status, errors);
+    }
+  catch (...)
+    {
+      if (! use_stdin)
+	close (src_fd);
+      throw;
+    }
+
+  if (! use_stdin)
+    close (src_fd);
+
+  std::cerr << errors;
+
+  return handled;
+}
+
+
+// Return the name of the output file for INPUT, as directed by OPTS,
+// or an empty string if its output goes to standard output.
+//
+static std::string
+output_file_name (const Options &opts, const Input &input)
+{
+  if (! input.out_file_name.empty () || opts.output_dir.empty ())
+    return input.out_file_name;
+
+  const std::string &src_file_name = input.src_file_name;
+  if (src_file_name == "-")
+    throw std::runtime_error ("-: No output file name for standard input");
+
+  std::size_t slash = src_file_name.rfind ('/');
+  std::string base_name
+    = (slash == std::string::npos
+       ? src_file_name : src_file_name.substr (slash + 1));
+
+  return opts.output_dir + "/" + base_name;
+}
+
+
+// Return a file descriptor for writing the file FILE_NAME, which is
+// created or truncated.
+//
+static int
+open_output_file (const std::string &file_name)
+{
+  int fd = open (file_name.c_str (), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+		 0666);
+  if (fd < 0)
+    throw std::runtime_error (file_name + ": Cannot create: "
+			      + strerror (errno));
+  return fd;
+}
+
+
+// Process every input in OPTS.inputs, using up to NUM_THREADS threads.
+//
+// All input files, and the functions within them, are processed on a
+// single work-stealing pool, so one large file doesn't hold up the
+// others, and threads stay busy until everything's done.  Output sent
+// to standard output, and error messages, appear in input order.
+//
+static void
+process_batch (const Options &opts, unsigned num_threads)
+{
+  // The state of one input file.
+  //
+  struct File
+  {
+    std::string src_file_name;
+
+    // Output file name, or empty for standard output.
+    //
+    std::string out_file_name;
+
+    std::unique_ptr<Prog> prog;
+
+    // Output for each function, and any error it caused.
+    //
+    std::vector<std::string> outputs;
+    std::vector<std::exception_ptr> errors;
+
+    // Number of functions still being processed.
+    //
+    std::atomic<unsigned> num_unfinished_funs { 0 };
+
+    // Output for standard output, and any error message, waiting to
+    // be reported in order.
+    //
+    std::string stdout_output;
+    std::string error;
+    bool finished = false;
+  };
+
+  std::vector<std::unique_ptr<File>> files;
+  std::set<std::string> out_file_names;
+
+  for (auto &input : opts.inputs)
+    {
+      std::unique_ptr<File> file (new File);
+      file->src_file_name = input.src_file_name;
+      file->out_file_name = output_file_name (opts, input);
+
+      if (! file->out_file_name.empty ()
+	  && ! out_file_names.insert (file->out_file_name).second)
+	throw std::runtime_error (file->out_file_name
+				  + ": Output file used for several inputs");
+
+      files.push_back (std::move (file));
+    }
+
+  std::unique_ptr<FunCache> cache = make_cache (opts);
+  FunCache::Key salt;
+  if (cache)
+    salt = cache_salt (opts);
+  bool write_bin = opts.write_bin, optimize = opts.optimize;
+  unsigned num_regs = opts.regalloc_regs;
+  FunTextWriter::Layout layout = opts.block_layout;
+  const EdgeProfile *profile = opts.profile.get ();
+
+  // Files whose results have been reported are before NEXT_REPORT.
+  //
+  unsigned next_report = 0;
+  std::mutex report_lock;
+  OutputBuffer stdout_buf (STDOUT_FILENO);
+
+  // Mark FILE_IDX as finished, and report the results of any files
+  // whose turn has come.
+  //
+  auto finish_file = [&] (unsigned file_idx)
+    {
+      std::lock_guard<std::mutex> lock (report_lock);
+
+      files[file_idx]->finished = true;
+
+      while (next_report < files.size () && files[next_report]->finished)
+	{
+	  File &file = *files[next_report++];
+
+	  if (! file.stdout_output.empty ())
+	    {
+	      stdout_buf << file.stdout_output;
+	      stdout_buf.flush ();
+	      std::string ().swap (file.stdout_output);
+	    }
+
+	  if (! file.error.empty ())
+	    std::cerr << file.error << '\n';
+	}
+    };
+
+  // Write the output for the file FILE_IDX, all of whose functions
+  // have been processed.
+  //
+  auto write_file = [&] (unsigned file_idx)
+    {
+      File &file = *files[file_idx];
+
+      try
+	{
+	  for (auto &error : file.errors)
+	    if (error)
+	      std::rethrow_exception (error);
+
+	  const std::vector<std::pair<std::string, Fun *>> &funs
+	    = file.prog->functions ();
+
+	  if (file.out_file_name.empty ())
+	    for (auto &output : file.outputs)
+	      file.stdout_output += output;
+	  else
+	    {
+	      int fd = open_output_file (file.out_file_name);
+	      try
+		{
+		  if (write_bin)
+		    {
+		      ProgBinWriter prog_writer (fd);
+		      for (unsigned idx = 0; idx < funs.size (); idx++)
+			prog_writer.add_encoded_fun (funs[idx].first,
+						     std::move (file.outputs[idx]));
+		      prog_writer.finish ();
+		    }
+		  else
+		    {
+		      ProgTextWriter prog_writer (fd);
+		      for (auto &output : file.outputs)
+			prog_writer.out () << output;
+		      prog_writer.flush ();
+		    }
+		}
+	      catch (...)
+		{
+		  close (fd);
+		  throw;
+		}
+	      close (fd);
+	    }
+	}
+      catch (std::runtime_error &err)
+	{
+	  file.error = err.what ();
+	}
+
+      file.prog.reset ();
+      file.outputs.clear ();
+      file.errors.clear ();
+
+      finish_file (file_idx);
+    };
+
+  WorkPool pool (num_threads);
+
+  // Read the file FILE_IDX, and start processing its functions.
+  //
+  auto start_file = [&] (unsigned file_idx)
+    {
+      File &file = *files[file_idx];
+      const std::string &src_file_name = file.src_file_name;
+
+      try
+	{
+	  std::unique_ptr<FileContents> contents
+	    = input_contents (opts, src_file_name);
+
+	  // A streamed file is processed in one go, directly to its
+	  // output file.
+	  //
+	  if (opts.stream)
+	    {
+	      int fd = open_output_file (file.out_file_name);
+	      try
+		{
+		  process (opts, src_file_name, std::move (contents), fd, 1,
+			   cache.get ());
+		}
+	      catch (...)
+		{
+		  close (fd);
+		  throw;
+		}
+	      close (fd);
+
+	      finish_file (file_idx);
+	      return;
+	    }
+
+	  if (opts.read_bin)
+	    {
+	      ProgBinReader prog_reader (contents->view (), src_file_name);
+	      file.prog.reset (prog_reader.read ());
+	    }
+	  else
+	    {
+	      FileSrcContext src_context;
+	      SrcFileInput inp (std::move (contents), src_file_name,
+				src_context);
+	      ProgTextReader prog_reader (inp);
+	      file.prog.reset (prog_reader.read ());
+	    }
+	}
+      catch (std::runtime_error &err)
 	{
-	  fun->combine_blocks ();
-	  fun->remove_unreachable ();
+	  file.error = err.what ();
+	  finish_file (file_idx);
+	  return;
+	}
+
+      const std::vector<std::pair<std::string, Fun *>> &funs
+	= file.prog->functions ();
+
+      if (funs.empty ())
+	{
+	  write_file (file_idx);
+	  return;
+	}
+
+      file.outputs.resize (funs.size ());
+      file.errors.resize (funs.size ());
+      file.num_unfinished_funs = funs.size ();
+
+      // Whichever function finishes last writes the file.
+      //
+      for (unsigned fun_idx = 0; fun_idx < funs.size (); fun_idx++)
+	pool.submit ([&, file_idx, fun_idx] ()
+	  {
+	    File &file = *files[file_idx];
+	    auto [name, fun] = file.prog->functions ()[fun_idx];
+
+	    try
+	      {
+		file.outputs[fun_idx]
+		  = fun_output (name, fun, optimize, num_regs, write_bin,
+				layout, profile, cache.get (), salt);
+	      }
+	    catch (std::runtime_error &)
+	      {
+		file.errors[fun_idx] = std::current_exception ();
+	      }
+
+	    if (--file.num_unfinished_funs == 0)
+	      write_file (file_idx);
+	  });
+    };
+
+  for (unsigned file_idx = 0; file_idx < files.size (); file_idx++)
+    pool.submit ([&, file_idx] () { start_file (file_idx); });
+
+  pool.run ();
+}
+
+
+static int
+usage (const char *prog_name)
+{
+  std::cerr << "Usage: " << prog_name << " [OPTION...] SRC_FILE...\n"
+	    << "       " << prog_name
+	    << " --serve SOCKET [--jobs N] [--cache DIR]\n"
+	    << "An argument @FILE reads input file names from FILE, one per line,\n"
+	    << "each optionally followed by an output file name.  By default, all\n"
+	    << "output goes to standard output, in order.\n"
+	    << "Options:\n"
+	    << "  --output-dir DIR, -d DIR  Write the output for each input to a\n"
+	    << "                 file with the same name in the directory DIR\n"
+	    << "  --read-bin     Read SRC_FILE as binary IR instead of text\n"
+	    << "  --write-bin    Write binary IR instead of text\n"
+	    << "  --no-opt       Don't optimize, just convert the input\n"
+	    << "  --regalloc N   After optimizing, allocate registers for a machine\n"
+	    << "                 with N registers\n"
+	    << "  --layout LAYOUT  Order blocks in text output depth-first (dfs, the\n"
+	    << "                 default), or by estimated frequency (freq)\n"
+	    << "  --profile-use FILE  Annotate text output with the block and edge\n"
+	    << "                 counts in the profile FILE, and use them for --layout freq\n"
+	    << "  --stream       Process one function at a time, to bound memory use\n"
+	    << "  --jobs N       Use up to N threads (default: number of CPUs)\n"
+	    << "  --cache DIR    Cache optimized functions in the directory DIR\n"
+	    << "  --cache-size SIZE  Limit the cache to SIZE bytes (suffixes K, M, G;\n"
+	    << "                 default 1G)\n"
+	    << "  --serve SOCKET Run as a server, handling requests from clients\n"
+	    << "                 on the Unix-domain socket SOCKET (requests use the\n"
+	    << "                 server's --cache, not their own)\n"
+	    << "  --client SOCKET  Have the server on SOCKET do the work, if there\n"
+	    << "                 is one (SRC_FILE \"-\" sends standard input)\n"
+	    << "  --stats        Print pass statistics to stderr\n"
+	    << "  --perf         Print per-pass and per-function times and hardware\n"
+	    << "                 counters (if permitted) to stderr\n"
+	    << "  --perf-times   Like --perf, but only report times, as when\n"
+	    << "                 counters aren't permitted\n"
+	    << "  --mem-breakdown  Print memory use by IR object type, and\n"
+	    << "                 per-pass and per-function high-water marks, to stderr\n"
+	    << "  --trace FILE   Write a Chrome trace-event (Perfetto) trace to FILE\n"
+	    << "  --run FUN:ARG,...  Instead of writing the program, run the function\n"
+	    << "                 FUN with the given integer arguments, and print its\n"
+	    << "                 results and dynamic counts\n"
+	    << "  --run-limit N  Stop a --run after N instructions\n"
+	    << "  --engine ENGINE  Also run with ENGINE (interp, vm, or jit), checking\n"
+	    << "                 its results against the interpreter's\n"
+	    << "  --run-repeat N  Time N calls of the --run function with the engine\n"
+	    << "  --profile-gen FILE  Count how often each edge of the --run function\n"
+	    << "                 is followed, and add the counts to the profile FILE\n";
+  return 1;
+}
 
-	  fun->update_dominators ();
-	  fun->update_post_dominators ();
 
-	  fun->convert_to_ssa_form ();
-	  fun->propagate_through_copies ();
-	  fun->convert_from_ssa_form ();
+int main (int argc, const char *const *argv)
+{
+  std::vector<std::string> args (argv + 1, argv + argc);
+
+  Options opts;
+  try
+    {
+      if (! parse_args (args, opts))
+	return usage (argv[0]);
+    }
+  catch (std::runtime_error &err)
+    {
+      std::cerr << err.what () << '\n';
+      return 1;
+    }
 
-	  fun->remove_useless_copies ();
+  if (! opts.serve_socket_name.empty ())
+    {
+      try
+	{
+	  std::unique_ptr<FunCache> cache = make_cache (opts);
+	  RequestServer server (opts.serve_socket_name,
+				[&] (const std::vector<std::string> &args,
+				     int src_fd, int out_fd, std::string &errors)
+				{
+				  return handle_request (args, src_fd, out_fd,
+							 errors, cache.get ());
+				});
+	  server.serve (opts.num_threads
+			? opts.num_threads : default_num_threads ());
+	}
+      catch (std::runtime_error &err)
+	{
+	  std::cerr << err.what () << '\n';
+	  return 1;
+	}
+
+      return 0;
+    }
+
+  if (! opts.client_socket_name.empty ())
+    {
+      try
+	{
+	  int status;
+	  if (run_client (opts, args, status))
+	    return status;
+	}
+      catch (std::runtime_error &err)
+	{
+	  std::cerr << err.what () << '\n';
+	  return 1;
 	}
+    }
+
+  if (! opts.trace_file_name.empty () || opts.print_perf || opts.print_mem)
+    Trace::enable ();
 
-      ProgTextWriter prog_writer (std::cout);
-      prog_writer.write (&*prog);
+  // This must happen before any IR is allocated.
+  //
+  if (opts.print_mem)
+    MemAccount::enable ();
+
+  if (opts.print_perf && opts.perf_counters)
+    {
+      std::string error;
+      if (! PerfCounters::enable (error))
+	std::cerr << argv[0] << ": Hardware counters unavailable, "
+		  << "reporting times only: " << error << '\n';
+    }
+
+  unsigned num_threads
+    = opts.num_threads ? opts.num_threads : default_num_threads ();
+
+  try
+    {
+      // A single input written to standard output is processed
+      // directly, anything else as a batch.
+      //
+      if (opts.inputs.size () == 1 && opts.output_dir.empty ()
+	  && opts.inputs[0].out_file_name.empty ())
+	{
+	  const std::string &src_file_name = opts.inputs[0].src_file_name;
+	  std::unique_ptr<FileContents> contents
+	    = input_contents (opts, src_file_name);
+	  if (! opts.run_fun.empty ())
+	    run_fun (opts, src_file_name, std::move (contents), num_threads);
+	  else
+	    {
+	      std::unique_ptr<FunCache> cache = make_cache (opts);
+	      process (opts, src_file_name, std::move (contents),
+		       STDOUT_FILENO, num_threads, cache.get ());
+	    }
+	}
+      else
+	process_batch (opts, num_threads);
     }
   catch (std::runtime_error &err)
     {
       std::cerr << err.what () << '\n';
     }
 
+  if (opts.print_stats)
+    Stat::report (std::cerr);
+
+  if (opts.print_perf || opts.print_mem)
+    Trace::write_summary (std::cerr, 5);
+
+  if (opts.print_mem)
+    {
+      std::cerr << '\n';
+      MemAccount::report (std::cerr);
+    }
+
+  if (! opts.trace_file_name.empty ())
+    {
+      const char *trace_file_name = opts.trace_file_name.c_str ();
+      std::ofstream trace_stream (trace_file_name);
+      Trace::write_json (trace_stream);
+      if (! trace_stream)
+	{
+	  std::cerr << trace_file_name << ": Error writing trace file\n";
+	  return 1;
+	}
+    }
+
   return 0;
 }
@@ -23,6 +23,8 @@ class CondBranchInsn : public Insn
 {
 public:
 
+  MEM_ACCOUNTED (CondBranchInsn);
+
   // Make a new conditional-branch instruction, which transfers
   // control to TARGET if COND contains a non-zero value, optionally
   // appending it to block BLOCK.
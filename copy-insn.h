@@ -18,6 +18,8 @@ class CopyInsn : public Insn
 {
 public:
 
+  MEM_ACCOUNTED (CopyInsn);
+
   // Make a new copy instruction, which copies FROM to TO
   // If BLOCK is non-NULL, the instruction is appended to it.
   //
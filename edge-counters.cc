@@ -0,0 +1,287 @@
+// edge-counters.cc -- Edge-profiling instrumentation of IR functions
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "check-assertion.h"
+#include "trace.h"
+#include "stats.h"
+
+#include "reg.h"
+#include "value.h"
+#include "calc-insn.h"
+#include "fun-result-insn.h"
+#include "block-freq.h"
+
+#include "fun.h"
+#include "bb.h"
+
+#include "edge-counters.h"
+
+
+static Stat counters_added ("edge-counters", "counters-added",
+			    "Number of edge counters added");
+static Stat edges_counted ("edge-counters", "edges-counted",
+			   "Number of edges in functions with counters added");
+static Stat edge_blocks_added ("edge-counters", "edge-blocks-added",
+			       "Number of blocks added to hold edge counters");
+
+
+// Add counters to FUN.
+//
+EdgeCounters::EdgeCounters (Fun *fun)
+{
+  TRACE_SPAN ("EdgeCounters");
+
+  std::vector<BB *> blocks (fun->blocks ().begin (), fun->blocks ().end ());
+  std::vector<unsigned> block_indices (fun->max_block_num () + 1);
+  for (unsigned i = 0; i < blocks.size (); i++)
+    block_indices[blocks[i]->num ()] = i;
+
+  _num_blocks = blocks.size ();
+  _cfg_hash = EdgeProfile::cfg_hash (fun);
+
+  // Find the edges to count, and the spanning tree.
+  //
+  {
+    BlockFreq freqs (fun);
+
+    std::vector<double> weights;
+    for (auto [from, to] : EdgeProfile::edges (fun))
+      {
+	_edges.push_back (Edge { block_indices[from->num ()],
+				 block_indices[to->num ()] });
+	weights.push_back (freqs.edge_freq (from, to));
+      }
+    _num_real_edges = _edges.size ();
+
+    BB *entry_block = fun->entry_block ();
+    if (entry_block)
+      for (auto block : blocks)
+	if (block->successors ().empty () && block != entry_block)
+	  _edges.push_back (Edge { block_indices[block->num ()],
+				   block_indices[entry_block->num ()] });
+
+    // Build a maximum spanning tree using Kruskal's algorithm.  The
+    // extra edges, which can't have counters, are put in the tree
+    // first.
+    //
+    std::vector<unsigned> order (_edges.size ());
+    for (unsigned i = 0; i < order.size (); i++)
+      order[i] = i;
+    std::stable_sort (order.begin () , order.begin () + _num_real_edges,
+		      [&weights] (unsigned edge1, unsigned edge2)
+		      {
+			return weights[edge1] > weights[edge2];
+		      });
+    std::rotate (order.begin (), order.begin () + _num_real_edges,
+		 order.end ());
+
+    // A union-find forest of blocks joined by tree edges.
+    //
+    std::vector<unsigned> parents (_num_blocks);
+    for (unsigned i = 0; i < _num_blocks; i++)
+      parents[i] = i;
+    auto root = [&parents] (unsigned block)
+      {
+	while (parents[block] != block)
+	  block = parents[block] = parents[parents[block]];
+	return block;
+      };
+
+    for (auto edge_idx : order)
+      {
+	Edge &edge = _edges[edge_idx];
+	unsigned from_root = root (edge.from), to_root = root (edge.to);
+	if (from_root != to_root)
+	  parents[from_root] = to_root;
+	else
+	  {
+	    check_assertion (edge_idx < _num_real_edges,
+			     "Extra profiling edge not in spanning tree");
+	    edge.counter = _counter_totals.size ();
+	    _counter_totals.push_back (0);
+	  }
+      }
+  }
+
+  edges_counted += _num_real_edges;
+  if (_counter_totals.empty ())
+    return;
+  counters_added += _counter_totals.size ();
+
+  BB *exit_block = fun->exit_block ();
+  if (! exit_block)
+    throw std::runtime_error ("Cannot count edges in a function"
+			      " with no exit block");
+
+  for (auto block : blocks)
+    for (auto insn : block->insns ())
+      if (FunResultInsn *fun_result = dynamic_cast<FunResultInsn *> (insn))
+	_first_counter_result
+	  = std::max (_first_counter_result, fun_result->result_num () + 1);
+
+  // Add an increment of each counter on its edge.
+  //
+  Reg *one = new Reg (new Value (1, fun));
+
+  for (unsigned edge_idx = 0; edge_idx < _num_real_edges; edge_idx++)
+    {
+      int counter_idx = _edges[edge_idx].counter;
+      if (counter_idx < 0)
+	continue;
+
+      BB *from = blocks[_edges[edge_idx].from];
+      BB *to = blocks[_edges[edge_idx].to];
+
+      Reg *counter
+	= new Reg (Symbol ("edge-count-" + std::to_string (counter_idx)), fun);
+      Insn *increment
+	= new CalcInsn (CalcInsn::Op::ADD, counter, one, counter);
+
+      const BB::InsnList &from_insns = from->insns ();
+      const BB::BlockList &to_preds = to->predecessors ();
+
+      auto is_branch = [] (Insn *insn) { return insn->is_branch_insn (); };
+
+      if (from->fall_through () == to
+	  && std::none_of (from_insns.begin (), from_insns.end (), is_branch))
+	from->add_insn (increment);
+      else if (to != fun->entry_block ()
+	       && std::all_of (to_preds.begin (), to_preds.end (),
+			       [from] (BB *pred) { return pred == from; }))
+	to->prepend_insn (increment);
+      else
+	{
+	  BB *edge_block = new BB (fun);
+	  ++edge_blocks_added;
+	  edge_block->add_insn (increment);
+	  edge_block->set_fall_through (to);
+
+	  // Every branch in FROM to TO, as well as its fall-through,
+	  // now goes through EDGE_BLOCK.
+	  //
+	  std::vector<Insn *> insns (from_insns.begin (), from_insns.end ());
+	  for (auto insn : insns)
+	    insn->change_branch_target (to, edge_block);
+	  if (from->fall_through () == to)
+	    from->set_fall_through (edge_block);
+	}
+
+      new FunResultInsn (_first_counter_result + counter_idx, counter,
+			 exit_block);
+    }
+}
+
+
+// Add the counters in RESULTS, the results of one call of the
+// instrumented function.
+//
+void
+EdgeCounters::add_call (const std::vector<int> &results)
+{
+  check_assertion (results.size () >= _first_counter_result + num_counters (),
+		   "Missing edge counter results");
+
+  _calls++;
+  for (unsigned i = 0; i < num_counters (); i++)
+    _counter_totals[i] += unsigned (results[_first_counter_result + i]);
+}
+
+
+// Return the counts for each edge of the function as it was before
+// being instrumented, from all the calls added so far.
+//
+// The count for each edge in the spanning tree is found once all the
+// other edges of one of its blocks are known, starting from the
+// leaves of the tree.
+//
+EdgeProfile::FunCounts
+EdgeCounters::counts () const
+{
+  std::vector<std::int64_t> counts (_edges.size ());
+  std::vector<bool> known (_edges.size ());
+
+  // Edges into or out of each block, except those back to the same
+  // block, which always have counters, and don't affect the balance.
+  //
+  std::vector<std::vector<unsigned>> block_edges (_num_blocks);
+  std::vector<unsigned> num_unknown (_num_blocks);
+
+  for (unsigned i = 0; i < _edges.size (); i++)
+    {
+      const Edge &edge = _edges[i];
+
+      if (edge.counter >= 0)
+	{
+	  counts[i] = _counter_totals[edge.counter];
+	  known[i] = true;
+	}
+      else
+	{
+	  num_unknown[edge.from]++;
+	  num_unknown[edge.to]++;
+	}
+
+      if (edge.from != edge.to)
+	{
+	  block_edges[edge.from].push_back (i);
+	  block_edges[edge.to].push_back (i);
+	}
+    }
+
+  std::vector<unsigned> ready;
+  for (unsigned block = 0; block < _num_blocks; block++)
+    if (num_unknown[block] == 1)
+      ready.push_back (block);
+
+  while (! ready.empty ())
+    {
+      unsigned block = ready.back ();
+      ready.pop_back ();
+
+      if (num_unknown[block] != 1)
+	continue;
+
+      // The sum of the counts of known edges in, minus those out.
+      //
+      std::int64_t balance = 0;
+      int unknown = -1;
+      for (auto edge_idx : block_edges[block])
+	if (! known[edge_idx])
+	  unknown = edge_idx;
+	else if (_edges[edge_idx].to == block)
+	  balance += counts[edge_idx];
+	else
+	  balance -= counts[edge_idx];
+
+      const Edge &edge = _edges[unknown];
+      counts[unknown] = edge.to == block ? -balance : balance;
+      known[unknown] = true;
+
+      num_unknown[edge.from]--;
+      num_unknown[edge.to]--;
+      unsigned other = edge.to == block ? edge.from : edge.to;
+      if (num_unknown[other] == 1)
+	ready.push_back (other);
+    }
+
+  EdgeProfile::FunCounts fun_counts;
+  fun_counts.cfg_hash = _cfg_hash;
+  fun_counts.calls = _calls;
+  for (unsigned i = 0; i < _num_real_edges; i++)
+    {
+      check_assertion (known[i] && counts[i] >= 0,
+		       "Inconsistent edge counts");
+      fun_counts.edge_counts.push_back (counts[i]);
+    }
+
+  return fun_counts;
+}
@@ -0,0 +1,107 @@
+// edge-counters.h -- Edge-profiling instrumentation of IR functions
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#ifndef __EDGE_COUNTERS_H__
+#define __EDGE_COUNTERS_H__
+
+#include <cstdint>
+#include <vector>
+
+#include "edge-profile.h"
+
+
+class Fun;
+
+
+// Instrumentation which makes an IR function count how many times
+// each of its control-flow edges is followed, for an EdgeProfile.
+//
+// Following Ball and Larus, "Optimally Profiling and Tracing
+// Programs", only edges not in a spanning tree of the flow graph get
+// counters, and the counts for the others are worked out afterwards
+// from the fact that as many times as control enters a block, it
+// leaves it.  For this, the flow graph is extended with an edge from
+// each block without successors back to the entry block.  The
+// spanning tree is a maximum one, weighted by estimated edge
+// frequencies (see BlockFreq), so the counters are on the edges
+// least likely to be followed.
+//
+// Each counter is a new register, which is incremented on its edge,
+// and returned as an extra function result, so the instrumented
+// function can be run by any engine.  The increment goes at the end
+// of the edge's source block if it's the only way out of it, at the
+// start of the edge's destination block if it's the only way in, and
+// otherwise in a new block on the edge.
+//
+// The function must not be in SSA form.
+//
+class EdgeCounters
+{
+public:
+
+  // Add counters to FUN.
+  //
+  EdgeCounters (Fun *fun);
+
+
+  // Return the number of counters added.
+  //
+  unsigned num_counters () const { return _counter_totals.size (); }
+
+  // Return the number of the first function result holding a counter;
+  // results before it are the function's own.
+  //
+  unsigned first_counter_result () const { return _first_counter_result; }
+
+
+  // Add the counters in RESULTS, the results of one call of the
+  // instrumented function.
+  //
+  void add_call (const std::vector<int> &results);
+
+  // Return the counts for each edge of the function as it was before
+  // being instrumented, from all the calls added so far.
+  //
+  EdgeProfile::FunCounts counts () const;
+
+
+private:
+
+  // An edge in the extended flow graph, between the blocks at
+  // positions FROM and TO in the function's block order.
+  //
+  struct Edge
+  {
+    unsigned from, to;
+
+    // The index of this edge's counter in _counter_totals, or -1 if
+    // it's in the spanning tree.
+    //
+    int counter = -1;
+  };
+
+
+  // The edges of the function in the order given by
+  // EdgeProfile::edges, followed by the extra edges to the entry
+  // block.
+  //
+  std::vector<Edge> _edges;
+  unsigned _num_real_edges = 0;
+
+  unsigned _num_blocks = 0;
+
+  std::uint64_t _cfg_hash = 0;
+
+  unsigned _first_counter_result = 0;
+
+  std::uint64_t _calls = 0;
+  std::vector<std::uint64_t> _counter_totals;
+};
+
+
+#endif // __EDGE_COUNTERS_H__
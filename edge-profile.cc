@@ -0,0 +1,196 @@
+// edge-profile.cc -- Measured control-flow edge counts for IR functions
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "file-contents.h"
+
+#include "fun.h"
+#include "bb.h"
+
+#include "edge-profile.h"
+
+
+// Return the control-flow edges of FUN, in a canonical order: for
+// each block, in the function's block order, an edge to each of its
+// successors, in order, ignoring duplicates.
+//
+std::vector<std::pair<BB *, BB *>>
+EdgeProfile::edges (Fun *fun)
+{
+  std::vector<std::pair<BB *, BB *>> edges;
+
+  for (auto block : fun->blocks ())
+    {
+      auto block_edges_beg = edges.size ();
+      for (auto succ : block->successors ())
+	if (std::none_of (edges.begin () + block_edges_beg, edges.end (),
+			  [succ] (const std::pair<BB *, BB *> &edge)
+			  {
+			    return edge.second == succ;
+			  }))
+	  edges.emplace_back (block, succ);
+    }
+
+  return edges;
+}
+
+
+// Return a hash of the shape of FUN's flow graph: its blocks, which
+// are the entry and exit blocks, and the edges between them.
+//
+std::uint64_t
+EdgeProfile::cfg_hash (Fun *fun)
+{
+  // Blocks are identified by their position in the function, as
+  // block numbers depend on the history of the function.
+  //
+  std::vector<unsigned> block_indices (fun->max_block_num () + 1);
+  unsigned num_blocks = 0;
+  for (auto block : fun->blocks ())
+    block_indices[block->num ()] = ++num_blocks;
+
+  auto block_index = [&] (BB *block)
+    {
+      return block ? block_indices[block->num ()] : 0;
+    };
+
+  // A 64-bit FNV-1a hash of each number.
+  //
+  std::uint64_t hash = 0xcbf29ce484222325;
+  auto hash_num = [&hash] (unsigned num)
+    {
+      for (unsigned i = 0; i < 4; i++)
+	{
+	  hash ^= (num >> (i * 8)) & 0xff;
+	  hash *= 0x100000001b3;
+	}
+    };
+
+  hash_num (num_blocks);
+  hash_num (block_index (fun->entry_block ()));
+  hash_num (block_index (fun->exit_block ()));
+
+  for (auto [from, to] : edges (fun))
+    {
+      hash_num (block_index (from));
+      hash_num (block_index (to));
+    }
+
+  return hash;
+}
+
+
+// Add COUNTS for the function called NAME to this profile.  If there
+// are already counts for a function called NAME with the same flow
+// graph, the new counts are added to them, otherwise they replace
+// them.
+//
+void
+EdgeProfile::add (const std::string &name, const FunCounts &counts)
+{
+  FunCounts &fun_counts = _funs[name];
+
+  if (fun_counts.cfg_hash != counts.cfg_hash
+      || fun_counts.edge_counts.size () != counts.edge_counts.size ())
+    {
+      fun_counts = counts;
+      return;
+    }
+
+  fun_counts.calls += counts.calls;
+  for (unsigned i = 0; i < counts.edge_counts.size (); i++)
+    fun_counts.edge_counts[i] += counts.edge_counts[i];
+}
+
+// Return the counts for the function FUN, called NAME, or zero if
+// there are none for its flow graph.
+//
+const EdgeProfile::FunCounts *
+EdgeProfile::find (const std::string &name, Fun *fun) const
+{
+  auto it = _funs.find (name);
+  if (it == _funs.end () || it->second.cfg_hash != cfg_hash (fun)
+      || it->second.edge_counts.size () != edges (fun).size ())
+    return 0;
+
+  return &it->second;
+}
+
+
+// Add the profile in the file FILE_NAME to this one.
+//
+void
+EdgeProfile::read (const std::string &file_name)
+{
+  FileContents contents (file_name);
+  std::istringstream data { std::string (contents.view ()) };
+
+  std::string line;
+  unsigned line_num = 0;
+  while (std::getline (data, line))
+    {
+      line_num++;
+
+      std::istringstream words (line);
+      std::string keyword, name;
+      FunCounts counts;
+
+      if (! (words >> keyword))
+	continue;
+      if (keyword != "fun"
+	  || ! (words >> name >> std::hex >> counts.cfg_hash
+		>> std::dec >> counts.calls))
+	throw std::runtime_error (file_name + ":" + std::to_string (line_num)
+				  + ": Invalid profile line");
+
+      std::uint64_t count;
+      while (words >> count)
+	counts.edge_counts.push_back (count);
+      if (! words.eof ())
+	throw std::runtime_error (file_name + ":" + std::to_string (line_num)
+				  + ": Invalid edge count");
+
+      add (name, counts);
+    }
+}
+
+// Write this profile to the file FILE_NAME, replacing its contents.
+//
+void
+EdgeProfile::write (const std::string &file_name) const
+{
+  std::ofstream stream (file_name);
+  stream << text ();
+  stream.close ();
+
+  if (! stream)
+    throw std::runtime_error (file_name + ": Error writing profile");
+}
+
+// Return this profile in the format used for files.
+//
+std::string
+EdgeProfile::text () const
+{
+  std::ostringstream out;
+
+  for (auto &[name, counts] : _funs)
+    {
+      out << "fun " << name << ' ' << std::hex << counts.cfg_hash
+	  << std::dec << ' ' << counts.calls;
+      for (auto count : counts.edge_counts)
+	out << ' ' << count;
+      out << '\n';
+    }
+
+  return out.str ();
+}
@@ -0,0 +1,110 @@
+// edge-profile.h -- Measured control-flow edge counts for IR functions
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#ifndef __EDGE_PROFILE_H__
+#define __EDGE_PROFILE_H__
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+class Fun;
+class BB;
+
+
+// A profile of the programs run: for each function, how many times it
+// was called, and how many times each of its control-flow edges was
+// followed, as collected by EdgeCounters.
+//
+// Functions are identified by name, and each function's counts are
+// only used for a function whose flow graph has the same hash as the
+// one which was run, so a stale profile is ignored rather than
+// misapplied.  As optimization changes the flow graph, a profile
+// should be made from a function optimized the same way as the one it
+// is used for.
+//
+// Profiles are stored in text files, which contain a line for each
+// function:
+//
+//    fun NAME CFG_HASH CALLS COUNT...
+//
+// where CFG_HASH is in hexadecimal, and there is one COUNT for each
+// edge, in the order given by EdgeProfile::edges.
+//
+class EdgeProfile
+{
+public:
+
+  // Counts for one function.
+  //
+  struct FunCounts
+  {
+    // The hash of the function's flow graph (see EdgeProfile::cfg_hash).
+    //
+    std::uint64_t cfg_hash = 0;
+
+    std::uint64_t calls = 0;
+
+    // The number of times each edge was followed, in the order given
+    // by EdgeProfile::edges.
+    //
+    std::vector<std::uint64_t> edge_counts;
+  };
+
+
+  // Return the control-flow edges of FUN, in a canonical order: for
+  // each block, in the function's block order, an edge to each of its
+  // successors, in order, ignoring duplicates.
+  //
+  static std::vector<std::pair<BB *, BB *>> edges (Fun *fun);
+
+  // Return a hash of the shape of FUN's flow graph: its blocks, which
+  // are the entry and exit blocks, and the edges between them.
+  //
+  static std::uint64_t cfg_hash (Fun *fun);
+
+
+  // Add COUNTS for the function called NAME to this profile.  If
+  // there are already counts for a function called NAME with the same
+  // flow graph, the new counts are added to them, otherwise they
+  // replace them.
+  //
+  void add (const std::string &name, const FunCounts &counts);
+
+  // Return the counts for the function FUN, called NAME, or zero if
+  // there are none for its flow graph.
+  //
+  const FunCounts *find (const std::string &name, Fun *fun) const;
+
+
+  // Add the profile in the file FILE_NAME to this one.
+  //
+  void read (const std::string &file_name);
+
+  // Write this profile to the file FILE_NAME, replacing its contents.
+  //
+  void write (const std::string &file_name) const;
+
+  // Return this profile in the format used for files.
+  //
+  std::string text () const;
+
+
+private:
+
+  // Counts for each function, by name, so files are written in a
+  // consistent order.
+  //
+  std::map<std::string, FunCounts> _funs;
+};
+
+
+#endif // __EDGE_PROFILE_H__
@@ -0,0 +1,175 @@
+// file-contents.cc -- In-memory contents of an input file
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "file-contents.h"
+
+
+// Return an exception describing a system-call failure on the file
+// FILE_NAME, using the current value of errno.
+//
+static std::runtime_error
+file_error (const std::string &file_name, const char *what)
+{
+  return std::runtime_error (file_name + ": " + what + ": " + strerror (errno));
+}
+
+
+// Read the file named FILE_NAME.  The name "-" means standard input.
+// If the file can't be opened, an exception is thrown.
+//
+// If DEFER_READ is true, and the file can't be memory-mapped, it
+// isn't read, but is left open for reading using
+// FileContents::unread_fd.
+//
+FileContents::FileContents (const std::string &file_name, bool defer_read)
+{
+  if (file_name == "-")
+    {
+      if (defer_read)
+	_unread_fd = 0;
+      else
+	read_into_buf (0, file_name);
+      return;
+    }
+
+  int fd = open (file_name.c_str (), O_RDONLY);
+  if (fd < 0)
+    throw file_error (file_name, "Cannot open");
+
+  try
+    {
+      if (load (fd, file_name, defer_read))
+	{
+	  _close_unread_fd = true;
+	  return;
+	}
+    }
+  catch (...)
+    {
+      close (fd);
+      throw;
+    }
+
+  close (fd);
+}
+
+// Read the file open on the file descriptor FD, which is not closed.
+// FILE_NAME is used for error messages.  DEFER_READ is as for the
+// previous constructor.
+//
+FileContents::FileContents (int fd, const std::string &file_name,
+			    bool defer_read)
+{
+  load (fd, file_name, defer_read);
+}
+
+// Use a copy of the SIZE bytes at DATA, which didn't come from a file.
+//
+FileContents::FileContents (const char *data, std::size_t size)
+  : _buf (data, data + size)
+{
+  _data = _buf.data ();
+  _size = size;
+}
+
+FileContents::~FileContents ()
+{
+  if (_mapped)
+    munmap (const_cast<char *> (_data), _size);
+  if (_close_unread_fd)
+    close (_unread_fd);
+}
+
+
+// Map or read the contents of the file descriptor FD, or if
+// DEFER_READ is true and it can't be mapped, remember it in
+// _UNREAD_FD.  Return true in the latter case.  FILE_NAME is used for
+// error messages.
+//
+bool
+FileContents::load (int fd, const std::string &file_name, bool defer_read)
+{
+  struct stat st;
+  if (fstat (fd, &st) == 0 && S_ISREG (st.st_mode) && st.st_size > 0)
+    {
+      void *mapping
+	= mmap (0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+      if (mapping != MAP_FAILED)
+	{
+	  // We read input strictly front-to-back, so tell the kernel
+	  // to read ahead aggressively, and drop pages behind us.
+	  //
+	  madvise (mapping, st.st_size, MADV_SEQUENTIAL);
+
+	  _data = static_cast<const char *> (mapping);
+	  _size = st.st_size;
+	  _mapped = true;
+
+	  return false;
+	}
+    }
+
+  // Not a regular file, or mmap failed for some reason, so fall back
+  // to just reading it, or leave that to our user.
+  //
+  if (defer_read)
+    {
+      _unread_fd = fd;
+      return true;
+    }
+
+  read_into_buf (fd, file_name);
+  return false;
+}
+
+
+// Read the entire contents of the file descriptor FD into _BUF.
+// FILE_NAME is used for error messages.
+//
+void
+FileContents::read_into_buf (int fd, const std::string &file_name)
+{
+  static const std::size_t MIN_READ_SIZE = 256 * 1024;
+
+  std::size_t len = 0;
+  for (;;)
+    {
+      if (_buf.size () - len < MIN_READ_SIZE)
+	_buf.resize (std::max (_buf.size () * 2, len + MIN_READ_SIZE));
+
+      ssize_t rval = read (fd, _buf.data () + len, _buf.size () - len);
+
+      if (rval < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  throw file_error (file_name, "Read error");
+	}
+
+      if (rval == 0)
+	break;
+
+      len += rval;
+    }
+
+  _buf.resize (len);
+
+  _data = _buf.data ();
+  _size = len;
+}
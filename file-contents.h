@@ -0,0 +1,115 @@
+// file-contents.h -- In-memory contents of an input file
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#ifndef __FILE_CONTENTS_H__
+#define __FILE_CONTENTS_H__
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+// The entire contents of an input file, available in memory.
+//
+// Regular files are memory-mapped, so no copying is done and pages
+// are only read as they're touched.  Anything that can't be mapped
+// (pipes, terminals, standard input) is instead read into a heap
+// buffer using large read(2) calls, unless the caller asks to defer
+// reading, in which case nothing is read, and the caller reads the
+// file descriptor itself (see FileContents::unread_fd).
+//
+class FileContents
+{
+public:
+
+  // Read the file named FILE_NAME.  The name "-" means standard
+  // input.  If the file can't be opened, an exception is thrown.
+  //
+  // If DEFER_READ is true, and the file can't be memory-mapped, it
+  // isn't read, but is left open for reading using
+  // FileContents::unread_fd.
+  //
+  FileContents (const std::string &file_name, bool defer_read = false);
+
+  // Read the file open on the file descriptor FD, which is not
+  // closed.  FILE_NAME is used for error messages.  DEFER_READ is
+  // as for the previous constructor.
+  //
+  FileContents (int fd, const std::string &file_name,
+		bool defer_read = false);
+
+  // Use a copy of the SIZE bytes at DATA, which didn't come from a
+  // file.
+  //
+  FileContents (const char *data, std::size_t size);
+
+  ~FileContents ();
+
+  FileContents (const FileContents &) = delete;
+  FileContents &operator= (const FileContents &) = delete;
+
+
+  // Return the file contents.
+  //
+  const char *data () const { return _data; }
+  std::size_t size () const { return _size; }
+  std::string_view view () const { return std::string_view (_data, _size); }
+
+  // Return true if the file contents are memory-mapped, rather than
+  // having been read into a buffer.
+  //
+  bool is_mapped () const { return _mapped; }
+
+  // If reading the file was deferred, return the file descriptor to
+  // read it from, which remains open while this object exists;
+  // otherwise return -1.  In the former case, the contents above are
+  // empty.
+  //
+  int unread_fd () const { return _unread_fd; }
+
+
+private:
+
+  // Map or read the contents of the file descriptor FD, or if
+  // DEFER_READ is true and it can't be mapped, remember it in
+  // _UNREAD_FD.  Return true in the latter case.  FILE_NAME is used
+  // for error messages.
+  //
+  bool load (int fd, const std::string &file_name, bool defer_read);
+
+  // Read the entire contents of the file descriptor FD into _BUF.
+  // FILE_NAME is used for error messages.
+  //
+  void read_into_buf (int fd, const std::string &file_name);
+
+
+  // The file contents.
+  //
+  const char *_data = 0;
+  std::size_t _size = 0;
+
+  // True if _DATA is a memory-mapping, which must be unmapped.
+  //
+  bool _mapped = false;
+
+  // If reading was deferred, the file descriptor to read from.
+  //
+  int _unread_fd = -1;
+
+  // True if _UNREAD_FD was opened by us, and must be closed.
+  //
+  bool _close_unread_fd = false;
+
+  // Buffer holding the file contents, if it wasn't memory-mapped.
+  //
+  std::vector<char> _buf;
+};
+
+
+#endif // __FILE_CONTENTS_H__
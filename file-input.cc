@@ -6,6 +6,14 @@
 // Created: 2019-12-13
 //
 
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <unistd.h>
+
+#include "check-assertion.h"
+
 #include "file-input.h"
 
 
@@ -18,15 +26,72 @@
 //
 FileInput::FileInput (const std::string &file_name, FileSrcContext &src_context,
 		      bool line_oriented)
-  : _inp_stream (file_name, std::ios_base::in),
+  : FileInput (std::make_unique<FileContents> (file_name),
+	       file_name, src_context, line_oriented)
+{
+}
+
+// Make a new stream reading CONTENTS, which are the contents of the
+// file named FILE_NAME, in the source context SRC_CONTEXT.
+// LINE_ORIENTED is as for the previous constructor.
+//
+FileInput::FileInput (std::unique_ptr<FileContents> contents,
+		      const std::string &file_name, FileSrcContext &src_context,
+		      bool line_oriented)
+  : _contents (std::move (contents)), _data (_contents->view ()),
     _line_oriented (line_oriented),
     _src_context (src_context), _src_file (_src_context.file (file_name))
 {
+  // If the contents haven't been read, read them a buffer at a time.
+  //
+  _fd = _contents->unread_fd ();
+  if (_fd >= 0)
+    {
+      _buf.resize (BUF_SIZE);
+      _data = std::string_view (_buf.data (), 0);
+    }
+
+  // Let the source context use our copy of the file contents for
+  // error messages.
+  //
+  _src_file->set_contents (_data);
+
   // Read the first line.
   //
   read_new_line ();
 }
 
+// Make a new stream reading only the part of PARENT's file in the
+// byte range [BEG_OFFS, END_OFFS), which must begin and end at line
+// boundaries.  The end of the range looks like the end of the file.
+// PARENT must remain valid while this input is in use.
+//
+// Source-locations are the same as those in PARENT.  If every line
+// in the range has already been read by some input for the same
+// file, reading doesn't modify the source context, so several such
+// inputs can be used on different threads at once.
+//
+FileInput::FileInput (const FileInput &parent,
+		      std::size_t beg_offs, std::size_t end_offs,
+		      bool line_oriented)
+  : _data (parent._data.substr (0, end_offs)),
+    _next_line_offs (beg_offs),
+    _line_oriented (line_oriented),
+    _src_context (parent._src_context), _src_file (parent._src_file)
+{
+  check_assertion (! parent.buffered (),
+		   "FileInput range of a buffered input");
+
+  read_new_line ();
+}
+
+
+FileInput::~FileInput ()
+{
+  if (_contents)
+    _src_file->set_contents (std::string_view ());
+}
+
 
 // Read a new line from this stream into the current line buffer,
 // and return true if successful. If at the end of the file, return
@@ -38,26 +103,71 @@ FileInput::read_new_line ()
   if (_at_eof)
     return false;
 
-  std::streamoff file_offs = _inp_stream.tellg ();
+  // Find the end of the line; memchr is vectorized, so this is much
+  // faster than scanning ourselves.  A buffered input may need to
+  // read more to find it.
+  //
+  const char *nl;
+  std::size_t scan_offs = _next_line_offs;
+  for (;;)
+    {
+      nl = (scan_offs < _data.size ()
+	    ? static_cast<const char *> (memchr (_data.data () + scan_offs, '\n',
+						 _data.size () - scan_offs))
+	    : 0);
+      if (nl || _fd < 0)
+	break;
+
+      // Refilling moves the unread part to the start of the buffer.
+      //
+      scan_offs = _data.size () - _next_line_offs;
+      if (! refill ())
+	break;
+    }
+
+  std::size_t file_offs = _next_line_offs;
+  std::size_t file_size = _data.size ();
 
   _cur_line_offs = 0;
 
-  if (std::getline (_inp_stream, _cur_line))
+  if (file_offs < file_size)
     {
+      const char *line = _data.data () + file_offs;
+
+      // Length of this line, not including any newline.
+      //
+      std::size_t line_len
+	= nl ? nl - line : file_size - file_offs;
+
       // Length of this line in the file, including the terminating
       // newline.
       //
-      unsigned file_line_size = _cur_line.size () + 1;
+      std::size_t file_line_size = line_len + 1;
+
+      _cur_line = line;
+      _cur_line_max_offs = line_len;
 
       // When not in line-oriented mode, we explicitly represent
-      // newlines.
+      // newlines.  If the file's last line doesn't have one, we need
+      // to make a copy of the line to add it.
       //
       if (! _line_oriented)
-	_cur_line += '\n';
+	{
+	  if (nl)
+	    _cur_line_max_offs++;
+	  else
+	    {
+	      _unterminated_line.assign (line, line_len);
+	      _unterminated_line += '\n';
+	      _cur_line = _unterminated_line.data ();
+	      _cur_line_max_offs = _unterminated_line.size ();
+	    }
+	}
 
-      _cur_line_max_offs = _cur_line.size ();
+      _next_line_offs = file_offs + file_line_size;
 
-      _cur_line_src_loc = _src_file->add_line (file_offs, file_line_size);
+      _cur_line_src_loc
+	= _src_file->add_line (_data_file_offs + file_offs, file_line_size);
 
       return true;
     }
@@ -87,3 +197,42 @@ FileInput::read_past_eol ()
   else
     return read_new_line ();
 }
+
+
+// Read more of a buffered input's file into _BUF, first discarding
+// everything before _NEXT_LINE_OFFS, and return true if anything was
+// read.
+//
+bool
+FileInput::refill ()
+{
+  std::size_t keep = _data.size () - _next_line_offs;
+
+  // If a single line fills the whole buffer, make room for more.
+  //
+  if (keep == _buf.size ())
+    _buf.resize (_buf.size () * 2);
+
+  memmove (_buf.data (), _buf.data () + _next_line_offs, keep);
+  _data_file_offs += _next_line_offs;
+  _next_line_offs = 0;
+
+  ssize_t rval;
+  do
+    rval = read (_fd, _buf.data () + keep, _buf.size () - keep);
+  while (rval < 0 && errno == EINTR);
+
+  if (rval < 0)
+    throw std::runtime_error (_src_file->name () + ": Read error: "
+			      + strerror (errno));
+
+  if (rval == 0)
+    _fd = -1;
+  else
+    keep += rval;
+
+  _data = std::string_view (_buf.data (), keep);
+  _src_file->set_contents (_data, _data_file_offs);
+
+  return rval > 0;
+}
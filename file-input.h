@@ -9,15 +9,25 @@
 #ifndef __FILE_INPUT_H__
 #define __FILE_INPUT_H__
 
-#include <fstream>
+#include <cstddef>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <vector>
 
+#include "file-contents.h"
 #include "file-src-context.h"
 
 
 // A file-oriented text input source, basically supports
 // character-by-character input, along with source-location tracking.
 //
+// The file contents are held in memory (see FileContents), and the
+// current line is just a view into them, so reading doesn't copy.  A
+// file which can't be memory-mapped, and whose reading has been
+// deferred (see FileContents::unread_fd), is instead read a buffer at
+// a time, and only the current line is kept.
+//
 class FileInput
 {
 public:
@@ -32,6 +42,33 @@ public:
   FileInput (const std::string &file_name, FileSrcContext &src_context,
 	     bool line_oriented = false);
 
+  // Make a new stream reading CONTENTS, which are the contents of the
+  // file named FILE_NAME, in the source context SRC_CONTEXT.
+  // LINE_ORIENTED is as for the previous constructor.
+  //
+  FileInput (std::unique_ptr<FileContents> contents,
+	     const std::string &file_name, FileSrcContext &src_context,
+	     bool line_oriented = false);
+
+  // Make a new stream reading only the part of PARENT's file in the
+  // byte range [BEG_OFFS, END_OFFS), which must begin and end at line
+  // boundaries.  The end of the range looks like the end of the file.
+  // PARENT must remain valid while this input is in use.
+  //
+  // Source-locations are the same as those in PARENT.  If every line
+  // in the range has already been read by some input for the same
+  // file, reading doesn't modify the source context, so several such
+  // inputs can be used on different threads at once.
+  //
+  FileInput (const FileInput &parent,
+	     std::size_t beg_offs, std::size_t end_offs,
+	     bool line_oriented = false);
+
+  ~FileInput ();
+
+  FileInput (const FileInput &) = delete;
+  FileInput &operator= (const FileInput &) = delete;
+
 
   //
   // Character-by-character input
@@ -84,6 +121,20 @@ public:
   }
 
 
+  // Return a pointer to the next unread character in the current
+  // line.  The characters from here to FileInput::line_end may be
+  // examined directly, and then consumed using
+  // FileInput::consume_in_line.  The pointer is only valid until the
+  // next line is read.
+  //
+  const char *line_pos () const { return _cur_line + _cur_line_offs; }
+
+  // Return a pointer to the end of the current line (ignoring any
+  // characters removed from the end of the line).
+  //
+  const char *line_end () const { return _cur_line + _cur_line_max_offs; }
+
+
   //
   // End-of-line character reading.  These remove characters from the
   // end of the current line.
@@ -144,6 +195,28 @@ public:
   //
   bool at_eof () const { return _at_eof; }
 
+  // Forget the source-locations of lines before the current one,
+  // which may no longer be used, so that reading a large file one
+  // part at a time needs memory only for the current part.  This
+  // mustn't be used while other inputs share our source context.
+  //
+  void forget_previous_lines ()
+  {
+    _src_file->forget_lines_before (_cur_line_src_loc);
+  }
+
+
+  // Return true if this input reads its file a buffer at a time,
+  // rather than having all of it in memory.
+  //
+  bool buffered () const { return ! _buf.empty (); }
+
+  // Return the entire contents of the file we're reading (or for an
+  // input reading only part of a file, the contents up to the end of
+  // that part).  This can't be used for a buffered input.
+  //
+  std::string_view contents () const { return _data; }
+
 
   //
   // Error handling
@@ -200,10 +273,17 @@ private:
   //
   bool read_past_eol ();
 
+  // Read more of a buffered input's file into _BUF, first discarding
+  // everything before _NEXT_LINE_OFFS, and return true if anything
+  // was read.
+  //
+  bool refill ();
+
 
-  // Current line we're parsing.
+  // Current line we're parsing.  This normally points directly into
+  // _DATA.
   //
-  std::string _cur_line;
+  const char *_cur_line = 0;
 
   // Current parsing offset into _CUR_LINE.
   //
@@ -218,9 +298,41 @@ private:
   FileSrcContext::Loc _cur_line_src_loc = 0;
 
 
-  // Stream we're reading from.
+  // Contents of the file we're reading, if we own them (inputs
+  // reading only part of a file share their parent's contents).
+  //
+  std::unique_ptr<FileContents> _contents;
+
+  // Contents of the file up to the point where we stop reading, or
+  // for a buffered input, the part of it in _BUF.
+  //
+  std::string_view _data;
+
+  // File offset of the beginning of _DATA, which is only non-zero
+  // for a buffered input.
+  //
+  std::size_t _data_file_offs = 0;
+
+  // Offset in _DATA of the line following the current line.
+  //
+  std::size_t _next_line_offs = 0;
+
+  // For a buffered input, the file descriptor we're reading, or -1
+  // once its end has been reached, and the buffer we read into.  The
+  // buffer only grows if a single line doesn't fit.
+  //
+  int _fd = -1;
+  std::vector<char> _buf;
+
+  // Initial size of _BUF.
+  //
+  static constexpr std::size_t BUF_SIZE = 64 * 1024;
+
+  // If the last line of the file isn't terminated by a newline,
+  // non-line-oriented mode still needs to see one, so in that case
+  // the current line is copied here with a newline added.
   //
-  std::fstream _inp_stream;
+  std::string _unterminated_line;
 
 
   // True if in "line-oriented" mode, in which case character reading
@@ -6,8 +6,10 @@
 // Created: 2019-12-13
 //
 
+#include <algorithm>
+#include <cstring>
+#include <fstream>
 #include <stdexcept>
-#include <map>
 
 #include "check-assertion.h"
 
@@ -22,109 +24,16 @@ FileSrcContext::file (const std::string &file_name)
   File *&file_entry = _files[file_name];
 
   if (! file_entry)
-    file_entry = new File (file_name, *this);
+    {
+      Loc base_loc = static_cast<Loc> (_file_list.size ()) << LOC_OFFS_BITS;
+      _file_list.emplace_back (new File (file_name, base_loc));
+      file_entry = _file_list.back ().get ();
+    }
 
   return file_entry;
 }
 
 
-
-// A "chunk" within the FileSrcContext::Loc address space.  Each chunk
-// corresponds to MAX_CHUNK_SIZE bytes within the Loc address space,
-// and refers to a range of locations within some file up to that size
-// (the size of the file range represented by a chunk may be smaller
-// than MAX_CHUNK_SIZE, in which case the remaining address space is
-// just unused).
-//
-struct FileSrcContext::File::Chunk
-{
-  Chunk (File *_file, FilePos _file_pos, FileOffs _size,
-	 unsigned _line_offs = 0)
-    : file (_file), loc (0 /* set below */),
-      file_pos (_file_pos), size (_size),
-      line_offs (_line_offs),
-      line_num (0 /* set below */), num_lines (1)
-  {
-    // Global state for this chunk.
-    //
-    FileSrcContext &src_context = file->_src_context;
-    std::vector<Chunk *> &global_chunks = src_context._chunks;
-
-    // File state.
-    //
-    std::vector<Chunk *> &file_chunks = file->_chunks;
-
-    // Check chunk ordering constraints and set line number.
-    //
-    if (file_chunks.empty ())
-      {
-	// first chunk in this file
-
-	check_assertion (_file_pos == 0,
-			 "FileSrcContext line not added contiguously");
-
-	line_num = 1;
-      }
-    else
-      {
-	// This line follows some other line
-
-	Chunk *prev_chunk = file_chunks.back ();
-
-	check_assertion (prev_chunk->file_pos + prev_chunk->size == _file_pos,
-			 "FileSrcContext line not added contiguously");
-
-	line_num = prev_chunk->line_num + prev_chunk->num_lines;
-      }
-
-    // The source-location of this chunks corresponds to its global
-    // position.
-    //
-    unsigned chunk_index = global_chunks.size ();
-    loc = chunk_index << LOC_OFFS_BITS;
-
-    // Add this chunk to both the file and global chunk vectors.
-    //
-    file->_chunks.push_back (this);
-    global_chunks.push_back (this);
-  }
-
-
-  // File this chunk is inside.
-  //
-  File *file;
-
-  // Source-location of the beginning of this chunk.  Locations within
-  // the chunk are just LOC plus the offset within the chunk.
-  //
-  Loc loc;
-
-  // Position of the beginning of this chunk inside the file.
-  //
-  FilePos file_pos;
-
-  // Size of this chunk.  Chunks cannot be larger than
-  // FileSrcContext::MAX_CHUNK_SIZE.
-  //
-  FileOffs size;
-
-  // Offset of the beginning of this chunk inside the line it's in.
-  // For most chunks this is 0, but very long lines may span
-  // multiple chunks, in which case chunks after the first will have
-  // non-zero line offsets.
-  //
-  unsigned line_offs;
-
-  // Line-number of the first line within this chunk.
-  //
-  unsigned line_num;
-
-  // Number of lines within this chunk.
-  //
-  unsigned num_lines;
-};
-
-
 // Return the beginning source-location for a line in this file
 // with a byte range [BOL_OFFS, BOL_OFFS+LEN).
 //
@@ -145,164 +54,53 @@ struct FileSrcContext::File::Chunk
 //    this file which was previously added.
 //
 FileSrcContext::Loc
-FileSrcContext::File::add_line (FilePos bol_file_pos, FileOffs len)
+FileSrcContext::File::add_line (FilePos bol_offs, FileOffs len)
 {
-  // See if there's an existing chunk for this position.
-  //
-  unsigned num_chunks = _chunks.size ();
-  for (unsigned chunk_idx = 0; chunk_idx < num_chunks; chunk_idx++)
+  if (bol_offs < _end)
     {
-      Chunk *existing_chunk = _chunks[chunk_idx];
-      FilePos ex_beg_file_pos = existing_chunk->file_pos;
-      FilePos ex_end_file_pos = existing_chunk->file_pos + existing_chunk->size;
-      
-      // If we're looking at a chunk which is afte BOL_FILE_POS, then
-      // the caller is trying to add a line in the wrong order, so
-      // throw an exception.
+      // An already-added line.  If it doesn't fit within the lines
+      // we've seen, that means the file has changed since we last saw
+      // it, which is a user error.
       //
-      if (ex_beg_file_pos > bol_file_pos)
-	throw std::runtime_error ("FileSrcContext line not added contiguously");
-
-      // See if BOL_FILE_POS is _within_ EXISTING_CHUNK.
-      //
-      // In this case, BOL_FILE_POS + LEN must also fit within the current
-      // bounds of that chunk plus any existing "extension" chunks.
-      //
-      if (ex_beg_file_pos <= bol_file_pos && ex_end_file_pos > bol_file_pos)
-	{
-	  // Increase EX_END_FILE_POS to include any "extension" chunks.
-	  //
-	  unsigned extension_num = 1;
-	  while (chunk_idx + extension_num < num_chunks
-		 && _chunks[chunk_idx + extension_num]->line_offs > 0)
-	    {
-	      ex_end_file_pos += _chunks[chunk_idx + extension_num]->size;
-	      extension_num++;
-	    }
-
-	  // If this new line doesn't fit within the existing bound,
-	  // that means the file has changed since we last saw it,
-	  // which is a user error.
-	  //
-	  if (bol_file_pos + len > ex_end_file_pos)
-	    throw std::runtime_error ("Source file line out of sync");
-
-	  // Just return the info from the existing state.
-	  //
-	  return existing_chunk->loc + (bol_file_pos - ex_beg_file_pos);
-	}
-
-      // See if BOL_FILE_POS is precisely after EXISTING_CHUNK.
-      //
-      if (ex_beg_file_pos <= bol_file_pos && ex_end_file_pos == bol_file_pos)
-	{
-	  // See if EXISTING_CHUNK is the last chunk within the file,
-	  // in which case we will either extend it, or add a new
-	  // chunk after it.
-	  //
-	  if (chunk_idx == num_chunks - 1)
-	    {
-	      // If EXISTING_CHUNK can be extended, just do that.
-	      //
-	      if (existing_chunk->size + len <= MAX_CHUNK_SIZE)
-		{
-		  existing_chunk->size += len;
-
-		  return existing_chunk->loc + (bol_file_pos - ex_beg_file_pos);
-		}
-
-	      // The global vector of chunks within our
-	      // FileSrcContext.
-	      //
-	      std::vector<Chunk *> &global_chunks = _src_context._chunks;
-
-	      // EXISTING_CHUNK can't be extended, because LEN is too
-	      // long, but if it's the last global chunk, we can add
-	      // "extension chunks" after it instead.
-	      //
-	      if (existing_chunk == global_chunks.back ())
-		{
-		  // Add extension chunks.
-
-		  // Offset from beginning of line of each extension
-		  // chunk.  This is initially for the first extension
-		  // chunk, which starts after we use as much space in
-		  // EXISTING_CHUNK as possible.
-		  //
-		  unsigned extension_chunk_line_offs
-		    = (MAX_CHUNK_SIZE - existing_chunk->size);
-
-		  // File position of each extension chunk.  This
-		  // initially for the first extension chunk, which
-		  // starts MAX_CHUNK_SIZE after EXISTING_CHUNK's file
-		  // position (because we extend EXISTING_CHUNK to its
-		  // max size).
-		  //
-		  FilePos extension_chunk_file_pos
-		    = existing_chunk->file_pos + static_cast<FileOffs> (MAX_CHUNK_SIZE);
-
-		  // First make EXISTING_CHUNK as long as possible.
-		  //
-		  len -= extension_chunk_line_offs;
-		  existing_chunk->size = MAX_CHUNK_SIZE;
-
-		  // Now add extension chunks until LEN is small
-		  // enough to fit within the last one.
-		  //
-		  while (len > MAX_CHUNK_SIZE)
-		    {
-		      new Chunk (this, extension_chunk_file_pos,
-				 MAX_CHUNK_SIZE,
-				 extension_chunk_line_offs);
-
-		      extension_chunk_line_offs += MAX_CHUNK_SIZE;
-		      extension_chunk_file_pos += MAX_CHUNK_SIZE;
-		      len -= MAX_CHUNK_SIZE;
-		    }
-
-		  // Now LEN is small enough that we can add a final
-		  // extension chunk containing the end of the line.
-		  //
-		  new Chunk (this, extension_chunk_file_pos, len,
-			     extension_chunk_line_offs);
-
-		  // The final result is within the initial
-		  // EXISTING_CHUNK (all the extension chunks we added
-		  // essentially just serve to reserve the
-		  // source-location namespace for the rest of the line).
-		  //
-		  return existing_chunk->loc + (bol_file_pos - ex_beg_file_pos);
-		}
-	    }
-	}
+      if (bol_offs + len > _end)
+	throw std::runtime_error ("Source file line out of sync");
     }
+  else
+    {
+      check_assertion (bol_offs == _end,
+		       "FileSrcContext line not added contiguously");
+      check_assertion (bol_offs + len <= (Loc (1) << LOC_OFFS_BITS),
+		       "FileSrcContext file too large");
 
-  // We couldn't extend any existing chunk, so just add a new chunk at
-  // end of everything, which starts at the beginning of this line.
-  //
-  Chunk *new_chunk = new Chunk (this, bol_file_pos, len);
+      _line_starts.push_back (bol_offs);
+      _end = bol_offs + len;
+    }
 
-  // In the case of a new chunk
-  return new_chunk->loc;
+  return _base_loc + bol_offs;
 }
 
 
-// Return the file chunk LOC is inside.
+// Forget the lines in this file before the one containing the
+// source-location LOC, which must have been added.  Locations in
+// those lines may no longer be used, but line numbers of later lines
+// are unaffected.  This keeps the line table of a large file read one
+// part at a time from growing without bound.
 //
-FileSrcContext::File::Chunk *
-FileSrcContext::loc_chunk (Loc loc) const
+void
+FileSrcContext::File::forget_lines_before (Loc loc)
 {
-  loc >>= LOC_OFFS_BITS;
+  FilePos offs = loc - _base_loc;
 
-  if (loc > _chunks.size ())
-    throw std::runtime_error (
-		 "Invalid location chunk number in FileSrcContext::loc_chunk");
+  auto line_it
+    = std::upper_bound (_line_starts.begin (), _line_starts.end (), offs) - 1;
+  if (line_it <= _line_starts.begin ())
+    return;
 
-  return _chunks[loc];
+  _num_forgotten_lines += line_it - _line_starts.begin ();
+  _line_starts.erase (_line_starts.begin (), line_it);
 }
 
 
-
 // Return info about the source-location LOC in the following
 // out-parameters:
 //  + FILE_NAME is the name of the source file LOC is from
@@ -313,44 +111,56 @@ FileSrcContext::loc_chunk (Loc loc) const
 void
 FileSrcContext::loc_source (Loc loc,
 			    std::string &file_name,
-			    unsigned &line_num, unsigned &line_offs,
+			    unsigned &line_num, std::size_t &line_offs,
 			    std::string &line)
   const
 {
-  File::Chunk *chunk = loc_chunk (loc);
+  Loc file_idx = loc >> LOC_OFFS_BITS;
+  if (file_idx >= _file_list.size ())
+    throw std::runtime_error (
+		 "Invalid location file number in FileSrcContext::loc_source");
 
-  file_name = chunk->file->name ();
-  line_num = chunk->line_num;
+  const File *file = _file_list[file_idx].get ();
+  FilePos offs = loc - file->_base_loc;
 
-  std::ifstream stream (file_name);
+  if (file->_line_starts.empty () || offs >= file->_end)
+    throw std::runtime_error
+      ("Source-location past end of file in FileSrcContext::loc_source");
+  if (offs < file->_line_starts.front ())
+    throw std::runtime_error
+      ("Source-location in forgotten line in FileSrcContext::loc_source");
 
-  stream.seekg (chunk->file_pos);
+  // Find the last line which starts at or before OFFS.
+  //
+  const std::vector<FilePos> &line_starts = file->_line_starts;
+  auto line_it
+    = std::upper_bound (line_starts.begin (), line_starts.end (), offs) - 1;
 
-  Loc bol_loc = chunk->loc;
-  for (;;)
-    {
-      if (! std::getline (stream, line))
-	{
-	  throw std::runtime_error
-	    ("Source-location past end of file in FileSrcContext::loc_line");
-	}
+  FilePos bol_offs = *line_it;
 
-      unsigned line_len = line.size () + 1; // add 1 for the newline
+  file_name = file->name ();
+  line_num = file->_num_forgotten_lines + (line_it - line_starts.begin ()) + 1;
+  line_offs = offs - bol_offs;
 
-      // If LINE now spans LOC, we've found the line we're looking
-      // for, so break out of the loop.
+  if (bol_offs >= file->_contents_offs
+      && bol_offs - file->_contents_offs < file->_contents.size ())
+    {
+      // The file contents are in memory, so just copy the line from
+      // there.
       //
-      if (bol_loc + line_len > loc)
-	{
-	  line_offs = loc - bol_loc;
-	  break;
-	}
-
-      // Otherwise, adjust our numbers to include the effects of LINE
-      // and keep looking.
+      std::string_view rest
+	= file->_contents.substr (bol_offs - file->_contents_offs);
+      line = rest.substr (0, rest.find ('\n'));
+    }
+  else
+    {
+      // Otherwise, re-read the line from the file.
       //
-      bol_loc += line_len;
-      line_num++;
+      std::ifstream stream (file_name);
+      stream.seekg (bol_offs);
+      if (! std::getline (stream, line))
+	throw std::runtime_error
+	  ("Source-location past end of file in FileSrcContext::loc_source");
     }
 }
 
@@ -364,14 +174,13 @@ FileSrcContext::error (Loc loc, const std::string &msg) const
   std::string file_name;
   std::string line;
   unsigned line_num;
-  unsigned line_offs;
+  std::size_t line_offs;
 
   loc_source (loc, file_name, line_num, line_offs, line);
 
   std::string desc (line);
   desc += '\n';
-  for (unsigned i = 0; i < line_offs; i++)
-    desc += ' ';
+  desc.append (line_offs, ' ');
   desc += '^';
   desc += '\n';
 
@@ -9,9 +9,12 @@
 #ifndef __FILE_SRC_CONTEXT_H__
 #define __FILE_SRC_CONTEXT_H__
 
-#include <fstream>
-#include <vector>
+#include <cstdint>
 #include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include "src-context.h"
 
@@ -19,22 +22,24 @@
 // A file-oriented source-context, which tracks source locations
 // inside files.
 //
+// A source-location is just a byte offset within a file, with the
+// file's index in this context stored in the high bits.  Each file
+// keeps a table of line-start offsets, which is used to find the line
+// containing a location when it's needed for an error message.
+//
 class FileSrcContext : public SrcContext
 {
 public:
 
-  typedef std::streampos FilePos;
-  typedef std::streamoff FileOffs;
+  typedef std::uint64_t FilePos;
+  typedef std::uint64_t FileOffs;
 
   class File
   {
   public:
 
-    struct Chunk;
-
-
-    File (const std::string &name, FileSrcContext &src_context)
-      : _name (name), _src_context (src_context)
+    File (const std::string &name, Loc base_loc)
+      : _name (name), _base_loc (base_loc)
     { }
 
 
@@ -59,24 +64,65 @@ public:
     //
     Loc add_line (FilePos bol_offs, FileOffs len);
 
+    // Forget the lines in this file before the one containing the
+    // source-location LOC, which must have been added.  Locations in
+    // those lines may no longer be used, but line numbers of later
+    // lines are unaffected.  This keeps the line table of a large
+    // file read one part at a time from growing without bound.
+    //
+    void forget_lines_before (Loc loc);
+
     // Return the name of this file.
     //
     const std::string &name () const { return _name; }
 
 
+    // Make the contents of this file available in memory as CONTENTS,
+    // so that source lines needn't be re-read from the file when
+    // reporting errors (which is impossible for standard input).
+    // If only part of the file is in memory, OFFS is the file offset
+    // where CONTENTS begins.  CONTENTS must remain valid until this
+    // is called again; calling it with an empty string makes the
+    // contents unavailable.
+    //
+    void set_contents (std::string_view contents, FilePos offs = 0)
+    {
+      _contents = contents;
+      _contents_offs = offs;
+    }
+
+
   private:
 
+    friend class FileSrcContext;
+
+
     // Name of this file.
     //
     std::string _name;
 
-    // Chunks inside the file.
+    // Source-location of the beginning of this file.
     //
-    std::vector<Chunk *> _chunks;
+    Loc _base_loc;
 
-    // Source context this file is in.
+    // File offsets of the beginning of every line added so far and
+    // not forgotten, in order.
     //
-    FileSrcContext &_src_context;
+    std::vector<FilePos> _line_starts;
+
+    // Number of lines forgotten from the beginning of _LINE_STARTS.
+    //
+    unsigned _num_forgotten_lines = 0;
+
+    // File offset of the end of the last line added.
+    //
+    FilePos _end = 0;
+
+    // Contents of this file, if available in memory, or empty if not,
+    // and the file offset where they begin.
+    //
+    std::string_view _contents;
+    FilePos _contents_offs = 0;
   };
 
 
@@ -103,37 +149,27 @@ public:
   //
   void loc_source (Loc loc,
 		   std::string &file_name,
-		   unsigned &line_num, unsigned &line_offs,
+		   unsigned &line_num, std::size_t &line_offs,
 		   std::string &line)
     const;
 
   
 private:
 
-  // Return the chunk LOC is inside.
-  //
-  File::Chunk *loc_chunk (Loc loc) const;
-
-
   // The number of bits inside a FileSrcContext::Loc descriptor which
-  // correspond to the chunk-offset of the location.
-  //
-  static const unsigned LOC_OFFS_BITS = 16;
-
-  // The maximum size of a chunk.  This is also the size of the region
-  // within the Loc address space that each chunk represents.
+  // correspond to the file offset of the location.  The remaining
+  // high bits hold the file index.
   //
-  static const unsigned MAX_CHUNK_SIZE = (1 << LOC_OFFS_BITS);
+  static const unsigned LOC_OFFS_BITS = 40;
 
-  // Files tracked by this source context.
+  // Files tracked by this source context, indexed by name.
   //
   std::map<const std::string, File *> _files;
 
-  // A series of "chunks", each representing MAX_CHUNK_SIZE bytes
-  // within the Loc address space, and each referring to some part of
-  // some file.
+  // Files tracked by this source context, in the order they were
+  // added, which is also the order of their source-locations.
   //
-  std::vector<File::Chunk *> _chunks;
+  std::vector<std::unique_ptr<File>> _file_list;
 };
 
 
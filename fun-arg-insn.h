@@ -20,6 +20,8 @@ class FunArgInsn : public Insn
 {
 public:
 
+  MEM_ACCOUNTED (FunArgInsn);
+
   // Make a new function-argument instruction, which associates
   // function argument ARG_NUM with the register ARG.
   //
@@ -0,0 +1,535 @@
+// fun-cache.cc -- On-disk cache of per-function results
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "stats.h"
+
+#include "fun-cache.h"
+
+
+static Stat cache_hits ("fun-cache", "hits",
+			"Number of functions found in the cache");
+static Stat cache_misses ("fun-cache", "misses",
+			  "Number of functions not found in the cache");
+static Stat cache_stores ("fun-cache", "stores",
+			  "Number of entries added to the cache");
+static Stat cache_store_failures ("fun-cache", "store-failures",
+				  "Number of entries which couldn't be written");
+static Stat cache_evictions ("fun-cache", "evictions",
+			     "Number of least-recently-used entries deleted");
+static Stat cache_scans ("fun-cache", "scans",
+			 "Number of scans of the cache directory");
+
+
+// Every entry file starts with this, followed by the entry's key, and
+// then the entry data.
+//
+static constexpr char ENTRY_MAGIC[4] = { 'C', 'C', 'F', 'C' };
+static constexpr std::size_t ENTRY_HEADER_SIZE
+  = sizeof ENTRY_MAGIC + 2 * sizeof (std::uint64_t);
+
+// Temporary files older than this many seconds are assumed to have
+// been left behind by a process which died, and are deleted.
+//
+static constexpr time_t STALE_TMP_FILE_AGE = 60 * 60;
+
+// An entry's modification time is only updated when it's used if it's
+// older than this many seconds, as writing it costs about as much as
+// the rest of a lookup.  Eviction order is only this precise.
+//
+static constexpr time_t MTIME_UPDATE_INTERVAL = 10 * 60;
+
+// Name of the file in the cache directory holding the total size of
+// all entries, as a decimal number.
+//
+static constexpr char SIZE_FILE_NAME[] = "size";
+
+
+// ----------------------------------------------------------------
+// Hashing
+
+
+// Keys are 128-bit FNV-1a hashes.
+//
+__extension__ typedef unsigned __int128 Hash128;
+
+static constexpr Hash128 FNV128_OFFSET
+  = (Hash128 (0x6c62272e07bb0142ULL) << 64) | 0x62b821756295c58dULL;
+static constexpr Hash128 FNV128_PRIME = (Hash128 (1) << 88) | 0x13b;
+
+// Return HASH updated with the contents of DATA.
+//
+static Hash128
+hash_update (Hash128 hash, std::string_view data)
+{
+  for (unsigned char ch : data)
+    {
+      hash ^= ch;
+      hash *= FNV128_PRIME;
+    }
+  return hash;
+}
+
+static Hash128
+key_hash (const FunCache::Key &key)
+{
+  return (Hash128 (key.hi) << 64) | key.lo;
+}
+
+static FunCache::Key
+hash_key (Hash128 hash)
+{
+  FunCache::Key key;
+  key.hi = hash >> 64;
+  key.lo = hash;
+  return key;
+}
+
+
+// ----------------------------------------------------------------
+// File helpers
+
+
+// Write LEN bytes from DATA to the file descriptor FD, and return
+// true if successful.
+//
+static bool
+write_all (int fd, const char *data, std::size_t len)
+{
+  while (len > 0)
+    {
+      ssize_t written = write (fd, data, len);
+      if (written < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  return false;
+	}
+      data += written;
+      len -= written;
+    }
+  return true;
+}
+
+// Read the entire contents of the file descriptor FD into DATA, and
+// return true if successful.  STAT_BUF is set to the file's status.
+//
+static bool
+read_all (int fd, std::string &data, struct stat &stat_buf)
+{
+  if (fstat (fd, &stat_buf) < 0)
+    return false;
+
+  data.resize (stat_buf.st_size);
+
+  std::size_t offs = 0;
+  while (offs < data.size ())
+    {
+      ssize_t num_read = read (fd, &data[offs], data.size () - offs);
+      if (num_read < 0 && errno == EINTR)
+	continue;
+      if (num_read <= 0)
+	return false;
+      offs += num_read;
+    }
+
+  return true;
+}
+
+
+// Read the number in the size file open on FD into SIZE, and return
+// true if successful.
+//
+static bool
+read_size (int fd, std::uint64_t &size)
+{
+  char buf[32];
+  ssize_t len = pread (fd, buf, sizeof buf - 1, 0);
+  if (len <= 0)
+    return false;
+  buf[len] = '\0';
+
+  char *end;
+  errno = 0;
+  size = strtoull (buf, &end, 10);
+  return errno == 0 && end != buf && *end == '\0';
+}
+
+// Replace the contents of the size file open on FD with SIZE.
+//
+static void
+write_size (int fd, std::uint64_t size)
+{
+  std::string text = std::to_string (size);
+  if (pwrite (fd, text.data (), text.size (), 0) == ssize_t (text.size ()))
+    ftruncate (fd, text.size ());
+  else
+    ftruncate (fd, 0);
+}
+
+
+// ----------------------------------------------------------------
+// FunCache
+
+
+// Make a cache using the directory DIR, which is created if
+// necessary, and whose total size is limited to MAX_SIZE bytes.
+//
+FunCache::FunCache (const std::string &dir, std::uint64_t max_size)
+  : _dir (dir), _max_size (max_size)
+{
+  if (mkdir (_dir.c_str (), 0777) < 0 && errno != EEXIST)
+    throw std::runtime_error (_dir + ": Cannot create cache directory: "
+			      + strerror (errno));
+
+  struct stat stat_buf;
+  if (stat (_dir.c_str (), &stat_buf) < 0 || ! S_ISDIR (stat_buf.st_mode))
+    throw std::runtime_error (_dir + ": Not a directory");
+}
+
+FunCache::~FunCache ()
+{
+  evict ();
+}
+
+
+// Return the starting point for the keys of results which depend on
+// SALT, which should describe everything besides a function which
+// affects them, for instance the tool version and the options used.
+//
+FunCache::Key
+FunCache::salt_key (std::string_view salt)
+{
+  return hash_key (hash_update (FNV128_OFFSET, salt));
+}
+
+
+// Return the key for a function called NAME whose canonical
+// representation is CANON, starting from SALT_KEY, which was returned
+// by salt_key.
+//
+FunCache::Key
+FunCache::key (const Key &salt_key,
+	       std::string_view name, std::string_view canon)
+{
+  Hash128 hash = key_hash (salt_key);
+
+  // Function names can't contain a NUL, so use that to separate the
+  // name from the representation.
+  //
+  hash = hash_update (hash, name);
+  hash = hash_update (hash, std::string_view ("", 1));
+  hash = hash_update (hash, canon);
+
+  return hash_key (hash);
+}
+
+
+// Return the name of the file holding the entry for KEY.
+//
+std::string
+FunCache::entry_file_name (const Key &key) const
+{
+  // Entries are spread over 256 subdirectories, named after the
+  // first two hex digits of the key, to keep directories small.
+  //
+  char hex[33];
+  snprintf (hex, sizeof hex, "%016llx%016llx",
+	    static_cast<unsigned long long> (key.hi),
+	    static_cast<unsigned long long> (key.lo));
+
+  std::string file_name (_dir);
+  file_name += '/';
+  file_name.append (hex, 2);
+  file_name += '/';
+  file_name.append (hex + 2);
+  return file_name;
+}
+
+
+// If there's an entry for KEY, store its data in DATA and return
+// true, otherwise return false.
+//
+bool
+FunCache::lookup (const Key &key, std::string &data)
+{
+  std::string file_name = entry_file_name (key);
+
+  int fd = open (file_name.c_str (), O_RDONLY);
+  if (fd < 0)
+    {
+      ++cache_misses;
+      return false;
+    }
+
+  std::string contents;
+  struct stat stat_buf;
+  bool ok = read_all (fd, contents, stat_buf);
+
+  // Check that the entry is valid, and really for KEY.
+  //
+  if (ok)
+    {
+      std::uint64_t hi, lo;
+      ok = (contents.size () >= ENTRY_HEADER_SIZE
+	    && memcmp (contents.data (), ENTRY_MAGIC, sizeof ENTRY_MAGIC) == 0);
+      if (ok)
+	{
+	  memcpy (&hi, contents.data () + sizeof ENTRY_MAGIC, sizeof hi);
+	  memcpy (&lo, contents.data () + sizeof ENTRY_MAGIC + sizeof hi,
+		  sizeof lo);
+	  ok = (hi == key.hi && lo == key.lo);
+	}
+    }
+
+  // Mark the entry as recently used, for eviction, unless it already
+  // was fairly recently.
+  //
+  if (ok && stat_buf.st_mtime + MTIME_UPDATE_INTERVAL < time (0))
+    futimens (fd, 0);
+
+  close (fd);
+
+  if (! ok)
+    {
+      ++cache_misses;
+      return false;
+    }
+
+  data.assign (contents, ENTRY_HEADER_SIZE);
+
+  ++cache_hits;
+
+  return true;
+}
+
+
+// Add DATA to the cache as the entry for KEY.
+//
+void
+FunCache::store (const Key &key, std::string_view data)
+{
+  std::string file_name = entry_file_name (key);
+
+  // Write the entry to a temporary file first, and then rename it
+  // into place, so it appears atomically.
+  //
+  std::string tmp_file_name (_dir);
+  tmp_file_name += "/tmp-";
+  tmp_file_name += std::to_string (getpid ());
+  tmp_file_name += '-';
+  tmp_file_name += std::to_string (_tmp_counter++);
+
+  int fd = open (tmp_file_name.c_str (), O_WRONLY | O_CREAT | O_EXCL, 0666);
+  if (fd < 0)
+    {
+      ++cache_store_failures;
+      return;
+    }
+
+  char header[ENTRY_HEADER_SIZE];
+  memcpy (header, ENTRY_MAGIC, sizeof ENTRY_MAGIC);
+  memcpy (header + sizeof ENTRY_MAGIC, &key.hi, sizeof key.hi);
+  memcpy (header + sizeof ENTRY_MAGIC + sizeof key.hi, &key.lo, sizeof key.lo);
+
+  bool ok = (write_all (fd, header, sizeof header)
+	     && write_all (fd, data.data (), data.size ()));
+
+  if (close (fd) < 0)
+    ok = false;
+
+  if (ok)
+    {
+      // Make sure the entry's subdirectory exists.
+      //
+      std::string subdir = file_name.substr (0, file_name.rfind ('/'));
+      if (mkdir (subdir.c_str (), 0777) < 0 && errno != EEXIST)
+	ok = false;
+    }
+
+  if (ok && rename (tmp_file_name.c_str (), file_name.c_str ()) < 0)
+    ok = false;
+
+  if (! ok)
+    {
+      unlink (tmp_file_name.c_str ());
+      ++cache_store_failures;
+      return;
+    }
+
+  _stored_size += sizeof header + data.size ();
+  _stored = true;
+
+  ++cache_stores;
+}
+
+
+// If the cache has grown larger than its size limit, delete
+// least-recently-used entries until it fits.  This is done
+// automatically when the cache is destroyed.
+//
+// The total size of the cache is kept in its size file, which each
+// process adds the size of the entries it stored to here, so the
+// directory is only scanned if that says the cache is over the limit,
+// or the file is missing.
+//
+void
+FunCache::evict ()
+{
+  // If nothing's been added, the cache can't have grown.
+  //
+  if (! _stored.exchange (false))
+    return;
+
+  std::lock_guard<std::mutex> guard (_evict_lock);
+
+  // The size file is locked while it's updated, and while scanning,
+  // so only one process scans at a time.  If it can't be used, we
+  // just scan every time.
+  //
+  std::string size_file_name = _dir + "/" + SIZE_FILE_NAME;
+  int size_fd = open (size_file_name.c_str (), O_RDWR | O_CREAT, 0666);
+  if (size_fd >= 0 && flock (size_fd, LOCK_EX) < 0)
+    {
+      close (size_fd);
+      size_fd = -1;
+    }
+
+  std::uint64_t total_size = 0;
+  bool size_known = size_fd >= 0 && read_size (size_fd, total_size);
+
+  total_size += _stored_size.exchange (0);
+
+  if (! size_known || total_size > _max_size)
+    total_size = scan ();
+
+  if (size_fd >= 0)
+    {
+      write_size (size_fd, total_size);
+      close (size_fd);
+    }
+}
+
+
+// Scan the cache directory, deleting stale temporary files, and if
+// the entries' total size is over the limit, least-recently-used
+// entries until it isn't.  Return the total size of the remaining
+// entries.
+//
+std::uint64_t
+FunCache::scan ()
+{
+  ++cache_scans;
+
+  struct Entry
+  {
+    std::string file_name;
+    std::uint64_t size;
+    struct timespec mtime;
+  };
+
+  std::vector<Entry> entries;
+  std::uint64_t total_size = 0;
+
+  time_t now = time (0);
+
+  DIR *dir = opendir (_dir.c_str ());
+  if (! dir)
+    return 0;
+
+  while (struct dirent *dir_ent = readdir (dir))
+    {
+      std::string name (dir_ent->d_name);
+      std::string path = _dir + "/" + name;
+
+      if (name.compare (0, 4, "tmp-") == 0)
+	{
+	  // A temporary file, which if old was probably left behind
+	  // by a process which died before renaming it.
+	  //
+	  struct stat stat_buf;
+	  if (stat (path.c_str (), &stat_buf) == 0
+	      && stat_buf.st_mtime + STALE_TMP_FILE_AGE < now)
+	    unlink (path.c_str ());
+	  continue;
+	}
+
+      if (name.size () != 2 || ! isxdigit (name[0]) || ! isxdigit (name[1]))
+	continue;
+
+      DIR *subdir = opendir (path.c_str ());
+      if (! subdir)
+	continue;
+
+      while (struct dirent *sub_ent = readdir (subdir))
+	{
+	  if (sub_ent->d_name[0] == '.')
+	    continue;
+
+	  std::string entry_path = path + "/" + sub_ent->d_name;
+
+	  struct stat stat_buf;
+	  if (stat (entry_path.c_str (), &stat_buf) < 0
+	      || ! S_ISREG (stat_buf.st_mode))
+	    continue;
+
+	  entries.push_back (Entry { entry_path,
+				     std::uint64_t (stat_buf.st_size),
+				     stat_buf.st_mtim });
+	  total_size += stat_buf.st_size;
+	}
+
+      closedir (subdir);
+    }
+
+  closedir (dir);
+
+  if (total_size <= _max_size)
+    return total_size;
+
+  // Delete entries in order of last use until we're under the limit.
+  //
+  std::sort (entries.begin (), entries.end (),
+	     [] (const Entry &e1, const Entry &e2)
+	     {
+	       if (e1.mtime.tv_sec != e2.mtime.tv_sec)
+		 return e1.mtime.tv_sec < e2.mtime.tv_sec;
+	       return e1.mtime.tv_nsec < e2.mtime.tv_nsec;
+	     });
+
+  for (auto &entry : entries)
+    {
+      if (total_size <= _max_size)
+	break;
+
+      // Another process may have deleted it already, but either
+      // way, it's gone.
+      //
+      unlink (entry.file_name.c_str ());
+      total_size -= entry.size;
+
+      ++cache_evictions;
+    }
+
+  return total_size;
+}
@@ -0,0 +1,150 @@
+// fun-cache.h -- On-disk cache of per-function results
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#ifndef __FUN_CACHE_H__
+#define __FUN_CACHE_H__
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+
+// A cache of results computed from functions, such as optimized
+// output, stored in a directory on the local filesystem so it can be
+// reused by later runs.
+//
+// Results are looked up by a key which is a 128-bit hash of
+// everything the result depends on, so one cache can hold results
+// computed with different options.  Each entry is stored in its own
+// file, which is written under a temporary name and then renamed
+// into place, so readers never see partial entries, and several
+// processes can safely share the same cache.
+//
+// Using an entry updates its modification time (at most every few
+// minutes), and when the cache is finished with, if it has grown
+// larger than its size limit, the least-recently-used entries are
+// deleted.  A long-lived process should instead call evict from time
+// to time, which is cheap unless the cache may have grown too large.
+//
+// The total size of all entries is kept in a file in the cache
+// directory, which each process adds to after storing entries, so
+// the directory only needs to be scanned when the cache is too large.
+// Entries deleted some other way make the total too large, which
+// just causes an early scan, which corrects it.
+//
+// Problems reading or writing individual entries just cause cache
+// misses or lost results, rather than errors.
+//
+class FunCache
+{
+public:
+
+  // A cache key.
+  //
+  struct Key
+  {
+    std::uint64_t hi = 0, lo = 0;
+
+    bool operator== (const Key &key) const
+    {
+      return hi == key.hi && lo == key.lo;
+    }
+  };
+
+
+  // Make a cache using the directory DIR, which is created if
+  // necessary, and whose total size is limited to MAX_SIZE bytes.
+  //
+  FunCache (const std::string &dir, std::uint64_t max_size);
+
+  ~FunCache ();
+
+  FunCache (const FunCache &) = delete;
+  FunCache &operator= (const FunCache &) = delete;
+
+
+  // Return the starting point for the keys of results which depend
+  // on SALT, which should describe everything besides a function
+  // which affects them, for instance the tool version and the options
+  // used.
+  //
+  static Key salt_key (std::string_view salt);
+
+  // Return the key for a function called NAME whose canonical
+  // representation is CANON, starting from SALT_KEY, which was
+  // returned by salt_key.
+  //
+  static Key key (const Key &salt_key,
+		  std::string_view name, std::string_view canon);
+
+
+  // If there's an entry for KEY, store its data in DATA and return
+  // true, otherwise return false.
+  //
+  bool lookup (const Key &key, std::string &data);
+
+  // Add DATA to the cache as the entry for KEY.
+  //
+  void store (const Key &key, std::string_view data);
+
+
+  // If the cache has grown larger than its size limit, delete
+  // least-recently-used entries until it fits.  This is done
+  // automatically when the cache is destroyed.
+  //
+  // If nothing has been stored since the last call, this does
+  // nothing, and otherwise it just updates the size file unless the
+  // cache is too large, so it's cheap to call often.
+  //
+  void evict ();
+
+
+private:
+
+  // Return the name of the file holding the entry for KEY.
+  //
+  std::string entry_file_name (const Key &key) const;
+
+  // Scan the cache directory, deleting stale temporary files, and if
+  // the entries' total size is over the limit, least-recently-used
+  // entries until it isn't.  Return the total size of the remaining
+  // entries.
+  //
+  std::uint64_t scan ();
+
+
+  // Directory holding the cache.
+  //
+  std::string _dir;
+
+  // Maximum total size of all entries.
+  //
+  std::uint64_t _max_size;
+
+  // True if anything has been stored since the last eviction.
+  //
+  std::atomic<bool> _stored { false };
+
+  // Total size of the entries stored since the last eviction, which
+  // haven't yet been added to the size file.
+  //
+  std::atomic<std::uint64_t> _stored_size { 0 };
+
+  // Held while scanning the directory to evict entries.
+  //
+  std::mutex _evict_lock;
+
+  // Counter used to make unique temporary file names.
+  //
+  std::atomic<unsigned> _tmp_counter { 0 };
+};
+
+
+#endif // __FUN_CACHE_H__
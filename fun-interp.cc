@@ -0,0 +1,353 @@
+// fun-interp.cc -- Reference interpreter for IR functions
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+#include "fun.h"
+#include "bb.h"
+#include "reg.h"
+#include "value.h"
+#include "copy-insn.h"
+#include "cond-branch-insn.h"
+#include "phi-fun-insn.h"
+#include "phi-fun-inp-insn.h"
+#include "fun-arg-insn.h"
+#include "fun-result-insn.h"
+
+#include "fun-interp.h"
+
+
+// Make an interpreter for FUN.
+//
+FunInterp::FunInterp (Fun *fun)
+{
+  // Block indices, by block number.
+  //
+  std::vector<unsigned> block_indices (fun->max_block_num () + 1, NO_BLOCK);
+  for (auto block : fun->blocks ())
+    {
+      block_indices[block->num ()] = _blocks.size ();
+      _blocks.push_back (Block { 0, 0, NO_BLOCK });
+      _block_counts.push_back (BlockCounts { block });
+    }
+
+  auto block_index = [&] (BB *block)
+    {
+      return block ? block_indices[block->num ()] : NO_BLOCK;
+    };
+
+  std::unordered_map<Reg *, unsigned> reg_nums;
+  auto reg_num = [&] (Reg *reg)
+    {
+      auto [it, added] = reg_nums.emplace (reg, _init_regs.size ());
+      if (added)
+	{
+	  Value *value = reg->value ();
+	  _init_regs.push_back (value ? value->int_value () : 0);
+	}
+      return it->second;
+    };
+
+  std::unordered_map<PhiFunInsn *, unsigned> phi_slots;
+  auto phi_slot = [&] (PhiFunInsn *phi_fun)
+    {
+      auto [it, added] = phi_slots.emplace (phi_fun, _num_phi_slots);
+      if (added)
+	_num_phi_slots++;
+      return it->second;
+    };
+
+  _entry = block_index (fun->entry_block ());
+  _exit = block_index (fun->exit_block ());
+
+  unsigned block_idx = 0;
+  for (auto block : fun->blocks ())
+    {
+      Block &flat_block = _blocks[block_idx++];
+
+      flat_block.beg = _ops.size ();
+      flat_block.fall_through = block_index (block->fall_through ());
+
+      for (auto insn : block->insns ())
+	{
+	  const Insn::RegVector &args = insn->args ();
+	  const Insn::RegVector &results = insn->results ();
+
+	  Op op { Kind::NOP, CalcInsn::Op::NONE, 0, 0, 0 };
+
+	  if (CalcInsn *calc_insn = dynamic_cast<CalcInsn *> (insn))
+	    {
+	      op.result = reg_num (results[0]);
+	      op.arg1 = reg_num (args[0]);
+	      if (calc_insn->op () == CalcInsn::Op::NEG)
+		op.kind = Kind::NEG;
+	      else
+		{
+		  op.kind = Kind::CALC;
+		  op.calc_op = calc_insn->op ();
+		  op.arg2 = reg_num (args[1]);
+		}
+	    }
+	  else if (dynamic_cast<CopyInsn *> (insn))
+	    {
+	      if (args.size () == 1)
+		{
+		  op.kind = Kind::COPY;
+		  op.result = reg_num (results[0]);
+		  op.arg1 = reg_num (args[0]);
+		}
+	      else
+		{
+		  op.kind = Kind::MULTI_COPY;
+		  op.arg1 = _multi_copy_regs.size ();
+		  op.arg2 = args.size ();
+		  for (auto arg : args)
+		    _multi_copy_regs.push_back (reg_num (arg));
+		  for (auto result : results)
+		    _multi_copy_regs.push_back (reg_num (result));
+		}
+	    }
+	  else if (CondBranchInsn *branch = dynamic_cast<CondBranchInsn *> (insn))
+	    {
+	      op.kind = Kind::COND_BRANCH;
+	      op.arg1 = reg_num (branch->condition ());
+	      op.arg2 = block_index (branch->target ());
+	      op.result = _branch_counts.size ();
+	      _branch_counts.push_back (BranchCounts { branch });
+	    }
+	  else if (PhiFunInsn *phi_fun = dynamic_cast<PhiFunInsn *> (insn))
+	    {
+	      op.kind = Kind::PHI_FUN;
+	      op.result = reg_num (results[0]);
+	      op.arg1 = phi_slot (phi_fun);
+	    }
+	  else if (PhiFunInpInsn *phi_inp = dynamic_cast<PhiFunInpInsn *> (insn))
+	    {
+	      // An input whose phi-function has gone does nothing.
+	      //
+	      if (phi_inp->phi_fun ())
+		{
+		  op.kind = Kind::PHI_FUN_INP;
+		  op.arg1 = reg_num (args[0]);
+		  op.arg2 = phi_slot (phi_inp->phi_fun ());
+		}
+	    }
+	  else if (FunArgInsn *fun_arg = dynamic_cast<FunArgInsn *> (insn))
+	    {
+	      op.kind = Kind::FUN_ARG;
+	      op.result = reg_num (results[0]);
+	      op.arg1 = fun_arg->arg_num ();
+	      _num_args = std::max (_num_args, op.arg1 + 1);
+	    }
+	  else if (FunResultInsn *fun_result
+		   = dynamic_cast<FunResultInsn *> (insn))
+	    {
+	      op.kind = Kind::FUN_RESULT;
+	      op.result = fun_result->result_num ();
+	      op.arg1 = reg_num (args[0]);
+	      _num_results = std::max (_num_results, op.result + 1);
+	    }
+
+	  _ops.push_back (op);
+	}
+
+      flat_block.end = _ops.size ();
+    }
+}
+
+
+// Return the result of the calculation OP on VAL1 and VAL2.
+// Arithmetic is done unsigned, so that overflow wraps around.
+//
+int
+FunInterp::calc (CalcInsn::Op op, int val1, int val2)
+{
+  unsigned uval1 = val1, uval2 = val2;
+
+  switch (op)
+    {
+    case CalcInsn::Op::ADD:
+      return int (uval1 + uval2);
+    case CalcInsn::Op::SUB:
+      return int (uval1 - uval2);
+    case CalcInsn::Op::MUL:
+      return int (uval1 * uval2);
+    case CalcInsn::Op::DIV:
+      if (val2 == 0)
+	throw std::runtime_error ("Division by zero");
+      if (val2 == -1)
+	return int (0U - uval1);
+      return val1 / val2;
+    case CalcInsn::Op::NEG:
+      return int (0U - uval1);
+    case CalcInsn::Op::NONE:
+      break;
+    }
+
+  throw std::runtime_error ("Invalid calculation operation");
+}
+
+
+// Run the function with arguments ARGS, and return its results,
+// indexed by result number.  Counts from this run are added to those
+// from any previous runs.
+//
+std::vector<int>
+FunInterp::run (const std::vector<int> &args)
+{
+  if (args.size () != _num_args)
+    throw std::runtime_error ("Function expects "
+			      + std::to_string (_num_args) + " arguments, but "
+			      + std::to_string (args.size ()) + " given");
+
+  if (_entry == NO_BLOCK)
+    throw std::runtime_error ("Function has no entry block");
+
+  std::vector<int> regs (_init_regs);
+  std::vector<int> results (_num_results);
+
+  // For each phi-function, the value recorded by its inputs, and the
+  // block which recorded it.
+  //
+  std::vector<int> phi_vals (_num_phi_slots);
+  std::vector<unsigned> phi_srcs (_num_phi_slots, NO_BLOCK);
+
+  // A scratch area for multiple copies.
+  //
+  std::vector<int> copy_vals;
+
+  std::uint64_t insns = 0;
+
+  unsigned block_idx = _entry, prev_block_idx = NO_BLOCK;
+  for (;;)
+    {
+      const Block &block = _blocks[block_idx];
+      unsigned next_block_idx = block.fall_through;
+
+      _block_counts[block_idx].visits++;
+      _block_visits++;
+
+      for (unsigned op_idx = block.beg; op_idx < block.end; op_idx++)
+	{
+	  const Op &op = _ops[op_idx];
+
+	  insns++;
+
+	  switch (op.kind)
+	    {
+	    case Kind::CALC:
+	      regs[op.result] = calc (op.calc_op, regs[op.arg1], regs[op.arg2]);
+	      break;
+
+	    case Kind::NEG:
+	      regs[op.result] = int (0U - unsigned (regs[op.arg1]));
+	      break;
+
+	    case Kind::COPY:
+	      regs[op.result] = regs[op.arg1];
+	      break;
+
+	    case Kind::MULTI_COPY:
+	      {
+		const unsigned *srcs = &_multi_copy_regs[op.arg1];
+		const unsigned *dsts = srcs + op.arg2;
+		copy_vals.resize (op.arg2);
+		for (unsigned i = 0; i < op.arg2; i++)
+		  copy_vals[i] = regs[srcs[i]];
+		for (unsigned i = 0; i < op.arg2; i++)
+		  regs[dsts[i]] = copy_vals[i];
+	      }
+	      break;
+
+	    case Kind::COND_BRANCH:
+	      {
+		BranchCounts &counts = _branch_counts[op.result];
+		if (regs[op.arg1])
+		  {
+		    counts.taken++;
+		    _branches_taken++;
+
+		    if (op.arg2 == NO_BLOCK)
+		      throw std::runtime_error ("Branch to undefined block");
+
+		    next_block_idx = op.arg2;
+		    goto end_block;
+		  }
+
+		counts.not_taken++;
+		_branches_not_taken++;
+	      }
+	      break;
+
+	    case Kind::PHI_FUN:
+	      if (phi_srcs[op.arg1] == prev_block_idx)
+		regs[op.result] = phi_vals[op.arg1];
+	      break;
+
+	    case Kind::PHI_FUN_INP:
+	      phi_vals[op.arg2] = regs[op.arg1];
+	      phi_srcs[op.arg2] = block_idx;
+	      break;
+
+	    case Kind::FUN_ARG:
+	      regs[op.result] = args[op.arg1];
+	      break;
+
+	    case Kind::FUN_RESULT:
+	      results[op.result] = regs[op.arg1];
+	      break;
+
+	    case Kind::NOP:
+	      break;
+	    }
+	}
+
+    end_block:
+      if (block_idx == _exit)
+	break;
+
+      if (next_block_idx == NO_BLOCK)
+	{
+	  _insns += insns;
+	  throw std::runtime_error ("Control fell off the end of block "
+				    + std::to_string (_block_counts[block_idx]
+						      .block->num ()));
+	}
+
+      if (_max_insns && insns > _max_insns)
+	{
+	  _insns += insns;
+	  throw std::runtime_error ("Instruction limit exceeded");
+	}
+
+      prev_block_idx = block_idx;
+      block_idx = next_block_idx;
+    }
+
+  _insns += insns;
+
+  return results;
+}
+
+
+// Reset all counts to zero.
+//
+void
+FunInterp::clear_counts ()
+{
+  _insns = _block_visits = 0;
+  _branches_taken = _branches_not_taken = 0;
+
+  for (auto &counts : _block_counts)
+    counts.visits = 0;
+  for (auto &counts : _branch_counts)
+    counts.taken = counts.not_taken = 0;
+}
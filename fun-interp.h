@@ -0,0 +1,199 @@
+// fun-interp.h -- Reference interpreter for IR functions
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#ifndef __FUN_INTERP_H__
+#define __FUN_INTERP_H__
+
+#include <cstdint>
+#include <vector>
+
+#include "calc-insn.h"
+
+
+class Fun;
+class BB;
+class Reg;
+class CondBranchInsn;
+
+
+// An interpreter which executes an IR function, either in SSA form or
+// not, and counts what it did.
+//
+// The function is first translated into a flat form, with registers
+// numbered densely and each block's instructions in an array, so the
+// function must not be changed while an interpreter for it exists.
+//
+// Semantics:
+//
+//   * Registers start out as zero, except for constant registers,
+//     which hold their value.  Arithmetic wraps around, and division
+//     by zero is an error.
+//
+//   * A block runs its instructions in order.  A conditional branch
+//     whose condition is non-zero transfers control immediately to
+//     its target; otherwise execution continues, and falls through to
+//     the block's fall-through block at the end.  Execution finishes
+//     at the end of the function's exit block.
+//
+//   * A phi-function input records the value of its argument for its
+//     phi-function.  A phi-function at the start of a block takes the
+//     value recorded by the block control came from, if any, or else
+//     leaves its result unchanged.  As recorded values are kept apart
+//     from registers, all the phi-functions in a block are in effect
+//     evaluated in parallel, as are the copies in a multiple copy.
+//
+class FunInterp
+{
+public:
+
+  // Dynamic counts for a block.
+  //
+  struct BlockCounts
+  {
+    BB *block;
+    std::uint64_t visits = 0;
+  };
+
+  // Dynamic counts for a conditional branch instruction.
+  //
+  struct BranchCounts
+  {
+    CondBranchInsn *insn;
+    std::uint64_t taken = 0, not_taken = 0;
+  };
+
+
+  // Make an interpreter for FUN.
+  //
+  FunInterp (Fun *fun);
+
+
+  // Run the function with arguments ARGS, and return its results,
+  // indexed by result number.  Counts from this run are added to
+  // those from any previous runs.
+  //
+  std::vector<int> run (const std::vector<int> &args);
+
+
+  // Make run fail if more than MAX_INSNS instructions are executed in
+  // a single call; zero means no limit.
+  //
+  void set_max_insns (std::uint64_t max_insns) { _max_insns = max_insns; }
+
+  // Return the number of arguments the function expects.
+  //
+  unsigned num_args () const { return _num_args; }
+
+
+  // Total dynamic counts: instructions executed, blocks entered, and
+  // conditional branches taken and not taken.
+  //
+  std::uint64_t insns () const { return _insns; }
+  std::uint64_t block_visits () const { return _block_visits; }
+  std::uint64_t branches_taken () const { return _branches_taken; }
+  std::uint64_t branches_not_taken () const { return _branches_not_taken; }
+
+  // Return counts for each block, in the function's block order, and
+  // for each conditional branch.
+  //
+  const std::vector<BlockCounts> &block_counts () const
+  {
+    return _block_counts;
+  }
+  const std::vector<BranchCounts> &branch_counts () const
+  {
+    return _branch_counts;
+  }
+
+  // Reset all counts to zero.
+  //
+  void clear_counts ();
+
+
+private:
+
+  // Kinds of flattened instruction.
+  //
+  enum class Kind
+  {
+    CALC, NEG, COPY, MULTI_COPY, COND_BRANCH,
+    PHI_FUN, PHI_FUN_INP, FUN_ARG, FUN_RESULT, NOP
+  };
+
+  // A flattened instruction.  The meaning of the operands depends on
+  // KIND:
+  //
+  //   CALC:        RESULT := ARG1 OP ARG2
+  //   NEG:         RESULT := - ARG1
+  //   COPY:        RESULT := ARG1
+  //   MULTI_COPY:  copies _multi_copy_regs[ARG1 .. ARG1 + 2 * ARG2),
+  //                which holds the sources followed by the results
+  //   COND_BRANCH: if ARG1 is non-zero, go to block ARG2, and
+  //                RESULT is the index in _branch_counts
+  //   PHI_FUN:     RESULT := value recorded in phi slot ARG1
+  //   PHI_FUN_INP: record ARG1 in phi slot ARG2
+  //   FUN_ARG:     RESULT := argument number ARG1
+  //   FUN_RESULT:  result number RESULT := ARG1
+  //
+  struct Op
+  {
+    Kind kind;
+    CalcInsn::Op calc_op;
+    unsigned result, arg1, arg2;
+  };
+
+  // A flattened block: ops [BEG, END) in _ops, and the index of its
+  // fall-through block, or NO_BLOCK.
+  //
+  struct Block
+  {
+    unsigned beg, end;
+    unsigned fall_through;
+  };
+
+  static constexpr unsigned NO_BLOCK = ~0U;
+
+
+  // Return the result of the calculation OP on VAL1 and VAL2.
+  //
+  static int calc (CalcInsn::Op op, int val1, int val2);
+
+
+  std::vector<Op> _ops;
+  std::vector<Block> _blocks;
+
+  // Index of the entry and exit blocks, or NO_BLOCK if there isn't
+  // one.
+  //
+  unsigned _entry = NO_BLOCK, _exit = NO_BLOCK;
+
+  // Register numbers for MULTI_COPY ops.
+  //
+  std::vector<unsigned> _multi_copy_regs;
+
+  // Initial values of all registers.
+  //
+  std::vector<int> _init_regs;
+
+  // Number of phi-functions, which are each given a slot for the
+  // value recorded by their inputs.
+  //
+  unsigned _num_phi_slots = 0;
+
+  unsigned _num_args = 0, _num_results = 0;
+
+  std::uint64_t _max_insns = 0;
+
+  std::uint64_t _insns = 0, _block_visits = 0;
+  std::uint64_t _branches_taken = 0, _branches_not_taken = 0;
+  std::vector<BlockCounts> _block_counts;
+  std::vector<BranchCounts> _branch_counts;
+};
+
+
+#endif // __FUN_INTERP_H__
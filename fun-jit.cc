@@ -0,0 +1,654 @@
+// fun-jit.cc -- x86-64 JIT compiler for IR functions
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "fun.h"
+#include "bb.h"
+#include "reg.h"
+#include "value.h"
+#include "calc-insn.h"
+#include "copy-insn.h"
+#include "cond-branch-insn.h"
+#include "phi-fun-insn.h"
+#include "phi-fun-inp-insn.h"
+#include "fun-arg-insn.h"
+#include "fun-result-insn.h"
+
+#include "fun-jit.h"
+
+
+namespace {
+
+// x86-64 register numbers.
+//
+enum MachReg
+{
+  RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+  R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+// Registers which may be assigned to IR registers.  RAX, RDX, and R11
+// are scratch registers, RDI and RSI hold the argument and result
+// pointers, and RSP is the stack pointer.
+//
+const MachReg assignable_regs[] = {
+  RBX, RBP, R12, R13, R14, R15, RCX, R8, R9, R10
+};
+
+// Callee-saved registers, which are saved by the prologue.
+//
+const MachReg saved_regs[] = { RBX, RBP, R12, R13, R14, R15 };
+
+
+// The location of an operand: a machine register, a 32-bit memory
+// word at a displacement from a base register, or an immediate
+// constant.
+//
+struct Loc
+{
+  enum Kind { REG, MEM, IMM };
+
+  static Loc reg (MachReg reg) { return Loc { REG, reg, RSP }; }
+  static Loc mem (int disp, MachReg base = RSP) { return Loc { MEM, disp, base }; }
+  static Loc imm (int val) { return Loc { IMM, val, RSP }; }
+
+  bool operator== (const Loc &loc) const
+  {
+    return kind == loc.kind && val == loc.val && base == loc.base;
+  }
+
+  Kind kind;
+
+  // The register for REG, the displacement for MEM, or the value for
+  // IMM.
+  //
+  int val;
+
+  // The base register for MEM.
+  //
+  MachReg base;
+};
+
+
+// A minimal x86-64 assembler, for only the instructions the JIT uses.
+// All operations are 32-bit unless noted otherwise.
+//
+class Assembler
+{
+public:
+
+  std::vector<std::uint8_t> code;
+
+
+  // Labels, which may be referred to before they're placed.
+  //
+  unsigned new_label ()
+  {
+    _label_offsets.push_back (-1);
+    return _label_offsets.size () - 1;
+  }
+  void place (unsigned label) { _label_offsets[label] = code.size (); }
+
+  // Fill in references to labels; every label referred to must have
+  // been placed.
+  //
+  void resolve ()
+  {
+    for (auto [pos, label] : _fixups)
+      {
+	std::int32_t rel = _label_offsets[label] - int (pos + 4);
+	std::memcpy (&code[pos], &rel, 4);
+      }
+  }
+
+
+  void mov (MachReg reg, const Loc &src)
+  {
+    if (src.kind == Loc::IMM)
+      {
+	rex (false, 0, reg);
+	byte (0xB8 + (reg & 7));
+	int32 (src.val);
+      }
+    else if (! (src == Loc::reg (reg)))
+      reg_rm ({ 0x8B }, reg, src);
+  }
+  void mov (const Loc &dst, MachReg reg)
+  {
+    if (dst.kind == Loc::REG)
+      mov (MachReg (dst.val), Loc::reg (reg));
+    else
+      reg_rm ({ 0x89 }, reg, dst);
+  }
+
+  // DST := SRC, through RAX if neither is a register.
+  //
+  void move (const Loc &dst, const Loc &src)
+  {
+    if (dst == src)
+      return;
+    if (dst.kind == Loc::REG)
+      mov (MachReg (dst.val), src);
+    else if (src.kind == Loc::REG)
+      mov (dst, MachReg (src.val));
+    else if (src.kind == Loc::IMM)
+      {
+	// mov dword [dst], imm32
+	reg_rm ({ 0xC7 }, 0, dst);
+	int32 (src.val);
+      }
+    else
+      {
+	mov (RAX, src);
+	mov (dst, RAX);
+      }
+  }
+
+  void add (MachReg reg, const Loc &src) { alu (0x03, 0, reg, src); }
+  void sub (MachReg reg, const Loc &src) { alu (0x2B, 5, reg, src); }
+
+  void imul (MachReg reg, const Loc &src)
+  {
+    if (src.kind == Loc::IMM)
+      {
+	reg_rm ({ 0x69 }, reg, Loc::reg (reg));
+	int32 (src.val);
+      }
+    else
+      reg_rm ({ 0x0F, 0xAF }, reg, src);
+  }
+
+  void neg (MachReg reg) { reg_rm ({ 0xF7 }, 3, Loc::reg (reg)); }
+
+  // EDX:EAX := sign-extended EAX, then divide it by REG.
+  //
+  void cdq_idiv (MachReg reg)
+  {
+    byte (0x99);
+    reg_rm ({ 0xF7 }, 7, Loc::reg (reg));
+  }
+
+  // Compare LOC with the constant VAL.
+  //
+  void cmp (const Loc &loc, int val)
+  {
+    if (loc.kind == Loc::REG && val == 0)
+      reg_rm ({ 0x85 }, loc.val, loc);	// test reg, reg
+    else
+      {
+	reg_rm ({ 0x81 }, 7, loc);
+	int32 (val);
+      }
+  }
+
+  void xor_self (MachReg reg) { reg_rm ({ 0x31 }, reg, Loc::reg (reg)); }
+
+  // Jump to LABEL, unconditionally, or if the last comparison was
+  // equal, not equal, or had a borrow.
+  //
+  void jmp (unsigned label) { byte (0xE9); rel32 (label); }
+  void je (unsigned label) { jcc (0x84, label); }
+  void jne (unsigned label) { jcc (0x85, label); }
+  void jb (unsigned label) { jcc (0x82, label); }
+
+  // 64-bit operations needed by the prologue and epilogue.
+  //
+  void push (MachReg reg) { rex (false, 0, reg); byte (0x50 + (reg & 7)); }
+  void pop (MachReg reg) { rex (false, 0, reg); byte (0x58 + (reg & 7)); }
+  void sub_rsp (int val) { reg_rm ({ 0x81 }, 5, Loc::reg (RSP), true); int32 (val); }
+  void add_rsp (int val) { reg_rm ({ 0x81 }, 0, Loc::reg (RSP), true); int32 (val); }
+  void mov64 (const Loc &dst, MachReg reg) { reg_rm ({ 0x89 }, reg, dst, true); }
+  void dec64 (const Loc &dst) { reg_rm ({ 0x83 }, 5, dst, true); byte (1); }
+  void ret () { byte (0xC3); }
+
+
+private:
+
+  void byte (std::uint8_t val) { code.push_back (val); }
+  void int32 (std::int32_t val)
+  {
+    std::uint8_t bytes[4];
+    std::memcpy (bytes, &val, 4);
+    code.insert (code.end (), bytes, bytes + 4);
+  }
+
+  void rel32 (unsigned label)
+  {
+    _fixups.emplace_back (code.size (), label);
+    int32 (0);
+  }
+
+  void jcc (std::uint8_t cond, unsigned label)
+  {
+    byte (0x0F);
+    byte (cond);
+    rel32 (label);
+  }
+
+  // Emit a REX prefix, if needed, for an instruction whose ModRM reg
+  // field is REG and whose r/m register (or base) is RM.
+  //
+  void rex (bool wide, unsigned reg, unsigned rm)
+  {
+    std::uint8_t prefix
+      = 0x40 | (wide << 3) | (((reg >> 3) & 1) << 2) | ((rm >> 3) & 1);
+    if (prefix != 0x40)
+      byte (prefix);
+  }
+
+  // Emit the instruction OPCODE with a ModRM byte whose reg field is
+  // REG (a register, or an opcode extension) and whose r/m operand is
+  // LOC, which must not be an immediate.
+  //
+  void reg_rm (std::initializer_list<std::uint8_t> opcode, unsigned reg,
+	       const Loc &loc, bool wide = false)
+  {
+    rex (wide, reg, loc.kind == Loc::REG ? loc.val : loc.base);
+    for (auto op_byte : opcode)
+      byte (op_byte);
+
+    if (loc.kind == Loc::REG)
+      byte (0xC0 | ((reg & 7) << 3) | (loc.val & 7));
+    else
+      {
+	// [base + disp32], which needs a SIB byte for RSP and R12.
+	//
+	byte (0x80 | ((reg & 7) << 3) | (loc.base & 7));
+	if ((loc.base & 7) == RSP)
+	  byte (0x24);
+	int32 (loc.val);
+      }
+  }
+
+  // Emit the ALU operation REG := REG op SRC, where OPCODE is the
+  // register/memory form, and EXT the opcode extension for the
+  // immediate form.
+  //
+  void alu (std::uint8_t opcode, unsigned ext, MachReg reg, const Loc &src)
+  {
+    if (src.kind == Loc::IMM)
+      {
+	reg_rm ({ 0x81 }, ext, Loc::reg (reg));
+	int32 (src.val);
+      }
+    else
+      reg_rm ({ opcode }, reg, src);
+  }
+
+  std::vector<int> _label_offsets;
+  std::vector<std::pair<std::size_t, unsigned>> _fixups;
+};
+
+} // namespace
+
+
+// Compile FUN to machine code.
+//
+FunJIT::FunJIT (Fun *fun)
+{
+#ifndef __x86_64__
+  throw std::runtime_error ("The JIT only supports x86-64");
+#endif
+
+  static constexpr unsigned NO_BLOCK = ~0U;
+
+  std::vector<BB *> blocks (fun->blocks ().begin (), fun->blocks ().end ());
+  unsigned num_blocks = blocks.size ();
+
+  std::vector<unsigned> block_indices (fun->max_block_num () + 1, NO_BLOCK);
+  for (unsigned i = 0; i < num_blocks; i++)
+    block_indices[blocks[i]->num ()] = i;
+
+  auto block_index = [&] (BB *block)
+    {
+      return block ? block_indices[block->num ()] : NO_BLOCK;
+    };
+
+
+  // Count the uses and definitions of each non-constant register, and
+  // find the number of scratch slots multiple copies need.
+  //
+  std::vector<Reg *> regs;
+  std::unordered_map<Reg *, unsigned> use_counts;
+  unsigned num_temps = 0;
+  for (auto block : blocks)
+    for (auto insn : block->insns ())
+      {
+	if (dynamic_cast<PhiFunInsn *> (insn)
+	    || (dynamic_cast<PhiFunInpInsn *> (insn)
+		&& static_cast<PhiFunInpInsn *> (insn)->phi_fun ()))
+	  throw std::runtime_error ("The JIT can't compile a function"
+				    " in SSA form");
+
+	for (auto reg_list : { &insn->args (), &insn->results () })
+	  for (auto reg : *reg_list)
+	    if (! reg->value () && use_counts[reg]++ == 0)
+	      regs.push_back (reg);
+
+	if (dynamic_cast<CopyInsn *> (insn) && insn->args ().size () > 1)
+	  num_temps = std::max (num_temps, unsigned (insn->args ().size ()));
+      }
+
+  // Assign machine registers to the most used registers, and stack
+  // slots to the rest.  The first 8 bytes of the frame hold the fuel.
+  //
+  std::stable_sort (regs.begin (), regs.end (),
+		    [&] (Reg *reg1, Reg *reg2)
+		    {
+		      return use_counts[reg1] > use_counts[reg2];
+		    });
+
+  std::unordered_map<Reg *, Loc> locs;
+  const Loc fuel = Loc::mem (0);
+  int frame_size = 8;
+  const unsigned num_assignable = std::size (assignable_regs);
+  for (unsigned i = 0; i < regs.size (); i++)
+    if (i < num_assignable)
+      locs.emplace (regs[i], Loc::reg (assignable_regs[i]));
+    else
+      {
+	locs.emplace (regs[i], Loc::mem (frame_size));
+	frame_size += 4;
+      }
+
+  std::vector<Loc> temps;
+  for (unsigned i = 0; i < num_temps; i++)
+    {
+      temps.push_back (Loc::mem (frame_size));
+      frame_size += 4;
+    }
+
+  frame_size = (frame_size + 15) & ~15;
+
+  auto loc = [&] (Reg *reg)
+    {
+      if (Value *value = reg->value ())
+	return Loc::imm (value->int_value ());
+      return locs.at (reg);
+    };
+
+
+  Assembler as;
+
+  std::vector<unsigned> block_labels (num_blocks);
+  for (auto &label : block_labels)
+    label = as.new_label ();
+
+  unsigned ok_label = as.new_label (), epilogue_label = as.new_label ();
+
+  // Labels for failure stubs, by message.
+  //
+  std::map<std::string, unsigned> fail_labels;
+  auto fail_label = [&] (const std::string &msg)
+    {
+      auto [it, added] = fail_labels.emplace (msg, 0);
+      if (added)
+	it->second = as.new_label ();
+      return it->second;
+    };
+
+  // Jump to LABEL, using a unit of fuel first if the jump is
+  // backward.
+  //
+  auto jump = [&] (unsigned label, bool backward)
+    {
+      if (backward)
+	{
+	  as.dec64 (fuel);
+	  as.jb (fail_label ("Jump limit exceeded"));
+	}
+      as.jmp (label);
+    };
+
+
+  // Prologue: save callee-saved registers, make the frame, and start
+  // all registers out as zero.
+  //
+  for (auto reg : saved_regs)
+    as.push (reg);
+  as.sub_rsp (frame_size);
+  as.mov64 (fuel, RDX);
+  for (auto reg : regs)
+    {
+      Loc reg_loc = locs.at (reg);
+      if (reg_loc.kind == Loc::REG)
+	as.xor_self (MachReg (reg_loc.val));
+      else
+	as.move (reg_loc, Loc::imm (0));
+    }
+
+  unsigned entry = block_index (fun->entry_block ());
+  if (entry == NO_BLOCK)
+    as.jmp (fail_label ("Function has no entry block"));
+  else if (entry != 0)
+    as.jmp (block_labels[entry]);
+
+  unsigned exit = block_index (fun->exit_block ());
+
+  for (unsigned block_idx = 0; block_idx < num_blocks; block_idx++)
+    {
+      BB *block = blocks[block_idx];
+
+      as.place (block_labels[block_idx]);
+
+      for (auto insn : block->insns ())
+	{
+	  const Insn::RegVector &args = insn->args ();
+	  const Insn::RegVector &results = insn->results ();
+
+	  if (CalcInsn *calc_insn = dynamic_cast<CalcInsn *> (insn))
+	    {
+	      Loc result = loc (results[0]);
+	      Loc arg1 = loc (args[0]);
+
+	      if (calc_insn->op () == CalcInsn::Op::NEG)
+		{
+		  as.mov (RAX, arg1);
+		  as.neg (RAX);
+		  as.mov (result, RAX);
+		  continue;
+		}
+
+	      Loc arg2 = loc (args[1]);
+
+	      if (calc_insn->op () == CalcInsn::Op::DIV)
+		{
+		  // Division by zero fails, and division by -1 is done
+		  // by negation, as idiv traps on overflow.
+		  //
+		  unsigned neg_label = as.new_label ();
+		  unsigned done_label = as.new_label ();
+
+		  as.mov (R11, arg2);
+		  as.cmp (Loc::reg (R11), 0);
+		  as.je (fail_label ("Division by zero"));
+		  as.cmp (Loc::reg (R11), -1);
+		  as.je (neg_label);
+		  as.mov (RAX, arg1);
+		  as.cdq_idiv (R11);
+		  as.jmp (done_label);
+		  as.place (neg_label);
+		  as.mov (RAX, arg1);
+		  as.neg (RAX);
+		  as.place (done_label);
+		  as.mov (result, RAX);
+		  continue;
+		}
+
+	      // Calculate directly in the result's register if it has
+	      // one, and it isn't needed for the second operand.
+	      //
+	      MachReg acc = RAX;
+	      if (result.kind == Loc::REG && ! (result == arg2))
+		acc = MachReg (result.val);
+
+	      as.mov (acc, arg1);
+	      switch (calc_insn->op ())
+		{
+		case CalcInsn::Op::ADD: as.add (acc, arg2); break;
+		case CalcInsn::Op::SUB: as.sub (acc, arg2); break;
+		case CalcInsn::Op::MUL: as.imul (acc, arg2); break;
+		default:
+		  throw std::runtime_error ("Invalid calculation operation");
+		}
+	      as.mov (result, acc);
+	    }
+	  else if (dynamic_cast<CopyInsn *> (insn))
+	    {
+	      if (args.size () == 1)
+		as.move (loc (results[0]), loc (args[0]));
+	      else
+		{
+		  // Copy through scratch slots, so that the copies
+		  // happen in parallel.
+		  //
+		  for (unsigned i = 0; i < args.size (); i++)
+		    as.move (temps[i], loc (args[i]));
+		  for (unsigned i = 0; i < args.size (); i++)
+		    as.move (loc (results[i]), temps[i]);
+		}
+	    }
+	  else if (CondBranchInsn *branch = dynamic_cast<CondBranchInsn *> (insn))
+	    {
+	      // A taken branch in the exit block finishes the call.
+	      //
+	      unsigned target = block_index (branch->target ());
+	      unsigned target_label
+		= (block_idx == exit ? ok_label
+		   : target == NO_BLOCK
+		   ? fail_label ("Branch to undefined block")
+		   : block_labels[target]);
+	      bool backward = (block_idx != exit && target <= block_idx);
+
+	      Loc cond = loc (branch->condition ());
+	      if (cond.kind == Loc::IMM)
+		{
+		  if (cond.val != 0)
+		    jump (target_label, backward);
+		}
+	      else if (backward)
+		{
+		  unsigned skip_label = as.new_label ();
+		  as.cmp (cond, 0);
+		  as.je (skip_label);
+		  jump (target_label, true);
+		  as.place (skip_label);
+		}
+	      else
+		{
+		  as.cmp (cond, 0);
+		  as.jne (target_label);
+		}
+	    }
+	  else if (FunArgInsn *fun_arg = dynamic_cast<FunArgInsn *> (insn))
+	    {
+	      as.move (loc (results[0]), Loc::mem (fun_arg->arg_num () * 4, RDI));
+	      _num_args = std::max (_num_args, fun_arg->arg_num () + 1);
+	    }
+	  else if (FunResultInsn *fun_result
+		   = dynamic_cast<FunResultInsn *> (insn))
+	    {
+	      as.move (Loc::mem (fun_result->result_num () * 4, RSI),
+		       loc (args[0]));
+	      _num_results
+		= std::max (_num_results, fun_result->result_num () + 1);
+	    }
+	}
+
+      unsigned fall_through = block_index (block->fall_through ());
+      if (block_idx == exit)
+	as.jmp (ok_label);
+      else if (fall_through == NO_BLOCK)
+	as.jmp (fail_label ("Control fell off the end of block "
+			    + std::to_string (block->num ())));
+      else if (fall_through != block_idx + 1)
+	jump (block_labels[fall_through], fall_through <= block_idx);
+    }
+
+  // Failure stubs, each returning its status.
+  //
+  for (auto [msg, label] : fail_labels)
+    {
+      as.place (label);
+      _fail_msgs.push_back (msg);
+      as.mov (RAX, Loc::imm (_fail_msgs.size ()));
+      as.jmp (epilogue_label);
+    }
+
+  as.place (ok_label);
+  as.xor_self (RAX);
+  as.place (epilogue_label);
+  as.add_rsp (frame_size);
+  for (unsigned i = std::size (saved_regs); i > 0; i--)
+    as.pop (saved_regs[i - 1]);
+  as.ret ();
+
+  as.resolve ();
+
+
+  // Copy the code into an executable buffer.
+  //
+  std::size_t page_size = sysconf (_SC_PAGESIZE);
+  _code_size = as.code.size ();
+  _mapped_size = (_code_size + page_size - 1) / page_size * page_size;
+
+  void *mapping = mmap (0, _mapped_size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mapping == MAP_FAILED)
+    throw std::runtime_error ("Couldn't allocate memory for JIT code");
+
+  std::memcpy (mapping, as.code.data (), _code_size);
+
+  if (mprotect (mapping, _mapped_size, PROT_READ | PROT_EXEC) != 0)
+    {
+      munmap (mapping, _mapped_size);
+      throw std::runtime_error ("Couldn't make JIT code executable");
+    }
+
+  _code = reinterpret_cast<Code> (mapping);
+}
+
+FunJIT::~FunJIT ()
+{
+  if (_code)
+    munmap (reinterpret_cast<void *> (_code), _mapped_size);
+}
+
+
+// Run the function with arguments ARGS, and return its results,
+// indexed by result number.
+//
+std::vector<int>
+FunJIT::run (const std::vector<int> &args) const
+{
+  if (args.size () != _num_args)
+    throw std::runtime_error ("Function expects "
+			      + std::to_string (_num_args) + " arguments, but "
+			      + std::to_string (args.size ()) + " given");
+
+  std::vector<int> results (_num_results);
+
+  std::uint64_t fuel
+    = _max_jumps ? _max_jumps : std::numeric_limits<std::uint64_t>::max ();
+
+  int status = _code (args.data (), results.data (), fuel);
+  if (status != 0)
+    throw std::runtime_error (_fail_msgs[status - 1]);
+
+  return results;
+}
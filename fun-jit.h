@@ -0,0 +1,97 @@
+// fun-jit.h -- x86-64 JIT compiler for IR functions
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#ifndef __FUN_JIT_H__
+#define __FUN_JIT_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+class Fun;
+
+
+// A compiler which translates an IR function, which must not be in SSA
+// form (as after Fun::convert_from_ssa_form), into x86-64 machine code
+// in an executable memory buffer, which can then be called directly.
+//
+// Registers are assigned in order of use count: the most used get
+// machine registers, and the rest live in stack slots.  Constant
+// operands are inlined as immediates.  Blocks are laid out in the
+// function's block order, with jumps added only where a block doesn't
+// fall through to the next one.
+//
+// Results are the same as FunInterp, except that the instruction limit
+// is replaced by a limit on backward jumps, which every loop contains.
+// Errors detected by the generated code are reported by returning a
+// status to run, which throws an exception.
+//
+class FunJIT
+{
+public:
+
+  // The type of the generated code.  As IR functions can have any
+  // number of arguments and results, these are passed as arrays
+  // rather than in machine registers; the return value is zero, or a
+  // non-zero status if there was an error.  At most FUEL backward
+  // jumps are allowed.
+  //
+  typedef int (*Code) (const int *args, int *results, std::uint64_t fuel);
+
+
+  // Compile FUN to machine code.
+  //
+  FunJIT (Fun *fun);
+  ~FunJIT ();
+
+  FunJIT (const FunJIT &) = delete;
+  FunJIT &operator= (const FunJIT &) = delete;
+
+
+  // Run the function with arguments ARGS, and return its results,
+  // indexed by result number.
+  //
+  std::vector<int> run (const std::vector<int> &args) const;
+
+
+  // Make run fail if more than MAX_JUMPS backward jumps are done in a
+  // single call; zero means no limit.
+  //
+  void set_max_jumps (std::uint64_t max_jumps) { _max_jumps = max_jumps; }
+
+  // Return the number of arguments the function expects.
+  //
+  unsigned num_args () const { return _num_args; }
+
+  // Return the generated code, and its size in bytes.
+  //
+  Code code () const { return _code; }
+  std::size_t code_size () const { return _code_size; }
+
+
+private:
+
+  // The executable buffer holding the code, and its size.
+  //
+  Code _code = 0;
+  std::size_t _code_size = 0, _mapped_size = 0;
+
+  // Messages for the non-zero statuses returned by the code, indexed
+  // by status minus one.
+  //
+  std::vector<std::string> _fail_msgs;
+
+  unsigned _num_args = 0, _num_results = 0;
+
+  std::uint64_t _max_jumps = 0;
+};
+
+
+#endif // __FUN_JIT_H__
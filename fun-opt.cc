@@ -9,6 +9,8 @@
 #include <deque>
 
 #include "check-assertion.h"
+#include "trace.h"
+#include "stats.h"
 
 #include "reg.h"
 #include "insn.h"
@@ -17,11 +19,29 @@
 #include "fun.h"
 
 
+static Stat blocks_unreachable ("fun-opt", "blocks-unreachable",
+				"Number of unreachable blocks deleted");
+static Stat branches_removed ("fun-opt", "branches-removed",
+			      "Number of pointless branch insns deleted");
+static Stat blocks_merged ("fun-opt", "blocks-merged",
+			   "Number of blocks merged into their predecessor");
+static Stat blocks_orphaned ("fun-opt", "blocks-orphaned",
+			     "Number of empty blocks orphaned by combine_blocks");
+static Stat combine_blocks_iters ("fun-opt", "combine-blocks-iters",
+				  "Number of combine_blocks fixed-point iterations");
+static Stat copies_propagated ("fun-opt", "copies-propagated",
+			       "Number of copied registers replaced by their source");
+static Stat copies_removed ("fun-opt", "copies-removed",
+			    "Number of useless copy insns deleted");
+
+
 // Remove any unreachable blocks.
 //
 void
 Fun::remove_unreachable ()
 {
+  TRACE_SPAN ("remove_unreachable");
+
   std::deque<BB *> queue;
   for (auto bb : _blocks)
     if (bb != _entry_block && bb->predecessors ().empty ())
@@ -39,7 +59,7 @@ Fun::remove_unreachable ()
       // it used to point to.
       //
 
-      const std::list<BB *> &succs = bb->successors ();
+      const BB::BlockList &succs = bb->successors ();
 
       auto succp = succs.begin ();
       while (succp != succs.end ())
@@ -54,6 +74,7 @@ Fun::remove_unreachable ()
 	}
 
       delete bb;
+      ++blocks_unreachable;
     }
 }
 
@@ -62,7 +83,7 @@ Fun::remove_unreachable ()
 // single block.
 //
 static bool
-singular_block_list (const std::list<BB *> &block_list)
+singular_block_list (const BB::BlockList &block_list)
 {
   BB *first_block = block_list.front ();
 
@@ -80,6 +101,7 @@ singular_block_list (const std::list<BB *> &block_list)
 void
 Fun::combine_blocks ()
 {
+  TRACE_SPAN ("combine_blocks");
 
   check_assertion (!_exit_block || _exit_block->successors ().empty (),
 		   "Exit block has successors before combine_blocks");
@@ -92,6 +114,7 @@ Fun::combine_blocks ()
   while (change)
     {
       change = false;
+      ++combine_blocks_iters;
 
       for (auto bb : _blocks)
 	{
@@ -102,7 +125,7 @@ Fun::combine_blocks ()
 
 	  // Remove pointless branch insn
 	  //
-	  const std::list<Insn *> &insns = bb->insns();
+	  const BB::InsnList &insns = bb->insns ();
 	  if (! insns.empty ())
 	    {
 	      Insn *last_insn = insns.back ();
@@ -111,6 +134,7 @@ Fun::combine_blocks ()
 		  if (singular_block_list (bb->successors ()))
 		    {
 		      delete last_insn;
+		      ++branches_removed;
 		      change = true;
 		    }
 		}
@@ -134,6 +158,7 @@ Fun::combine_blocks ()
 		  // Orphan SUCC, to simplify the flow graph.
 		  //
 		  succ->set_fall_through (0);
+		  ++blocks_merged;
 
 		  change = true;
 		}
@@ -153,9 +178,12 @@ Fun::combine_blocks ()
 		    if (new_succ != succ)
 		      {
 			if (succ->predecessors ().size () == 1)
-			  // Orphan SUCC, to simplify the flow graph.
-			  //
-			  succ->set_fall_through (0);
+			  {
+			    // Orphan SUCC, to simplify the flow graph.
+			    //
+			    succ->set_fall_through (0);
+			    ++blocks_orphaned;
+			  }
 
 			bb->change_successor (succ, new_succ);
 
@@ -186,6 +214,8 @@ Fun::combine_blocks ()
 void
 Fun::propagate_through_copies ()
 {
+  TRACE_SPAN ("propagate_through_copies");
+
   for (auto reg : _regs)
     {
       auto &defs = reg->defs ();
@@ -226,6 +256,8 @@ Fun::propagate_through_copies ()
 		      auto &reg_uses = reg->uses ();
 		      while (! reg_uses.empty ())
 			reg_uses.front ()->change_arg (reg, reg_src);
+
+		      ++copies_propagated;
 		    }
 		}
 	  }
@@ -237,6 +269,8 @@ Fun::propagate_through_copies ()
 void
 Fun::remove_useless_copies ()
 {
+  TRACE_SPAN ("remove_useless_copies");
+
   for (auto bb : _blocks)
     {
       //
@@ -246,7 +280,7 @@ Fun::remove_useless_copies ()
       // it used to point to.
       //
 
-      const std::list<Insn *> &insns = bb->insns ();
+      const BB::InsnList &insns = bb->insns ();
 
       auto insnp = insns.begin ();
       while (insnp != insns.end ())
@@ -265,7 +299,10 @@ Fun::remove_useless_copies ()
 		  }
 
 	      if (! result_used)
-		delete copy_insn;
+		{
+		  delete copy_insn;
+		  ++copies_removed;
+		}
 	    }
 	}
     }
@@ -0,0 +1,1223 @@
+// fun-regalloc.cc -- IR function register allocation
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#include <algorithm>
+#include <deque>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "check-assertion.h"
+#include "trace.h"
+#include "stats.h"
+#include "bitvec.h"
+
+#include "reg.h"
+#include "value.h"
+#include "insn.h"
+#include "copy-insn.h"
+#include "phi-fun-insn.h"
+#include "phi-fun-inp-insn.h"
+
+#include "fun.h"
+
+
+static Stat spill_stores ("fun-regalloc", "spill-stores",
+			  "Number of register-to-stack-slot copies added");
+static Stat reloads ("fun-regalloc", "reloads",
+		     "Number of stack-slot-to-register copies added");
+static Stat reg_moves ("fun-regalloc", "reg-moves",
+		       "Number of register-to-register copies added");
+static Stat intervals_split ("fun-regalloc", "intervals-split",
+			     "Number of lifetime intervals split");
+static Stat copies_coalesced ("fun-regalloc", "copies-coalesced",
+			      "Number of copies removed because their source"
+			      " and destination got the same register");
+static Stat edge_blocks_added ("fun-regalloc", "edge-blocks-added",
+			       "Number of blocks added to hold copies on"
+			       " critical edges");
+
+
+namespace {
+
+// A position later than any real one.
+//
+constexpr int NO_POS = std::numeric_limits<int>::max ();
+
+
+// A pair of registers, a source and a destination, for a copy.
+//
+typedef std::pair<Reg *, Reg *> Move;
+
+// Return a sequence of single copies with the same effect as the
+// parallel copies MOVES, whose destinations must be distinct.  Cycles
+// are broken using a temporary register returned by MAKE_TEMP, which
+// is only called if needed; one temporary is enough, as each cycle is
+// finished before the next is started.
+//
+template<typename MakeTemp>
+std::vector<Move>
+sequentialize_moves (std::vector<Move> moves, MakeTemp make_temp)
+{
+  moves.erase (std::remove_if (moves.begin (), moves.end (),
+			       [] (const Move &move)
+			       {
+				 return move.first == move.second;
+			       }),
+	       moves.end ());
+
+  std::vector<Move> seq;
+  Reg *temp = 0;
+
+  while (! moves.empty ())
+    {
+      // Do every copy whose destination isn't still needed as a
+      // source.
+      //
+      bool progress = false;
+      for (unsigned i = 0; i < moves.size (); )
+	{
+	  Reg *dst = moves[i].second;
+	  if (std::none_of (moves.begin (), moves.end (),
+			    [dst] (const Move &move)
+			    {
+			      return move.first == dst;
+			    }))
+	    {
+	      seq.push_back (moves[i]);
+	      moves.erase (moves.begin () + i);
+	      progress = true;
+	    }
+	  else
+	    i++;
+	}
+
+      // If nothing could be done, everything left is in cycles, so
+      // save one destination's value in the temporary.
+      //
+      if (! progress)
+	{
+	  if (! temp)
+	    temp = make_temp ();
+
+	  Reg *dst = moves[0].second;
+	  seq.emplace_back (dst, temp);
+	  for (auto &move : moves)
+	    if (move.first == dst)
+	      move.first = temp;
+	}
+    }
+
+  return seq;
+}
+
+
+// A half-open range of positions, [FROM, TO).
+//
+struct Range
+{
+  int from, to;
+};
+
+// The lifetime interval of a register, or a part of one.  An interval
+// is a sorted list of disjoint ranges, so may have holes, and holds
+// the positions which use or define the register.  After allocation,
+// the whole interval is in one place: a physical register or the
+// register's stack slot.
+//
+struct Interval
+{
+  Interval (unsigned vreg, unsigned id) : vreg (vreg), id (id) { }
+
+  int start () const { return ranges.front ().from; }
+  int end () const { return ranges.back ().to; }
+
+  // Return true if this interval covers POS, which must be no less
+  // than the position passed in any previous call.
+  //
+  bool covers (int pos)
+  {
+    while (cursor < ranges.size () && ranges[cursor].to <= pos)
+      cursor++;
+    return cursor < ranges.size () && ranges[cursor].from <= pos;
+  }
+
+  // Return true if this interval covers POS, which may be anything.
+  //
+  bool covers_at (int pos) const
+  {
+    auto range = first_range_after (pos);
+    return range != ranges.end () && range->from <= pos;
+  }
+
+  // Return the first range which ends after POS.
+  //
+  std::vector<Range>::const_iterator first_range_after (int pos) const
+  {
+    return std::partition_point (ranges.begin (), ranges.end (),
+				 [pos] (const Range &range)
+				 {
+				   return range.to <= pos;
+				 });
+  }
+
+  // Return the first use or definition at or after POS, or NO_POS.
+  //
+  int next_use (int pos) const
+  {
+    auto use = std::lower_bound (uses.begin (), uses.end (), pos);
+    return use == uses.end () ? NO_POS : *use;
+  }
+
+  // Return the first position at or after POS covered by both this
+  // interval and OTHER, or NO_POS.
+  //
+  int next_intersection (const Interval &other, int pos) const
+  {
+    auto r1 = first_range_after (pos), r2 = other.first_range_after (pos);
+    while (r1 != ranges.end () && r2 != other.ranges.end ())
+      {
+	int from = std::max ({ r1->from, r2->from, pos });
+	if (from < std::min (r1->to, r2->to))
+	  return from;
+	if (r1->to < r2->to)
+	  ++r1;
+	else
+	  ++r2;
+      }
+    return NO_POS;
+  }
+
+  // The register this is an interval for, and a unique number, used
+  // to make allocation order deterministic.
+  //
+  unsigned vreg, id;
+
+  std::vector<Range> ranges;
+  std::vector<int> uses;
+
+  // The physical register assigned, or -1 if none.
+  //
+  int phys = -1;
+
+  // True if this interval is in the register's stack slot.
+  //
+  bool in_memory = false;
+
+  // The index of the first range which may cover positions passed to
+  // covers in the future.
+  //
+  unsigned cursor = 0;
+};
+
+
+// Linear-scan register allocation for a function, following Wimmer and
+// Mössenböck, "Optimized Interval Splitting in a Linear Scan Register
+// Allocator".
+//
+// Blocks are put in a linear order (reverse post-order), and each
+// instruction numbered: instruction N reads its arguments at an even
+// position, and writes its results at the odd position after.  Each
+// block also has an even position before its first instruction.
+// Lifetime intervals are built from liveness information, and then
+// allocated in order of start position.  When there's no physical
+// register free for all of an interval, it, or whichever interval has
+// the furthest next use, is split and partly moved to memory.  Every
+// use or definition must be in a physical register.
+//
+// Finally, registers are replaced by their assigned locations, and
+// copies added wherever a register's location changes: inside a block
+// where an interval was split, and on edges between blocks where the
+// locations at either end differ.
+//
+class LinearScan
+{
+public:
+
+  LinearScan (Fun *fun, unsigned num_regs);
+
+  void run ();
+
+
+private:
+
+  // Split blocks after any conditional branch which isn't their last
+  // instruction.
+  //
+  void split_blocks_at_branches ();
+
+  // Replace multiple copies by sequences of single copies.
+  //
+  void sequentialize_multi_copies ();
+
+  // Order and number blocks, instructions, and registers.
+  //
+  void number ();
+
+  // Calculate which registers are live into and out of each block.
+  //
+  void calc_liveness ();
+
+  // Make lifetime intervals for all registers.
+  //
+  void build_intervals ();
+
+  // Assign locations to all intervals.
+  //
+  void allocate ();
+
+  // Try to find a register for CURRENT, which is free for at least a
+  // prefix of it, and return true if one was found.
+  //
+  bool try_allocate_free_reg (Interval *current);
+
+  // Give CURRENT the register whose next use is furthest away,
+  // splitting and moving to memory whichever intervals need it less.
+  //
+  void allocate_blocked_reg (Interval *current);
+
+  // Move the part of IVAL from POS on out of its physical register:
+  // into memory until its next use, and back to the unhandled list
+  // for the rest.
+  //
+  void spill_from (Interval *ival, int pos);
+
+  // Split IVAL at POS, returning the new interval for the part from
+  // POS on.
+  //
+  Interval *split (Interval *ival, int pos);
+
+  Interval *new_interval (unsigned vreg)
+  {
+    _intervals.emplace_back (vreg, _intervals.size ());
+    _parts[vreg].push_back (&_intervals.back ());
+    return &_intervals.back ();
+  }
+
+  // Replace registers with their locations, and add copies where
+  // locations change.
+  //
+  void rewrite ();
+
+  // Add copies at the ends of edges into the block at index BLOCK_IDX,
+  // where locations differ.
+  //
+  void resolve_edges (unsigned block_idx);
+
+  // Add the parallel copies MOVES to BLOCK, before POS.
+  //
+  void insert_moves (BB *block, BB::InsnList::const_iterator pos,
+		     const std::vector<Move> &moves);
+
+  // Return the location of register VREG at POS.
+  //
+  Reg *location (unsigned vreg, int pos);
+
+  Reg *phys_reg (unsigned num);
+  Reg *slot_reg (unsigned vreg);
+
+  // Return the register number of REG, or -1 if it's a constant.
+  //
+  int vreg_num (Reg *reg) const
+  {
+    return reg->value () ? -1 : int (_vreg_nums.at (reg));
+  }
+
+
+  Fun *_fun;
+  unsigned _num_regs;
+
+  // Blocks in linear order, and the index in that order of each
+  // block, by block number.
+  //
+  std::vector<BB *> _order;
+  std::vector<unsigned> _block_indices;
+
+  // The first position in each block, and the position after it.
+  //
+  struct BlockPos { int from, to; };
+  std::vector<BlockPos> _block_pos;
+
+  // Registers allocated, and their numbers.
+  //
+  std::vector<Reg *> _vregs;
+  std::unordered_map<Reg *, unsigned> _vreg_nums;
+
+  // For each register defined by a copy, the register copied from,
+  // or -1; giving both the same physical register removes the copy.
+  //
+  std::vector<int> _hints;
+
+  std::vector<Bitvec> _live_in, _live_out;
+
+  // All intervals, and for each register, all intervals which are
+  // part of it.
+  //
+  std::deque<Interval> _intervals;
+  std::vector<std::vector<Interval *>> _parts;
+
+  // Intervals not yet allocated, earliest start first.
+  //
+  struct LaterStart
+  {
+    bool operator() (const Interval *ival1, const Interval *ival2) const
+    {
+      if (ival1->start () != ival2->start ())
+	return ival1->start () > ival2->start ();
+      return ival1->id > ival2->id;
+    }
+  };
+  std::priority_queue<Interval *, std::vector<Interval *>, LaterStart>
+    _unhandled;
+
+  // Intervals with physical registers which cover the current
+  // position, and which are in a hole at the current position.
+  //
+  std::vector<Interval *> _active, _inactive;
+
+  // Physical registers and stack slots, made when first needed, and a
+  // stack slot used to break cycles of copies.
+  //
+  std::vector<Reg *> _phys_regs, _slots;
+  unsigned _num_slots = 0;
+  Reg *_scratch_slot = 0;
+};
+
+
+LinearScan::LinearScan (Fun *fun, unsigned num_regs)
+  : _fun (fun), _num_regs (num_regs), _phys_regs (num_regs)
+{
+}
+
+
+void
+LinearScan::run ()
+{
+  split_blocks_at_branches ();
+  sequentialize_multi_copies ();
+  number ();
+  calc_liveness ();
+  build_intervals ();
+  allocate ();
+  rewrite ();
+}
+
+
+// Split blocks after any conditional branch which isn't their last
+// instruction.  The instructions following such a branch are only
+// done if it isn't taken, so values live into its target are live at
+// the branch, not at the end of the block; after splitting, every
+// edge leaves from the end of a block.
+//
+void
+LinearScan::split_blocks_at_branches ()
+{
+  std::vector<BB *> blocks (_fun->blocks ().begin (), _fun->blocks ().end ());
+
+  while (! blocks.empty ())
+    {
+      BB *block = blocks.back ();
+      blocks.pop_back ();
+
+      const BB::InsnList &insns = block->insns ();
+      auto branch = std::find_if (insns.begin (), insns.end (),
+				  [] (Insn *insn)
+				  {
+				    return insn->is_branch_insn ();
+				  });
+      if (branch == insns.end () || std::next (branch) == insns.end ())
+	continue;
+
+      BB *rest = new BB (_fun);
+      while (std::next (branch) != insns.end ())
+	rest->add_insn (*std::next (branch));
+
+      rest->set_fall_through (block->fall_through ());
+      block->set_fall_through (rest);
+
+      // The rest may contain another branch.
+      //
+      blocks.push_back (rest);
+    }
+}
+
+
+// Replace multiple copies by sequences of single copies, so that no
+// instruction needs more than two physical registers at once.
+//
+void
+LinearScan::sequentialize_multi_copies ()
+{
+  Reg *temp = 0;
+  auto make_temp = [&] ()
+    {
+      if (! temp)
+	temp = new Reg (Symbol ("regalloc-temp"), _fun);
+      return temp;
+    };
+
+  for (auto block : _fun->blocks ())
+    {
+      const BB::InsnList &insns = block->insns ();
+      for (auto insn_iter = insns.begin (); insn_iter != insns.end (); )
+	{
+	  Insn *insn = *insn_iter;
+	  const Insn::RegVector &args = insn->args ();
+
+	  if (! dynamic_cast<CopyInsn *> (insn) || args.size () < 2)
+	    {
+	      ++insn_iter;
+	      continue;
+	    }
+
+	  std::vector<Move> moves;
+	  for (unsigned i = 0; i < args.size (); i++)
+	    moves.emplace_back (args[i], insn->results ()[i]);
+
+	  for (auto move : sequentialize_moves (moves, make_temp))
+	    block->insert_insn (insn_iter, new CopyInsn (move.first, move.second));
+
+	  ++insn_iter;
+	  delete insn;
+	}
+    }
+}
+
+
+// Order and number blocks, instructions, and registers.
+//
+void
+LinearScan::number ()
+{
+  // Put blocks in reverse post-order from the entry block, followed
+  // by any unreachable blocks.
+  //
+  _block_indices.assign (_fun->max_block_num () + 1, ~0U);
+
+  std::vector<BB *> post_order;
+  std::vector<std::pair<BB *, BB::BlockList::const_iterator>> stack;
+  auto visit = [&] (BB *block)
+    {
+      _block_indices[block->num ()] = 0;
+      stack.emplace_back (block, block->successors ().begin ());
+    };
+
+  if (_fun->entry_block ())
+    visit (_fun->entry_block ());
+  while (! stack.empty ())
+    {
+      auto &[block, succ_iter] = stack.back ();
+      if (succ_iter == block->successors ().end ())
+	{
+	  post_order.push_back (block);
+	  stack.pop_back ();
+	}
+      else
+	{
+	  BB *succ = *succ_iter++;
+	  if (_block_indices[succ->num ()] == ~0U)
+	    visit (succ);
+	}
+    }
+
+  _order.assign (post_order.rbegin (), post_order.rend ());
+  for (auto block : _fun->blocks ())
+    if (_block_indices[block->num ()] == ~0U)
+      _order.push_back (block);
+
+  int pos = 0;
+  for (unsigned i = 0; i < _order.size (); i++)
+    {
+      BB *block = _order[i];
+      _block_indices[block->num ()] = i;
+
+      int from = pos;
+      pos += 2 + 2 * block->insns ().size ();
+      _block_pos.push_back (BlockPos { from, pos });
+    }
+
+  for (auto reg : _fun->regs ())
+    if (! reg->value ())
+      {
+	_vreg_nums.emplace (reg, _vregs.size ());
+	_vregs.push_back (reg);
+      }
+
+  _parts.resize (_vregs.size ());
+  _slots.resize (_vregs.size ());
+  _hints.assign (_vregs.size (), -1);
+}
+
+
+// Calculate which registers are live into and out of each block.
+//
+void
+LinearScan::calc_liveness ()
+{
+  unsigned num_blocks = _order.size (), num_vregs = _vregs.size ();
+
+  // Registers used in each block before being defined there, and
+  // registers defined in each block.
+  //
+  std::vector<Bitvec> gen (num_blocks, Bitvec (num_vregs));
+  std::vector<Bitvec> kill (num_blocks, Bitvec (num_vregs));
+
+  for (unsigned i = 0; i < num_blocks; i++)
+    for (auto insn : _order[i]->insns ())
+      {
+	for (auto arg : insn->args ())
+	  {
+	    int vreg = vreg_num (arg);
+	    if (vreg >= 0 && ! kill[i].get (vreg))
+	      gen[i].set (vreg);
+	  }
+	for (auto result : insn->results ())
+	  {
+	    int vreg = vreg_num (result);
+	    if (vreg >= 0)
+	      kill[i].set (vreg);
+	  }
+      }
+
+  _live_in.assign (num_blocks, Bitvec (num_vregs));
+  _live_out.assign (num_blocks, Bitvec (num_vregs));
+
+  // Iterate to a fixed point, going backwards, which is the fastest
+  // direction for backward data-flow in reverse post-order.
+  //
+  bool changed = true;
+  while (changed)
+    {
+      changed = false;
+
+      for (unsigned i = num_blocks; i > 0; i--)
+	{
+	  unsigned block_idx = i - 1;
+
+	  Bitvec &live_out = _live_out[block_idx];
+	  for (auto succ : _order[block_idx]->successors ())
+	    live_out |= _live_in[_block_indices[succ->num ()]];
+
+	  Bitvec live_in = live_out;
+	  live_in.clear (kill[block_idx]);
+	  live_in |= gen[block_idx];
+
+	  if (live_in != _live_in[block_idx])
+	    {
+	      _live_in[block_idx] = std::move (live_in);
+	      changed = true;
+	    }
+	}
+    }
+}
+
+
+// Make lifetime intervals for all registers.
+//
+void
+LinearScan::build_intervals ()
+{
+  // Intervals are built backwards, so ranges and uses are added in
+  // reverse order, and reversed at the end.
+  //
+  std::vector<Interval *> roots (_vregs.size ());
+  auto root = [&] (unsigned vreg)
+    {
+      if (! roots[vreg])
+	roots[vreg] = new_interval (vreg);
+      return roots[vreg];
+    };
+
+  auto add_range = [&] (unsigned vreg, int from, int to)
+    {
+      std::vector<Range> &ranges = root (vreg)->ranges;
+      if (! ranges.empty () && ranges.back ().from <= to)
+	{
+	  ranges.back ().from = std::min (ranges.back ().from, from);
+	  ranges.back ().to = std::max (ranges.back ().to, to);
+	}
+      else
+	ranges.push_back (Range { from, to });
+    };
+
+  for (unsigned i = _order.size (); i > 0; i--)
+    {
+      unsigned block_idx = i - 1;
+      BlockPos block_pos = _block_pos[block_idx];
+
+      _live_out[block_idx].for_each ([&] (unsigned vreg)
+	{
+	  add_range (vreg, block_pos.from, block_pos.to);
+	});
+
+      const BB::InsnList &insns = _order[block_idx]->insns ();
+      int pos = block_pos.to;
+      for (auto insn_iter = insns.rbegin (); insn_iter != insns.rend ();
+	   ++insn_iter)
+	{
+	  Insn *insn = *insn_iter;
+	  pos -= 2;
+
+	  for (auto result : insn->results ())
+	    {
+	      int vreg = vreg_num (result);
+	      if (vreg < 0)
+		continue;
+
+	      // A definition starts the value's range, or if the value
+	      // is never used, makes a short one.
+	      //
+	      Interval *ival = root (vreg);
+	      std::vector<Range> &ranges = ival->ranges;
+	      if (! ranges.empty () && ranges.back ().from <= pos + 1
+		  && pos + 1 < ranges.back ().to)
+		ranges.back ().from = pos + 1;
+	      else
+		ranges.push_back (Range { pos + 1, pos + 2 });
+	      ival->uses.push_back (pos + 1);
+
+	      if (dynamic_cast<CopyInsn *> (insn))
+		_hints[vreg] = vreg_num (insn->args ()[0]);
+	    }
+
+	  for (auto arg : insn->args ())
+	    {
+	      int vreg = vreg_num (arg);
+	      if (vreg < 0)
+		continue;
+
+	      add_range (vreg, block_pos.from, pos + 1);
+	      root (vreg)->uses.push_back (pos);
+	    }
+	}
+    }
+
+  for (auto ival : roots)
+    if (ival)
+      {
+	std::reverse (ival->ranges.begin (), ival->ranges.end ());
+	std::reverse (ival->uses.begin (), ival->uses.end ());
+	_unhandled.push (ival);
+      }
+}
+
+
+// Assign locations to all intervals.
+//
+void
+LinearScan::allocate ()
+{
+  while (! _unhandled.empty ())
+    {
+      Interval *current = _unhandled.top ();
+      _unhandled.pop ();
+
+      int pos = current->start ();
+
+      // Retire intervals which have ended, and move others between
+      // the active and inactive lists as needed.
+      //
+      for (unsigned i = 0; i < _active.size (); )
+	{
+	  Interval *ival = _active[i];
+	  if (ival->end () <= pos || ! ival->covers (pos))
+	    {
+	      if (ival->end () > pos)
+		_inactive.push_back (ival);
+	      _active[i] = _active.back ();
+	      _active.pop_back ();
+	    }
+	  else
+	    i++;
+	}
+      for (unsigned i = 0; i < _inactive.size (); )
+	{
+	  Interval *ival = _inactive[i];
+	  if (ival->end () <= pos || ival->covers (pos))
+	    {
+	      if (ival->end () > pos)
+		_active.push_back (ival);
+	      _inactive[i] = _inactive.back ();
+	      _inactive.pop_back ();
+	    }
+	  else
+	    i++;
+	}
+
+      if (! try_allocate_free_reg (current))
+	allocate_blocked_reg (current);
+
+      if (current->phys >= 0)
+	_active.push_back (current);
+    }
+}
+
+
+// Try to find a register for CURRENT, which is free for at least a
+// prefix of it, and return true if one was found.
+//
+bool
+LinearScan::try_allocate_free_reg (Interval *current)
+{
+  int pos = current->start ();
+
+  std::vector<int> free_until (_num_regs, NO_POS);
+  for (auto ival : _active)
+    free_until[ival->phys] = 0;
+  for (auto ival : _inactive)
+    free_until[ival->phys]
+      = std::min (free_until[ival->phys],
+		  ival->next_intersection (*current, pos));
+
+  unsigned reg = std::max_element (free_until.begin (), free_until.end ())
+		 - free_until.begin ();
+
+  // Prefer the register of the interval this one's value is copied
+  // from, if it's free for all of this one.
+  //
+  if (int hint = _hints[current->vreg]; hint >= 0)
+    for (auto part : _parts[hint])
+      if (part->phys >= 0 && part->covers_at (pos - 1)
+	  && free_until[part->phys] >= current->end ())
+	reg = part->phys;
+
+  if (free_until[reg] >= current->end ())
+    {
+      current->phys = reg;
+      return true;
+    }
+
+  // The register is only free for part of the interval, so split it
+  // at an instruction boundary before the register's next use.
+  //
+  int split_pos = free_until[reg] & ~1;
+  if (split_pos <= pos)
+    return false;
+
+  _unhandled.push (split (current, split_pos));
+  current->phys = reg;
+  return true;
+}
+
+
+// Give CURRENT the register whose next use is furthest away,
+// splitting and moving to memory whichever intervals need it less.
+//
+void
+LinearScan::allocate_blocked_reg (Interval *current)
+{
+  int pos = current->start ();
+
+  std::vector<int> use_pos (_num_regs, NO_POS);
+  for (auto ival : _active)
+    use_pos[ival->phys] = std::min (use_pos[ival->phys], ival->next_use (pos));
+  for (auto ival : _inactive)
+    if (ival->next_intersection (*current, pos) != NO_POS)
+      use_pos[ival->phys]
+	= std::min (use_pos[ival->phys], ival->next_use (pos));
+
+  unsigned reg = std::max_element (use_pos.begin (), use_pos.end ())
+		 - use_pos.begin ();
+
+  // If every register is needed before CURRENT needs one, put
+  // CURRENT in memory until just before it does.
+  //
+  int first_use = current->next_use (pos);
+  if (use_pos[reg] < first_use)
+    {
+      if (first_use == NO_POS)
+	{
+	  current->in_memory = true;
+	  return;
+	}
+
+      int split_pos = first_use & ~1;
+      if (split_pos > pos)
+	{
+	  _unhandled.push (split (current, split_pos));
+	  current->in_memory = true;
+	  return;
+	}
+    }
+
+  // Otherwise take the register from the intervals using it.
+  //
+  current->phys = reg;
+
+  for (unsigned i = 0; i < _active.size (); )
+    if (_active[i]->phys == int (reg))
+      {
+	spill_from (_active[i], pos);
+	_active[i] = _active.back ();
+	_active.pop_back ();
+      }
+    else
+      i++;
+
+  for (auto ival : _inactive)
+    if (ival->phys == int (reg))
+      {
+	int inter = ival->next_intersection (*current, pos);
+	if (inter != NO_POS)
+	  spill_from (ival, inter & ~1);
+      }
+}
+
+
+// Move the part of IVAL from POS on out of its physical register:
+// into memory until its next use, and back to the unhandled list for
+// the rest.
+//
+void
+LinearScan::spill_from (Interval *ival, int pos)
+{
+  Interval *rest = ival;
+  if (pos > ival->start ())
+    rest = split (ival, pos);
+  rest->phys = -1;
+
+  int use = rest->next_use (rest->start ());
+  if (use == NO_POS)
+    {
+      rest->in_memory = true;
+      return;
+    }
+
+  int split_pos = use & ~1;
+  if (split_pos > rest->start ())
+    {
+      _unhandled.push (split (rest, split_pos));
+      rest->in_memory = true;
+    }
+  else
+    _unhandled.push (rest);
+}
+
+
+// Split IVAL at POS, returning the new interval for the part from POS
+// on.
+//
+Interval *
+LinearScan::split (Interval *ival, int pos)
+{
+  check_assertion (ival->start () < pos && pos < ival->end (),
+		   "Interval split outside its range");
+
+  ++intervals_split;
+
+  Interval *child = new_interval (ival->vreg);
+
+  auto range = std::partition_point (ival->ranges.begin (), ival->ranges.end (),
+				     [pos] (const Range &range)
+				     {
+				       return range.to <= pos;
+				     });
+  if (range->from < pos)
+    {
+      child->ranges.push_back (Range { pos, range->to });
+      range->to = pos;
+      ++range;
+    }
+  child->ranges.insert (child->ranges.end (), range, ival->ranges.end ());
+  ival->ranges.erase (range, ival->ranges.end ());
+
+  auto use = std::lower_bound (ival->uses.begin (), ival->uses.end (), pos);
+  child->uses.assign (use, ival->uses.end ());
+  ival->uses.erase (use, ival->uses.end ());
+
+  return child;
+}
+
+
+// Return the location of register VREG at POS.
+//
+Reg *
+LinearScan::location (unsigned vreg, int pos)
+{
+  const std::vector<Interval *> &parts = _parts[vreg];
+
+  auto part = std::upper_bound (parts.begin (), parts.end (), pos,
+				[] (int pos, const Interval *part)
+				{
+				  return pos < part->start ();
+				});
+  check_assertion (part != parts.begin (), "No interval for live register");
+  --part;
+
+  if ((*part)->phys >= 0)
+    return phys_reg ((*part)->phys);
+  check_assertion ((*part)->in_memory, "Interval left unallocated");
+  return slot_reg (vreg);
+}
+
+Reg *
+LinearScan::phys_reg (unsigned num)
+{
+  if (! _phys_regs[num])
+    _phys_regs[num] = new Reg (Symbol ("r" + std::to_string (num)), _fun);
+  return _phys_regs[num];
+}
+
+Reg *
+LinearScan::slot_reg (unsigned vreg)
+{
+  if (! _slots[vreg])
+    _slots[vreg] = new Reg (Symbol ("s" + std::to_string (_num_slots++)), _fun);
+  return _slots[vreg];
+}
+
+
+// Add the parallel copies MOVES to BLOCK, before POS.
+//
+void
+LinearScan::insert_moves (BB *block, BB::InsnList::const_iterator pos,
+			  const std::vector<Move> &moves)
+{
+  auto make_temp = [this] ()
+    {
+      if (! _scratch_slot)
+	_scratch_slot = new Reg (Symbol ("s" + std::to_string (_num_slots++)),
+				 _fun);
+      return _scratch_slot;
+    };
+
+  auto is_slot = [this] (Reg *reg)
+    {
+      return std::find (_phys_regs.begin (), _phys_regs.end (), reg)
+	     == _phys_regs.end ();
+    };
+
+  for (auto move : sequentialize_moves (moves, make_temp))
+    {
+      if (move.first->value ())
+	;
+      else if (is_slot (move.first))
+	++reloads;
+      else if (is_slot (move.second))
+	++spill_stores;
+      else
+	++reg_moves;
+
+      block->insert_insn (pos, new CopyInsn (move.first, move.second));
+    }
+}
+
+
+// Replace registers with their locations, and add copies where
+// locations change.
+//
+void
+LinearScan::rewrite ()
+{
+  // Copies needed where an interval was split inside a block, by
+  // position.  Splits at the start of a block are handled on the edges
+  // into it.
+  //
+  // An interval split at an odd position, where an instruction writes
+  // its results, still has its old location when the instruction
+  // reads its arguments, and the new one is always a stack slot, so
+  // the copy can be put before the instruction, after any copies for
+  // the even position.  If the value was only just loaded from the
+  // same slot, the copy isn't needed at all.
+  //
+  std::vector<bool> block_start (_block_pos.empty () ? 0 : _block_pos.back ().to);
+  for (auto block_pos : _block_pos)
+    block_start[block_pos.from] = true;
+
+  std::map<int, std::vector<Move>> split_moves;
+  for (unsigned vreg = 0; vreg < _vregs.size (); vreg++)
+    {
+      std::vector<Interval *> &parts = _parts[vreg];
+      std::sort (parts.begin (), parts.end (),
+		 [] (const Interval *part1, const Interval *part2)
+		 {
+		   return part1->start () < part2->start ();
+		 });
+
+      for (unsigned i = 1; i < parts.size (); i++)
+	{
+	  int pos = parts[i]->start ();
+	  if (parts[i - 1]->end () == pos && ! block_start[pos & ~1])
+	    {
+	      Reg *from = location (vreg, pos - 1), *to = location (vreg, pos);
+	      bool reloaded
+		= ((pos & 1) && i >= 2 && parts[i - 1]->start () == pos - 1
+		   && parts[i - 2]->end () == pos - 1
+		   && location (vreg, pos - 2) == to);
+	      if (from != to && ! reloaded)
+		split_moves[pos].emplace_back (from, to);
+	    }
+	}
+    }
+
+  // The old registers are about to be replaced everywhere, so don't
+  // bother keeping track of their uses.
+  //
+  for (auto reg : _vregs)
+    reg->forget_uses_and_defs ();
+
+  for (unsigned block_idx = 0; block_idx < _order.size (); block_idx++)
+    {
+      BB *block = _order[block_idx];
+      const BB::InsnList &insns = block->insns ();
+
+      int pos = _block_pos[block_idx].from;
+      for (auto insn_iter = insns.begin (); insn_iter != insns.end (); )
+	{
+	  Insn *insn = *insn_iter;
+	  pos += 2;
+
+	  for (int move_pos : { pos, pos + 1 })
+	    {
+	      auto moves = split_moves.find (move_pos);
+	      if (moves != split_moves.end ())
+		insert_moves (block, insn_iter, moves->second);
+	    }
+
+	  ++insn_iter;
+
+	  const Insn::RegVector &args = insn->args ();
+	  const Insn::RegVector &results = insn->results ();
+
+	  auto arg_loc = [&] (unsigned num)
+	    {
+	      int vreg = vreg_num (args[num]);
+	      return vreg < 0 ? args[num] : location (vreg, pos);
+	    };
+	  auto result_loc = [&] (unsigned num)
+	    {
+	      int vreg = vreg_num (results[num]);
+	      return vreg < 0 ? results[num] : location (vreg, pos + 1);
+	    };
+
+	  // A copy whose source and destination ended up in the same
+	  // register is just deleted.
+	  //
+	  if (dynamic_cast<CopyInsn *> (insn) && arg_loc (0) == result_loc (0))
+	    {
+	      ++copies_coalesced;
+	      delete insn;
+	      continue;
+	    }
+
+	  for (unsigned i = 0; i < args.size (); i++)
+	    insn->change_arg (i, arg_loc (i));
+	  for (unsigned i = 0; i < results.size (); i++)
+	    insn->change_result (i, result_loc (i));
+	}
+    }
+
+  for (unsigned block_idx = 0; block_idx < _order.size (); block_idx++)
+    resolve_edges (block_idx);
+
+  // Registers live into the entry block are read before being set,
+  // and so must start out as zero, as they would have.
+  //
+  if (! _order.empty () && _order[0] == _fun->entry_block ())
+    {
+      std::vector<Move> inits;
+      Reg *zero = 0;
+      _live_in[0].for_each ([&] (unsigned vreg)
+	{
+	  if (! zero)
+	    zero = new Reg (new Value (0, _fun));
+	  inits.emplace_back (zero, location (vreg, _block_pos[0].from));
+	});
+      if (! inits.empty ())
+	insert_moves (_order[0], _order[0]->insns ().begin (), inits);
+    }
+
+  for (auto reg : _vregs)
+    delete reg;
+}
+
+
+// Add copies at the ends of edges into the block at index BLOCK_IDX,
+// where locations differ.
+//
+void
+LinearScan::resolve_edges (unsigned block_idx)
+{
+  BB *block = _order[block_idx];
+
+  std::vector<BB *> preds (block->predecessors ().begin (),
+			   block->predecessors ().end ());
+  std::sort (preds.begin (), preds.end (),
+	     [] (BB *block1, BB *block2)
+	     {
+	       return block1->num () < block2->num ();
+	     });
+  preds.erase (std::unique (preds.begin (), preds.end ()), preds.end ());
+
+  for (auto pred : preds)
+    {
+      unsigned pred_idx = _block_indices[pred->num ()];
+
+      std::vector<Move> moves;
+      _live_in[block_idx].for_each ([&] (unsigned vreg)
+	{
+	  Reg *from = location (vreg, _block_pos[pred_idx].to - 1);
+	  Reg *to = location (vreg, _block_pos[block_idx].from);
+	  if (from != to)
+	    moves.emplace_back (from, to);
+	});
+
+      if (moves.empty ())
+	continue;
+
+      // Put the copies at the end of the predecessor if this is its
+      // only successor, at the start of this block if the predecessor
+      // is its only predecessor, and otherwise in a new block on the
+      // edge.
+      //
+      const BB::InsnList &pred_insns = pred->insns ();
+      if (pred->successors ().size () == 1
+	  && (pred_insns.empty () || ! pred_insns.back ()->is_branch_insn ()))
+	insert_moves (pred, pred_insns.end (), moves);
+      else if (block->predecessors ().size () == 1)
+	insert_moves (block, block->insns ().begin (), moves);
+      else
+	{
+	  BB *edge_block = new BB (_fun);
+	  ++edge_blocks_added;
+	  edge_block->set_fall_through (block);
+	  pred->change_successor (block, edge_block);
+	  insert_moves (edge_block, edge_block->insns ().end (), moves);
+	}
+    }
+}
+
+} // namespace
+
+
+// Assign each register in this function to one of NUM_REGS physical
+// registers, called r0, r1, ..., or a stack slot, called s0, s1, ....
+//
+void
+Fun::allocate_registers (unsigned num_regs)
+{
+  TRACE_SPAN ("allocate_registers");
+
+  if (num_regs < 2)
+    throw std::runtime_error ("Register allocation needs at least"
+			      " 2 registers");
+
+  for (auto block : _blocks)
+    for (auto insn : block->insns ())
+      if (dynamic_cast<PhiFunInsn *> (insn)
+	  || dynamic_cast<PhiFunInpInsn *> (insn))
+	throw std::runtime_error ("Register allocation can't be done"
+				  " in SSA form");
+
+  LinearScan (this, num_regs).run ();
+}
@@ -20,6 +20,8 @@ class FunResultInsn : public Insn
 {
 public:
 
+  MEM_ACCOUNTED (FunResultInsn);
+
   // Make a new function-result instruction, which stores the register
   // RESULT into the function result RESULT_NUM.
   //
@@ -7,10 +7,12 @@
 // Created: 2019-11-25
 //
 
-#include <set>
 #include <map>
+#include <vector>
 
 #include "check-assertion.h"
+#include "trace.h"
+#include "stats.h"
 
 #include "reg.h"
 #include "insn.h"
@@ -21,6 +23,14 @@
 #include "fun.h"
 
 
+static Stat phi_funs_inserted ("fun-ssa", "phi-funs-inserted",
+			       "Number of phi-functions inserted");
+static Stat phi_funs_removed ("fun-ssa", "phi-funs-removed",
+			      "Number of phi-functions replaced by copies");
+static Stat phi_inp_blocks_added ("fun-ssa", "phi-inp-blocks-added",
+				  "Number of blocks added to hold phi-function inputs");
+
+
 
 // ----------------------------------------------------------------
 // Convert to SSA-form
@@ -30,45 +40,123 @@
 // Insert SSA phi-functions in every place they're needed in this
 // function.
 //
+// A register needs a phi-function at the start of each block in the
+// iterated dominance frontier of the blocks defining it: the
+// dominance frontier of those blocks, plus the dominance frontier of
+// every block given a phi-function for it, and so on, as each
+// phi-function is itself a new definition (Cytron et al, "Efficiently
+// Computing Static Single Assignment Form and the Control Dependence
+// Graph").
+//
 void
 Fun::insert_phi_functions ()
 {
+  TRACE_SPAN ("insert_phi_functions");
+
+  // The dominance frontier of every block, by block number, found by
+  // walking up the dominator tree from the predecessors of each join
+  // point until reaching its immediate dominator (Cooper, Harvey and
+  // Kennedy, "A Simple, Fast Dominance Algorithm").
+  //
+  std::vector<std::vector<BB *>> frontiers (_max_block_num + 1);
   for (auto bb : _blocks)
     {
-      std::set<Reg *> bb_regs;
-      for (auto insn : bb->insns ())
-	for (auto reg : insn->results ())
-	  bb_regs.insert (reg);
-
-      for (auto frontier_block : bb->dominance_frontier ())
-	for (auto reg : bb_regs)
-	  {
-	    // Search existing phi functions in FRONTIER_BLOCK to see
-	    // if there's already one present for REG.
-	    //
-	    bool found_phi_function = false;
-	    for (auto insn : frontier_block->insns ())
-	      if (PhiFunInsn *phi_fun = dynamic_cast<PhiFunInsn *> (insn))
+      const BB::BlockList &preds = bb->predecessors ();
+      if (preds.size () < 2)
+	continue;
+
+      for (auto pred : preds)
+	{
+	  // Unreachable blocks have no dominator.
+	  //
+	  if (pred != _entry_block && ! pred->dominator ())
+	    continue;
+
+	  for (BB *runner = pred; runner && runner != bb->dominator ();
+	       runner = runner->dominator ())
+	    {
+	      std::vector<BB *> &frontier = frontiers[runner->num ()];
+	      if (frontier.empty () || frontier.back () != bb)
+		frontier.push_back (bb);
+	    }
+	}
+    }
+
+  // For each block, the last register given a phi-function there,
+  // and the last register for which it was added to WORKLIST.
+  //
+  std::vector<Reg *> phi_fun_regs (_max_block_num + 1);
+  std::vector<Reg *> worklist_regs (_max_block_num + 1);
+
+  // Registers are processed in the function's order, rather than by
+  // address, as the order phi-functions are added to a block
+  // determines how SSA values are numbered, and so the output.
+  //
+  std::vector<BB *> worklist;
+  for (auto reg : _regs)
+    {
+      // Start with the blocks defining REG.
+      //
+      for (auto def : reg->defs ())
+	{
+	  BB *bb = def->block ();
+	  if (bb && worklist_regs[bb->num ()] != reg)
+	    {
+	      worklist_regs[bb->num ()] = reg;
+	      worklist.push_back (bb);
+	    }
+	}
+
+      while (! worklist.empty ())
+	{
+	  BB *bb = worklist.back ();
+	  worklist.pop_back ();
+
+	  for (auto frontier_block : frontiers[bb->num ()])
+	    {
+	      unsigned frontier_num = frontier_block->num ();
+	      if (phi_fun_regs[frontier_num] == reg)
+		continue;
+	      phi_fun_regs[frontier_num] = reg;
+
+	      // Search existing phi functions in FRONTIER_BLOCK to see
+	      // if there's already one present for REG.
+	      //
+	      bool found_phi_function = false;
+	      for (auto insn : frontier_block->insns ())
+		if (PhiFunInsn *phi_fun = dynamic_cast<PhiFunInsn *> (insn))
+		  {
+		    if (phi_fun->results ()[0] == reg)
+		      {
+			// We found a matching phi function!
+			found_phi_function = true;
+			break;
+		      }
+		  }
+		else
+		  {
+		    // Phi-functions occur at the beginning of the
+		    // block, so when we run into a non-phi-function
+		    // insn, we can just stop looking.
+
+		    break;
+		  }
+
+	      if (! found_phi_function)
 		{
-		  if (phi_fun->results ()[0] == reg)
-		    {
-		      // We found a matching phi function!
-		      found_phi_function = true;
-		      break;
-		    }
+		  new PhiFunInsn (reg, frontier_block);
+		  ++phi_funs_inserted;
 		}
-	      else
-		{
-		  // Phi-functions occur at the beginning of the
-		  // block, so when we run into a non-phi-function
-		  // insn, we can just stop looking.
 
-		  break;
+	      // The phi-function is a new definition of REG.
+	      //
+	      if (worklist_regs[frontier_num] != reg)
+		{
+		  worklist_regs[frontier_num] = reg;
+		  worklist.push_back (frontier_block);
 		}
-
-	    if (! found_phi_function)
-	      new PhiFunInsn (reg, frontier_block);
-	  }
+	    }
+	}
     }
 }
 
@@ -119,7 +207,7 @@ convert_dominated_regs_to_ssa_values (BB *block, HierarchialRegMap *dominating_r
       // Replace argument registers in INSN with the corresponding
       // SSA values.
       //
-      const std::vector<Reg *> &args = insn->args ();
+      const Insn::RegVector &args = insn->args ();
       unsigned num_args = args.size ();
       for (unsigned arg_num = 0; arg_num < num_args; arg_num++)
 	{
@@ -131,7 +219,7 @@ convert_dominated_regs_to_ssa_values (BB *block, HierarchialRegMap *dominating_r
 
       // Insert new mappings to reflect INSN's results.
       //
-      const std::vector<Reg *> &results = insn->results ();
+      const Insn::RegVector &results = insn->results ();
       unsigned num_results = results.size ();
       for (unsigned result_num = 0; result_num < num_results; result_num++)
 	{
@@ -154,14 +242,28 @@ convert_dominated_regs_to_ssa_values (BB *block, HierarchialRegMap *dominating_r
     for (auto insn : succ->insns ())
       if (PhiFunInsn *phi_fun = dynamic_cast<PhiFunInsn *> (insn))
 	{
-	  Reg *arg_proto = phi_fun->results ()[0]->ssa_proto ();
+	  // If SUCC hasn't been converted yet (because BLOCK doesn't
+	  // dominate it), the phi-function's result is still the
+	  // original register rather than an SSA value.
+	  //
+	  Reg *phi_reg = phi_fun->results ()[0];
+	  Reg *arg_proto = phi_reg->ssa_proto ();
+	  if (! arg_proto)
+	    arg_proto = phi_reg;
+
 	  Reg *arg_value = reg_map.map (arg_proto);
 
 	  check_assertion
 	    (arg_value,
 	     "Phi-function input has no value in predecessor block");
 
-	  new PhiFunInpInsn (phi_fun, arg_value, block);
+	  // A register still mapped to itself hasn't been defined on
+	  // any path to BLOCK, as phi-functions are inserted without
+	  // regard to liveness, so the phi-function gets no input
+	  // along this edge.
+	  //
+	  if (arg_value != arg_proto)
+	    new PhiFunInpInsn (phi_fun, arg_value, block);
 	}
       else
 	break;
@@ -172,9 +274,18 @@ convert_dominated_regs_to_ssa_values (BB *block, HierarchialRegMap *dominating_r
 void
 Fun::convert_to_ssa_form ()
 {
+  TRACE_SPAN ("convert_to_ssa_form");
+
   insert_phi_functions ();
 
-  convert_dominated_regs_to_ssa_values (_entry_block);
+  // Every register starts out mapped to itself, meaning it has no
+  // value yet.
+  //
+  HierarchialRegMap undefined_regs (0);
+  for (auto reg : _regs)
+    undefined_regs.add (reg, reg);
+
+  convert_dominated_regs_to_ssa_values (_entry_block, &undefined_regs);
 }
 
 
@@ -199,7 +310,7 @@ isolate_phi_function_inputs (BB *inp_block)
   //
   std::map<BB *, BB *> interposing_blocks;
 
-  const std::list<Insn *> &inp_block_insns = inp_block->insns ();
+  const BB::InsnList &inp_block_insns = inp_block->insns ();
   while (! inp_block_insns.empty ())
     {
       auto insn_iter = inp_block_insns.end ();
@@ -235,10 +346,11 @@ isolate_phi_function_inputs (BB *inp_block)
 	  if (! interposing_block)
 	    {
 	      interposing_block = new BB (inp_block->fun ());
+	      ++phi_inp_blocks_added;
 	      interposing_block->set_fall_through (phi_fun_block);
 	      inp_block->change_successor (phi_fun_block, interposing_block);
 
-	      const std::list<BB *> &succs = inp_block->successors ();
+	      const BB::BlockList &succs = inp_block->successors ();
 	      check_assertion (std::find (succs.begin(), succs.end(), phi_fun_block) == succs.end(), "@2");
 	    }
 
@@ -248,7 +360,7 @@ isolate_phi_function_inputs (BB *inp_block)
 	  interposing_block->add_insn (inp_to_move);
 
 	  check_assertion (inp_to_move->block () == interposing_block, "@1");
-	  const std::list<Insn *> &insns = inp_block->insns ();
+	  const BB::InsnList &insns = inp_block->insns ();
 	  check_assertion (std::find (insns.begin(), insns.end(), inp_to_move) == insns.end (), "@3");
 	}
       else
@@ -267,9 +379,11 @@ isolate_phi_function_inputs (BB *inp_block)
 void
 Fun::convert_from_ssa_form ()
 {
+  TRACE_SPAN ("convert_from_ssa_form");
+
   for (auto bb : _blocks)
     {
-      const std::list<Insn *> &insns = bb->insns ();
+      const BB::InsnList &insns = bb->insns ();
 
       while (! insns.empty ())
 	{
@@ -317,6 +431,7 @@ Fun::convert_from_ssa_form ()
 	  // Finally, get rid of the phi-function.
 	  //
 	  delete phi_fun;
+	  ++phi_funs_removed;
 	}
     }
 }
@@ -7,6 +7,8 @@
 // Created: 2019-11-03
 //
 
+#include <string_view>
+
 #include "fun.h"
 #include "reg.h"
 
@@ -22,6 +24,119 @@
 #include "fun-text-reader.h"
 
 
+// ----------------------------------------------------------------
+// Statement keywords
+
+
+// Keywords which can start a statement.
+//
+enum class Keyword { NONE, FUN_RESULT, REG, GOTO, IF, NOP, FUN_ARG };
+
+struct KeywordEntry
+{
+  std::string_view name;
+  Keyword keyword = Keyword::NONE;
+};
+
+static constexpr KeywordEntry keywords[] = {
+  { "fun_result", Keyword::FUN_RESULT },
+  { "reg", Keyword::REG },
+  { "goto", Keyword::GOTO },
+  { "if", Keyword::IF },
+  { "nop", Keyword::NOP },
+  { "fun_arg", Keyword::FUN_ARG },
+};
+
+
+// Keywords are looked up in a perfect hash table, so that any
+// identifier can be classified using a single hash calculation and
+// comparison.  The hash function is parameterized by a multiplier,
+// and a multiplier which gives no collisions is searched for at
+// compile time.
+//
+static constexpr unsigned KEYWORD_TABLE_SIZE = 16;
+
+// Return the keyword-table hash of the non-empty identifier WORD,
+// using the multiplier MULT.
+//
+static constexpr unsigned
+keyword_hash (std::string_view word, unsigned mult)
+{
+  return ((static_cast<unsigned char> (word[0])
+	   + static_cast<unsigned char> (word[word.size () - 1]) * mult
+	   + word.size ())
+	  % KEYWORD_TABLE_SIZE);
+}
+
+// Return the smallest multiplier for which keyword_hash maps every
+// keyword to a different slot, or zero if there is none.
+//
+static constexpr unsigned
+find_keyword_hash_mult ()
+{
+  for (unsigned mult = 1; mult < 256; mult++)
+    {
+      bool used[KEYWORD_TABLE_SIZE] = { };
+      bool collision = false;
+
+      for (const KeywordEntry &entry : keywords)
+	{
+	  unsigned slot = keyword_hash (entry.name, mult);
+	  if (used[slot])
+	    collision = true;
+	  used[slot] = true;
+	}
+
+      if (! collision)
+	return mult;
+    }
+
+  return 0;
+}
+
+static constexpr unsigned KEYWORD_HASH_MULT = find_keyword_hash_mult ();
+
+static_assert (KEYWORD_HASH_MULT != 0,
+	       "No perfect hash for keywords; increase KEYWORD_TABLE_SIZE");
+
+struct KeywordTable
+{
+  KeywordEntry slots[KEYWORD_TABLE_SIZE];
+};
+
+static constexpr KeywordTable
+make_keyword_table ()
+{
+  KeywordTable table { };
+  for (const KeywordEntry &entry : keywords)
+    table.slots[keyword_hash (entry.name, KEYWORD_HASH_MULT)] = entry;
+  return table;
+}
+
+static constexpr KeywordTable keyword_table = make_keyword_table ();
+
+
+// Return the keyword named WORD, or Keyword::NONE if WORD isn't a
+// keyword.
+//
+static Keyword
+lookup_keyword (std::string_view word)
+{
+  if (word.empty ())
+    return Keyword::NONE;
+
+  const KeywordEntry &entry
+    = keyword_table.slots[keyword_hash (word, KEYWORD_HASH_MULT)];
+
+  return entry.name == word ? entry.keyword : Keyword::NONE;
+}
+
+
+
+// ----------------------------------------------------------------
+// Function parsing
+
+
 // Parse the contents of a function.
 //
 void
@@ -52,28 +167,19 @@ FunTextReader::parse_fun ()
       if (inp.skip ('#') || inp.at_eol ())
 	continue;
 
-      // A "function result" insn, which must come at the end of the
-      // function.
+      // Any keyword at the start of the line determines what kind of
+      // statement this is.  It isn't consumed until we've checked
+      // that a statement is valid here, so that errors point at the
+      // beginning of the statement.
       //
-      if (inp.skip ("fun_result"))
-	{
-	  unsigned result_num = inp.read_unsigned ();
-	  Reg *result_reg = read_lvalue_reg ();
-	  new FunResultInsn (result_num,
-			     result_reg, cur_fun->exit_block ());
-
-	  saw_fun_result = true;
-
-	  continue;
-	}
-      else
-	{
-	  // Anything _except_ a function result insn must not follow
-	  // one.
+      std::string_view keyw_name = inp.peek_id ();
+      Keyword keyw = lookup_keyword (keyw_name);
 
-	  if (saw_fun_result)
-	    inp.error ("No instructions can follow a fun-result instruction");
-	}
+      // Anything _except_ a function result insn must not follow
+      // one.
+      //
+      if (saw_fun_result && keyw != Keyword::FUN_RESULT)
+	inp.error ("No instructions can follow a fun-result instruction");
 
       // Label (starts a new block)
       //
@@ -95,75 +201,100 @@ FunTextReader::parse_fun ()
 	  continue;
 	}
 
-      // Register declaration
+      // Except for function results and register declarations, a
+      // block is expected.
       //
-      if (inp.skip ("reg"))
+      if (! cur_block
+	  && keyw != Keyword::FUN_RESULT && keyw != Keyword::REG)
+	inp.error ("Expected label");
+
+      if (keyw != Keyword::NONE)
+	inp.consume_in_line (keyw_name.size ());
+
+      switch (keyw)
 	{
-	  std::string reg_name = inp.read_id ();
+	case Keyword::FUN_RESULT:
+	  {
+	    // A "function result" insn, which must come at the end of
+	    // the function.
 
-	  Reg *&reg = registers[reg_name];
-	  if (reg)
-	    inp.error (std::string ("Duplicate register declaration \"")
-		       + reg_name + "\"");
+	    unsigned result_num = inp.read_unsigned ();
+	    Reg *result_reg = read_lvalue_reg ();
+	    new FunResultInsn (result_num,
+			       result_reg, cur_fun->exit_block ());
 
-	  reg = new Reg (reg_name, cur_fun);
+	    saw_fun_result = true;
 
-	  continue;
-	}
+	    continue;
+	  }
 
-      // For everything after this point, a block is expected.
-      //
-      if (! cur_block)
-	inp.error ("Expected label");
+	case Keyword::REG:
+	  {
+	    // Register declaration
 
-      // Branch insn, ends the current block
-      //
-      if (inp.skip ("goto"))
-	{
-	  BB *target = read_label ();
-	  cur_block->set_fall_through (target);
-	  cur_block = 0;
+	    Symbol reg_name (inp.read_id ());
 
-	  continue;
-	}
+	    Reg *&reg = registers[reg_name];
+	    if (reg)
+	      inp.error (std::string ("Duplicate register declaration \"")
+			 + std::string (reg_name.name ()) + "\"");
 
-      // Conditional branch insn
-      //
-      if (inp.skip ("if"))
-	{
-	  inp.expect ('(');
-	  Reg *cond = read_rvalue_reg ();
-	  inp.expect (')');
-	  inp.expect ("goto");
+	    reg = new Reg (reg_name, cur_fun);
 
-	  BB *target = read_label ();
+	    continue;
+	  }
 
-	  new CondBranchInsn (cond, target, cur_block);
+	case Keyword::GOTO:
+	  {
+	    // Branch insn, ends the current block
 
-	  continue;
-	}
+	    BB *target = read_label ();
+	    cur_block->set_fall_through (target);
+	    cur_block = 0;
+
+	    continue;
+	  }
+
+	case Keyword::IF:
+	  {
+	    // Conditional branch insn
+
+	    inp.expect ('(');
+	    Reg *cond = read_rvalue_reg ();
+	    inp.expect (')');
+	    inp.expect ("goto");
+
+	    BB *target = read_label ();
+
+	    new CondBranchInsn (cond, target, cur_block);
+
+	    continue;
+	  }
+
+	case Keyword::NOP:
+	  // No-operation insn
 
-      // No-operation insn
-      //
-      if (inp.skip ("nop"))
-	{
 	  new NopInsn (cur_block);
+
 	  continue;
-	}
 
-      // Function-argument insn
-      //
-      if (inp.skip ("fun_arg"))
-	{
-	  if (saw_label)
-	    inp.error
-	      ("fun_arg instructions are only valid at the start of a function");
+	case Keyword::FUN_ARG:
+	  {
+	    // Function-argument insn
 
-	  unsigned arg_num = inp.read_unsigned ();
-	  Reg *arg_reg = read_lvalue_reg ();
-	  new FunArgInsn (arg_num, arg_reg, cur_fun->entry_block ());
+	    if (saw_label)
+	      inp.error
+		("fun_arg instructions are only valid at the start of a function");
 
-	  continue;
+	    unsigned arg_num = inp.read_unsigned ();
+	    Reg *arg_reg = read_lvalue_reg ();
+	    new FunArgInsn (arg_num, arg_reg, cur_fun->entry_block ());
+
+	    continue;
+	  }
+
+	case Keyword::NONE:
+	  break;
 	}
 
       //
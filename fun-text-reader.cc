@@ -6,8 +6,11 @@
 // Created: 2019-11-03
 //
 
+#include <memory>
 #include <stdexcept>
 
+#include "trace.h"
+
 #include "fun.h"
 #include "reg.h"
 #include "value.h"
@@ -47,6 +50,8 @@ FunTextReader::input () const
 Fun *
 FunTextReader::read ()
 {
+  TRACE_SPAN ("FunTextReader::read");
+
   // We need to be in line-oriented mode.
   //
   input ().set_line_oriented (true);
@@ -56,12 +61,25 @@ FunTextReader::read ()
   if (cur_fun)
     throw std::runtime_error ("Recursive call to FunTextReader::read");
 
-  Fun *fun = new Fun ();
+  std::unique_ptr<Fun> fun (new Fun ());
 
-  cur_fun = fun;
+  cur_fun = fun.get ();
   cur_block = fun->entry_block ();
 
-  parse_fun ();
+  try
+    {
+      parse_fun ();
+    }
+  catch (...)
+    {
+      // Discard the partially read function, and leave us ready to
+      // read another.
+      //
+      cur_fun = 0;
+      cur_block = 0;
+      clear_state ();
+      throw;
+    }
 
   cur_fun = 0;
   cur_block = 0;
@@ -70,7 +88,7 @@ FunTextReader::read ()
   //
   clear_state ();
 
-  return fun;
+  return fun.release ();
 }
 
 
@@ -81,7 +99,7 @@ FunTextReader::read_label ()
 {
   SrcFileInput &inp = input ();
   inp.skip ('<');
-  return label_block (inp.read_delimited_string ('>'));
+  return label_block (Symbol (inp.read_delimited_string ('>')));
 }
 
 
@@ -90,18 +108,19 @@ FunTextReader::read_label ()
 Reg *
 FunTextReader::read_lvalue_reg ()
 {
-  return get_reg (input ().read_id ());
+  return get_reg (Symbol (input ().read_id ()));
 }
 
 // Return the register (which must exist) called NAME
 //
 Reg *
-FunTextReader::get_reg (const std::string &name)
+FunTextReader::get_reg (Symbol name)
 {
-  auto reg_it = registers.find (name);
-  if (reg_it == registers.end ())
-    input ().error (std::string ("Unknown register \"") + name + "\"");
-  return reg_it->second;
+  Reg **reg = registers.find (name);
+  if (! reg)
+    input ().error (std::string ("Unknown register \"")
+		    + std::string (name.name ()) + "\"");
+  return *reg;
 }
 
 // Read a comma-separated list of lvalue registers, as for
@@ -167,6 +186,7 @@ void
 FunTextReader::clear_state ()
 {
   labeled_blocks.clear ();
+  registers.clear ();
 }
 
 
@@ -174,7 +194,7 @@ FunTextReader::clear_state ()
 // label has yet been encountered, a new block is added and returned.
 //
 BB *
-FunTextReader::label_block (const std::string &label)
+FunTextReader::label_block (Symbol label)
 {
   BB *&block_ptr = labeled_blocks[label];
 
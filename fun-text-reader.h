@@ -9,8 +9,9 @@
 #ifndef __FUN_TEXT_READER_H__
 #define __FUN_TEXT_READER_H__
 
-#include <string>
-#include <unordered_map>
+#include <vector>
+
+#include "symbol-map.h"
 
 
 class ProgTextReader;
@@ -48,7 +49,7 @@ public:
 
   // Return the register (which must exist) called NAME
   //
-  Reg *get_reg (const std::string &name);
+  Reg *get_reg (Symbol name);
 
   // Read a comma-separated list of lvalue registers, as for
   // FunTextReader::read_lvalue_reg, and return them as a vector.
@@ -71,7 +72,7 @@ public:
   // Return the block corresponding to the label LABEL.  If no such
   // label has yet been encountered, a new block is added and returned.
   //
-  BB *label_block (const std::string &label);
+  BB *label_block (Symbol label);
 
 
 private:
@@ -99,9 +100,12 @@ private:
   BB *cur_block = 0;
 
 
-  std::unordered_map<std::string, BB *> labeled_blocks;
-
-  std::unordered_map<std::string, Reg *> registers;
+  // Blocks and registers in the current function, indexed by name.
+  // Names are interned directly from the input buffer, so looking up
+  // a name already seen doesn't allocate anything.
+  //
+  SymbolMap<BB *> labeled_blocks;
+  SymbolMap<Reg *> registers;
 };
 
 
@@ -6,13 +6,18 @@
 // Created: 2019-11-02
 //
 
-#include <ostream>
+#include <algorithm>
+#include <charconv>
+#include <optional>
 #include <unordered_set>
 #include <deque>
 
+#include "trace.h"
+
 #include "reg.h"
 #include "fun.h"
 #include "value.h"
+#include "block-freq.h"
 
 #include "prog-text-writer.h"
 #include "fun-text-writer.h"
@@ -24,10 +29,10 @@ FunTextWriter::FunTextWriter (ProgTextWriter &_prog_writer)
 }
 
 
-// Return the output stream we're writing to.
+// Return the output buffer we're writing to.
 //
-std::ostream
-&FunTextWriter::output_stream ()
+OutputBuffer &
+FunTextWriter::output_buffer ()
 {
   return prog_writer.out ();
 }
@@ -39,7 +44,9 @@ std::ostream
 void
 FunTextWriter::write (Fun *fun)
 {
-  std::ostream &out = output_stream ();
+  TRACE_SPAN ("FunTextWriter::write");
+
+  OutputBuffer &out = output_buffer ();
 
   out << "{\n";
 
@@ -47,38 +54,80 @@ FunTextWriter::write (Fun *fun)
   //
   for (auto reg : fun->regs ())
     {
-      const std::string &name = reg->name ();
+      // Length of the description we write, for padding.
+      //
+      std::size_t desc_len;
+
+      out << "   ";
 
-      std::string desc;
       if (reg->is_constant ())
 	{
-	  desc = "# const ";
-	  desc += std::to_string (reg->value ()->int_value ());
+	  char num_buf[24];
+	  std::size_t num_len
+	    = std::to_chars (num_buf, num_buf + sizeof num_buf,
+			     reg->value ()->int_value ()).ptr
+	      - num_buf;
+
+	  out << "# const ";
+	  out.write (num_buf, num_len);
+
+	  desc_len = 8 + num_len;
 	}
       else
 	{
-	  desc = "reg ";
-	  desc += name;
+	  std::string_view name = reg->name ();
+
+	  out << "reg " << name;
+
+	  desc_len = 4 + name.size ();
 	}
-      
-      unsigned desc_len = desc.size ();
-      std::string padding ((desc_len > 18 ? 2 : 20 - desc_len), ' ');
 
       unsigned nuses = reg->uses ().size ();
       unsigned ndefs = reg->defs ().size ();
 
-      out << "   " << desc;
-      out << padding << "# (" << nuses << (nuses == 1 ? " use" : " uses");
+      out.pad (desc_len > 18 ? 2 : 20 - desc_len);
+      out << "# (" << nuses << (nuses == 1 ? " use" : " uses");
       if (! reg->is_constant ())
 	out << ", " << ndefs << (ndefs == 1 ? " def" : " defs");
       out << ")\n";
     }
 
-  // A record of which blocks we've queued to be written.
+  std::optional<BlockFreq> freqs;
+  if (profile_counts)
+    freqs.emplace (fun, *profile_counts);
+  else if (layout == Layout::FREQUENCY)
+    freqs.emplace (fun);
+  if (freqs)
+    block_freq = &*freqs;
+
+  std::vector<BB *> order;
+  if (layout == Layout::FREQUENCY)
+    order = frequency_order (fun);
+  else
+    order = depth_first_order (fun);
+
+  for (unsigned i = 0; i < order.size (); i++)
+    block_writer.write (order[i], i + 1 < order.size () ? order[i + 1] : 0);
+
+  block_freq = 0;
+
+  out << "}\n";
+}
+
+
+// Return the blocks of FUN in depth-first order from the entry block,
+// preferring fall-through successors.
+//
+std::vector<BB *>
+FunTextWriter::depth_first_order (Fun *fun)
+{
+  std::vector<BB *> order;
+
+  // A record of which blocks we've queued.
   //
   std::unordered_set<BB *> queued_blocks;
 
-  // A queue of blocks needing to be written.
+  // A queue of blocks needing to be added to ORDER.
   //
   std::deque<BB *> write_queue;
 
@@ -87,7 +136,7 @@ FunTextWriter::write (Fun *fun)
   //
   BB *exit_block = fun->exit_block ();
 
-  // Start out by writing the entry point.
+  // Start out with the entry point.
   //
   if (fun->entry_block ())
     {
@@ -95,8 +144,8 @@ FunTextWriter::write (Fun *fun)
       queued_blocks.insert (fun->entry_block ());
     }
 
-  // Write the function in depth-first order, avoiding loops by just
-  // ignoring any block we've already written.
+  // Go through the function in depth-first order, avoiding loops by
+  // just ignoring any block we've already queued.
   //
   while (! write_queue.empty ())
     {
@@ -129,45 +178,129 @@ FunTextWriter::write (Fun *fun)
       if (block != exit_block && exit_block && write_queue.empty ())
 	write_queue.push_back (exit_block);
 
-      BB *next_block = write_queue.empty () ? 0 : write_queue.front ();
-
-      block_writer.write (block, next_block);
+      order.push_back (block);
     }
 
-  out << "}\n";
+  return order;
 }
 
 
-// Return a text label for BLOCK.
+// Return the reachable blocks of FUN ordered by frequency, as
+// described for Layout::FREQUENCY.  BLOCK_FREQ must be set.
 //
-std::string
-FunTextWriter::block_label (const BB *block)
+std::vector<BB *>
+FunTextWriter::frequency_order (Fun *fun)
 {
-  std::string label ("<");
-  label += std::to_string (block->num ());
-  label += '>';
-  return label;
+  BB *entry_block = fun->entry_block ();
+  BB *exit_block = fun->exit_block ();
+
+  // Chains of blocks, and for each block, the index of its chain, by
+  // block number.
+  //
+  std::vector<std::vector<BB *>> chains;
+  std::vector<int> block_chains (fun->max_block_num () + 1, -1);
+
+  std::vector<BB *> blocks;
+  for (auto block : depth_first_order (fun))
+    if (block != exit_block)
+      {
+	block_chains[block->num ()] = chains.size ();
+	chains.push_back ({ block });
+	blocks.push_back (block);
+      }
+
+  // Join chains along fall-through edges, hottest first.  An edge can
+  // only join the end of one chain to the start of another, and the
+  // entry block must stay at the start of its chain.
+  //
+  std::vector<BB *> sources;
+  for (auto block : blocks)
+    {
+      BB *fall_through = block->fall_through ();
+      if (fall_through && fall_through != exit_block
+	  && fall_through != entry_block && fall_through != block)
+	sources.push_back (block);
+    }
+  auto fall_through_freq = [this] (BB *block)
+    {
+      return block_freq->edge_freq (block, block->fall_through ());
+    };
+  std::stable_sort (sources.begin (), sources.end (),
+		    [&] (BB *block1, BB *block2)
+		    {
+		      return fall_through_freq (block1) > fall_through_freq (block2);
+		    });
+
+  for (auto block : sources)
+    {
+      int chain = block_chains[block->num ()];
+      int succ_chain = block_chains[block->fall_through ()->num ()];
+
+      if (chain == succ_chain || chains[chain].back () != block
+	  || chains[succ_chain].front () != block->fall_through ())
+	continue;
+
+      for (auto succ : chains[succ_chain])
+	{
+	  chains[chain].push_back (succ);
+	  block_chains[succ->num ()] = chain;
+	}
+      chains[succ_chain].clear ();
+    }
+
+  // Write the entry block's chain first, and then the others in
+  // order of their hottest block.
+  //
+  std::vector<std::pair<double, unsigned>> chain_order;
+  for (unsigned i = 0; i < chains.size (); i++)
+    if (! chains[i].empty () && chains[i].front () != entry_block)
+      {
+	double max_freq = 0;
+	for (auto block : chains[i])
+	  max_freq = std::max (max_freq, block_freq->freq (block));
+	chain_order.emplace_back (max_freq, i);
+      }
+  std::stable_sort (chain_order.begin (), chain_order.end (),
+		    [] (const std::pair<double, unsigned> &chain1,
+			const std::pair<double, unsigned> &chain2)
+		    {
+		      return chain1.first > chain2.first;
+		    });
+
+  std::vector<BB *> order;
+  if (entry_block)
+    order = chains[block_chains[entry_block->num ()]];
+  for (auto [max_freq, chain] : chain_order)
+    order.insert (order.end (), chains[chain].begin (), chains[chain].end ());
+  if (exit_block)
+    order.push_back (exit_block);
+
+  return order;
 }
 
 
-// Return a string containing labels for all blocks in BLOCK_LIST,
-// separated by a comma and space.
+// Write a text label for BLOCK.
 //
-std::string
-FunTextWriter::block_list_labels (const std::list<BB *> &block_list)
+void
+FunTextWriter::write_block_label (const BB *block)
 {
-  std::string str;
+  output_buffer () << '<' << block->num () << '>';
+}
 
+// Write labels for all blocks in BLOCK_LIST, separated by a comma
+// and space.
+//
+void
+FunTextWriter::write_block_list_labels (const BB::BlockList &block_list)
+{
   bool first = true;
   for (auto bb : block_list)
     {
       if (first)
 	first = false;
       else
-	str += ", ";
+	output_buffer () << ", ";
 
-      str += block_label (bb);
+      write_block_label (bb);
     }
-
-  return str;
 }
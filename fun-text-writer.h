@@ -9,9 +9,12 @@
 #ifndef __FUN_TEXT_WRITER_H__
 #define __FUN_TEXT_WRITER_H__
 
-#include <string>
 #include <list>
-#include <ostream>
+#include <vector>
+
+#include "output-buffer.h"
+#include "edge-profile.h"
+#include "bb.h"
 
 #include "insn-text-writer.h"
 #include "bb-text-writer.h"
@@ -20,6 +23,8 @@
 class ProgTextWriter;
 
 class Fun;
+class BB;
+class BlockFreq;
 
 
 // A class for outputting text representations of a function.
@@ -28,12 +33,36 @@ class FunTextWriter
 {
 public:
 
+  // Ways of ordering blocks in the output.  In either case, the entry
+  // block comes first and the exit block last.
+  //
+  enum class Layout
+  {
+    // Depth-first from the entry block, following fall-through edges
+    // when possible.
+    //
+    DEPTH_FIRST,
+
+    // Using block frequencies (see BlockFreq), measured if there's a
+    // profile, and otherwise estimated, which are also written:
+    // blocks are joined into chains along fall-through edges, hottest
+    // edge first, as in Pettis and Hansen's "Profile Guided Code
+    // Positioning", so that the most frequent paths need no gotos,
+    // and the chains are then written hottest first, so rarely
+    // executed blocks sink to the end.  This needn't write fewer
+    // gotos than DEPTH_FIRST (after optimization it usually writes
+    // the same number), but puts them on colder edges.
+    //
+    FREQUENCY
+  };
+
+
   FunTextWriter (ProgTextWriter &prog_writer);
 
 
-  // Return the output stream we're writing to.
+  // Return the output buffer we're writing to.
   //
-  std::ostream &output_stream ();
+  OutputBuffer &output_buffer ();
 
 
   // Write a text representation of FUN.
@@ -41,14 +70,14 @@ public:
   void write (Fun *fun);
 
 
-  // Return a text label for BLOCK.
+  // Write a text label for BLOCK.
   //
-  std::string block_label (const BB *block);
+  void write_block_label (const BB *block);
 
-  // Return a string containing labels for all blocks in BLOCK_LIST,
-  // separated by a comma and space.
+  // Write labels for all blocks in BLOCK_LIST, separated by a comma
+  // and space.
   //
-  std::string block_list_labels (const std::list<BB *> &block_list);
+  void write_block_list_labels (const BB::BlockList &block_list);
 
 
   //
@@ -69,6 +98,30 @@ public:
   // Text writer for blocks.
   //
   BBTextWriter block_writer;
+
+
+  // How blocks are ordered.
+  //
+  Layout layout = Layout::DEPTH_FIRST;
+
+  // Measured counts for the function being written, or zero if there
+  // are none.  If set, the counts are written, and used instead of
+  // estimates by Layout::FREQUENCY.
+  //
+  const EdgeProfile::FunCounts *profile_counts = 0;
+
+  // Block frequencies for the function being written, if LAYOUT is
+  // Layout::FREQUENCY or PROFILE_COUNTS is set, otherwise zero.
+  //
+  const BlockFreq *block_freq = 0;
+
+
+private:
+
+  // Return the blocks of FUN in the order they should be written.
+  //
+  std::vector<BB *> depth_first_order (Fun *fun);
+  std::vector<BB *> frequency_order (Fun *fun);
 };
 
 
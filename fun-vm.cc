@@ -0,0 +1,479 @@
+// fun-vm.cc -- Bytecode virtual machine for IR functions
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "fun.h"
+#include "bb.h"
+#include "reg.h"
+#include "value.h"
+#include "calc-insn.h"
+#include "copy-insn.h"
+#include "cond-branch-insn.h"
+#include "phi-fun-insn.h"
+#include "phi-fun-inp-insn.h"
+#include "fun-arg-insn.h"
+#include "fun-result-insn.h"
+
+#include "fun-vm.h"
+
+
+namespace {
+
+// Bytecode opcodes.  Operands A, B, and C are frame slots unless
+// noted otherwise; "imm" operands are constants.
+//
+enum Opcode
+{
+  OP_ADD,			// A := B + C
+  OP_ADD_I,			// A := B + imm C
+  OP_SUB,			// A := B - C
+  OP_SUB_I,			// A := B - imm C
+  OP_I_SUB,			// A := imm B - C
+  OP_MUL,			// A := B * C
+  OP_MUL_I,			// A := B * imm C
+  OP_DIV,			// A := B / C
+  OP_DIV_I,			// A := B / imm C, C not 0 or -1
+  OP_I_DIV,			// A := imm B / C
+  OP_NEG,			// A := - B
+  OP_MOVE,			// A := B
+  OP_MOVE_I,			// A := imm B
+  OP_BRANCH,			// if A, come from block C and go to offset B
+  OP_JUMP,			// come from block C and go to offset B
+  OP_SET_FROM,			// come from block A
+  OP_PHI,			// A := B if slot B + 1 holds the from block
+  OP_PHI_INP,			// B := A, and slot B + 1 := block C
+  OP_ARG,			// A := argument number B
+  OP_RESULT,			// result number A := B
+  OP_RETURN,			// finish
+  OP_FAIL,			// fail with message number A
+  NUM_OPCODES
+};
+
+
+// Return VAL1 divided by VAL2, wrapping around on overflow.
+//
+inline int
+divide (int val1, int val2)
+{
+  if (val2 == 0)
+    throw std::runtime_error ("Division by zero");
+  if (val2 == -1)
+    return int (0U - unsigned (val1));
+  return val1 / val2;
+}
+
+} // namespace
+
+
+// Make a VM for FUN, compiling it to bytecode.
+//
+FunVM::FunVM (Fun *fun)
+{
+  static constexpr unsigned NO_BLOCK = ~0U;
+
+  std::vector<BB *> blocks (fun->blocks ().begin (), fun->blocks ().end ());
+  unsigned num_blocks = blocks.size ();
+
+  // Block indices, by block number, and whether each block has any
+  // phi-functions, which need to know where control came from.
+  //
+  std::vector<unsigned> block_indices (fun->max_block_num () + 1, NO_BLOCK);
+  std::vector<bool> has_phi_funs (num_blocks);
+  for (unsigned i = 0; i < num_blocks; i++)
+    {
+      block_indices[blocks[i]->num ()] = i;
+      for (auto insn : blocks[i]->insns ())
+	if (dynamic_cast<PhiFunInsn *> (insn))
+	  has_phi_funs[i] = true;
+    }
+
+  auto block_index = [&] (BB *block)
+    {
+      return block ? block_indices[block->num ()] : NO_BLOCK;
+    };
+
+  // Besides the real blocks, branches may go to two stubs after
+  // them, one which fails and one which returns.
+  //
+  const unsigned undefined_stub = num_blocks, return_stub = num_blocks + 1;
+
+  std::unordered_map<Reg *, int> reg_slots;
+  auto slot = [&] (Reg *reg)
+    {
+      auto [it, added] = reg_slots.emplace (reg, _init_frame.size ());
+      if (added)
+	{
+	  Value *value = reg->value ();
+	  _init_frame.push_back (value ? value->int_value () : 0);
+	}
+      return it->second;
+    };
+
+  // The slot holding the value recorded for a phi-function; the slot
+  // after it holds the block which recorded it.
+  //
+  std::unordered_map<PhiFunInsn *, int> phi_slots;
+  auto phi_slot = [&] (PhiFunInsn *phi_fun)
+    {
+      auto [it, added] = phi_slots.emplace (phi_fun, _init_frame.size ());
+      if (added)
+	{
+	  _init_frame.push_back (0);
+	  _init_frame.push_back (-1);
+	}
+      return it->second;
+    };
+
+  // Scratch slots for multiple copies.
+  //
+  std::vector<int> temp_slots;
+  auto temp_slot = [&] (unsigned num)
+    {
+      while (temp_slots.size () <= num)
+	{
+	  temp_slots.push_back (_init_frame.size ());
+	  _init_frame.push_back (0);
+	}
+      return temp_slots[num];
+    };
+
+  // Opcodes for each instruction, which are turned into handler
+  // addresses at the end.
+  //
+  std::vector<Opcode> opcodes;
+  auto emit = [&] (Opcode opcode, int a, int b = 0, int c = 0)
+    {
+      opcodes.push_back (opcode);
+      _code.push_back (Op { 0, a, b, c });
+    };
+
+  auto emit_fail = [&] (const std::string &msg)
+    {
+      emit (OP_FAIL, _fail_msgs.size ());
+      _fail_msgs.push_back (msg);
+    };
+
+  // Offset of each block (and stub) in _code.
+  //
+  std::vector<int> block_offsets (num_blocks + 2);
+
+  unsigned exit = block_index (fun->exit_block ());
+
+  for (unsigned block_idx = 0; block_idx < num_blocks; block_idx++)
+    {
+      BB *block = blocks[block_idx];
+
+      block_offsets[block_idx] = _code.size ();
+
+      for (auto insn : block->insns ())
+	{
+	  const Insn::RegVector &args = insn->args ();
+	  const Insn::RegVector &results = insn->results ();
+
+	  if (CalcInsn *calc_insn = dynamic_cast<CalcInsn *> (insn))
+	    {
+	      int result = slot (results[0]);
+	      Reg *arg1 = args[0];
+	      Value *val1 = arg1->value ();
+
+	      if (calc_insn->op () == CalcInsn::Op::NEG)
+		{
+		  if (val1)
+		    emit (OP_MOVE_I, result, int (0U - unsigned (val1->int_value ())));
+		  else
+		    emit (OP_NEG, result, slot (arg1));
+		  continue;
+		}
+
+	      Reg *arg2 = args[1];
+	      Value *val2 = arg2->value ();
+
+	      // Operand forms: both registers, a constant second
+	      // operand, or a constant first operand.
+	      //
+	      Opcode rr, ri, ir;
+	      bool commutative = false;
+	      switch (calc_insn->op ())
+		{
+		case CalcInsn::Op::ADD:
+		  rr = OP_ADD, ri = ir = OP_ADD_I, commutative = true;
+		  break;
+		case CalcInsn::Op::SUB:
+		  rr = OP_SUB, ri = OP_SUB_I, ir = OP_I_SUB;
+		  break;
+		case CalcInsn::Op::MUL:
+		  rr = OP_MUL, ri = ir = OP_MUL_I, commutative = true;
+		  break;
+		case CalcInsn::Op::DIV:
+		  rr = OP_DIV, ri = OP_DIV_I, ir = OP_I_DIV;
+
+		  // Division by these is handled specially.
+		  //
+		  if (val2 && (val2->int_value () == 0 || val2->int_value () == -1))
+		    val2 = 0;
+		  break;
+		default:
+		  throw std::runtime_error ("Invalid calculation operation");
+		}
+
+	      if (val2)
+		emit (ri, result, slot (arg1), val2->int_value ());
+	      else if (val1 && commutative)
+		emit (ir, result, slot (arg2), val1->int_value ());
+	      else if (val1)
+		emit (ir, result, val1->int_value (), slot (arg2));
+	      else
+		emit (rr, result, slot (arg1), slot (arg2));
+	    }
+	  else if (dynamic_cast<CopyInsn *> (insn))
+	    {
+	      auto emit_move = [&] (int to, Reg *from)
+		{
+		  if (Value *value = from->value ())
+		    emit (OP_MOVE_I, to, value->int_value ());
+		  else
+		    emit (OP_MOVE, to, slot (from));
+		};
+
+	      if (args.size () == 1)
+		emit_move (slot (results[0]), args[0]);
+	      else
+		{
+		  // Copy non-constant sources to scratch slots first, so
+		  // that the copies happen in parallel.
+		  //
+		  for (unsigned i = 0; i < args.size (); i++)
+		    if (! args[i]->value ())
+		      emit (OP_MOVE, temp_slot (i), slot (args[i]));
+		  for (unsigned i = 0; i < args.size (); i++)
+		    if (args[i]->value ())
+		      emit_move (slot (results[i]), args[i]);
+		    else
+		      emit (OP_MOVE, slot (results[i]), temp_slot (i));
+		}
+	    }
+	  else if (CondBranchInsn *branch = dynamic_cast<CondBranchInsn *> (insn))
+	    {
+	      // A taken branch in the exit block finishes the call.
+	      //
+	      unsigned target = block_index (branch->target ());
+	      if (block_idx == exit)
+		target = return_stub;
+	      else if (target == NO_BLOCK)
+		target = undefined_stub;
+
+	      emit (OP_BRANCH, slot (branch->condition ()), target, block_idx);
+	    }
+	  else if (PhiFunInsn *phi_fun = dynamic_cast<PhiFunInsn *> (insn))
+	    {
+	      emit (OP_PHI, slot (results[0]), phi_slot (phi_fun));
+	    }
+	  else if (PhiFunInpInsn *phi_inp = dynamic_cast<PhiFunInpInsn *> (insn))
+	    {
+	      if (phi_inp->phi_fun ())
+		emit (OP_PHI_INP, slot (args[0]), phi_slot (phi_inp->phi_fun ()),
+		      block_idx);
+	    }
+	  else if (FunArgInsn *fun_arg = dynamic_cast<FunArgInsn *> (insn))
+	    {
+	      emit (OP_ARG, slot (results[0]), fun_arg->arg_num ());
+	      _num_args = std::max (_num_args, fun_arg->arg_num () + 1);
+	    }
+	  else if (FunResultInsn *fun_result
+		   = dynamic_cast<FunResultInsn *> (insn))
+	    {
+	      emit (OP_RESULT, fun_result->result_num (), slot (args[0]));
+	      _num_results
+		= std::max (_num_results, fun_result->result_num () + 1);
+	    }
+	}
+
+      unsigned fall_through = block_index (block->fall_through ());
+      if (block_idx == exit)
+	emit (OP_RETURN, 0);
+      else if (fall_through == NO_BLOCK)
+	emit_fail ("Control fell off the end of block "
+		   + std::to_string (block->num ()));
+      else if (fall_through != block_idx + 1)
+	emit (OP_JUMP, 0, fall_through, block_idx);
+      else if (has_phi_funs[fall_through])
+	emit (OP_SET_FROM, block_idx);
+    }
+
+  block_offsets[undefined_stub] = _code.size ();
+  emit_fail ("Branch to undefined block");
+  block_offsets[return_stub] = _code.size ();
+  emit (OP_RETURN, 0);
+
+  if (fun->entry_block ())
+    _entry = block_offsets[block_index (fun->entry_block ())];
+
+  // Resolve branch targets, and thread the code.
+  //
+  const void *const *handlers = execute (0, 0, 0, 0, 0, 0);
+  for (unsigned i = 0; i < _code.size (); i++)
+    {
+      if (opcodes[i] == OP_BRANCH || opcodes[i] == OP_JUMP)
+	_code[i].b = block_offsets[_code[i].b];
+      _code[i].handler = handlers[opcodes[i]];
+    }
+}
+
+
+// Run the function with arguments ARGS, and return its results,
+// indexed by result number.
+//
+std::vector<int>
+FunVM::run (const std::vector<int> &args)
+{
+  if (args.size () != _num_args)
+    throw std::runtime_error ("Function expects "
+			      + std::to_string (_num_args) + " arguments, but "
+			      + std::to_string (args.size ()) + " given");
+
+  if (_entry < 0)
+    throw std::runtime_error ("Function has no entry block");
+
+  std::vector<int> results (_num_results);
+
+  _frame = _init_frame;
+
+  std::uint64_t fuel
+    = _max_jumps ? _max_jumps : std::numeric_limits<std::uint64_t>::max ();
+
+  execute (_code.data (), _entry, _frame.data (), args.data (),
+	   results.data (), fuel);
+
+  return results;
+}
+
+
+// Taking the address of a label, and computed gotos, are GNU
+// extensions, which are the whole point here.
+//
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+// Execute the bytecode CODE starting at offset START, with FRAME as its
+// frame, taking arguments from ARGS and storing results in RESULTS, and
+// allowing at most FUEL jumps.  If CODE is zero, just return the table
+// of handler addresses, indexed by opcode.
+//
+const void *const *
+FunVM::execute (const Op *code, unsigned start, int *frame,
+		const int *args, int *results, std::uint64_t fuel) const
+{
+  // Handler addresses, in the same order as the Opcode enumeration.
+  //
+  static const void *const handlers[NUM_OPCODES] = {
+    &&op_add, &&op_add_i, &&op_sub, &&op_sub_i, &&op_i_sub,
+    &&op_mul, &&op_mul_i, &&op_div, &&op_div_i, &&op_i_div, &&op_neg,
+    &&op_move, &&op_move_i, &&op_branch, &&op_jump, &&op_set_from,
+    &&op_phi, &&op_phi_inp, &&op_arg, &&op_result, &&op_return, &&op_fail
+  };
+
+  if (! code)
+    return handlers;
+
+  const Op *pc = code + start;
+
+  // The block control last came from, for phi-functions.
+  //
+  int from = -1;
+
+#define NEXT goto *(++pc)->handler
+#define JUMP_TO(offset)							\
+  do {									\
+    if (fuel-- == 0)							\
+      throw std::runtime_error ("Jump limit exceeded");			\
+    pc = code + (offset);						\
+    goto *pc->handler;							\
+  } while (0)
+
+  goto *pc->handler;
+
+ op_add:
+  frame[pc->a] = int (unsigned (frame[pc->b]) + unsigned (frame[pc->c]));
+  NEXT;
+ op_add_i:
+  frame[pc->a] = int (unsigned (frame[pc->b]) + unsigned (pc->c));
+  NEXT;
+ op_sub:
+  frame[pc->a] = int (unsigned (frame[pc->b]) - unsigned (frame[pc->c]));
+  NEXT;
+ op_sub_i:
+  frame[pc->a] = int (unsigned (frame[pc->b]) - unsigned (pc->c));
+  NEXT;
+ op_i_sub:
+  frame[pc->a] = int (unsigned (pc->b) - unsigned (frame[pc->c]));
+  NEXT;
+ op_mul:
+  frame[pc->a] = int (unsigned (frame[pc->b]) * unsigned (frame[pc->c]));
+  NEXT;
+ op_mul_i:
+  frame[pc->a] = int (unsigned (frame[pc->b]) * unsigned (pc->c));
+  NEXT;
+ op_div:
+  frame[pc->a] = divide (frame[pc->b], frame[pc->c]);
+  NEXT;
+ op_div_i:
+  frame[pc->a] = frame[pc->b] / pc->c;
+  NEXT;
+ op_i_div:
+  frame[pc->a] = divide (pc->b, frame[pc->c]);
+  NEXT;
+ op_neg:
+  frame[pc->a] = int (0U - unsigned (frame[pc->b]));
+  NEXT;
+ op_move:
+  frame[pc->a] = frame[pc->b];
+  NEXT;
+ op_move_i:
+  frame[pc->a] = pc->b;
+  NEXT;
+ op_branch:
+  if (frame[pc->a])
+    {
+      from = pc->c;
+      JUMP_TO (pc->b);
+    }
+  NEXT;
+ op_jump:
+  from = pc->c;
+  JUMP_TO (pc->b);
+ op_set_from:
+  from = pc->a;
+  NEXT;
+ op_phi:
+  if (frame[pc->b + 1] == from)
+    frame[pc->a] = frame[pc->b];
+  NEXT;
+ op_phi_inp:
+  frame[pc->b] = frame[pc->a];
+  frame[pc->b + 1] = pc->c;
+  NEXT;
+ op_arg:
+  frame[pc->a] = args[pc->b];
+  NEXT;
+ op_result:
+  results[pc->a] = frame[pc->b];
+  NEXT;
+ op_return:
+  return handlers;
+ op_fail:
+  throw std::runtime_error (_fail_msgs[pc->a]);
+
+#undef NEXT
+#undef JUMP_TO
+}
+
+#pragma GCC diagnostic pop
@@ -0,0 +1,115 @@
+// fun-vm.h -- Bytecode virtual machine for IR functions
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#ifndef __FUN_VM_H__
+#define __FUN_VM_H__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+class Fun;
+
+
+// A virtual machine which executes an IR function compiled to a flat
+// register-machine bytecode, for evaluating a function many times.
+//
+// Compilation maps every register, and the value recorded for each
+// phi-function, to a slot in a frame; constant operands of
+// calculations and copies are inlined in the instruction; blocks are
+// laid out in the function's block order with branch targets resolved
+// to instruction offsets, and jumps added only where a block doesn't
+// fall through to the next one.  Instructions are dispatched by
+// jumping directly to the address of each instruction's handler,
+// which is stored in the instruction ("direct threading").
+//
+// Results are the same as FunInterp, except that the instruction limit
+// is replaced by a limit on jumps, which is cheaper to check.  The
+// function must not be changed while a VM for it exists.
+//
+class FunVM
+{
+public:
+
+  // Make a VM for FUN, compiling it to bytecode.
+  //
+  FunVM (Fun *fun);
+
+
+  // Run the function with arguments ARGS, and return its results,
+  // indexed by result number.  A VM can only run one call at a time.
+  //
+  std::vector<int> run (const std::vector<int> &args);
+
+
+  // Make run fail if more than MAX_JUMPS jumps (taken branches, and
+  // fall-throughs to a block other than the next one) are done in a
+  // single call; zero means no limit.  Every loop contains a jump, so
+  // this is enough to stop runaway loops.
+  //
+  void set_max_jumps (std::uint64_t max_jumps) { _max_jumps = max_jumps; }
+
+  // Return the number of arguments the function expects.
+  //
+  unsigned num_args () const { return _num_args; }
+
+  // Return the number of bytecode instructions.
+  //
+  std::size_t code_size () const { return _code.size (); }
+
+
+  // A bytecode instruction: the address of its handler, and up to
+  // three operands, whose meaning depends on the handler.
+  //
+  struct Op
+  {
+    const void *handler;
+    int a, b, c;
+  };
+
+
+private:
+
+  // Execute the bytecode CODE starting at offset START, with FRAME as
+  // its frame, taking arguments from ARGS and storing results in
+  // RESULTS, and allowing at most FUEL jumps.  If CODE is zero, just
+  // return the table of handler addresses, indexed by opcode.
+  //
+  const void *const *execute (const Op *code, unsigned start, int *frame,
+			      const int *args, int *results,
+			      std::uint64_t fuel) const;
+
+
+  std::vector<Op> _code;
+
+  // Offset in _code of the entry block, or -1 if there isn't one.
+  //
+  int _entry = -1;
+
+  // The initial frame, holding zero for ordinary registers, the value
+  // of constant registers, and "no block" for the block which
+  // recorded each phi-function's value.
+  //
+  std::vector<int> _init_frame;
+
+  // The frame used by the current call.
+  //
+  std::vector<int> _frame;
+
+  // Messages for FAIL instructions.
+  //
+  std::vector<std::string> _fail_msgs;
+
+  unsigned _num_args = 0, _num_results = 0;
+
+  std::uint64_t _max_jumps = 0;
+};
+
+
+#endif // __FUN_VM_H__
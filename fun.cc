@@ -6,7 +6,10 @@
 // Created: 2019-11-02
 //
 
+#include "trace.h"
+
 #include "reg.h"
+#include "value.h"
 
 #include "fun.h"
 
@@ -24,11 +27,21 @@ Fun::Fun ()
 
 Fun::~Fun ()
 {
+  // Everything is being deleted, so registers needn't search their
+  // use / def lists each time an instruction goes away, which would
+  // make destroying a large function quadratic.
+  //
+  for (auto reg : _regs)
+    reg->forget_uses_and_defs ();
+
   while (! _blocks.empty ())
     delete _blocks.front ();
 
   while (! _regs.empty ())
     delete _regs.front ();
+
+  while (! _values.empty ())
+    delete _values.front ();
 }
 
 
@@ -37,10 +50,31 @@ Fun::~Fun ()
 void
 Fun::remove_block (BB *block)
 {
-  _blocks.remove (block);
+  remove_one (block, _blocks);
 
   if (_entry_block == block)
     _entry_block = 0;
   if (_exit_block == block)
     _exit_block = 0;
 }
+
+
+// Calculate the forward dominator tree for all blocks in BLOCKS.
+//
+void
+Fun::calc_dominators ()
+{
+  TRACE_SPAN ("calc_dominators");
+
+  BB::calc_dominators (_blocks);
+}
+
+// Calculate the post dominator tree for all blocks in BLOCKS.
+//
+void
+Fun::calc_post_dominators ()
+{
+  TRACE_SPAN ("calc_post_dominators");
+
+  BB::calc_post_dominators (_blocks);
+}
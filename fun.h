@@ -10,6 +10,7 @@
 #define __FUN_H__
 
 
+#include "remove-one.h"
 #include "bb.h"
 
 
@@ -40,6 +41,16 @@ public:
   //
   void remove_block (BB *block);
 
+  // Return the maximum block number used in this function so far.
+  //
+  unsigned max_block_num () const { return _max_block_num; }
+
+  // Set the maximum block number used in this function to NUM, so
+  // that blocks added subsequently are numbered after it.  This is
+  // for restoring a previously saved function.
+  //
+  void set_max_block_num (unsigned num) { _max_block_num = num; }
+
   // Return a reference to a read-only list containing the blocks in
   // this function.
   //
@@ -82,7 +93,7 @@ public:
   // Remove REG from this function.  It is not deallocated, merely
   // forgotten.  This does not modify REG's reference to this function.
   //
-  void remove_reg (Reg *reg) { _regs.remove (reg); }
+  void remove_reg (Reg *reg) { remove_one (reg, _regs); }
 
 
   // Return a reference to a read-only list containing the values
@@ -99,7 +110,7 @@ public:
   // Remove VALUE from this function.  It is not deallocated, merely
   // forgotten.  This does not modify VALUE's reference to this function.
   //
-  void remove_value (Value *value) { _values.remove (value); }
+  void remove_value (Value *value) { remove_one (value, _values); }
 
 
   // Make sure dominator information in this function is valid.
@@ -162,15 +173,25 @@ public:
   void remove_useless_copies ();
 
 
+  // Allocate registers for a machine with NUM_REGS registers.  Every
+  // register in this function, which must not be in SSA form, is
+  // replaced by a physical register, called r0, r1, ..., or where
+  // there aren't enough, a stack slot, called s0, s1, ....  Copies are
+  // added wherever a value moves between locations, and copies whose
+  // source and destination end up in the same place are removed.
+  //
+  void allocate_registers (unsigned num_regs);
+
+
 private:
 
   // Calculate the forward dominator tree for all blocks in BLOCKS.
   //
-  void calc_dominators () { BB::calc_dominators (_blocks); }
+  void calc_dominators ();
 
   // Calculate the post dominator tree for all blocks in BLOCKS.
   //
-  void calc_post_dominators () { BB::calc_post_dominators (_blocks); }
+  void calc_post_dominators ();
 
 
   // Insert SSA phi-functions in every place they're needed in this
@@ -6,9 +6,9 @@
 // Created: 2019-11-02
 //
 
+#include <mutex>
 #include <stdexcept>
 #include <string>
-#include <ostream>
 
 #include "bb.h"
 #include "reg.h"
@@ -48,40 +48,35 @@ InsnTextWriter::write (Insn *insn)
 }
 
 
-// Return a string representation of the register REG
+// Write a text representation of the register REG.
 //
-std::string
-InsnTextWriter::reg_name (Reg *reg) const
+void
+InsnTextWriter::write_reg (Reg *reg)
 {
-  if (! reg)
-    return "?";
+  OutputBuffer &out = fun_writer.output_buffer ();
 
-  if (reg->is_constant ())
-    return std::to_string (reg->value ()->int_value ());
+  if (! reg)
+    out << '?';
+  else if (reg->is_constant ())
+    out << reg->value ()->int_value ();
   else
-    return reg->name  ();
+    out << reg->name ();
 }
 
-
-// Return a string representation of the registers in the vector
-// REGS, starting from index START_IDX (default 0).
+// Write text representations of the registers in the vector REGS,
+// starting from index START_IDX (default 0), separated by a comma
+// and space.
 //
-std::string
-InsnTextWriter::reg_names (const std::vector<Reg *> &regs,
-			   unsigned start_idx)
-  const
+void
+InsnTextWriter::write_regs (const Insn::RegVector &regs,
+			    unsigned start_idx)
 {
-  std::string result;
-
   for (auto idx = start_idx; idx < regs.size (); idx++)
     {
-      if (! result.empty ())
-	result += ", ";
-
-      result += reg_name (regs[idx]);
+      if (idx != start_idx)
+	fun_writer.output_buffer () << ", ";
+      write_reg (regs[idx]);
     }
-
-  return result;
 }
 
 
@@ -96,11 +91,13 @@ InsnTextWriter::write_cond_branch (Insn *insn)
   if (! cond_branch_insn)
     invalid_write_method (insn, "CondBranchInsn");
 
-  std::ostream &out = fun_writer.output_stream ();
+  OutputBuffer &out = fun_writer.output_buffer ();
   BB *target = cond_branch_insn->target ();
-  out << "if (" << reg_name (cond_branch_insn->condition ()) << ") goto ";
+  out << "if (";
+  write_reg (cond_branch_insn->condition ());
+  out << ") goto ";
   if (target)
-    out << fun_writer.block_label (target);
+    fun_writer.write_block_label (target);
   else
     out << "-";
 }
@@ -108,45 +105,55 @@ InsnTextWriter::write_cond_branch (Insn *insn)
 void
 InsnTextWriter::write_nop (Insn *)
 {
-  std::ostream &out = fun_writer.output_stream ();
+  OutputBuffer &out = fun_writer.output_buffer ();
   out << "nop";
 }
 
+// Write the name of the calculation operation OP to OUT.
+//
+static void
+write_calc_op (OutputBuffer &out, CalcInsn::Op op)
+{
+  switch (op)
+    {
+    case CalcInsn::Op::ADD: out << '+'; break;
+    case CalcInsn::Op::SUB: out << '-'; break;
+    case CalcInsn::Op::MUL: out << '*'; break;
+    case CalcInsn::Op::DIV: out << '/'; break;
+    case CalcInsn::Op::NEG: out << '-'; break;
+    default:
+      out << "?(" << static_cast<int> (op) << ')';
+    }
+}
+
 void
 InsnTextWriter::write_calc (Insn *insn)
 {
   if (CalcInsn *calc_insn = dynamic_cast<CalcInsn *> (insn))
     {
-      std::ostream &out = fun_writer.output_stream ();
+      OutputBuffer &out = fun_writer.output_buffer ();
 
-      const std::vector<Reg *> &args = calc_insn->args ();
-      const std::vector<Reg *> &results = calc_insn->results ();
+      const Insn::RegVector &args = calc_insn->args ();
+      const Insn::RegVector &results = calc_insn->results ();
 
-      std::string op_name;
-      switch (calc_insn->op ())
-	{
-	case CalcInsn::Op::ADD: op_name = "+"; break;
-	case CalcInsn::Op::SUB: op_name = "-"; break;
-	case CalcInsn::Op::MUL: op_name = "*"; break;
-	case CalcInsn::Op::DIV: op_name = "/"; break;
-	case CalcInsn::Op::NEG: op_name = "-"; break;
-	default:
-	  op_name
-	    = "?("
-	    + std::to_string (static_cast<int> (calc_insn->op ()))
-	    + ")";
-	}
+      write_reg (results[0]);
+      out << " := ";
 
       // Binary or unary op
       if (args.size () == 2)
-	out << reg_name (results[0]) << " := "
-	    << reg_name (args[0])
-	    << ' ' << op_name << ' '
-	    << reg_name (args[1]);
+	{
+	  write_reg (args[0]);
+	  out << ' ';
+	  write_calc_op (out, calc_insn->op ());
+	  out << ' ';
+	  write_reg (args[1]);
+	}
       else
-	out << reg_name (results[0]) << " := "
-	    << op_name << ' '
-	    << reg_name (args[0]);
+	{
+	  write_calc_op (out, calc_insn->op ());
+	  out << ' ';
+	  write_reg (args[0]);
+	}
     }
   else
     invalid_write_method (insn, "CalcInsn");
@@ -157,10 +164,10 @@ InsnTextWriter::write_copy (Insn *insn)
 {
   if (CopyInsn *copy_insn = dynamic_cast<CopyInsn *> (insn))
     {
-      std::ostream &out = fun_writer.output_stream ();
-      out << reg_names (copy_insn->results ())
-	  << " := "
-	  << reg_names (copy_insn->args ());
+      OutputBuffer &out = fun_writer.output_buffer ();
+      write_regs (copy_insn->results ());
+      out << " := ";
+      write_regs (copy_insn->args ());
     }
   else
     invalid_write_method (insn, "CopyInsn");
@@ -171,14 +178,14 @@ InsnTextWriter::write_fun_arg (Insn *insn)
 {
   if (FunArgInsn *fun_arg_insn = dynamic_cast<FunArgInsn *> (insn))
     {
-      std::ostream &out = fun_writer.output_stream ();
+      OutputBuffer &out = fun_writer.output_buffer ();
 
-      const std::vector<Reg *> &results = fun_arg_insn->results ();
+      const Insn::RegVector &results = fun_arg_insn->results ();
 
       out << "fun_arg "
 	  << fun_arg_insn->arg_num ()
-	  << ' '
-	  << reg_name (results[0]);
+	  << ' ';
+      write_reg (results[0]);
     }
   else
     invalid_write_method (insn, "FunArgInsn");
@@ -189,14 +196,14 @@ InsnTextWriter::write_fun_result (Insn *insn)
 {
   if (FunResultInsn *fun_result_insn = dynamic_cast<FunResultInsn *> (insn))
     {
-      std::ostream &out = fun_writer.output_stream ();
+      OutputBuffer &out = fun_writer.output_buffer ();
 
-      const std::vector<Reg *> &args = fun_result_insn->args ();
+      const Insn::RegVector &args = fun_result_insn->args ();
 
       out << "fun_result "
 	  << fun_result_insn->result_num ()
-	  << ' '
-	  << reg_name (args[0]);
+	  << ' ';
+      write_reg (args[0]);
     }
   else
     invalid_write_method (insn, "FunResultInsn");
@@ -207,12 +214,12 @@ InsnTextWriter::write_phi_fun (Insn *insn)
 {
   if (PhiFunInsn *phi_fun_insn = dynamic_cast<PhiFunInsn *> (insn))
     {
-      std::ostream &out = fun_writer.output_stream ();
+      OutputBuffer &out = fun_writer.output_buffer ();
 
-      const std::vector<Reg *> &results = phi_fun_insn->results ();
+      const Insn::RegVector &results = phi_fun_insn->results ();
 
-      out << reg_name (results[0])
-	  << " := phi (";
+      write_reg (results[0]);
+      out << " := phi (";
 
       bool first_arg = true;
       for (auto inp : phi_fun_insn->inputs ())
@@ -222,9 +229,9 @@ InsnTextWriter::write_phi_fun (Insn *insn)
 	  else
 	    out << ", ";
 
-	  out << fun_writer.block_label (inp->block ())
-	      << ": "
-	      << reg_name (inp->args ()[0]);
+	  fun_writer.write_block_label (inp->block ());
+	  out << ": ";
+	  write_reg (inp->args ()[0]);
 	}
 
       out << ')';
@@ -238,16 +245,19 @@ InsnTextWriter::write_phi_fun_inp (Insn *insn)
 {
   if (PhiFunInpInsn *phi_fun_inp_insn = dynamic_cast<PhiFunInpInsn *> (insn))
     {
-      std::ostream &out = fun_writer.output_stream ();
+      OutputBuffer &out = fun_writer.output_buffer ();
 
-      const std::vector<Reg *> &args = phi_fun_inp_insn->args ();
+      const Insn::RegVector &args = phi_fun_inp_insn->args ();
 
       PhiFunInsn *phi_fun = phi_fun_inp_insn->phi_fun ();
 
-      out << "phi_fun_inp "
-	  << (phi_fun ? reg_name (phi_fun->results ()[0]) : "-")
-	  << " := "
-	  << reg_name (args[0]);
+      out << "phi_fun_inp ";
+      if (phi_fun)
+	write_reg (phi_fun->results ()[0]);
+      else
+	out << '-';
+      out << " := ";
+      write_reg (args[0]);
     }
   else
     invalid_write_method (insn, "PhiFunInpInsn");
@@ -266,19 +276,22 @@ std::unordered_map<std::type_index, InsnTextWriter::WriteMeth> InsnTextWriter::w
 void
 InsnTextWriter::setup_write_meths ()
 {
-  // If we've already done this setup, just return.
+  // Writers may be made on several threads at once, so make sure
+  // this setup is only done once.
   //
-  if (! write_meths.empty ())
-    return;
-
-  write_meths[typeid (CondBranchInsn)] = &InsnTextWriter::write_cond_branch;
-  write_meths[typeid (NopInsn)] = &InsnTextWriter::write_nop;
-  write_meths[typeid (CalcInsn)] = &InsnTextWriter::write_calc;
-  write_meths[typeid (CopyInsn)] = &InsnTextWriter::write_copy;
-  write_meths[typeid (FunArgInsn)] = &InsnTextWriter::write_fun_arg;
-  write_meths[typeid (FunResultInsn)] = &InsnTextWriter::write_fun_result;
-  write_meths[typeid (PhiFunInsn)] = &InsnTextWriter::write_phi_fun;
-  write_meths[typeid (PhiFunInpInsn)] = &InsnTextWriter::write_phi_fun_inp;
+  static std::once_flag setup_done;
+
+  std::call_once (setup_done, [] ()
+    {
+      write_meths[typeid (CondBranchInsn)] = &InsnTextWriter::write_cond_branch;
+      write_meths[typeid (NopInsn)] = &InsnTextWriter::write_nop;
+      write_meths[typeid (CalcInsn)] = &InsnTextWriter::write_calc;
+      write_meths[typeid (CopyInsn)] = &InsnTextWriter::write_copy;
+      write_meths[typeid (FunArgInsn)] = &InsnTextWriter::write_fun_arg;
+      write_meths[typeid (FunResultInsn)] = &InsnTextWriter::write_fun_result;
+      write_meths[typeid (PhiFunInsn)] = &InsnTextWriter::write_phi_fun;
+      write_meths[typeid (PhiFunInpInsn)] = &InsnTextWriter::write_phi_fun_inp;
+    });
 }
 
 
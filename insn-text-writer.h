@@ -14,8 +14,9 @@
 #include <unordered_map>
 #include <vector>
 
+#include "insn.h"
+
 
-class Insn;
 class FunTextWriter;
 
 
@@ -34,16 +35,15 @@ public:
 
 private:
 
-  // Return a string representation of the register REG
+  // Write a text representation of the register REG.
   //
-  std::string reg_name (Reg *reg) const;
+  void write_reg (Reg *reg);
 
-  // Return a string representation of the registers in the vector
-  // REGS, starting from index START_IDX (default 0).
+  // Write text representations of the registers in the vector REGS,
+  // starting from index START_IDX (default 0), separated by a comma
+  // and space.
   //
-  std::string reg_names (const std::vector<Reg *> &regs,
-			 unsigned start_idx = 0)
-    const;
+  void write_regs (const Insn::RegVector &regs, unsigned start_idx = 0);
 
 
   // Text writer for the function we're associated with.
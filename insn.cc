@@ -33,7 +33,8 @@ Insn::Insn (BB *block,
 Insn::Insn (BB *block,
 	    const std::vector<Reg *> &args,
 	    const std::vector<Reg *> &results)
-  : _args (args), _results (results)
+  : _args (args.begin (), args.end ()),
+    _results (results.begin (), results.end ())
 {
   for (auto arg : _args)
     if (arg)
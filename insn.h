@@ -12,6 +12,8 @@
 #include <vector>
 #include <initializer_list>
 
+#include "mem-account.h"
+
 
 class BB;
 class Reg;
@@ -23,6 +25,21 @@ class Insn
 {
 public:
 
+  // A vector of argument or result registers of an instruction; its
+  // storage is charged to the Insn account.
+  //
+  typedef std::vector<Reg *, MemAccountAllocator<Reg *, Insn>> RegVector;
+
+  // Return the account to which storage for instruction arguments and
+  // results is charged.  Instructions themselves are charged to the
+  // accounts of their subclasses.
+  //
+  static MemAccount &mem_account ()
+  {
+    static MemAccount account ("Insn");
+    return account;
+  }
+
   virtual ~Insn ();
 
 
@@ -60,12 +77,12 @@ public:
   // Return a reference to a read-only vector of arguments read by
   // this instruction.  For many insns, this is empty.
   //
-  const std::vector<Reg *> &args () const { return _args; }
+  const RegVector &args () const { return _args; }
 
   // Return a reference to a read-only vector of results written by
   // this instruction.  For many insns, this is empty.
   //
-  const std::vector<Reg *> &results () const { return _results; }
+  const RegVector &results () const { return _results; }
 
   // Change each use of the argument register FROM in this instruction
   // to TO.  TO may be NULL.  This will update FROM and TO accordingly
@@ -128,8 +145,8 @@ private:
 
   // Arguments to, and results from, this calculation insn.
   //
-  std::vector<Reg *> _args;
-  std::vector<Reg *> _results;
+  RegVector _args;
+  RegVector _results;
 
 
   // The block this instruction is in.
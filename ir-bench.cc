@@ -0,0 +1,637 @@
+// ir-bench.cc -- Scaling benchmarks for core IR algorithms
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "output-buffer.h"
+#include "ir-generator.h"
+#include "mem-account.h"
+
+#include "fun.h"
+#include "prog.h"
+#include "file-contents.h"
+#include "file-src-context.h"
+#include "src-file-input.h"
+#include "prog-text-reader.h"
+#include "prog-text-writer.h"
+
+
+// State for one repetition of a benchmark.
+//
+struct Sample
+{
+  Sample (const std::string &text) : text (text) { }
+
+  // Text of the input program.
+  //
+  const std::string &text;
+
+  // Input for reading TEXT.
+  //
+  std::unique_ptr<FileSrcContext> src_context;
+  std::unique_ptr<SrcFileInput> inp;
+
+  // The program being operated on.
+  //
+  std::unique_ptr<Prog> prog;
+};
+
+
+// Read SAMPLE's program from its text.
+//
+static void
+read_prog (Sample &sample)
+{
+  sample.src_context.reset (new FileSrcContext);
+  sample.inp.reset (new SrcFileInput (std::make_unique<FileContents>
+				        (sample.text.data (),
+					 sample.text.size ()),
+				      "<generated>", *sample.src_context));
+
+  ProgTextReader reader (*sample.inp);
+  sample.prog.reset (reader.read ());
+}
+
+// Call FUN_OP on every function in SAMPLE's program.
+//
+template<typename Op>
+static void
+for_each_fun (Sample &sample, Op fun_op)
+{
+  for (auto &entry : sample.prog->functions ())
+    fun_op (entry.second);
+}
+
+
+// Do what compcat's optimizer does before converting to SSA form.
+//
+static void
+prepare_for_ssa (Sample &sample)
+{
+  read_prog (sample);
+  for_each_fun (sample, [] (Fun *fun)
+    {
+      fun->combine_blocks ();
+      fun->remove_unreachable ();
+      fun->update_dominators ();
+      fun->update_post_dominators ();
+    });
+}
+
+// Do what compcat's optimizer does before propagating copies.
+//
+static void
+prepare_for_copy_prop (Sample &sample)
+{
+  prepare_for_ssa (sample);
+  for_each_fun (sample, [] (Fun *fun) { fun->convert_to_ssa_form (); });
+}
+
+// Do what compcat's optimizer does before converting from SSA form.
+//
+static void
+prepare_for_ssa_exit (Sample &sample)
+{
+  prepare_for_copy_prop (sample);
+  for_each_fun (sample, [] (Fun *fun) { fun->propagate_through_copies (); });
+}
+
+
+// Somewhere to put results, so the compiler can't discard the work
+// done to compute them.
+//
+static volatile std::size_t result_sink;
+
+
+// A benchmark of a single operation.  SETUP does any preparation
+// needed before each repetition, which isn't timed, and RUN does the
+// operation being timed.
+//
+struct Benchmark
+{
+  const char *name;
+  void (*setup) (Sample &sample);
+  void (*run) (Sample &sample);
+};
+
+static const Benchmark benchmarks[] = {
+  { "calc_dominators", read_prog, [] (Sample &sample)
+    {
+      for_each_fun (sample, [] (Fun *fun)
+	{
+	  BB::calc_dominators (fun->blocks ());
+	});
+    } },
+  { "calc_post_dominators", read_prog, [] (Sample &sample)
+    {
+      for_each_fun (sample, [] (Fun *fun)
+	{
+	  BB::calc_post_dominators (fun->blocks ());
+	});
+    } },
+  { "dominance_frontier",
+    [] (Sample &sample)
+    {
+      read_prog (sample);
+      for_each_fun (sample, [] (Fun *fun) { fun->update_dominators (); });
+    },
+    [] (Sample &sample)
+    {
+      for_each_fun (sample, [] (Fun *fun)
+	{
+	  for (auto block : fun->blocks ())
+	    result_sink += block->dominance_frontier ().size ();
+	});
+    } },
+  { "convert_to_ssa_form", prepare_for_ssa, [] (Sample &sample)
+    {
+      for_each_fun (sample, [] (Fun *fun) { fun->convert_to_ssa_form (); });
+    } },
+  { "propagate_through_copies", prepare_for_copy_prop, [] (Sample &sample)
+    {
+      for_each_fun (sample, [] (Fun *fun)
+	{
+	  fun->propagate_through_copies ();
+	});
+    } },
+  { "convert_from_ssa_form", prepare_for_ssa_exit, [] (Sample &sample)
+    {
+      for_each_fun (sample, [] (Fun *fun) { fun->convert_from_ssa_form (); });
+    } },
+  { "combine_blocks", read_prog, [] (Sample &sample)
+    {
+      for_each_fun (sample, [] (Fun *fun) { fun->combine_blocks (); });
+    } },
+  { "ProgTextReader::read",
+    [] (Sample &) { },
+    read_prog },
+  { "ProgTextWriter::write", read_prog, [] (Sample &sample)
+    {
+      ProgTextWriter writer;
+      writer.write (sample.prog.get ());
+      result_sink += writer.out ().contents ().size ();
+    } },
+};
+
+
+// A family of generated inputs, with a particular flow graph shape.
+//
+struct Family
+{
+  const char *name;
+  void (*adjust) (IrGenerator::Params &params);
+};
+
+static const Family families[] = {
+  { "mixed", [] (IrGenerator::Params &) { } },
+  { "loops", [] (IrGenerator::Params &params)
+    {
+      params.loop_prob = 0.5;
+      params.max_loop_depth = 8;
+      params.diamond_prob = 0.1;
+    } },
+  { "diamonds", [] (IrGenerator::Params &params)
+    {
+      params.loop_prob = 0.05;
+      params.diamond_prob = 0.6;
+    } },
+  { "ladders", [] (IrGenerator::Params &params)
+    {
+      params.ladder_prob = 0.5;
+    } },
+  { "irreducible", [] (IrGenerator::Params &params)
+    {
+      params.irreducible_prob = 0.1;
+    } },
+};
+
+
+// Options controlling which benchmarks are run, and how.
+//
+struct Options
+{
+  std::vector<unsigned> sizes { 1000, 2000, 4000, 8000, 16000 };
+  unsigned warmup = 2;
+  unsigned reps = 9;
+  std::uint64_t seed = 1;
+
+  // If non-empty, only benchmarks / families with these names are
+  // run.
+  //
+  std::vector<std::string> benchmarks, families;
+
+  // If positive, a scaling slope above this is a failure.
+  //
+  double max_slope = 0;
+
+  // Sizes at which a single repetition, including setup, would take
+  // longer than this many seconds (extrapolating from smaller sizes)
+  // are skipped, so badly scaling operations don't take forever.
+  //
+  double max_time = 1;
+};
+
+
+// Split the comma-separated list LIST.
+//
+static std::vector<std::string>
+split_list (const std::string &list)
+{
+  std::vector<std::string> elems;
+  std::istringstream in (list);
+  std::string elem;
+  while (std::getline (in, elem, ','))
+    if (! elem.empty ())
+      elems.push_back (elem);
+  return elems;
+}
+
+// Return true if NAME is in SELECTED, or SELECTED is empty.
+//
+static bool
+selected (const std::vector<std::string> &selected, const char *name)
+{
+  return (selected.empty ()
+	  || std::find (selected.begin (), selected.end (), name)
+	     != selected.end ());
+}
+
+
+// Return the text of a program generated for FAMILY, with NUM_BLOCKS
+// blocks, using seed SEED.
+//
+static std::string
+gen_text (const Family &family, unsigned num_blocks, std::uint64_t seed)
+{
+  IrGenerator::Params params;
+  params.seed = seed;
+  params.num_blocks = num_blocks;
+  family.adjust (params);
+
+  OutputBuffer out;
+  IrGenerator gen (params, out);
+  gen.gen ();
+
+  return std::string (out.contents ());
+}
+
+
+// Memory used by one repetition of a benchmark, if memory accounting
+// is enabled.
+//
+struct MemUse
+{
+  // Bytes held after setup, and the high-water mark and net change
+  // in bytes during the timed part.
+  //
+  std::int64_t setup = 0, peak = 0, net = 0;
+};
+
+
+// Run BENCHMARK once on TEXT, and return the time taken by the timed
+// part, in seconds.  The total time, including setup and cleanup, is
+// stored in TOTAL, and if memory accounting is enabled, the memory
+// used is stored in MEM.
+//
+static double
+run_once (const Benchmark &benchmark, const std::string &text, double &total,
+	  MemUse &mem)
+{
+  auto setup_start = std::chrono::steady_clock::now ();
+
+  MemAccount::Usage setup_beg, run_beg, run_end;
+
+  double secs;
+  {
+    Sample sample (text);
+
+    MemAccount::read (setup_beg);
+    benchmark.setup (sample);
+
+    std::int64_t outer_peak = MemAccount::start_peak ();
+    MemAccount::read (run_beg);
+
+    auto start = std::chrono::steady_clock::now ();
+    benchmark.run (sample);
+    auto end = std::chrono::steady_clock::now ();
+
+    MemAccount::read (run_end);
+    MemAccount::end_peak (outer_peak);
+
+    secs = std::chrono::duration<double> (end - start).count ();
+  }
+
+  mem.setup = run_beg.total_bytes - setup_beg.total_bytes;
+  mem.peak = run_end.peak_bytes - run_beg.total_bytes;
+  mem.net = run_end.total_bytes - run_beg.total_bytes;
+
+  auto cleanup_end = std::chrono::steady_clock::now ();
+  total = std::chrono::duration<double> (cleanup_end - setup_start).count ();
+
+  return secs;
+}
+
+
+// Return a printable form of the time SECS.
+//
+static std::string
+format_time (double secs)
+{
+  static const char *units[] = { "s", "ms", "us", "ns" };
+
+  unsigned unit = 0;
+  while (secs < 1 && unit + 1 < sizeof units / sizeof units[0])
+    {
+      secs *= 1000;
+      unit++;
+    }
+
+  std::ostringstream out;
+  out << std::fixed << std::setprecision (secs < 10 ? 2 : 1)
+      << secs << ' ' << units[unit];
+  return out.str ();
+}
+
+
+// Return the least-squares slope of log(Y) against log(X), or NAN if
+// there aren't enough points.
+//
+static double
+log_log_slope (const std::vector<double> &xs, const std::vector<double> &ys)
+{
+  unsigned n = 0;
+  double sum_x = 0, sum_y = 0, sum_xx = 0, sum_xy = 0;
+
+  for (unsigned i = 0; i < xs.size (); i++)
+    if (xs[i] > 0 && ys[i] > 0)
+      {
+	double x = std::log (xs[i]), y = std::log (ys[i]);
+	sum_x += x;
+	sum_y += y;
+	sum_xx += x * x;
+	sum_xy += x * y;
+	n++;
+      }
+
+  double denom = n * sum_xx - sum_x * sum_x;
+  if (n < 2 || denom == 0)
+    return NAN;
+
+  return (n * sum_xy - sum_x * sum_y) / denom;
+}
+
+
+// Run BENCHMARK over FAMILY at every size in OPTS, and print the
+// results.  Return false if the scaling slope is above the limit in
+// OPTS.
+//
+static bool
+run_series (const Benchmark &benchmark, const Family &family,
+	    const Options &opts)
+{
+  std::cout << benchmark.name << " (" << family.name << ")\n"
+	    << std::setw (12) << "blocks"
+	    << std::setw (14) << "median"
+	    << std::setw (14) << "p95";
+  if (MemAccount::enabled ())
+    std::cout << std::setw (10) << "IR mem"
+	      << std::setw (10) << "peak" << std::setw (10) << "net";
+  std::cout << '\n';
+
+  std::vector<double> sizes, medians;
+
+  // Size and longest repetition time for the previous two sizes, for
+  // guessing how long the next will take.
+  //
+  double prev_size = 0, prev_total = 0;
+  double prev_prev_size = 0, prev_prev_total = 0;
+
+  for (unsigned size : opts.sizes)
+    {
+      if (prev_total > 0)
+	{
+	  // Assume at least linear growth, or the growth seen between
+	  // the previous two sizes if that's worse.
+	  //
+	  double growth = 1;
+	  if (prev_prev_total > 0 && prev_size > prev_prev_size)
+	    growth = std::max (growth,
+			       std::log (prev_total / prev_prev_total)
+			       / std::log (prev_size / prev_prev_size));
+
+	  double guess = prev_total * std::pow (size / prev_size, growth);
+	  if (guess > opts.max_time)
+	    {
+	      std::cout << std::setw (12) << size
+			<< "  (larger sizes skipped, would take about "
+			<< format_time (guess) << " each)\n";
+	      break;
+	    }
+	}
+
+      std::string text = gen_text (family, size, opts.seed);
+      double total, max_total = 0;
+
+      // Memory use doesn't vary between repetitions, so the last one's
+      // is reported.
+      //
+      MemUse mem;
+
+      for (unsigned i = 0; i < opts.warmup; i++)
+	{
+	  run_once (benchmark, text, total, mem);
+	  max_total = std::max (max_total, total);
+	}
+
+      std::vector<double> times;
+      for (unsigned i = 0; i < opts.reps; i++)
+	{
+	  times.push_back (run_once (benchmark, text, total, mem));
+	  max_total = std::max (max_total, total);
+	}
+
+      std::sort (times.begin (), times.end ());
+
+      unsigned n = times.size ();
+      double median = (times[(n - 1) / 2] + times[n / 2]) / 2;
+      double p95 = times[std::max (unsigned (std::ceil (0.95 * n)), 1U) - 1];
+
+      std::cout << std::setw (12) << size
+		<< std::setw (14) << format_time (median)
+		<< std::setw (14) << format_time (p95);
+      if (MemAccount::enabled ())
+	std::cout << std::setw (10) << MemAccount::format_bytes (mem.setup)
+		  << std::setw (10) << MemAccount::format_bytes (mem.peak)
+		  << std::setw (10) << MemAccount::format_bytes (mem.net);
+      std::cout << '\n';
+
+      sizes.push_back (size);
+      medians.push_back (median);
+
+      prev_prev_size = prev_size;
+      prev_prev_total = prev_total;
+      prev_size = size;
+      prev_total = max_total;
+    }
+
+  double slope = log_log_slope (sizes, medians);
+  bool ok = ! (opts.max_slope > 0 && slope > opts.max_slope);
+
+  std::cout << std::setw (12) << "slope"
+	    << std::setw (14) << std::fixed << std::setprecision (2) << slope;
+  if (! ok)
+    std::cout << "  (above limit " << opts.max_slope << ")";
+  else if (slope >= 1.5)
+    std::cout << "  (superlinear)";
+  std::cout << "\n\n";
+
+  return ok;
+}
+
+
+static int
+usage (const char *prog_name)
+{
+  std::cerr << "Usage: " << prog_name << " [OPTION...]\n"
+	    << "Time core IR operations on generated inputs of increasing size.\n"
+	    << "Options:\n"
+	    << "  --sizes N,...        Block counts (default 1000,2000,4000,8000,16000)\n"
+	    << "  --reps N             Timed repetitions per size (default 9)\n"
+	    << "  --warmup N           Untimed repetitions per size (default 2)\n"
+	    << "  --seed N             Random seed for generated inputs (default 1)\n"
+	    << "  --benchmarks NAME,...  Only run these benchmarks\n"
+	    << "  --families NAME,...  Only use these input families\n"
+	    << "  --max-slope X        Fail if any log-log slope is above X\n"
+	    << "  --max-time SECS      Skip sizes where a repetition would take\n"
+	    << "                       longer than SECS (default 1)\n"
+	    << "  --mem                Also report memory: the IR's size after setup,\n"
+	    << "                       and the high-water mark and net change during\n"
+	    << "                       the timed operation\n"
+	    << "  --list               List benchmarks and families\n";
+  return 1;
+}
+
+
+int main (int argc, const char *const *argv)
+{
+  Options opts;
+
+  for (int i = 1; i < argc; i++)
+    {
+      std::string arg (argv[i]);
+
+      if (arg == "--list")
+	{
+	  std::cout << "Benchmarks:";
+	  for (auto &benchmark : benchmarks)
+	    std::cout << ' ' << benchmark.name;
+	  std::cout << "\nFamilies:";
+	  for (auto &family : families)
+	    std::cout << ' ' << family.name;
+	  std::cout << '\n';
+	  return 0;
+	}
+
+      if (arg == "--mem")
+	{
+	  MemAccount::enable ();
+	  continue;
+	}
+
+      if (i + 1 == argc)
+	return usage (argv[0]);
+
+      const char *val = argv[++i];
+      char *end;
+      unsigned long num = std::strtoul (val, &end, 10);
+      bool num_ok = (*val && *end == '\0');
+
+      if (arg == "--sizes")
+	{
+	  opts.sizes.clear ();
+	  for (auto &size : split_list (val))
+	    {
+	      num = std::strtoul (size.c_str (), &end, 10);
+	      if (*end != '\0' || num == 0)
+		return usage (argv[0]);
+	      opts.sizes.push_back (num);
+	    }
+	  if (opts.sizes.empty ())
+	    return usage (argv[0]);
+	}
+      else if (arg == "--reps" && num_ok && num > 0)
+	opts.reps = num;
+      else if (arg == "--warmup" && num_ok)
+	opts.warmup = num;
+      else if (arg == "--seed" && num_ok)
+	opts.seed = num;
+      else if (arg == "--benchmarks")
+	opts.benchmarks = split_list (val);
+      else if (arg == "--families")
+	opts.families = split_list (val);
+      else if (arg == "--max-time")
+	{
+	  opts.max_time = std::strtod (val, &end);
+	  if (! *val || *end != '\0' || opts.max_time <= 0)
+	    return usage (argv[0]);
+	}
+      else if (arg == "--max-slope")
+	{
+	  opts.max_slope = std::strtod (val, &end);
+	  if (! *val || *end != '\0' || opts.max_slope <= 0)
+	    return usage (argv[0]);
+	}
+      else
+	return usage (argv[0]);
+    }
+
+  for (auto &name : opts.benchmarks)
+    if (std::none_of (std::begin (benchmarks), std::end (benchmarks),
+		      [&] (const Benchmark &b) { return name == b.name; }))
+      {
+	std::cerr << argv[0] << ": Unknown benchmark \"" << name << "\"\n";
+	return 1;
+      }
+  for (auto &name : opts.families)
+    if (std::none_of (std::begin (families), std::end (families),
+		      [&] (const Family &f) { return name == f.name; }))
+      {
+	std::cerr << argv[0] << ": Unknown family \"" << name << "\"\n";
+	return 1;
+      }
+
+  bool ok = true;
+
+  try
+    {
+      for (auto &benchmark : benchmarks)
+	if (selected (opts.benchmarks, benchmark.name))
+	  for (auto &family : families)
+	    if (selected (opts.families, family.name))
+	      if (! run_series (benchmark, family, opts))
+		ok = false;
+    }
+  catch (std::runtime_error &err)
+    {
+      std::cerr << err.what () << '\n';
+      return 1;
+    }
+
+  return ok ? 0 : 1;
+}
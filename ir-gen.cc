@@ -0,0 +1,102 @@
+// ir-gen.cc -- Write synthetic text-format IR
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include <unistd.h>
+
+#include "output-buffer.h"
+#include "ir-generator.h"
+
+
+static int
+usage (const char *prog_name)
+{
+  std::cerr << "Usage: " << prog_name << " [OPTION...]\n"
+	    << "Write random text-format IR to standard output.\n"
+	    << "Options:\n"
+	    << "  --seed N             Random seed (default 1)\n"
+	    << "  --funs N             Number of functions (default 1)\n"
+	    << "  --blocks N           Blocks per function (default 100)\n"
+	    << "  --regs N             Registers per function (default 16)\n"
+	    << "  --insns N            Average instructions per block (default 4)\n"
+	    << "  --loop-depth N       Maximum loop nesting depth (default 2)\n"
+	    << "  --loops P            Probability of a loop (default 0.15)\n"
+	    << "  --irreducible P      Probability of an irreducible region (default 0)\n"
+	    << "  --ladders P          Probability of a ladder chain (default 0.05)\n"
+	    << "  --diamonds P         Probability of a diamond (default 0.2)\n"
+	    << "  --literals P         Probability an operand is a literal (default 0.2)\n"
+	    << "  --copies P           Probability an instruction is a copy (default 0.2)\n";
+  return 1;
+}
+
+
+int main (int argc, const char *const *argv)
+{
+  IrGenerator::Params params;
+
+  for (int i = 1; i < argc; i++)
+    {
+      std::string arg (argv[i]);
+
+      if (i + 1 == argc)
+	return usage (argv[0]);
+
+      const char *val = argv[++i];
+      char *end;
+      unsigned long num = std::strtoul (val, &end, 10);
+      bool num_ok = (*val && *end == '\0');
+      double prob = std::strtod (val, &end);
+      bool prob_ok = (*val && *end == '\0' && prob >= 0 && prob <= 1);
+
+      if (arg == "--seed" && num_ok)
+	params.seed = num;
+      else if (arg == "--funs" && num_ok)
+	params.num_funs = num;
+      else if (arg == "--blocks" && num_ok && num > 0)
+	params.num_blocks = num;
+      else if (arg == "--regs" && num_ok && num > 0)
+	params.num_regs = num;
+      else if (arg == "--insns" && num_ok)
+	params.insns_per_block = num;
+      else if (arg == "--loop-depth" && num_ok)
+	params.max_loop_depth = num;
+      else if (arg == "--loops" && prob_ok)
+	params.loop_prob = prob;
+      else if (arg == "--irreducible" && prob_ok)
+	params.irreducible_prob = prob;
+      else if (arg == "--ladders" && prob_ok)
+	params.ladder_prob = prob;
+      else if (arg == "--diamonds" && prob_ok)
+	params.diamond_prob = prob;
+      else if (arg == "--literals" && prob_ok)
+	params.literal_prob = prob;
+      else if (arg == "--copies" && prob_ok)
+	params.copy_prob = prob;
+      else
+	return usage (argv[0]);
+    }
+
+  try
+    {
+      OutputBuffer out (STDOUT_FILENO);
+      IrGenerator gen (params, out);
+      gen.gen ();
+      out.flush ();
+    }
+  catch (std::runtime_error &err)
+    {
+      std::cerr << err.what () << '\n';
+      return 1;
+    }
+
+  return 0;
+}
@@ -0,0 +1,262 @@
+// ir-generator.cc -- Generator for synthetic text-format IR
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#include <algorithm>
+
+#include "output-buffer.h"
+
+#include "ir-generator.h"
+
+
+// Generate every function.
+//
+void
+IrGenerator::gen ()
+{
+  for (unsigned fun_num = 0; fun_num < _params.num_funs; fun_num++)
+    gen_fun (fun_num);
+}
+
+
+std::uint64_t
+IrGenerator::rand ()
+{
+  // xorshift64*
+  _rng_state ^= _rng_state >> 12;
+  _rng_state ^= _rng_state << 25;
+  _rng_state ^= _rng_state >> 27;
+  return _rng_state * 0x2545f4914f6cdd1dULL;
+}
+
+
+void
+IrGenerator::gen_fun (unsigned fun_num)
+{
+  _out << "fun f" << fun_num << "\n{\n";
+
+  for (unsigned reg = 0; reg < _params.num_regs; reg++)
+    _out << "   reg r" << reg << '\n';
+
+  _out << "   fun_arg 0 r0\n";
+
+  _next_label = 1;
+  _blocks_left = _params.num_blocks;
+
+  // Give every register a value before it's used.
+  //
+  start_block (new_label ());
+  for (unsigned reg = 1; reg < _params.num_regs; reg++)
+    _out << "   r" << reg << " := " << rand_below (100) << '\n';
+
+  gen_region (0, _blocks_left);
+
+  _out << "   fun_result 0 r" << rand_below (_params.num_regs) << "\n}\n\n";
+}
+
+// Start a new block with label LABEL.  If there's a current block, it
+// falls through to the new one.
+//
+void
+IrGenerator::start_block (unsigned label)
+{
+  _out << '<' << label << ">\n";
+  _block_open = true;
+
+  if (_blocks_left > 0)
+    _blocks_left--;
+}
+
+// End the current block with a conditional branch to LABEL.
+//
+void
+IrGenerator::cond_branch (unsigned label)
+{
+  ensure_block ();
+  _out << "   if (";
+  write_reg ();
+  _out << ") goto <" << label << ">\n";
+  _block_open = false;
+}
+
+// End the current block with an unconditional branch to LABEL.
+//
+void
+IrGenerator::branch (unsigned label)
+{
+  ensure_block ();
+  _out << "   goto <" << label << ">\n";
+  _block_open = false;
+}
+
+// Write a random register name.
+//
+void
+IrGenerator::write_reg ()
+{
+  _out << 'r' << rand_below (_params.num_regs);
+}
+
+// Write a random operand, which may be a literal.
+//
+void
+IrGenerator::write_operand ()
+{
+  if (chance (_params.literal_prob))
+    _out << rand_below (100);
+  else
+    write_reg ();
+}
+
+// Add a random number of random instructions to the current block.
+//
+void
+IrGenerator::gen_insns ()
+{
+  ensure_block ();
+
+  unsigned avg = _params.insns_per_block;
+  unsigned count = avg ? 1 + rand_below (2 * avg - 1) : 0;
+
+  for (unsigned i = 0; i < count; i++)
+    {
+      _out << "   ";
+      write_reg ();
+      _out << " := ";
+
+      if (chance (_params.copy_prob))
+	write_operand ();
+      else if (chance (0.15))
+	{
+	  _out << "- ";
+	  write_reg ();
+	}
+      else
+	{
+	  static const char ops[] = { '+', '-', '*' };
+	  write_reg ();
+	  _out << ' ' << ops[rand_below (sizeof ops)] << ' ';
+	  write_operand ();
+	}
+
+      _out << '\n';
+    }
+}
+
+
+// Generate a sequence of constructs using about BUDGET blocks, at loop
+// nesting depth DEPTH.
+//
+void
+IrGenerator::gen_region (unsigned depth, unsigned budget)
+{
+  unsigned stop = _blocks_left > budget ? _blocks_left - budget : 0;
+
+  while (_blocks_left > stop)
+    {
+      unsigned left = _blocks_left - stop;
+
+      // Nested constructs get at most half of what's left, which
+      // keeps recursion depth logarithmic.
+      //
+      unsigned sub_budget = 1 + rand_below (std::max (left / 2, 1U));
+
+      if (left >= 3 && depth < _params.max_loop_depth
+	  && chance (_params.loop_prob))
+	gen_loop (depth, sub_budget);
+      else if (left >= 3 && chance (_params.irreducible_prob))
+	gen_irreducible ();
+      else if (left >= 3 && chance (_params.ladder_prob))
+	gen_ladder (std::min (sub_budget, 16U));
+      else if (left >= 4 && chance (_params.diamond_prob))
+	gen_diamond (depth, sub_budget);
+      else
+	{
+	  // Straight-line block.
+	  //
+	  start_block (new_label ());
+	  gen_insns ();
+	}
+    }
+}
+
+// A loop: a header, a body of about BUDGET blocks, and a latch
+// branching back to the header.
+//
+void
+IrGenerator::gen_loop (unsigned depth, unsigned budget)
+{
+  unsigned header = new_label ();
+  start_block (header);
+  gen_insns ();
+
+  gen_region (depth + 1, budget);
+
+  gen_insns ();
+  cond_branch (header);
+}
+
+// An if-then-else diamond, with about BUDGET blocks split between the
+// two arms.
+//
+void
+IrGenerator::gen_diamond (unsigned depth, unsigned budget)
+{
+  unsigned else_label = new_label (), join_label = new_label ();
+
+  gen_insns ();
+  cond_branch (else_label);
+
+  unsigned then_budget = budget / 2;
+  gen_region (depth, std::max (then_budget, 1U));
+  branch (join_label);
+
+  start_block (else_label);
+  gen_insns ();
+  gen_region (depth, budget - then_budget);
+
+  start_block (join_label);
+  gen_insns ();
+}
+
+// A ladder: a chain of RUNGS blocks, each of which may branch to a
+// common exit.
+//
+void
+IrGenerator::gen_ladder (unsigned rungs)
+{
+  unsigned exit_label = new_label ();
+
+  for (unsigned rung = 0; rung < rungs; rung++)
+    {
+      start_block (new_label ());
+      gen_insns ();
+      cond_branch (exit_label);
+    }
+
+  start_block (exit_label);
+  gen_insns ();
+}
+
+// An irreducible region: a cycle of two blocks, each of which can be
+// entered from outside the cycle.
+//
+void
+IrGenerator::gen_irreducible ()
+{
+  unsigned first = new_label (), second = new_label ();
+
+  gen_insns ();
+  cond_branch (second);
+
+  start_block (first);
+  gen_insns ();
+
+  start_block (second);
+  gen_insns ();
+  cond_branch (first);
+}
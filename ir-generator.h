@@ -0,0 +1,195 @@
+// ir-generator.h -- Generator for synthetic text-format IR
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#ifndef __IR_GENERATOR_H__
+#define __IR_GENERATOR_H__
+
+#include <cstdint>
+
+
+class OutputBuffer;
+
+
+// A generator for random IR functions, written in text form.
+//
+// Control flow is built from nested constructs, each of which has a
+// single entry and a single exit, except for irreducible regions.
+// Labels are allocated as needed, so branches can refer to blocks
+// which haven't been emitted yet.  The reader doesn't care about
+// label numbering, so the generated text can be emitted in a single
+// pass, without holding anything in memory.
+//
+// All random choices come from a simple xorshift generator, so the
+// same seed gives the same output everywhere.
+//
+class IrGenerator
+{
+public:
+
+  // Parameters controlling the generated IR.
+  //
+  struct Params
+  {
+    std::uint64_t seed = 1;
+
+    unsigned num_funs = 1;
+
+    // Number of blocks in each function.
+    //
+    unsigned num_blocks = 100;
+
+    // Number of registers in each function.
+    //
+    unsigned num_regs = 16;
+
+    // Average number of instructions in each block.
+    //
+    unsigned insns_per_block = 4;
+
+    // Maximum nesting depth of loops.
+    //
+    unsigned max_loop_depth = 2;
+
+    // Probability that a construct is a loop (if the nesting depth
+    // allows), an irreducible region, a ladder, or a diamond;
+    // anything else is a straight-line block.
+    //
+    double loop_prob = 0.15;
+    double irreducible_prob = 0;
+    double ladder_prob = 0.05;
+    double diamond_prob = 0.2;
+
+    // Probability that an instruction operand is a literal rather
+    // than a register.
+    //
+    double literal_prob = 0.2;
+
+    // Probability that an instruction is a copy rather than a
+    // calculation.
+    //
+    double copy_prob = 0.2;
+  };
+
+
+  // Make a generator which writes IR described by PARAMS to OUT.
+  //
+  IrGenerator (const Params &params, OutputBuffer &out)
+    : _params (params), _out (out), _rng_state (params.seed * 2 + 1)
+  { }
+
+  // Generate every function.
+  //
+  void gen ();
+
+
+private:
+
+  // Random numbers.
+
+  std::uint64_t rand ();
+
+  // Return a random number in [0, LIMIT).
+  //
+  unsigned rand_below (unsigned limit)
+  {
+    return limit ? rand () % limit : 0;
+  }
+
+  // Return true with probability PROB.
+  //
+  bool chance (double prob)
+  {
+    return (rand () >> 11) * (1.0 / (std::uint64_t (1) << 53)) < prob;
+  }
+
+
+  // Emitting.
+
+  void gen_fun (unsigned fun_num);
+
+  unsigned new_label () { return _next_label++; }
+
+  // Start a new block with label LABEL.  If there's a current block,
+  // it falls through to the new one.
+  //
+  void start_block (unsigned label);
+
+  // Make sure there's a current block to add instructions to.
+  //
+  void ensure_block ()
+  {
+    if (! _block_open)
+      start_block (new_label ());
+  }
+
+  // End the current block with a conditional branch to LABEL.
+  //
+  void cond_branch (unsigned label);
+
+  // End the current block with an unconditional branch to LABEL.
+  //
+  void branch (unsigned label);
+
+  // Write a random register name.
+  //
+  void write_reg ();
+
+  // Write a random operand, which may be a literal.
+  //
+  void write_operand ();
+
+  // Add a random number of random instructions to the current block.
+  //
+  void gen_insns ();
+
+
+  // Generate a sequence of constructs using about BUDGET blocks, at
+  // loop nesting depth DEPTH.
+  //
+  void gen_region (unsigned depth, unsigned budget);
+
+  // A loop: a header, a body of about BUDGET blocks, and a latch
+  // branching back to the header.
+  //
+  void gen_loop (unsigned depth, unsigned budget);
+
+  // An if-then-else diamond, with about BUDGET blocks split between
+  // the two arms.
+  //
+  void gen_diamond (unsigned depth, unsigned budget);
+
+  // A ladder: a chain of RUNGS blocks, each of which may branch to a
+  // common exit.
+  //
+  void gen_ladder (unsigned rungs);
+
+  // An irreducible region: a cycle of two blocks, each of which can
+  // be entered from outside the cycle.
+  //
+  void gen_irreducible ();
+
+
+  const Params &_params;
+  OutputBuffer &_out;
+
+  std::uint64_t _rng_state;
+
+  unsigned _next_label = 1;
+
+  // Number of blocks still to be emitted in the current function.
+  //
+  unsigned _blocks_left = 0;
+
+  // True if there's a current block which instructions can be added
+  // to, or which can fall through to the next block.
+  //
+  bool _block_open = false;
+};
+
+
+#endif // __IR_GENERATOR_H__
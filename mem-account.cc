@@ -0,0 +1,435 @@
+// mem-account.cc -- Memory allocation accounting
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include <malloc.h>
+
+#include "mem-account.h"
+
+
+std::atomic<bool> MemAccount::_enabled (false);
+
+
+namespace {
+
+// All accounts, indexed by account number.
+//
+std::atomic<unsigned> next_account_num (0);
+std::atomic<MemAccount *> accounts[MemAccount::MAX_ACCOUNTS];
+
+// The calling thread's net memory use.  This is only ever touched by
+// its own thread, so needs no locking.
+//
+thread_local MemAccount::Usage thread_usage;
+
+// If non-zero, allocations by the calling thread aren't accounted.
+//
+thread_local unsigned pause_depth = 0;
+
+
+// The account for allocations made through the global operator new.
+//
+MemAccount &
+other_account ()
+{
+  static MemAccount account ("other");
+  return account;
+}
+
+
+// Raise MAX to VAL, if it's currently smaller.
+//
+void
+raise_max (std::atomic<std::int64_t> &max, std::int64_t val)
+{
+  std::int64_t cur = max.load (std::memory_order_relaxed);
+  while (cur < val
+	 && ! max.compare_exchange_weak (cur, val, std::memory_order_relaxed))
+    ;
+}
+
+
+// Return a block of at least SIZE bytes from malloc, with the same
+// failure behavior as operator new.
+//
+void *
+checked_malloc (std::size_t size)
+{
+  void *ptr;
+  while (! (ptr = std::malloc (size ? size : 1)))
+    {
+      std::new_handler handler = std::get_new_handler ();
+      if (! handler)
+	throw std::bad_alloc ();
+      handler ();
+    }
+  return ptr;
+}
+
+
+// Allocate SIZE bytes for the global operator new, charging them to
+// the "other" account.  As the size isn't always available on
+// deletion, the size used is what malloc actually allocated.
+//
+void *
+other_new (std::size_t size)
+{
+  void *ptr = checked_malloc (size);
+  if (MemAccount::enabled ())
+    other_account ().add (malloc_usable_size (ptr));
+  return ptr;
+}
+
+// Free PTR, which was returned by other_new.
+//
+void
+other_delete (void *ptr) noexcept
+{
+  if (ptr && MemAccount::enabled ())
+    other_account ().remove (malloc_usable_size (ptr));
+  std::free (ptr);
+}
+
+} // namespace
+
+
+// Replacements for the global operator new and delete.  Every
+// non-aligned form is replaced, rather than relying on the library's
+// versions to call each other, so that nothing allocated by one of
+// these can be freed by some other allocator's version.  Aligned
+// allocations are rare, and are left unaccounted.
+//
+void *
+operator new (std::size_t size)
+{
+  return other_new (size);
+}
+
+void *
+operator new[] (std::size_t size)
+{
+  return other_new (size);
+}
+
+void *
+operator new (std::size_t size, const std::nothrow_t &) noexcept
+{
+  try
+    {
+      return other_new (size);
+    }
+  catch (std::bad_alloc &)
+    {
+      return 0;
+    }
+}
+
+void *
+operator new[] (std::size_t size, const std::nothrow_t &) noexcept
+{
+  return operator new (size, std::nothrow);
+}
+
+void
+operator delete (void *ptr) noexcept
+{
+  other_delete (ptr);
+}
+
+void
+operator delete[] (void *ptr) noexcept
+{
+  other_delete (ptr);
+}
+
+void
+operator delete (void *ptr, std::size_t) noexcept
+{
+  other_delete (ptr);
+}
+
+void
+operator delete[] (void *ptr, std::size_t) noexcept
+{
+  other_delete (ptr);
+}
+
+void
+operator delete (void *ptr, const std::nothrow_t &) noexcept
+{
+  other_delete (ptr);
+}
+
+void
+operator delete[] (void *ptr, const std::nothrow_t &) noexcept
+{
+  other_delete (ptr);
+}
+
+
+// Make a new account called NAME, which must be a string with static
+// storage duration.
+//
+MemAccount::MemAccount (const char *name)
+  : _name (name), _num (next_account_num.fetch_add (1))
+{
+  if (_num >= MAX_ACCOUNTS)
+    throw std::runtime_error ("Too many memory accounts");
+
+  accounts[_num].store (this);
+}
+
+
+// Allocate SIZE bytes, charging them to this account.
+//
+void *
+MemAccount::allocate (std::size_t size)
+{
+  void *ptr = checked_malloc (size);
+  if (enabled ())
+    add (size);
+  return ptr;
+}
+
+// Free PTR, which was returned by allocate with the same SIZE.
+//
+void
+MemAccount::deallocate (void *ptr, std::size_t size)
+{
+  if (ptr && enabled ())
+    remove (size);
+  std::free (ptr);
+}
+
+
+// Like allocate and deallocate, but for storage belonging to an
+// object in this account, such as a container's, so only the bytes
+// are charged, not a new object.
+//
+void *
+MemAccount::allocate_storage (std::size_t size)
+{
+  void *ptr = checked_malloc (size);
+  if (enabled ())
+    add (size, 0);
+  return ptr;
+}
+void
+MemAccount::deallocate_storage (void *ptr, std::size_t size)
+{
+  if (ptr && enabled ())
+    remove (size, 0);
+  std::free (ptr);
+}
+
+
+// Charge an allocation of SIZE bytes, holding NUM_OBJECTS objects, to
+// this account.
+//
+void
+MemAccount::add (std::size_t size, unsigned num_objects)
+{
+  if (pause_depth)
+    return;
+
+  std::int64_t count
+    = _live_count.fetch_add (num_objects, std::memory_order_relaxed);
+  std::int64_t bytes = _live_bytes.fetch_add (size, std::memory_order_relaxed);
+  raise_max (_peak_count, count + num_objects);
+  raise_max (_peak_bytes, bytes + std::int64_t (size));
+  _num_allocs.fetch_add (1, std::memory_order_relaxed);
+
+  Usage &usage = thread_usage;
+  usage.counts[_num] += num_objects;
+  usage.bytes[_num] += size;
+  usage.total_bytes += size;
+  if (usage.total_bytes > usage.peak_bytes)
+    usage.peak_bytes = usage.total_bytes;
+}
+
+// Credit a deallocation of SIZE bytes, holding NUM_OBJECTS objects,
+// to this account.
+//
+void
+MemAccount::remove (std::size_t size, unsigned num_objects)
+{
+  if (pause_depth)
+    return;
+
+  _live_count.fetch_sub (num_objects, std::memory_order_relaxed);
+  _live_bytes.fetch_sub (size, std::memory_order_relaxed);
+
+  Usage &usage = thread_usage;
+  usage.counts[_num] -= num_objects;
+  usage.bytes[_num] -= size;
+  usage.total_bytes -= size;
+}
+
+
+// Subtract the values in OTHER.
+//
+MemAccount::Usage &
+MemAccount::Usage::operator-= (const Usage &other)
+{
+  for (unsigned i = 0; i < MAX_ACCOUNTS; i++)
+    {
+      counts[i] -= other.counts[i];
+      bytes[i] -= other.bytes[i];
+    }
+  total_bytes -= other.total_bytes;
+  peak_bytes -= other.peak_bytes;
+  return *this;
+}
+
+
+// Turn on accounting.
+//
+void
+MemAccount::enable ()
+{
+  // Make sure the "other" account gets the first number, rather than
+  // being created in the middle of some other allocation.
+  //
+  other_account ();
+
+  _enabled.store (true);
+}
+
+
+// Store the calling thread's current memory use in USAGE.
+//
+void
+MemAccount::read (Usage &usage)
+{
+  usage = thread_usage;
+}
+
+// Start a new high-water mark for the calling thread, at its current
+// memory use, and return the old one, which should later be passed to
+// end_peak.
+//
+std::int64_t
+MemAccount::start_peak ()
+{
+  Usage &usage = thread_usage;
+  std::int64_t outer_peak = usage.peak_bytes;
+  usage.peak_bytes = usage.total_bytes;
+  return outer_peak;
+}
+
+// End a high-water mark started by start_peak, which returned
+// OUTER_PEAK.  The outer high-water mark is updated to include
+// anything reached in the meantime.
+//
+void
+MemAccount::end_peak (std::int64_t outer_peak)
+{
+  Usage &usage = thread_usage;
+  usage.peak_bytes = std::max (usage.peak_bytes, outer_peak);
+}
+
+
+// Return the number of accounts.
+//
+unsigned
+MemAccount::num_accounts ()
+{
+  return std::min (next_account_num.load (), MAX_ACCOUNTS);
+}
+
+// Return the account with number NUM, or zero if it is still being
+// registered.
+//
+const MemAccount *
+MemAccount::account (unsigned num)
+{
+  return accounts[num].load ();
+}
+
+
+// Return a short printable form of the byte count BYTES, which may be
+// negative, with a suffix such as "M" for large numbers.
+//
+std::string
+MemAccount::format_bytes (std::int64_t bytes)
+{
+  static const char suffixes[] = " KMGT";
+
+  double val = bytes < 0 ? -double (bytes) : double (bytes);
+  unsigned suffix = 0;
+  while (val >= 1024 && suffixes[suffix + 1])
+    {
+      val /= 1024;
+      suffix++;
+    }
+
+  std::ostringstream out;
+  if (bytes < 0)
+    out << '-';
+  if (suffix == 0)
+    out << val;
+  else
+    out << std::fixed << std::setprecision (val < 10 ? 2 : 1)
+	<< val << suffixes[suffix];
+  return out.str ();
+}
+
+
+// Write a table of the process-wide totals for every account which
+// has been used to OUT.
+//
+void
+MemAccount::report (std::ostream &out)
+{
+  Pause pause;
+
+  std::vector<const MemAccount *> used;
+  for (unsigned num = 0; num < num_accounts (); num++)
+    if (const MemAccount *acc = account (num))
+      if (acc->_num_allocs.load () != 0)
+	used.push_back (acc);
+
+  std::stable_sort (used.begin (), used.end (),
+		    [] (const MemAccount *acc1, const MemAccount *acc2)
+		    {
+		      return acc1->_peak_bytes.load () > acc2->_peak_bytes.load ();
+		    });
+
+  out << std::left << std::setw (16) << "Memory by type" << std::right
+      << std::setw (12) << "allocs"
+      << std::setw (12) << "peak objs" << std::setw (12) << "peak bytes"
+      << std::setw (12) << "live objs" << std::setw (12) << "live bytes"
+      << '\n';
+
+  for (auto acc : used)
+    out << std::left << std::setw (16) << acc->name () << std::right
+	<< std::setw (12) << acc->_num_allocs.load ()
+	<< std::setw (12) << acc->_peak_count.load ()
+	<< std::setw (12) << format_bytes (acc->_peak_bytes.load ())
+	<< std::setw (12) << acc->live_count ()
+	<< std::setw (12) << format_bytes (acc->live_bytes ())
+	<< '\n';
+}
+
+
+MemAccount::Pause::Pause ()
+{
+  pause_depth++;
+}
+
+MemAccount::Pause::~Pause ()
+{
+  pause_depth--;
+}
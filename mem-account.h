@@ -0,0 +1,274 @@
+// mem-account.h -- Memory allocation accounting
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#ifndef __MEM_ACCOUNT_H__
+#define __MEM_ACCOUNT_H__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+
+// A named account to which memory allocations are charged, usually
+// one per class.  Classes join an account by using the MEM_ACCOUNTED
+// macro in their definition, which gives them class-level operator
+// new and delete.  Containers owned by objects of such a class can
+// charge their storage to the class's account too, by using
+// MemAccountAllocator; all other heap allocations made through the
+// global operator new (strings, other containers, and so on) are
+// charged to a single account called "other".
+//
+// Accounting is off until MemAccount::enable is called, and should be
+// turned on before any accounted objects are allocated, as freeing
+// an object which was allocated while accounting was off will make
+// its account's totals too small.
+//
+// Each account keeps process-wide totals, and each thread also keeps
+// its own net totals, which can be used to measure the memory used by
+// a region of code running in that thread (Trace does this for traced
+// regions).
+//
+class MemAccount
+{
+public:
+
+  // Maximum number of accounts.
+  //
+  static const unsigned MAX_ACCOUNTS = 32;
+
+
+  // Make a new account called NAME, which must be a string with
+  // static storage duration.
+  //
+  MemAccount (const char *name);
+
+  MemAccount (const MemAccount &) = delete;
+  MemAccount &operator= (const MemAccount &) = delete;
+
+
+  // Return this account's name.
+  //
+  const char *name () const { return _name; }
+
+
+  // Allocate SIZE bytes, charging them to this account.
+  //
+  void *allocate (std::size_t size);
+
+  // Free PTR, which was returned by allocate with the same SIZE.
+  //
+  void deallocate (void *ptr, std::size_t size);
+
+  // Like allocate and deallocate, but for storage belonging to an
+  // object in this account, such as a container's, so only the bytes
+  // are charged, not a new object.
+  //
+  void *allocate_storage (std::size_t size);
+  void deallocate_storage (void *ptr, std::size_t size);
+
+
+  // Net memory use by a thread, or changes in it.
+  //
+  struct Usage
+  {
+    // The net number of objects and bytes allocated in each account,
+    // indexed by account number.
+    //
+    std::int64_t counts[MAX_ACCOUNTS] = { };
+    std::int64_t bytes[MAX_ACCOUNTS] = { };
+
+    // The net number of bytes allocated in all accounts, and the
+    // highest value it has reached since the last call to
+    // MemAccount::start_peak.
+    //
+    std::int64_t total_bytes = 0;
+    std::int64_t peak_bytes = 0;
+
+    // Subtract the values in OTHER.
+    //
+    Usage &operator-= (const Usage &other);
+  };
+
+
+  // Turn on accounting.
+  //
+  static void enable ();
+
+  // Return true if accounting is turned on.
+  //
+  static bool enabled ()
+  {
+    return _enabled.load (std::memory_order_relaxed);
+  }
+
+
+  // Store the calling thread's current memory use in USAGE.
+  //
+  static void read (Usage &usage);
+
+  // Start a new high-water mark for the calling thread, at its current
+  // memory use, and return the old one, which should later be passed
+  // to end_peak.
+  //
+  static std::int64_t start_peak ();
+
+  // End a high-water mark started by start_peak, which returned
+  // OUTER_PEAK.  The outer high-water mark is updated to include
+  // anything reached in the meantime.
+  //
+  static void end_peak (std::int64_t outer_peak);
+
+
+  // Return the number of accounts, and the account with number NUM
+  // (which may be zero if it is still being registered).
+  //
+  static unsigned num_accounts ();
+  static const MemAccount *account (unsigned num);
+
+  // Return the current process-wide number of objects and bytes
+  // allocated in this account.
+  //
+  std::int64_t live_count () const
+  {
+    return _live_count.load (std::memory_order_relaxed);
+  }
+  std::int64_t live_bytes () const
+  {
+    return _live_bytes.load (std::memory_order_relaxed);
+  }
+
+
+  // Write a table of the process-wide totals for every account which
+  // has been used to OUT.
+  //
+  static void report (std::ostream &out);
+
+  // Return a short printable form of the byte count BYTES, which may
+  // be negative, with a suffix such as "M" for large numbers.
+  //
+  static std::string format_bytes (std::int64_t bytes);
+
+
+  // While an object of this class exists, allocations by the
+  // calling thread are not accounted.  This is used to keep the
+  // memory used by bookkeeping (such as trace buffers) out of the
+  // numbers; anything allocated while paused must also be freed
+  // while paused.
+  //
+  class Pause
+  {
+  public:
+    Pause ();
+    ~Pause ();
+
+    Pause (const Pause &) = delete;
+    Pause &operator= (const Pause &) = delete;
+  };
+
+
+  // Charge an allocation of SIZE bytes, holding NUM_OBJECTS objects,
+  // to this account.  This is public only for the replacement global
+  // operator new.
+  //
+  void add (std::size_t size, unsigned num_objects = 1);
+
+  // Credit a deallocation of SIZE bytes, holding NUM_OBJECTS objects,
+  // to this account.  This is public only for the replacement global
+  // operator delete.
+  //
+  void remove (std::size_t size, unsigned num_objects = 1);
+
+
+private:
+
+  const char *_name;
+
+  // This account's number, used to index Usage arrays.
+  //
+  unsigned _num;
+
+  // Process-wide totals: the number of objects and bytes currently
+  // allocated, the highest values they have reached, and the total
+  // number of allocations.
+  //
+  std::atomic<std::int64_t> _live_count { 0 }, _live_bytes { 0 };
+  std::atomic<std::int64_t> _peak_count { 0 }, _peak_bytes { 0 };
+  std::atomic<std::uint64_t> _num_allocs { 0 };
+
+  // True if accounting is enabled.
+  //
+  static std::atomic<bool> _enabled;
+};
+
+
+// Charge allocations of objects of class CLASS_NAME, which must be the
+// class being defined, to an account of the same name.  This defines
+// class-level operator new and delete.
+//
+// As the sized form of operator delete is used, deleting an object
+// through a pointer to a base class is only accounted correctly if
+// the base class has a virtual destructor.
+//
+#define MEM_ACCOUNTED(class_name)					\
+  static MemAccount &mem_account ()					\
+  {									\
+    static MemAccount account (#class_name);				\
+    return account;							\
+  }									\
+  static void *operator new (std::size_t size)				\
+  {									\
+    return mem_account ().allocate (size);				\
+  }									\
+  static void operator delete (void *ptr, std::size_t size)		\
+  {									\
+    mem_account ().deallocate (ptr, size);				\
+  }
+
+
+
+// A standard allocator which charges storage to the account of
+// OWNER, a class using MEM_ACCOUNTED, for containers which are part
+// of OWNER objects.
+//
+template<typename T, typename Owner>
+class MemAccountAllocator
+{
+public:
+
+  typedef T value_type;
+
+  MemAccountAllocator () { }
+  template<typename U>
+  MemAccountAllocator (const MemAccountAllocator<U, Owner> &) { }
+
+  T *allocate (std::size_t num)
+  {
+    return static_cast<T *> (Owner::mem_account ().allocate_storage
+			     (num * sizeof (T)));
+  }
+  void deallocate (T *ptr, std::size_t num)
+  {
+    Owner::mem_account ().deallocate_storage (ptr, num * sizeof (T));
+  }
+
+  template<typename U>
+  bool operator== (const MemAccountAllocator<U, Owner> &) const
+  {
+    return true;
+  }
+  template<typename U>
+  bool operator!= (const MemAccountAllocator<U, Owner> &) const
+  {
+    return false;
+  }
+};
+
+
+#endif // __MEM_ACCOUNT_H__
@@ -20,6 +20,8 @@ class NopInsn : public Insn
 {
 public:
 
+  MEM_ACCOUNTED (NopInsn);
+
   // Make a new conditional-branch instruction, which transfers
   // control to TARGET if COND contains a non-zero value, optionally
   // appending it to block BLOCK.p
@@ -0,0 +1,182 @@
+// output-buffer.cc -- Buffered output
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "output-buffer.h"
+
+
+// Make a buffer writing to the file descriptor FD, which is not
+// closed when we're done.
+//
+OutputBuffer::OutputBuffer (int fd)
+  : _buf (new char[DEFAULT_CAPACITY]), _fd (fd)
+{
+}
+
+// Make a buffer writing to the stream OUT.
+//
+OutputBuffer::OutputBuffer (std::ostream &out)
+  : _buf (new char[DEFAULT_CAPACITY]), _out (&out)
+{
+}
+
+// Make a buffer with no destination, which just accumulates
+// everything written to it in memory.
+//
+OutputBuffer::OutputBuffer ()
+  : _buf (new char[INITIAL_MEMORY_CAPACITY]),
+    _capacity (INITIAL_MEMORY_CAPACITY)
+{
+}
+
+OutputBuffer::~OutputBuffer ()
+{
+  try
+    {
+      flush ();
+    }
+  catch (std::runtime_error &)
+    {
+      // There's no way to report an error here.
+    }
+}
+
+
+// Write out everything in the buffer.  If the buffer has no
+// destination, this does nothing.
+//
+void
+OutputBuffer::flush ()
+{
+  if (_fd < 0 && ! _out)
+    return;
+
+  // Reset the buffer first, so that if writing fails, we don't try
+  // again in the destructor.
+  //
+  std::size_t len = _len;
+  _len = 0;
+
+  if (len > 0)
+    write_out (_buf.get (), len);
+}
+
+
+// Try to make room for at least LEN more bytes, and return true if
+// successful.  A buffer with no destination grows; otherwise the
+// buffer is flushed, after which it may still be too small.
+//
+bool
+OutputBuffer::make_room (std::size_t len)
+{
+  if (_fd < 0 && ! _out)
+    {
+      std::size_t new_capacity = std::max (_capacity * 2, _len + len);
+      std::unique_ptr<char[]> new_buf (new char[new_capacity]);
+      memcpy (new_buf.get (), _buf.get (), _len);
+      _buf = std::move (new_buf);
+      _capacity = new_capacity;
+      return true;
+    }
+
+  flush ();
+
+  return len <= _capacity;
+}
+
+
+// Write the contents of every buffer in BUFS to our destination,
+// in order, following anything already in this buffer.  For a
+// file-descriptor destination, this uses writev(2), so the contents
+// aren't copied.
+//
+void
+OutputBuffer::splice (const std::vector<const OutputBuffer *> &bufs)
+{
+  flush ();
+
+  if (_fd < 0)
+    {
+      for (auto buf : bufs)
+	write (buf->_buf.get (), buf->_len);
+      return;
+    }
+
+  std::vector<iovec> iovs;
+  for (auto buf : bufs)
+    if (buf->_len > 0)
+      iovs.push_back (iovec { buf->_buf.get (), buf->_len });
+
+  // Each writev call can only handle IOV_MAX buffers, and may write
+  // only part of them.
+  //
+  iovec *iov = iovs.data ();
+  iovec *iov_end = iov + iovs.size ();
+  while (iov < iov_end)
+    {
+      int count = std::min<std::ptrdiff_t> (iov_end - iov, IOV_MAX);
+
+      ssize_t written = ::writev (_fd, iov, count);
+      if (written < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  throw std::runtime_error (std::string ("Error writing output: ")
+				    + strerror (errno));
+	}
+
+      // Skip whatever was written.
+      //
+      while (iov < iov_end && std::size_t (written) >= iov->iov_len)
+	written -= (iov++)->iov_len;
+      if (written > 0)
+	{
+	  iov->iov_base = static_cast<char *> (iov->iov_base) + written;
+	  iov->iov_len -= written;
+	}
+    }
+}
+
+
+// Write LEN bytes from DATA to our destination, bypassing the
+// buffer.
+//
+void
+OutputBuffer::write_out (const char *data, std::size_t len)
+{
+  if (_fd < 0)
+    {
+      _out->write (data, len);
+      if (! *_out)
+	throw std::runtime_error ("Error writing output");
+      return;
+    }
+
+  while (len > 0)
+    {
+      ssize_t written = ::write (_fd, data, len);
+      if (written < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  throw std::runtime_error (std::string ("Error writing output: ")
+				    + strerror (errno));
+	}
+      data += written;
+      len -= written;
+    }
+}
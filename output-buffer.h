@@ -0,0 +1,194 @@
+// output-buffer.h -- Buffered output
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#ifndef __OUTPUT_BUFFER_H__
+#define __OUTPUT_BUFFER_H__
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+
+// A large append-only output buffer, which is written out to a file
+// descriptor (using a single write(2) call each time it's flushed),
+// or to a std::ostream.  A buffer can also have no destination, in
+// which case it just grows to hold everything written to it.
+//
+// Appending is just a bounds check and a copy, and integers are
+// formatted directly into the buffer, so nothing is allocated while
+// writing.  The buffer is flushed whenever it's full, and when it's
+// destroyed.
+//
+// Errors writing output cause a std::runtime_error exception, except
+// when flushing from the destructor, where they're ignored.
+//
+class OutputBuffer
+{
+public:
+
+  // Make a buffer writing to the file descriptor FD, which is not
+  // closed when we're done.
+  //
+  OutputBuffer (int fd);
+
+  // Make a buffer writing to the stream OUT.
+  //
+  OutputBuffer (std::ostream &out);
+
+  // Make a buffer with no destination, which just accumulates
+  // everything written to it in memory.
+  //
+  OutputBuffer ();
+
+  ~OutputBuffer ();
+
+  OutputBuffer (const OutputBuffer &) = delete;
+  OutputBuffer &operator= (const OutputBuffer &) = delete;
+
+
+  // Append LEN bytes from DATA.
+  //
+  void write (const char *data, std::size_t len)
+  {
+    // Something too big to fit even in an empty buffer is just
+    // written directly.
+    //
+    if (len > _capacity - _len && ! make_room (len))
+      {
+	write_out (data, len);
+	return;
+      }
+
+    memcpy (_buf.get () + _len, data, len);
+    _len += len;
+  }
+
+  // Append COUNT copies of the character CH.
+  //
+  void pad (std::size_t count, char ch = ' ')
+  {
+    while (count > 0)
+      {
+	if (_len == _capacity)
+	  make_room (1);
+
+	std::size_t chunk = std::min (count, _capacity - _len);
+	memset (_buf.get () + _len, ch, chunk);
+	_len += chunk;
+	count -= chunk;
+      }
+  }
+
+  OutputBuffer &operator<< (std::string_view str)
+  {
+    write (str.data (), str.size ());
+    return *this;
+  }
+  OutputBuffer &operator<< (const char *str)
+  {
+    return *this << std::string_view (str);
+  }
+
+  OutputBuffer &operator<< (char ch)
+  {
+    if (_len == _capacity)
+      make_room (1);
+    _buf[_len++] = ch;
+    return *this;
+  }
+
+  // Append the decimal representation of the integer VAL.
+  //
+  template<typename T>
+  std::enable_if_t<std::is_integral_v<T> && ! std::is_same_v<T, char>
+		     && ! std::is_same_v<T, bool>,
+		   OutputBuffer &>
+  operator<< (T val)
+  {
+    if (_capacity - _len < MAX_INT_CHARS)
+      make_room (MAX_INT_CHARS);
+    char *beg = _buf.get () + _len;
+    _len = std::to_chars (beg, beg + MAX_INT_CHARS, val).ptr - _buf.get ();
+    return *this;
+  }
+
+
+  // Write out everything in the buffer.  If the buffer has no
+  // destination, this does nothing.
+  //
+  void flush ();
+
+
+  // Return everything in the buffer which hasn't been written out
+  // yet (which for a buffer with no destination, is everything ever
+  // written to it).
+  //
+  std::string_view contents () const
+  {
+    return std::string_view (_buf.get (), _len);
+  }
+
+
+  // Write the contents of every buffer in BUFS to our destination,
+  // in order, following anything already in this buffer.  For a
+  // file-descriptor destination, this uses writev(2), so the contents
+  // aren't copied.
+  //
+  void splice (const std::vector<const OutputBuffer *> &bufs);
+
+
+private:
+
+  // Try to make room for at least LEN more bytes, and return true if
+  // successful.  A buffer with no destination grows; otherwise the
+  // buffer is flushed, after which it may still be too small.
+  //
+  bool make_room (std::size_t len);
+
+  // Write LEN bytes from DATA to our destination, bypassing the
+  // buffer.
+  //
+  void write_out (const char *data, std::size_t len);
+
+
+  // Enough characters to hold any integer formatted in decimal.
+  //
+  static constexpr std::size_t MAX_INT_CHARS = 24;
+
+  // Default buffer size.
+  //
+  static constexpr std::size_t DEFAULT_CAPACITY = 1 << 20;
+
+  // Initial size of a buffer with no destination.
+  //
+  static constexpr std::size_t INITIAL_MEMORY_CAPACITY = 4096;
+
+
+  // The buffer, which holds _CAPACITY bytes, of which the first _LEN
+  // are waiting to be written.
+  //
+  std::unique_ptr<char[]> _buf;
+  std::size_t _len = 0;
+  std::size_t _capacity = DEFAULT_CAPACITY;
+
+  // Where output goes; either _FD is a file descriptor, or if it's
+  // negative, _OUT is a stream, or if that's zero too, there's no
+  // destination.
+  //
+  int _fd = -1;
+  std::ostream *_out = 0;
+};
+
+
+#endif // __OUTPUT_BUFFER_H__
@@ -0,0 +1,91 @@
+// parallel-for.h -- Simple parallel loops
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#ifndef __PARALLEL_FOR_H__
+#define __PARALLEL_FOR_H__
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Return the number of threads to use by default for parallel work,
+// which is the number of hardware threads available.
+//
+static inline unsigned
+default_num_threads ()
+{
+  unsigned num = std::thread::hardware_concurrency ();
+  return num ? num : 1;
+}
+
+
+// Call FN (I) for every I in [0, COUNT), using up to NUM_THREADS
+// threads, one of which is the calling thread.  Indices are handed
+// out one at a time as threads become free, so uneven amounts of work
+// per index are balanced automatically.  Calls may happen in any
+// order, and FN must be safe to call concurrently.
+//
+// If any call throws an exception, no further indices are started,
+// and once all threads have finished, the first exception thrown is
+// rethrown in the calling thread.
+//
+template<typename Fn>
+void
+parallel_for (unsigned count, unsigned num_threads, Fn fn)
+{
+  num_threads = std::min (num_threads, count);
+
+  if (num_threads <= 1)
+    {
+      for (unsigned i = 0; i < count; i++)
+	fn (i);
+      return;
+    }
+
+  std::atomic<unsigned> next_index (0);
+  std::atomic<bool> failed (false);
+  std::exception_ptr first_exception;
+  std::mutex exception_lock;
+
+  auto worker = [&] ()
+    {
+      try
+	{
+	  unsigned i;
+	  while (! failed.load (std::memory_order_relaxed)
+		 && (i = next_index.fetch_add (1)) < count)
+	    fn (i);
+	}
+      catch (...)
+	{
+	  std::lock_guard<std::mutex> guard (exception_lock);
+	  if (! first_exception)
+	    first_exception = std::current_exception ();
+	  failed = true;
+	}
+    };
+
+  std::vector<std::thread> threads;
+  for (unsigned t = 1; t < num_threads; t++)
+    threads.emplace_back (worker);
+
+  worker ();
+
+  for (auto &thread : threads)
+    thread.join ();
+
+  if (first_exception)
+    std::rethrow_exception (first_exception);
+}
+
+
+#endif // __PARALLEL_FOR_H__
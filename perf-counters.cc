@@ -0,0 +1,195 @@
+// perf-counters.cc -- Hardware performance counters
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "perf-counters.h"
+
+
+std::atomic<bool> PerfCounters::_enabled (false);
+
+
+namespace {
+
+// How to ask the kernel for each counter, indexed by
+// PerfCounters::Counter.
+//
+struct CounterConfig
+{
+  const char *name;
+  std::uint32_t type;
+  std::uint64_t config;
+};
+
+const CounterConfig counter_configs[PerfCounters::NUM_COUNTERS] = {
+  { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+  { "insns", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+  { "L1D-miss", PERF_TYPE_HW_CACHE,
+    (PERF_COUNT_HW_CACHE_L1D
+     | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+     | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)) },
+  { "LLC-miss", PERF_TYPE_HW_CACHE,
+    (PERF_COUNT_HW_CACHE_LL
+     | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+     | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)) },
+  { "br-miss", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+};
+
+
+// The counters opened by a single thread.
+//
+// Counters are opened individually rather than as a group, so that
+// one which can't be scheduled doesn't stop the others from counting.
+// If there are more counters than the hardware can count at once, the
+// kernel multiplexes them, and the values read are scaled to
+// compensate.
+//
+struct ThreadCounters
+{
+  ThreadCounters ()
+  {
+    for (unsigned i = 0; i < PerfCounters::NUM_COUNTERS; i++)
+      {
+	perf_event_attr attr;
+	memset (&attr, 0, sizeof attr);
+	attr.size = sizeof attr;
+	attr.type = counter_configs[i].type;
+	attr.config = counter_configs[i].config;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format
+	  = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	fds[i] = syscall (SYS_perf_event_open, &attr, 0, -1, -1,
+			  PERF_FLAG_FD_CLOEXEC);
+	if (fds[i] < 0 && open_errno == 0)
+	  open_errno = errno;
+      }
+  }
+
+  ~ThreadCounters ()
+  {
+    for (int fd : fds)
+      if (fd >= 0)
+	close (fd);
+  }
+
+  // File descriptor for each counter, or -1 if it isn't available.
+  //
+  int fds[PerfCounters::NUM_COUNTERS];
+
+  // The errno from the first counter which couldn't be opened, if
+  // any.
+  //
+  int open_errno = 0;
+};
+
+// The calling thread's counters.
+//
+ThreadCounters &
+thread_counters ()
+{
+  static thread_local ThreadCounters counters;
+  return counters;
+}
+
+} // namespace
+
+
+PerfCounters::Counts &
+PerfCounters::Counts::operator+= (const Counts &other)
+{
+  valid &= other.valid;
+  for (unsigned i = 0; i < NUM_COUNTERS; i++)
+    counts[i] += other.counts[i];
+  return *this;
+}
+
+PerfCounters::Counts &
+PerfCounters::Counts::operator-= (const Counts &other)
+{
+  valid &= other.valid;
+  for (unsigned i = 0; i < NUM_COUNTERS; i++)
+    counts[i] -= other.counts[i];
+  return *this;
+}
+
+
+// Start counting.  If no counters are available at all, store a
+// description of why not in ERROR, and return false; otherwise return
+// true.
+//
+bool
+PerfCounters::enable (std::string &error)
+{
+  const ThreadCounters &counters = thread_counters ();
+
+  for (int fd : counters.fds)
+    if (fd >= 0)
+      {
+	_enabled.store (true);
+	return true;
+      }
+
+  error = "perf_event_open: ";
+  error += strerror (counters.open_errno);
+
+  if (counters.open_errno == EACCES || counters.open_errno == EPERM)
+    {
+      std::ifstream paranoid_file ("/proc/sys/kernel/perf_event_paranoid");
+      int paranoid;
+      if (paranoid_file >> paranoid)
+	error += " (perf_event_paranoid is " + std::to_string (paranoid) + ")";
+    }
+
+  return false;
+}
+
+
+// Store the current counts for the calling thread in COUNTS.
+//
+void
+PerfCounters::read (Counts &counts)
+{
+  const ThreadCounters &counters = thread_counters ();
+
+  counts.valid = 0;
+
+  for (unsigned i = 0; i < NUM_COUNTERS; i++)
+    {
+      // The value, time enabled, and time running.
+      //
+      std::uint64_t buf[3];
+
+      if (counters.fds[i] < 0
+	  || ::read (counters.fds[i], buf, sizeof buf) != sizeof buf)
+	continue;
+
+      std::uint64_t value = buf[0], enabled = buf[1], running = buf[2];
+      if (running != 0 && running < enabled)
+	value = std::uint64_t (double (value) * enabled / running);
+
+      counts.counts[i] = value;
+      counts.valid |= 1U << i;
+    }
+}
+
+
+// Return a short name for COUNTER, suitable for a column heading.
+//
+const char *
+PerfCounters::name (Counter counter)
+{
+  return counter_configs[counter].name;
+}
@@ -0,0 +1,97 @@
+// perf-counters.h -- Hardware performance counters
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#ifndef __PERF_COUNTERS_H__
+#define __PERF_COUNTERS_H__
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+
+// Per-thread hardware performance counters, using the Linux
+// perf_event_open system call.  Only user-space events in the calling
+// thread are counted.
+//
+// Counters are off until PerfCounters::enable is called.  Each thread
+// opens its own counters the first time it reads them.  Counters which
+// the hardware, kernel, or container don't permit are simply marked
+// as unavailable, so callers should check PerfCounters::Counts::valid.
+//
+class PerfCounters
+{
+public:
+
+  // The events counted.
+  //
+  enum Counter
+  {
+    CYCLES,
+    INSTRUCTIONS,
+    L1D_MISSES,
+    LLC_MISSES,
+    BRANCH_MISSES,
+
+    NUM_COUNTERS
+  };
+
+
+  // A set of counter values.
+  //
+  struct Counts
+  {
+    std::uint64_t counts[NUM_COUNTERS] = { };
+
+    // A bit mask of counters which are available, with bit N set if
+    // counter N is.
+    //
+    unsigned valid = 0;
+
+    bool has (Counter counter) const { return valid & (1U << counter); }
+
+    // Add / subtract the counts in OTHER, for counters available in
+    // both.
+    //
+    Counts &operator+= (const Counts &other);
+    Counts &operator-= (const Counts &other);
+  };
+
+
+  // Start counting.  If no counters are available at all, store a
+  // description of why not in ERROR, and return false; otherwise
+  // return true.
+  //
+  static bool enable (std::string &error);
+
+  // Return true if counting has been enabled.
+  //
+  static bool enabled ()
+  {
+    return _enabled.load (std::memory_order_relaxed);
+  }
+
+
+  // Store the current counts for the calling thread in COUNTS.
+  //
+  static void read (Counts &counts);
+
+
+  // Return a short name for COUNTER, suitable for a column heading.
+  //
+  static const char *name (Counter counter);
+
+
+private:
+
+  // True if counting is enabled.
+  //
+  static std::atomic<bool> _enabled;
+};
+
+
+#endif // __PERF_COUNTERS_H__
@@ -26,6 +26,8 @@ class PhiFunInpInsn : public Insn
 {
 public:
 
+  MEM_ACCOUNTED (PhiFunInpInsn);
+
   // Make a new phi-function input instruction for the phi-function
   // instruction PHI_FUN, using ARG as the input to the phi function..
   //
@@ -30,6 +30,8 @@ class PhiFunInsn : public Insn
 {
 public:
 
+  MEM_ACCOUNTED (PhiFunInsn);
+
   // Make a new phi-function instruction for the register REG.
   //
   // If BLOCK is non-NULL, the instruction is prepended to it
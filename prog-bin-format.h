@@ -0,0 +1,138 @@
+// prog-bin-format.h -- Binary IR format definitions
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#ifndef __PROG_BIN_FORMAT_H__
+#define __PROG_BIN_FORMAT_H__
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+
+// The binary IR format is a compact equivalent of the text format,
+// which can be loaded without any lexing, and which records enough
+// to restore a program exactly (so converting it back to text gives
+// the same result as writing the original program as text).
+//
+// All integers are unsigned LEB128 "varints," except for constant
+// values, which are zigzag-encoded first.  Strings are a varint
+// length followed by the bytes.  References to registers, blocks, and
+// instructions are dense indices within the function; where a
+// reference may be null, it's stored as the index plus one, and zero
+// means null.
+//
+// A file looks like:
+//
+//   magic "CCIR"
+//   version
+//   number of functions
+//   for each function:
+//     name, data offset, data size
+//   function data
+//
+// Function data offsets are relative to the beginning of the
+// function data (right after the header), so any single function can
+// be located and read without looking at the others.
+//
+// Each function's data is:
+//
+//   constants:	count, then each value
+//   registers:	count, then each register, which is either 0
+//		followed by the register name, or a constant index
+//		plus one (for constant-valued registers)
+//   blocks:	count, then each block number
+//   entry block, exit block (nullable), maximum block number
+//   for each block:
+//     instruction count, then each instruction (see below)
+//     fall-through block (nullable)
+//   for each block:
+//     0 if the block's successors and predecessors are in the order
+//     that adding the instructions and fall-throughs above creates
+//     them, otherwise 1 followed by:
+//       successors:	count, then each block
+//       predecessors:	count, then each block
+//   for each block:
+//     dominator (nullable), depth, dominatees: count, then each block
+//     the same for the post-dominator tree
+//
+// An instruction is its opcode (BinInsnOp), argument registers
+// (count, then each nullable register), result registers (likewise),
+// and then opcode-specific operands:
+//
+//   COND_BRANCH	target block (nullable)
+//   CALC		operation (CalcInsn::Op)
+//   FUN_ARG		argument number
+//   FUN_RESULT		result number
+//   PHI_FUN		inputs: count, then each instruction
+//   PHI_FUN_INP	phi-function instruction (nullable)
+//
+// Instructions are numbered in the order they appear in the file.
+//
+
+
+// Magic number at the beginning of every binary IR file.
+//
+static constexpr char BIN_IR_MAGIC[4] = { 'C', 'C', 'I', 'R' };
+
+// Current format version.  Readers reject any other version.
+//
+static constexpr unsigned BIN_IR_VERSION = 2;
+
+
+// Instruction opcodes.
+//
+enum class BinInsnOp
+{
+  COND_BRANCH, NOP, CALC, COPY, FUN_ARG, FUN_RESULT, PHI_FUN, PHI_FUN_INP
+};
+
+
+// Return true if DATA looks like binary IR, that is, if it starts
+// with the magic number.
+//
+static inline bool
+is_bin_ir (std::string_view data)
+{
+  return data.substr (0, sizeof BIN_IR_MAGIC)
+    == std::string_view (BIN_IR_MAGIC, sizeof BIN_IR_MAGIC);
+}
+
+
+// Append the varint encoding of VAL to BUF.
+//
+static inline void
+bin_put_varint (std::string &buf, std::uint64_t val)
+{
+  while (val >= 0x80)
+    {
+      buf += static_cast<char> (val | 0x80);
+      val >>= 7;
+    }
+  buf += static_cast<char> (val);
+}
+
+// Append the zigzag varint encoding of the signed value VAL to BUF.
+//
+static inline void
+bin_put_svarint (std::string &buf, std::int64_t val)
+{
+  bin_put_varint (buf, (static_cast<std::uint64_t> (val) << 1)
+			^ static_cast<std::uint64_t> (val >> 63));
+}
+
+// Append the string STR to BUF.
+//
+static inline void
+bin_put_string (std::string &buf, std::string_view str)
+{
+  bin_put_varint (buf, str.size ());
+  buf += str;
+}
+
+
+#endif // __PROG_BIN_FORMAT_H__
@@ -0,0 +1,588 @@
+// prog-bin-reader.cc -- Binary-format input of an IR program
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <unordered_set>
+
+#include "trace.h"
+
+#include "prog.h"
+#include "reg.h"
+#include "value.h"
+
+#include "cond-branch-insn.h"
+#include "nop-insn.h"
+#include "calc-insn.h"
+#include "copy-insn.h"
+#include "fun-arg-insn.h"
+#include "fun-result-insn.h"
+#include "phi-fun-insn.h"
+#include "phi-fun-inp-insn.h"
+
+#include "prog-bin-format.h"
+
+#include "prog-bin-reader.h"
+
+
+// A cursor for decoding the primitive elements of binary IR.
+//
+class BinDecoder
+{
+public:
+
+  BinDecoder (std::string_view data, const std::string &file_name)
+    : _pos (data.data ()), _end (data.data () + data.size ()),
+      _file_name (file_name)
+  { }
+
+
+  // Read and return a varint.
+  //
+  std::uint64_t get ()
+  {
+    // Most values are small, so check for that first.
+    //
+    if (_pos != _end && static_cast<unsigned char> (*_pos) < 0x80)
+      return static_cast<unsigned char> (*_pos++);
+
+    std::uint64_t val = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7)
+      {
+	if (_pos == _end)
+	  error ("Unexpected end of data");
+
+	unsigned char byte = *_pos++;
+	val |= static_cast<std::uint64_t> (byte & 0x7F) << shift;
+	if (byte < 0x80)
+	  return val;
+      }
+
+    error ("Invalid varint");
+  }
+
+  // Read and return a zigzag-encoded signed varint.
+  //
+  std::int64_t get_signed ()
+  {
+    std::uint64_t val = get ();
+    return static_cast<std::int64_t> (val >> 1) ^ -static_cast<std::int64_t> (val & 1);
+  }
+
+  // Read and return a varint which must be less than LIMIT.
+  //
+  unsigned get_index (std::uint64_t limit)
+  {
+    std::uint64_t val = get ();
+    if (val >= limit)
+      error ("Index out of range");
+    return val;
+  }
+
+  // Read and return the count of a list whose elements each take at
+  // least one byte.
+  //
+  unsigned get_count () { return get_index (_end - _pos + 1); }
+
+  // Read and return a string.  The result points into the data.
+  //
+  std::string_view get_string ()
+  {
+    unsigned len = get_count ();
+    std::string_view str (_pos, len);
+    _pos += len;
+    return str;
+  }
+
+
+  // Return the remaining data.
+  //
+  std::string_view rest () const { return std::string_view (_pos, _end - _pos); }
+
+  // Return true if all data has been read.
+  //
+  bool at_end () const { return _pos == _end; }
+
+
+  // Throw an exception for an error in the data, with message MSG.
+  //
+  [[noreturn]] void error (const std::string &msg) const
+  {
+    throw std::runtime_error (_file_name + ": Invalid binary IR: " + msg);
+  }
+
+
+private:
+
+  // Data remaining to be read.
+  //
+  const char *_pos, *_end;
+
+  // Name of the file we're reading, for error messages.
+  //
+  const std::string &_file_name;
+};
+
+
+// Helper class for decoding a single function.
+//
+class FunBinDecoder
+{
+public:
+
+  FunBinDecoder (std::string_view data, const std::string &file_name)
+    : _dec (data, file_name)
+  { }
+
+  // Decode our function, and return it.
+  //
+  Fun *decode ();
+
+
+private:
+
+  // Read a reference to a register, block, or instruction, and return
+  // the corresponding object.  If NULLABLE is true, a null reference
+  // is allowed, and zero is returned for it.
+  //
+  Reg *get_reg (bool nullable)
+  {
+    return get_ref (_regs, nullable);
+  }
+  BB *get_block (bool nullable)
+  {
+    return get_ref (_blocks, nullable);
+  }
+  template<typename T>
+  T *get_ref (const std::vector<T *> &objs, bool nullable)
+  {
+    if (nullable)
+      {
+	unsigned ref = _dec.get_index (objs.size () + 1);
+	return ref ? objs[ref - 1] : 0;
+      }
+    else
+      return objs[_dec.get_index (objs.size ())];
+  }
+
+  // Read a count followed by that many non-null block references,
+  // and return the blocks.
+  //
+  BB::BlockList get_blocks ()
+  {
+    BB::BlockList blocks;
+    for (unsigned num = _dec.get_count (); num > 0; num--)
+      blocks.push_back (get_block (false));
+    return blocks;
+  }
+
+  // Read a count followed by that many nullable register references
+  // into REGS.
+  //
+  void get_regs (std::vector<Reg *> &regs)
+  {
+    regs.resize (_dec.get_count ());
+    for (auto &reg : regs)
+      reg = get_reg (true);
+  }
+
+  // Read an instruction, and add it to the end of BLOCK.
+  //
+  void get_insn (BB *block);
+
+
+  // Decoder for our data.
+  //
+  BinDecoder _dec;
+
+  // The function being decoded.
+  //
+  std::unique_ptr<Fun> _fun;
+
+  // Registers, blocks, and instructions, by index.
+  //
+  std::vector<Reg *> _regs;
+  std::vector<BB *> _blocks;
+  std::vector<Insn *> _insns;
+
+  // The arguments and results of the instruction being read, kept
+  // here so their storage is reused.
+  //
+  std::vector<Reg *> _args, _results;
+
+  // Phi-function inputs, and phi-functions of phi-function input
+  // instructions, which may refer to instructions not yet read.  Each
+  // is stored as the instruction index.
+  //
+  std::vector<std::pair<PhiFunInsn *, std::vector<unsigned>>> _phi_fun_inputs;
+  std::vector<std::pair<PhiFunInpInsn *, unsigned>> _phi_fun_inp_phi_funs;
+};
+
+
+// Decode our function, and return it.
+//
+Fun *
+FunBinDecoder::decode ()
+{
+  _fun.reset (new Fun ());
+
+  // Get rid of the default entry and exit blocks, as the saved
+  // function says which blocks they should be.
+  //
+  delete _fun->entry_block ();
+  delete _fun->exit_block ();
+
+  // Constants and registers.
+  //
+  std::vector<int> consts (_dec.get_count ());
+  for (auto &int_value : consts)
+    {
+      std::int64_t val = _dec.get_signed ();
+      if (val < INT_MIN || val > INT_MAX)
+	_dec.error ("Constant out of range");
+      int_value = val;
+    }
+
+  _regs.resize (_dec.get_count ());
+  for (auto &reg : _regs)
+    {
+      unsigned kind = _dec.get_index (consts.size () + 1);
+      if (kind == 0)
+	reg = new Reg (Symbol (_dec.get_string ()), _fun.get ());
+      else
+	reg = new Reg (new Value (consts[kind - 1], _fun.get ()));
+    }
+
+  // Blocks.
+  //
+  _blocks.resize (_dec.get_count ());
+  for (auto &block : _blocks)
+    {
+      block = new BB (_fun.get ());
+      block->set_num (_dec.get ());
+    }
+
+  _fun->set_entry_block (get_block (true));
+  _fun->set_exit_block (get_block (true));
+  _fun->set_max_block_num (_dec.get ());
+
+  // Block contents.
+  //
+  for (auto block : _blocks)
+    {
+      for (unsigned num = _dec.get_count (); num > 0; num--)
+	get_insn (block);
+      block->set_fall_through (get_block (true));
+    }
+
+  // Now that all instructions exist, we can link up phi-functions.
+  //
+  for (auto &[phi_fun, inputs] : _phi_fun_inputs)
+    for (auto input_idx : inputs)
+      {
+	PhiFunInpInsn *input
+	  = input_idx < _insns.size ()
+	  ? dynamic_cast<PhiFunInpInsn *> (_insns[input_idx])
+	  : 0;
+	if (! input)
+	  _dec.error ("Invalid phi-function input");
+	phi_fun->add_input (input);
+      }
+  for (auto [input, phi_fun_ref] : _phi_fun_inp_phi_funs)
+    if (phi_fun_ref)
+      {
+	PhiFunInsn *phi_fun
+	  = phi_fun_ref <= _insns.size ()
+	  ? dynamic_cast<PhiFunInsn *> (_insns[phi_fun_ref - 1])
+	  : 0;
+	if (! phi_fun)
+	  _dec.error ("Invalid phi-function reference");
+	input->set_phi_fun (phi_fun);
+      }
+
+  // Flow-graph edges.  Adding instructions and fall-throughs above
+  // already created all the edges, so this just restores their order
+  // for blocks where it's different.
+  //
+  for (auto block : _blocks)
+    if (_dec.get_index (2))
+      {
+	BB::BlockList succs = get_blocks ();
+	BB::BlockList preds = get_blocks ();
+
+	if (! std::is_permutation (succs.begin (), succs.end (),
+				   block->successors ().begin (),
+				   block->successors ().end ())
+	    || ! std::is_permutation (preds.begin (), preds.end (),
+				      block->predecessors ().begin (),
+				      block->predecessors ().end ()))
+	  _dec.error ("Inconsistent flow-graph edges");
+
+	block->reorder_edges (std::move (succs), std::move (preds));
+      }
+
+  // Dominator trees.
+  //
+  for (auto block : _blocks)
+    {
+      BB *dom = get_block (true);
+      unsigned depth = _dec.get ();
+      BB::BlockList dominatees = get_blocks ();
+
+      BB *post_dom = get_block (true);
+      unsigned post_depth = _dec.get ();
+      BB::BlockList post_dominatees = get_blocks ();
+
+      block->restore_dominators (dom, depth, std::move (dominatees),
+				 post_dom, post_depth,
+				 std::move (post_dominatees));
+    }
+
+  if (! _dec.at_end ())
+    _dec.error ("Extra data at end of function");
+
+  return _fun.release ();
+}
+
+
+// Read an instruction, and add it to the end of BLOCK.
+//
+void
+FunBinDecoder::get_insn (BB *block)
+{
+  unsigned op = _dec.get ();
+  std::vector<Reg *> &args = _args, &results = _results;
+  get_regs (args);
+  get_regs (results);
+
+  // Check that the instruction has NUM_ARGS arguments and NUM_RESULTS
+  // results.
+  //
+  auto check_operands = [&] (unsigned num_args, unsigned num_results)
+    {
+      if (args.size () != num_args || results.size () != num_results)
+	_dec.error ("Wrong number of instruction operands");
+    };
+
+  // Check that none of the registers in REGS is null.
+  //
+  auto check_non_null = [&] (const std::vector<Reg *> &regs)
+    {
+      for (auto reg : regs)
+	if (! reg)
+	  _dec.error ("Null instruction operand");
+    };
+
+  Insn *insn;
+  switch (static_cast<BinInsnOp> (op))
+    {
+    case BinInsnOp::COND_BRANCH:
+      check_operands (1, 0);
+      check_non_null (args);
+      insn = new CondBranchInsn (args[0], get_block (true), block);
+      break;
+
+    case BinInsnOp::NOP:
+      check_operands (0, 0);
+      insn = new NopInsn (block);
+      break;
+
+    case BinInsnOp::CALC:
+      {
+	auto calc_op
+	  = static_cast<CalcInsn::Op> (
+	      _dec.get_index (static_cast<unsigned> (CalcInsn::Op::NEG) + 1));
+	if (calc_op == CalcInsn::Op::NONE)
+	  _dec.error ("Invalid calculation operation");
+
+	check_operands (calc_op == CalcInsn::Op::NEG ? 1 : 2, 1);
+	check_non_null (args);
+	check_non_null (results);
+
+	if (calc_op == CalcInsn::Op::NEG)
+	  insn = new CalcInsn (calc_op, args[0], results[0], block);
+	else
+	  insn = new CalcInsn (calc_op, args[0], args[1], results[0], block);
+      }
+      break;
+
+    case BinInsnOp::COPY:
+      if (args.empty () || args.size () != results.size ())
+	_dec.error ("Wrong number of instruction operands");
+      insn = new CopyInsn (args, results, block);
+      break;
+
+    case BinInsnOp::FUN_ARG:
+      check_operands (0, 1);
+      insn = new FunArgInsn (_dec.get (), results[0], block);
+      break;
+
+    case BinInsnOp::FUN_RESULT:
+      check_operands (1, 0);
+      check_non_null (args);
+      insn = new FunResultInsn (_dec.get (), args[0], block);
+      break;
+
+    case BinInsnOp::PHI_FUN:
+      {
+	check_operands (0, 1);
+
+	PhiFunInsn *phi_fun = new PhiFunInsn (results[0]);
+	block->add_insn (phi_fun);
+
+	std::vector<unsigned> inputs (_dec.get_count ());
+	for (auto &input : inputs)
+	  input = _dec.get ();
+	_phi_fun_inputs.emplace_back (phi_fun, std::move (inputs));
+
+	insn = phi_fun;
+      }
+      break;
+
+    case BinInsnOp::PHI_FUN_INP:
+      {
+	check_operands (1, 0);
+
+	PhiFunInpInsn *input = new PhiFunInpInsn (0, args[0]);
+	block->add_insn (input);
+
+	_phi_fun_inp_phi_funs.emplace_back (input, _dec.get ());
+
+	insn = input;
+      }
+      break;
+
+    default:
+      _dec.error ("Unknown instruction opcode " + std::to_string (op));
+    }
+
+  _insns.push_back (insn);
+}
+
+
+// Make a reader for the binary IR in DATA, which must remain valid
+// while the reader is used.  FILE_NAME is used in error messages.
+// The header is read immediately.
+//
+ProgBinReader::ProgBinReader (std::string_view data,
+			      const std::string &file_name)
+  : _file_name (file_name)
+{
+  BinDecoder dec (data.substr (std::min (data.size (), sizeof BIN_IR_MAGIC)),
+		  _file_name);
+
+  if (! is_bin_ir (data))
+    dec.error ("Bad magic number");
+
+  unsigned version = dec.get ();
+  if (version != BIN_IR_VERSION)
+    dec.error ("Unsupported version " + std::to_string (version));
+
+  std::vector<std::pair<std::uint64_t, std::uint64_t>> extents;
+
+  _funs.resize (dec.get_count ());
+  for (auto &entry : _funs)
+    {
+      entry.name = dec.get_string ();
+      std::uint64_t offs = dec.get ();
+      std::uint64_t size = dec.get ();
+      extents.emplace_back (offs, size);
+    }
+
+  // Function data starts right after the header.
+  //
+  std::string_view fun_data = dec.rest ();
+
+  for (unsigned fun_idx = 0; fun_idx < _funs.size (); fun_idx++)
+    {
+      auto [offs, size] = extents[fun_idx];
+      if (offs > fun_data.size () || size > fun_data.size () - offs)
+	dec.error ("Function data out of range");
+      _funs[fun_idx].data = fun_data.substr (offs, size);
+    }
+}
+
+
+// Read the entire program, and return the new program.
+//
+Prog *
+ProgBinReader::read ()
+{
+  TRACE_SPAN ("ProgBinReader::read");
+
+  std::unique_ptr<Prog> prog (new Prog ());
+
+  read_funs ([&] (const std::string &name, Fun *fun)
+	     {
+	       std::unique_ptr<Fun> fun_holder (fun);
+	       prog->add_fun (name, fun);
+	       fun_holder.release ();
+	     });
+
+  return prog.release ();
+}
+
+
+// Read the program one function at a time, calling HANDLER with
+// each function as soon as it has been read, instead of building a
+// program.
+//
+void
+ProgBinReader::read_funs (const FunHandler &handler) const
+{
+  std::unordered_set<std::string> fun_names;
+
+  for (auto &entry : _funs)
+    {
+      if (! fun_names.insert (entry.name).second)
+	throw std::runtime_error
+	  (std::string ("Duplicate function definition \"")
+	   + entry.name + "\"");
+
+      handler (entry.name, read_fun (entry));
+    }
+}
+
+// Return the names of the functions in the program, in order.
+//
+std::vector<std::string>
+ProgBinReader::fun_names () const
+{
+  std::vector<std::string> names;
+  for (auto &entry : _funs)
+    names.push_back (entry.name);
+  return names;
+}
+
+
+// Read and return just the function called NAME, without looking
+// at any other functions.  If there's no such function, return
+// zero.
+//
+Fun *
+ProgBinReader::read_fun (const std::string &name) const
+{
+  for (auto &entry : _funs)
+    if (entry.name == name)
+      return read_fun (entry);
+  return 0;
+}
+
+
+// Read and return the function described by ENTRY.
+//
+Fun *
+ProgBinReader::read_fun (const FunEntry &entry) const
+{
+  TRACE_SPAN ("ProgBinReader::read_fun", entry.name);
+
+  return FunBinDecoder (entry.data, _file_name).decode ();
+}
@@ -0,0 +1,91 @@
+// prog-bin-reader.h -- Binary-format input of an IR program
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#ifndef __PROG_BIN_READER_H__
+#define __PROG_BIN_READER_H__
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+class Prog;
+class Fun;
+
+
+// A class for reading binary representations of a program (see
+// prog-bin-format.h for a description of the format).
+//
+// Errors in the input cause a std::runtime_error exception.
+//
+class ProgBinReader
+{
+public:
+
+  // Make a reader for the binary IR in DATA, which must remain valid
+  // while the reader is used.  FILE_NAME is used in error messages.
+  // The header is read immediately.
+  //
+  ProgBinReader (std::string_view data, const std::string &file_name);
+
+
+  // Read the entire program, and return the new program.
+  //
+  Prog *read ();
+
+
+  // A function called with each function read by read_funs, and its
+  // name.  The function becomes owned by the handler.
+  //
+  typedef std::function<void (const std::string &name, Fun *fun)> FunHandler;
+
+  // Read the program one function at a time, calling HANDLER with
+  // each function as soon as it has been read, instead of building a
+  // program.
+  //
+  void read_funs (const FunHandler &handler) const;
+
+
+  // Return the names of the functions in the program, in order.
+  //
+  std::vector<std::string> fun_names () const;
+
+  // Read and return just the function called NAME, without looking
+  // at any other functions.  If there's no such function, return
+  // zero.
+  //
+  Fun *read_fun (const std::string &name) const;
+
+
+private:
+
+  // Location of a function within the function data.
+  //
+  struct FunEntry
+  {
+    std::string name;
+    std::string_view data;
+  };
+
+  // Read and return the function described by ENTRY.
+  //
+  Fun *read_fun (const FunEntry &entry) const;
+
+
+  // Name of the file we're reading, for error messages.
+  //
+  std::string _file_name;
+
+  // All functions in the program.
+  //
+  std::vector<FunEntry> _funs;
+};
+
+
+#endif // __PROG_BIN_READER_H__
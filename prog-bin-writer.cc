@@ -0,0 +1,386 @@
+// prog-bin-writer.cc -- Binary-format output of an IR program
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#include <algorithm>
+#include <stdexcept>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+#include "trace.h"
+
+#include "prog.h"
+#include "reg.h"
+#include "value.h"
+
+#include "cond-branch-insn.h"
+#include "nop-insn.h"
+#include "calc-insn.h"
+#include "copy-insn.h"
+#include "fun-arg-insn.h"
+#include "fun-result-insn.h"
+#include "phi-fun-insn.h"
+#include "phi-fun-inp-insn.h"
+
+#include "prog-bin-format.h"
+
+#include "prog-bin-writer.h"
+
+
+ProgBinWriter::ProgBinWriter (std::ostream &out)
+  : _out (out)
+{
+}
+
+// Make a writer writing to the file descriptor FD, which is not
+// closed when we're done.
+//
+ProgBinWriter::ProgBinWriter (int fd)
+  : _out (fd)
+{
+}
+
+
+// Write a binary representation of PROG.
+//
+void
+ProgBinWriter::write (Prog *prog)
+{
+  TRACE_SPAN ("ProgBinWriter::write");
+
+  for (auto [name, fun] : prog->functions ())
+    add_fun (name, fun);
+
+  finish ();
+}
+
+
+// Add the function FUN, called NAME, to the output.  FUN is encoded
+// immediately, so it may be deleted after this returns.  Nothing is
+// actually written until finish is called.
+//
+void
+ProgBinWriter::add_fun (const std::string &name, Fun *fun)
+{
+  add_encoded_fun (name, encode_fun (fun));
+}
+
+// Add a function called NAME, whose encoding (as returned by
+// ProgBinWriter::encode_fun) is DATA, to the output.
+//
+void
+ProgBinWriter::add_encoded_fun (const std::string &name, std::string data)
+{
+  _funs.emplace_back (name, std::move (data));
+}
+
+
+// Write all functions added with add_fun.
+//
+void
+ProgBinWriter::finish ()
+{
+  // The header needs the offsets of all functions, so nothing can be
+  // written before every function has been encoded.
+  //
+  std::string header (BIN_IR_MAGIC, sizeof BIN_IR_MAGIC);
+  bin_put_varint (header, BIN_IR_VERSION);
+  bin_put_varint (header, _funs.size ());
+
+  std::size_t offs = 0;
+  for (auto &[name, data] : _funs)
+    {
+      bin_put_string (header, name);
+      bin_put_varint (header, offs);
+      bin_put_varint (header, data.size ());
+
+      offs += data.size ();
+    }
+
+  _out.write (header.data (), header.size ());
+  for (auto &[name, data] : _funs)
+    _out.write (data.data (), data.size ());
+
+  _out.flush ();
+
+  _funs.clear ();
+}
+
+
+// Helper class for encoding a single function.
+//
+class FunBinEncoder
+{
+public:
+
+  FunBinEncoder (Fun *fun) : _fun (fun) { }
+
+  // Return the binary representation of our function.
+  //
+  std::string encode ();
+
+
+private:
+
+  void put (std::uint64_t val) { bin_put_varint (_buf, val); }
+
+  // Append a reference to REG, BLOCK, or INSN, any of which may be
+  // zero.
+  //
+  void put_ref (Reg *reg) { put (reg ? _reg_indices.at (reg) + 1 : 0); }
+  void put_ref (BB *block) { put (block ? _block_indices.at (block) + 1 : 0); }
+  void put_ref (Insn *insn) { put (insn ? _insn_indices.at (insn) + 1 : 0); }
+
+  // Append a count, followed by a non-null reference to each block in
+  // BLOCKS.
+  //
+  void put_blocks (const BB::BlockList &blocks)
+  {
+    put (blocks.size ());
+    for (auto block : blocks)
+      put (_block_indices.at (block));
+  }
+
+  // Append a count, followed by a nullable reference to each register
+  // in REGS.
+  //
+  void put_regs (const Insn::RegVector &regs)
+  {
+    put (regs.size ());
+    for (auto reg : regs)
+      put_ref (reg);
+  }
+
+  // Append the instruction INSN.
+  //
+  void put_insn (Insn *insn);
+
+
+  // The function we're encoding.
+  //
+  Fun *_fun;
+
+  // Output buffer.
+  //
+  std::string _buf;
+
+  // Dense indices for registers, blocks, and instructions.
+  //
+  std::unordered_map<Reg *, unsigned> _reg_indices;
+  std::unordered_map<BB *, unsigned> _block_indices;
+  std::unordered_map<Insn *, unsigned> _insn_indices;
+};
+
+
+// Return the binary representation of our function.
+//
+std::string
+FunBinEncoder::encode ()
+{
+  // Constants and registers.
+  //
+  std::vector<int> consts;
+  std::unordered_map<int, unsigned> const_indices;
+  std::vector<unsigned> reg_kinds;
+
+  for (auto reg : _fun->regs ())
+    {
+      _reg_indices.emplace (reg, _reg_indices.size ());
+
+      if (reg->is_constant ())
+	{
+	  int int_value = reg->value ()->int_value ();
+	  auto [const_it, inserted]
+	    = const_indices.emplace (int_value, consts.size ());
+	  if (inserted)
+	    consts.push_back (int_value);
+	  reg_kinds.push_back (const_it->second + 1);
+	}
+      else
+	reg_kinds.push_back (0);
+    }
+
+  put (consts.size ());
+  for (auto int_value : consts)
+    bin_put_svarint (_buf, int_value);
+
+  put (reg_kinds.size ());
+  unsigned reg_idx = 0;
+  for (auto reg : _fun->regs ())
+    {
+      unsigned kind = reg_kinds[reg_idx++];
+      put (kind);
+      if (kind == 0)
+	bin_put_string (_buf, reg->name ());
+    }
+
+  // Block and instruction numbering.
+  //
+  const std::list<BB *> &blocks = _fun->blocks ();
+  for (auto block : blocks)
+    {
+      _block_indices.emplace (block, _block_indices.size ());
+      for (auto insn : block->insns ())
+	_insn_indices.emplace (insn, _insn_indices.size ());
+    }
+
+  put (blocks.size ());
+  for (auto block : blocks)
+    put (block->num ());
+
+  put_ref (_fun->entry_block ());
+  put_ref (_fun->exit_block ());
+  put (_fun->max_block_num ());
+
+  // Block contents.
+  //
+  for (auto block : blocks)
+    {
+      put (block->insns ().size ());
+      for (auto insn : block->insns ())
+	put_insn (insn);
+      put_ref (block->fall_through ());
+    }
+
+  // Flow-graph edges.  A reader recreates the edges while adding
+  // each block's instructions and fall-through, so a block's edges
+  // are only written if their order is different from that.
+  //
+  std::vector<std::list<BB *>> loaded_succs (blocks.size ());
+  std::vector<std::list<BB *>> loaded_preds (blocks.size ());
+  unsigned block_idx = 0;
+  for (auto block : blocks)
+    {
+      std::list<BB *> &succs = loaded_succs[block_idx++];
+      for (auto insn : block->insns ())
+	if (CondBranchInsn *branch = dynamic_cast<CondBranchInsn *> (insn))
+	  if (branch->target ())
+	    succs.push_back (branch->target ());
+      if (block->fall_through ())
+	succs.push_back (block->fall_through ());
+
+      for (auto succ : succs)
+	loaded_preds[_block_indices.at (succ)].push_back (block);
+    }
+
+  block_idx = 0;
+  for (auto block : blocks)
+    {
+      const BB::BlockList &succs = block->successors ();
+      const BB::BlockList &preds = block->predecessors ();
+      if (std::equal (succs.begin (), succs.end (),
+		      loaded_succs[block_idx].begin (),
+		      loaded_succs[block_idx].end ())
+	  && std::equal (preds.begin (), preds.end (),
+			 loaded_preds[block_idx].begin (),
+			 loaded_preds[block_idx].end ()))
+	put (0);
+      else
+	{
+	  put (1);
+	  put_blocks (succs);
+	  put_blocks (preds);
+	}
+      block_idx++;
+    }
+
+  // Dominator trees.
+  //
+  for (auto block : blocks)
+    {
+      put_ref (block->dominator ());
+      put (block->dominator_depth ());
+      put_blocks (block->dominatees ());
+
+      put_ref (block->post_dominator ());
+      put (block->post_dominator_depth ());
+      put_blocks (block->post_dominatees ());
+    }
+
+  return std::move (_buf);
+}
+
+
+// Append the instruction INSN.
+//
+void
+FunBinEncoder::put_insn (Insn *insn)
+{
+  BinInsnOp op;
+  if (dynamic_cast<CondBranchInsn *> (insn))
+    op = BinInsnOp::COND_BRANCH;
+  else if (dynamic_cast<NopInsn *> (insn))
+    op = BinInsnOp::NOP;
+  else if (dynamic_cast<CalcInsn *> (insn))
+    op = BinInsnOp::CALC;
+  else if (dynamic_cast<CopyInsn *> (insn))
+    op = BinInsnOp::COPY;
+  else if (dynamic_cast<FunArgInsn *> (insn))
+    op = BinInsnOp::FUN_ARG;
+  else if (dynamic_cast<FunResultInsn *> (insn))
+    op = BinInsnOp::FUN_RESULT;
+  else if (dynamic_cast<PhiFunInsn *> (insn))
+    op = BinInsnOp::PHI_FUN;
+  else if (dynamic_cast<PhiFunInpInsn *> (insn))
+    op = BinInsnOp::PHI_FUN_INP;
+  else
+    throw std::runtime_error
+      (std::string ("No binary encoding for insn of type ")
+       + typeid (*insn).name ());
+
+  put (static_cast<unsigned> (op));
+  put_regs (insn->args ());
+  put_regs (insn->results ());
+
+  switch (op)
+    {
+    case BinInsnOp::COND_BRANCH:
+      put_ref (static_cast<CondBranchInsn *> (insn)->target ());
+      break;
+
+    case BinInsnOp::CALC:
+      put (static_cast<unsigned> (static_cast<CalcInsn *> (insn)->op ()));
+      break;
+
+    case BinInsnOp::FUN_ARG:
+      put (static_cast<FunArgInsn *> (insn)->arg_num ());
+      break;
+
+    case BinInsnOp::FUN_RESULT:
+      put (static_cast<FunResultInsn *> (insn)->result_num ());
+      break;
+
+    case BinInsnOp::PHI_FUN:
+      {
+	const std::list<PhiFunInpInsn *> &inputs
+	  = static_cast<PhiFunInsn *> (insn)->inputs ();
+	put (inputs.size ());
+	for (auto input : inputs)
+	  put (_insn_indices.at (input));
+      }
+      break;
+
+    case BinInsnOp::PHI_FUN_INP:
+      put_ref (static_cast<PhiFunInpInsn *> (insn)->phi_fun ());
+      break;
+
+    case BinInsnOp::NOP:
+    case BinInsnOp::COPY:
+      break;
+    }
+}
+
+
+// Return the binary representation of the function FUN, as it
+// appears in the function-data part of a binary IR file.
+//
+std::string
+ProgBinWriter::encode_fun (Fun *fun)
+{
+  return FunBinEncoder (fun).encode ();
+}
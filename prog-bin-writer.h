@@ -0,0 +1,79 @@
+// prog-bin-writer.h -- Binary-format output of an IR program
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#ifndef __PROG_BIN_WRITER_H__
+#define __PROG_BIN_WRITER_H__
+
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "output-buffer.h"
+
+
+class Prog;
+class Fun;
+
+
+// A class for outputting binary representations of a program (see
+// prog-bin-format.h for a description of the format).
+//
+class ProgBinWriter
+{
+public:
+
+  ProgBinWriter (std::ostream &out);
+
+  // Make a writer writing to the file descriptor FD, which is not
+  // closed when we're done.
+  //
+  ProgBinWriter (int fd);
+
+
+  // Write a binary representation of PROG.
+  //
+  void write (Prog *prog);
+
+
+  // Add the function FUN, called NAME, to the output.  FUN is encoded
+  // immediately, so it may be deleted after this returns.  Nothing is
+  // actually written until finish is called.
+  //
+  void add_fun (const std::string &name, Fun *fun);
+
+  // Add a function called NAME, whose encoding (as returned by
+  // ProgBinWriter::encode_fun) is DATA, to the output.
+  //
+  void add_encoded_fun (const std::string &name, std::string data);
+
+  // Write all functions added with add_fun.
+  //
+  void finish ();
+
+
+  // Return the binary representation of the function FUN, as it
+  // appears in the function-data part of a binary IR file.
+  //
+  static std::string encode_fun (Fun *fun);
+
+
+private:
+
+  // Where output goes.
+  //
+  OutputBuffer _out;
+
+  // Encoded functions waiting to be written by finish, paired with
+  // their names.
+  //
+  std::vector<std::pair<std::string, std::string>> _funs;
+};
+
+
+#endif // __PROG_BIN_WRITER_H__
@@ -6,7 +6,16 @@
 // Created: 2019-11-14
 //
 
+#include <cstring>
+#include <memory>
 #include <stdexcept>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "trace.h"
+#include "stats.h"
+#include "parallel-for.h"
 
 #include "prog.h"
 
@@ -15,6 +24,10 @@
 #include "prog-text-reader.h"
 
 
+static Stat parallel_ranges ("prog-text-reader", "parallel-ranges",
+			     "Number of input ranges read in parallel");
+
+
 ProgTextReader::ProgTextReader (SrcFileInput &inp)
   : _inp (inp), _fun_reader (*this)
 {
@@ -25,31 +38,212 @@ ProgTextReader::ProgTextReader (SrcFileInput &inp)
 //
 Prog *
 ProgTextReader::read ()
+{
+  TRACE_SPAN ("ProgTextReader::read");
+
+  std::unique_ptr<Prog> prog (new Prog ());
+
+  read_funs ([&] (const std::string &name, Fun *fun)
+	     {
+	       std::unique_ptr<Fun> fun_holder (fun);
+	       prog->add_fun (name, fun);
+	       fun_holder.release ();
+	     });
+
+  return prog.release ();
+}
+
+
+// Read a text representation of a program, calling HANDLER with
+// each function as soon as it has been read, instead of building a
+// program.  Nothing is retained between functions except their
+// names, so the memory needed is bounded by the largest function.
+//
+void
+ProgTextReader::read_funs (const FunHandler &handler)
 {
   // Cannot be called recursively.
   //
-  if (cur_prog)
+  if (_reading)
     throw std::runtime_error ("Recursive call to ProgTextReader::read");
 
-  Prog *prog = new Prog ();
-
-  cur_prog = prog;
+  _reading = true;
 
-  do
+  try
     {
-      if (! _inp.at_eol ())
+      std::unordered_set<std::string> fun_names;
+
+      do
 	{
-	  _inp.expect ("fun");
-	  std::string fun_name = _inp.read_id ();
+	  if (! _inp.at_eol ())
+	    {
+	      _inp.expect ("fun");
+	      std::string fun_name (_inp.read_id ());
 
-	  Fun *fun = _fun_reader.read ();
+	      Fun *fun;
+	      {
+		TRACE_SPAN ("ProgTextReader::read_fun", fun_name);
+		fun = _fun_reader.read ();
+	      }
 
-	  prog->add_fun (fun_name, fun);
+	      if (! fun_names.insert (fun_name).second)
+		{
+		  delete fun;
+		  throw std::runtime_error
+		    (std::string ("Duplicate function definition \"")
+		     + fun_name + "\"");
+		}
+
+	      handler (fun_name, fun);
+	    }
 	}
+      while (_inp.read_new_line ());
+    }
+  catch (...)
+    {
+      _reading = false;
+      throw;
     }
-  while (_inp.read_new_line ());
 
-  cur_prog = 0;
+  _reading = false;
+}
+
+
+// Read a text representation of a program, and return the new
+// program, like ProgTextReader::read, but using up to NUM_THREADS
+// threads to parse functions in parallel.  This must be called
+// before anything else has been read from the input.
+//
+// The input is first scanned for lines where a new function
+// definition must begin, and the ranges between them are parsed on
+// separate threads, with the results added to the program in
+// source order.  If any range has an error, the whole input is
+// re-read sequentially, so errors are reported exactly as they
+// would be by ProgTextReader::read.  A buffered input (see
+// FileInput::buffered) is always read sequentially.
+//
+Prog *
+ProgTextReader::read_parallel (unsigned num_threads)
+{
+  if (num_threads <= 1 || _inp.buffered ())
+    return read ();
+
+  TRACE_SPAN ("ProgTextReader::read_parallel");
+
+  std::string_view contents = _inp.contents ();
+
+  // Split the input into about this many ranges, so that threads
+  // which finish early can pick up more work.
+  //
+  static constexpr unsigned RANGES_PER_THREAD = 4;
+  std::size_t min_range_size
+    = contents.size () / (num_threads * RANGES_PER_THREAD) + 1;
+
+  // Offsets of the boundaries between ranges, including the
+  // beginning and end of the input.
+  //
+  std::vector<std::size_t> bounds { 0 };
+
+  {
+    TRACE_SPAN ("ProgTextReader::read_parallel scan");
+
+    // Scan the whole input with a separate reader.  Besides finding
+    // range boundaries, this adds every line to the source context,
+    // which the parallel readers then only look at.
+    //
+    SrcFileInput scan_inp (_inp, 0, contents.size (), true);
+
+    // Inside a function, any line beginning with "}" ends the
+    // function, so the next line that isn't blank or just a comment
+    // is at the top level, and if it begins with "fun", it definitely
+    // starts a new function definition.  A range boundary is only put
+    // at such a line.  (Other places where functions can start are
+    // missed, and if the line with "}" is not actually inside a
+    // function, the input has an error, which will be found when
+    // parsing the range it's in.)
+    //
+    bool prev_line_ends_fun = false;
+    do
+      {
+	const char *line = scan_inp.line_pos ();
+	std::size_t line_len = scan_inp.line_end () - line;
+	std::size_t offs = line - contents.data ();
+
+	if (prev_line_ends_fun
+	    && offs - bounds.back () >= min_range_size
+	    && line_len > 3 && memcmp (line, "fun", 3) == 0
+	    && (line[3] == ' ' || line[3] == '\t'))
+	  bounds.push_back (offs);
+
+	std::size_t indent = 0;
+	while (indent < line_len
+	       && (line[indent] == ' ' || line[indent] == '\t'))
+	  indent++;
+	if (indent < line_len && line[indent] != '#')
+	  prev_line_ends_fun = line[0] == '}';
+      }
+    while (scan_inp.read_new_line ());
+
+    bounds.push_back (contents.size ());
+  }
+
+  unsigned num_ranges = bounds.size () - 1;
+  if (num_ranges == 1)
+    return read ();
+
+  // Functions read from each range, in order, and whether reading
+  // the range had an error.
+  //
+  struct RangeFuns
+  {
+    std::vector<std::pair<std::string, std::unique_ptr<Fun>>> funs;
+    bool failed = false;
+  };
+  std::vector<RangeFuns> range_funs (num_ranges);
+
+  parallel_for (num_ranges, num_threads, [&] (unsigned range_idx)
+    {
+      RangeFuns &result = range_funs[range_idx];
+
+      // After the first function, the program reader is always in
+      // line-oriented mode, so other ranges must start out that way.
+      //
+      bool line_oriented = range_idx > 0 || _inp.line_oriented ();
+
+      SrcFileInput range_inp (_inp, bounds[range_idx], bounds[range_idx + 1],
+			      line_oriented);
+      ProgTextReader range_reader (range_inp);
+
+      try
+	{
+	  range_reader.read_funs ([&] (const std::string &name, Fun *fun)
+				  {
+				    result.funs.emplace_back (name, fun);
+				  });
+	}
+      catch (std::runtime_error &)
+	{
+	  result.failed = true;
+	}
+    });
+
+  for (auto &result : range_funs)
+    if (result.failed)
+      {
+	range_funs.clear ();
+	return read ();
+      }
+
+  parallel_ranges += num_ranges;
+
+  std::unique_ptr<Prog> prog (new Prog ());
+
+  for (auto &result : range_funs)
+    for (auto &[name, fun] : result.funs)
+      {
+	prog->add_fun (name, fun.get ());
+	fun.release ();
+      }
 
-  return prog;
+  return prog.release ();
 }
@@ -9,9 +9,13 @@
 #ifndef __PROG_TEXT_READER_H__
 #define __PROG_TEXT_READER_H__
 
+#include <functional>
+#include <string>
+
 #include "fun-text-reader.h"
 
 class Prog;
+class Fun;
 class SrcFileInput;
 
 
@@ -34,13 +38,44 @@ public:
   Prog *read ();
 
 
+  // A function called with each function read by read_funs, and its
+  // name.  The function becomes owned by the handler.
+  //
+  typedef std::function<void (const std::string &name, Fun *fun)> FunHandler;
+
+  // Read a text representation of a program, calling HANDLER with
+  // each function as soon as it has been read, instead of building a
+  // program.  Nothing is retained between functions except their
+  // names, so the memory needed is bounded by the largest function.
+  //
+  void read_funs (const FunHandler &handler);
+
+
+  // Read a text representation of a program, and return the new
+  // program, like ProgTextReader::read, but using up to NUM_THREADS
+  // threads to parse functions in parallel.  This must be called
+  // before anything else has been read from the input.
+  //
+  // The input is first scanned for lines where a new function
+  // definition must begin, and the ranges between them are parsed on
+  // separate threads, with the results added to the program in
+  // source order.  If any range has an error, the whole input is
+  // re-read sequentially, so errors are reported exactly as they
+  // would be by ProgTextReader::read.  A buffered input (see
+  // FileInput::buffered) is always read sequentially.
+  //
+  Prog *read_parallel (unsigned num_threads);
+
+
 private:
 
   SrcFileInput &_inp;
 
   FunTextReader _fun_reader;
 
-  Prog *cur_prog = 0;
+  // True while we're reading, to catch recursive calls.
+  //
+  bool _reading = false;
 };
 
 
@@ -6,26 +6,118 @@
 // Created: 2019-11-14
 //
 
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "trace.h"
+#include "parallel-for.h"
+
 #include "prog.h"
 
 #include "prog-text-writer.h"
 
 
+// Make a writer which writes to the file descriptor FD.
+//
+ProgTextWriter::ProgTextWriter (int fd)
+  : _out (fd), _fun_writer (*this)
+{
+}
+
+// Make a writer which writes to the stream OUT.
+//
 ProgTextWriter::ProgTextWriter (std::ostream &out)
   : _out (out), _fun_writer (*this)
 {
 }
 
 
+// Make a writer which just accumulates its output in memory, where
+// it's available from ProgTextWriter::out.
+//
+ProgTextWriter::ProgTextWriter ()
+  : _fun_writer (*this)
+{
+}
+
+
 // Write a text representation of PROG.
 //
 void
 ProgTextWriter::write (Prog *prog)
 {
+  TRACE_SPAN ("ProgTextWriter::write");
+
   for (auto [name, fun] : prog->functions ())
+    write_fun (name, fun);
+
+  _out.flush ();
+}
+
+
+// Write a text representation of PROG, like ProgTextWriter::write,
+// but using up to NUM_THREADS threads.  Each function is written
+// into a separate in-memory buffer on a worker thread, and the
+// buffers are then spliced into the output in order.
+//
+void
+ProgTextWriter::write_parallel (Prog *prog, unsigned num_threads)
+{
+  if (num_threads <= 1)
     {
-      _out << "fun " << name << '\n';
-      _fun_writer.write (fun);
-      _out << '\n';
+      write (prog);
+      return;
+    }
+
+  TRACE_SPAN ("ProgTextWriter::write_parallel");
+
+  const std::vector<std::pair<std::string, Fun *>> &funs
+    = prog->functions ();
+
+  // Functions are written in batches, to limit how much output is
+  // held in memory at once.
+  //
+  static constexpr unsigned FUNS_PER_THREAD = 16;
+  unsigned batch_size = num_threads * FUNS_PER_THREAD;
+
+  for (unsigned batch_beg = 0; batch_beg < funs.size ();
+       batch_beg += batch_size)
+    {
+      unsigned batch_len
+	= std::min<std::size_t> (batch_size, funs.size () - batch_beg);
+
+      std::vector<std::unique_ptr<ProgTextWriter>> fun_writers (batch_len);
+
+      parallel_for (batch_len, num_threads, [&] (unsigned idx)
+	{
+	  auto [name, fun] = funs[batch_beg + idx];
+	  fun_writers[idx].reset (new ProgTextWriter ());
+	  fun_writers[idx]->set_block_layout (_fun_writer.layout);
+	  fun_writers[idx]->set_profile (_profile);
+	  fun_writers[idx]->write_fun (name, fun);
+	});
+
+      std::vector<const OutputBuffer *> bufs;
+      for (auto &fun_writer : fun_writers)
+	bufs.push_back (&fun_writer->out ());
+
+      _out.splice (bufs);
     }
+
+  _out.flush ();
+}
+
+
+// Write a text representation of the function FUN, called NAME,
+// as it would appear in a program.
+//
+void
+ProgTextWriter::write_fun (const std::string &name, Fun *fun)
+{
+  _out << "fun " << name << '\n';
+  _fun_writer.profile_counts = _profile ? _profile->find (name, fun) : 0;
+  _fun_writer.write (fun);
+  _fun_writer.profile_counts = 0;
+  _out << '\n';
 }
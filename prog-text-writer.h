@@ -10,11 +10,14 @@
 #define __PROG_TEXT_WRITER_H__
 
 #include <ostream>
+#include <string>
 
+#include "output-buffer.h"
 #include "fun-text-writer.h"
 
 
 class Prog;
+class Fun;
 
 
 // A class for outputting text representations of a function.
@@ -23,28 +26,77 @@ class ProgTextWriter
 {
 public:
 
+  // Make a writer which writes to the file descriptor FD.
+  //
+  ProgTextWriter (int fd);
+
+  // Make a writer which writes to the stream OUT.
+  //
   ProgTextWriter (std::ostream &out);
 
+  // Make a writer which just accumulates its output in memory, where
+  // it's available from ProgTextWriter::out.
+  //
+  ProgTextWriter ();
+
 
-  // Return the output stream we're writing to.
+  // Return the output buffer we're writing to.
   //
-  std::ostream &out () const { return _out; }
+  OutputBuffer &out () { return _out; }
 
 
   // Write a text representation of PROG.
   //
   void write (Prog *prog);
 
+  // Write a text representation of PROG, like ProgTextWriter::write,
+  // but using up to NUM_THREADS threads.  Each function is written
+  // into a separate in-memory buffer on a worker thread, and the
+  // buffers are then spliced into the output in order.
+  //
+  void write_parallel (Prog *prog, unsigned num_threads);
+
+  // Write a text representation of the function FUN, called NAME,
+  // as it would appear in a program.
+  //
+  void write_fun (const std::string &name, Fun *fun);
+
+
+  // Make blocks in functions be ordered according to LAYOUT.
+  //
+  void set_block_layout (FunTextWriter::Layout layout)
+  {
+    _fun_writer.layout = layout;
+  }
+
+
+  // Annotate functions with counts from PROFILE, which must exist as
+  // long as this writer is used, and use them for block layout.  If
+  // PROFILE is zero, there are no counts.
+  //
+  void set_profile (const EdgeProfile *profile) { _profile = profile; }
+
+
+  // Write out any buffered output.  This is done automatically when
+  // the writer is destroyed, but errors are only reported by an
+  // explicit call.
+  //
+  void flush () { _out.flush (); }
+
 
 private:
 
-  // Stream we're writing to.
+  // Buffer we're writing to.
   //
-  std::ostream &_out;
+  OutputBuffer _out;
 
   // Text writer for insns.
   //
   FunTextWriter _fun_writer;
+
+  // Profile to annotate functions with, or zero.
+  //
+  const EdgeProfile *_profile = 0;
 };
 
 
@@ -27,8 +27,8 @@ Prog::~Prog ()
 void
 Prog::add_fun (const std::string &name, Fun *fun)
 {
-  Fun *&stored_fun =_funs[name];
-  if (stored_fun)
+  auto [_, inserted] = _fun_indices.emplace (name, _funs.size ());
+  if (! inserted)
     throw std::runtime_error (std::string ("Duplicate function definition \"") + name + "\"");
-  stored_fun = fun;
+  _funs.emplace_back (name, fun);
 }
@@ -11,6 +11,8 @@
 
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "fun.h"
 
@@ -30,18 +32,35 @@ public:
   //
   void add_fun (const std::string &name, Fun *fun);
 
-  // Return a reference to a read-only map containing the mapping of
-  // names to functions in this program.
+  // Return a reference to a read-only vector containing the
+  // functions in this program, paired with their names, in the order
+  // they were added.
   //
-  const std::unordered_map<std::string, Fun *> &functions () const { return _funs; }
+  const std::vector<std::pair<std::string, Fun *>> &functions () const
+  {
+    return _funs;
+  }
+
+  // Return the function called NAME in this program, or zero if
+  // there is none.
+  //
+  Fun *fun (const std::string &name) const
+  {
+    auto fun_it = _fun_indices.find (name);
+    return fun_it == _fun_indices.end () ? 0 : _funs[fun_it->second].second;
+  }
 
 
 private:
 
-  // A read-only map containing the mapping of names to functions in
-  // this program.
+  // Functions in this program, paired with their names, in the order
+  // they were added.
+  //
+  std::vector<std::pair<std::string, Fun *>> _funs;
+
+  // A mapping from function names to indices in _FUNS.
   //
-  std::unordered_map<std::string, Fun *> _funs;
+  std::unordered_map<std::string, unsigned> _fun_indices;
 
 };
 
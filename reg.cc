@@ -6,6 +6,8 @@
 // Created: 2019-11-17
 //
 
+#include <string>
+
 #include "fun.h"
 #include "insn.h"
 #include "value.h"
@@ -16,7 +18,7 @@
 // Return a new register called NAME.  If FUN is non-NULL, the
 // register is added to FUN.
 //
-Reg::Reg (const std::string &name, Fun *fun)
+Reg::Reg (Symbol name, Fun *fun)
   : _name (name)
 {
   set_fun (fun);
@@ -86,11 +88,11 @@ Reg::set_fun (Fun *fun)
 Reg *
 Reg::make_ssa_value ()
 {
-  std::string val_name = _name;
-  val_name += '.';
-  val_name += std::to_string (_ssa_values.size ());
+  Reg *val_reg = new Reg (Symbol (), _fun);
 
-  Reg *val_reg = new Reg (val_name, _fun);
+  val_reg->_ssa_value_name = name ();
+  val_reg->_ssa_value_name += '.';
+  val_reg->_ssa_value_name += std::to_string (_ssa_values.size ());
 
   val_reg->_ssa_proto = this;
   _ssa_values.push_back (val_reg);
@@ -10,8 +10,13 @@
 #define __REG_H__
 
 #include <string>
+#include <string_view>
 #include <list>
 
+#include "symbol.h"
+
+#include "mem-account.h"
+
 
 class Fun;
 class Insn;
@@ -24,10 +29,18 @@ class Reg
 {
 public:
 
+  MEM_ACCOUNTED (Reg);
+
+  // Lists of instructions and registers which are part of a register;
+  // their storage is charged to the Reg account.
+  //
+  typedef std::list<Insn *, MemAccountAllocator<Insn *, Reg>> InsnList;
+  typedef std::list<Reg *, MemAccountAllocator<Reg *, Reg>> RegList;
+
   // Return a new register called NAME.  If FUN is non-NULL, the
   // register is added to FUN.
   //
-  Reg (const std::string &name, Fun *fun = 0);
+  Reg (Symbol name, Fun *fun = 0);
 
   // Return a new unnamed register with constant value VALUE.
   // If VALUE is in a function, the register is added to that function
@@ -40,7 +53,10 @@ public:
 
   // Return the name of this register.
   //
-  const std::string &name () const { return _name; }
+  std::string_view name () const
+  {
+    return _ssa_value_name.empty () ? _name.name () : _ssa_value_name;
+  }
 
 
   // Return this register's known value, of NULL if it has none.
@@ -49,18 +65,18 @@ public:
 
   // Return true if this is a constant-valued unnamed register.
   //
-  bool is_constant () const { return _name.size () == 0 && _value; }
+  bool is_constant () const { return _name.empty () && _value; }
 
 
   // Return a reference to a read-only list of places this register is
   // used.
   //
-  const std::list<Insn *> &uses () const { return _uses; }
+  const InsnList &uses () const { return _uses; }
 
   // Return a reference to a read-only list of places this register is
   // set.
   //
-  const std::list<Insn *> &defs () const { return _defs; }
+  const InsnList &defs () const { return _defs; }
 
 
   // Remember that this register is used in instruction INSN.
@@ -88,6 +104,12 @@ public:
   //
   void remove_def (Insn *insn) { _defs.remove (insn); }
 
+  // Forget every place this register is used or set, without
+  // searching.  This does not effect any instruction, so is only
+  // useful when they're all about to be deleted.
+  //
+  void forget_uses_and_defs () { _uses.clear (); _defs.clear (); }
+
 
   // Set the function this register is associated with to FUN.  This
   // will also remove the register from any previously associated
@@ -106,7 +128,7 @@ public:
   // corresponding to this prototype register, otherwiser return an
   // empty list.
   //
-  const std::list<Reg *> ssa_values () const { return _ssa_values; }
+  const RegList &ssa_values () const { return _ssa_values; }
 
   // Return a new individual value register for SSA-form, which will
   // have this register as its prototype.
@@ -118,7 +140,14 @@ private:
 
   // Name of this register.
   //
-  std::string _name;
+  Symbol _name;
+
+  // If this register is a particular value in SSA-form, its name,
+  // which is used instead of _NAME.  Interned symbols are never
+  // freed, and every conversion to SSA-form makes new values, so
+  // these names are kept here instead.
+  //
+  std::string _ssa_value_name;
 
   // Function where this register is used.
   //
@@ -130,22 +159,22 @@ private:
 
   // Places this register is used.
   //
-  std::list<Insn *> _uses;
+  InsnList _uses;
 
   // Places this register is set.
   //
-  std::list<Insn *> _defs;
+  InsnList _defs;
 
   // If this register is a particular value in SSA-form, the original
   // register it corresponds to, otherwise known as its "prototype,"
   // otherwise NULL.
   //
-  Reg *_ssa_proto;
+  Reg *_ssa_proto = 0;
 
   // In SSA-form, the list of individal values corresponding to this
   // prototype.
   //
-  std::list<Reg *> _ssa_values;
+  RegList _ssa_values;
 };
 
 
@@ -16,9 +16,9 @@
 // This differs from std::list<T>::remove as the latter removes all
 // matching entries.
 //
-template<typename T>
+template<typename T, typename Alloc>
 void
-remove_one (const T &el, std::list<T> &list)
+remove_one (const T &el, std::list<T, Alloc> &list)
 {
   for (auto iter = list.begin (); iter != list.end (); ++iter)
     if (*iter == el)
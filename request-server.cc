@@ -0,0 +1,503 @@
+// request-server.cc -- Server for requests over a Unix-domain socket
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "stats.h"
+
+#include "request-server.h"
+
+
+static Stat requests_handled ("request-server", "requests",
+			      "Number of requests handled by the server");
+static Stat bad_requests ("request-server", "bad-requests",
+			  "Number of malformed requests received");
+
+
+// Every request and reply packet starts with one of these.
+//
+static constexpr char REQUEST_MAGIC[4] = { 'C', 'C', 'R', 'Q' };
+static constexpr char REPLY_MAGIC[4] = { 'C', 'C', 'R', 'P' };
+
+// Maximum size of a request or reply packet.  Error messages which
+// won't fit in a reply are truncated.
+//
+static constexpr std::size_t MAX_PACKET_SIZE = 64 * 1024;
+
+// Number of file descriptors passed with each request.
+//
+static constexpr unsigned NUM_REQUEST_FDS = 2;
+
+
+// Return an exception describing a system-call failure involving the
+// socket SOCKET_NAME, using the current value of errno.
+//
+static std::runtime_error
+socket_error (const std::string &socket_name, const char *what)
+{
+  return std::runtime_error (socket_name + ": " + what + ": "
+			     + strerror (errno));
+}
+
+
+// Store the address of the socket named SOCKET_NAME in ADDR.
+//
+static void
+make_socket_addr (const std::string &socket_name, sockaddr_un &addr)
+{
+  memset (&addr, 0, sizeof addr);
+  addr.sun_family = AF_UNIX;
+
+  if (socket_name.size () >= sizeof addr.sun_path)
+    throw std::runtime_error (socket_name + ": Socket name too long");
+
+  memcpy (addr.sun_path, socket_name.data (), socket_name.size ());
+}
+
+
+// Append the 32-bit integer VAL to the packet PACKET.
+//
+static void
+put_u32 (std::string &packet, std::uint32_t val)
+{
+  packet.append (reinterpret_cast<const char *> (&val), sizeof val);
+}
+
+// If there are at least 4 bytes remaining in PACKET at offset OFFS,
+// store them as an integer in VAL, advance OFFS, and return true,
+// otherwise return false.
+//
+static bool
+get_u32 (std::string_view packet, std::size_t &offs, std::uint32_t &val)
+{
+  if (packet.size () - offs < sizeof val)
+    return false;
+  memcpy (&val, packet.data () + offs, sizeof val);
+  offs += sizeof val;
+  return true;
+}
+
+
+// ----------------------------------------------------------------
+// Server
+
+
+// Make a server listening on the socket named SOCKET_NAME, which
+// uses HANDLER to handle requests.  A stale socket left behind by a
+// previous server is replaced, but if another server is still
+// listening on it, an exception is thrown.
+//
+RequestServer::RequestServer (const std::string &socket_name,
+			      Handler handler)
+  : _socket_name (socket_name), _handler (handler)
+{
+  sockaddr_un addr;
+  make_socket_addr (_socket_name, addr);
+
+  _listen_fd = socket (AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (_listen_fd < 0)
+    throw socket_error (_socket_name, "Cannot create socket");
+
+  int rval = bind (_listen_fd, reinterpret_cast<sockaddr *> (&addr), sizeof addr);
+
+  if (rval < 0 && errno == EADDRINUSE)
+    {
+      // If nobody's listening on the existing socket, it was left
+      // behind by a server which died, so it's safe to replace it.
+      //
+      int probe_fd = socket (AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+      bool in_use
+	= (probe_fd >= 0
+	   && connect (probe_fd, reinterpret_cast<sockaddr *> (&addr),
+		       sizeof addr) == 0);
+      if (probe_fd >= 0)
+	close (probe_fd);
+
+      if (in_use)
+	{
+	  close (_listen_fd);
+	  throw std::runtime_error (_socket_name + ": Server already running");
+	}
+
+      unlink (_socket_name.c_str ());
+      rval = bind (_listen_fd, reinterpret_cast<sockaddr *> (&addr),
+		   sizeof addr);
+    }
+
+  if (rval < 0 || listen (_listen_fd, SOMAXCONN) < 0)
+    {
+      std::runtime_error err = socket_error (_socket_name, "Cannot listen");
+      close (_listen_fd);
+      throw err;
+    }
+}
+
+// Stop listening, and remove the socket.
+//
+RequestServer::~RequestServer ()
+{
+  close (_listen_fd);
+  unlink (_socket_name.c_str ());
+}
+
+
+// Set when the server receives SIGINT or SIGTERM.
+//
+static volatile std::sig_atomic_t interrupted = 0;
+
+static void
+interrupt_handler (int)
+{
+  interrupted = 1;
+}
+
+
+// Handle requests using NUM_WORKERS threads, until interrupted by a
+// SIGINT or SIGTERM signal.  Requests which have already been
+// accepted are finished before returning.
+//
+void
+RequestServer::serve (unsigned num_workers)
+{
+  // Connections waiting for a worker, and how workers are told to
+  // finish.
+  //
+  std::deque<int> pending;
+  bool done = false;
+  std::mutex pending_lock;
+  std::condition_variable pending_cond;
+
+  auto worker = [&] ()
+    {
+      for (;;)
+	{
+	  int conn_fd;
+	  {
+	    std::unique_lock<std::mutex> lock (pending_lock);
+	    pending_cond.wait (lock, [&] { return done || ! pending.empty (); });
+	    if (pending.empty ())
+	      return;
+	    conn_fd = pending.front ();
+	    pending.pop_front ();
+	  }
+
+	  handle_connection (conn_fd);
+	}
+    };
+
+  // A client going away while we're writing its output shouldn't kill
+  // the server; the write will just fail instead.
+  //
+  struct sigaction ignore_action, old_pipe_action;
+  memset (&ignore_action, 0, sizeof ignore_action);
+  ignore_action.sa_handler = SIG_IGN;
+  sigaction (SIGPIPE, &ignore_action, &old_pipe_action);
+
+  // Interrupting signals are delivered only to this thread, and
+  // don't restart accept, so we notice them.
+  //
+  struct sigaction interrupt_action, old_int_action, old_term_action;
+  memset (&interrupt_action, 0, sizeof interrupt_action);
+  interrupt_action.sa_handler = interrupt_handler;
+  sigaction (SIGINT, &interrupt_action, &old_int_action);
+  sigaction (SIGTERM, &interrupt_action, &old_term_action);
+
+  sigset_t interrupt_signals, old_mask;
+  sigemptyset (&interrupt_signals);
+  sigaddset (&interrupt_signals, SIGINT);
+  sigaddset (&interrupt_signals, SIGTERM);
+
+  pthread_sigmask (SIG_BLOCK, &interrupt_signals, &old_mask);
+
+  // Workers are started once and reused for every request, which
+  // also bounds how many requests run at once.
+  //
+  std::vector<std::thread> workers;
+  for (unsigned i = 0; i < std::max (num_workers, 1U); i++)
+    workers.emplace_back (worker);
+
+  pthread_sigmask (SIG_UNBLOCK, &interrupt_signals, 0);
+
+  int accept_errno = 0;
+  while (! interrupted)
+    {
+      int conn_fd = accept4 (_listen_fd, 0, 0, SOCK_CLOEXEC);
+
+      if (conn_fd < 0)
+	{
+	  // Running out of resources, or a client giving up, are
+	  // transient problems.
+	  //
+	  if (errno == EINTR || errno == ECONNABORTED || errno == EMFILE
+	      || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM)
+	    continue;
+
+	  accept_errno = errno;
+	  break;
+	}
+
+      std::lock_guard<std::mutex> lock (pending_lock);
+      pending.push_back (conn_fd);
+      pending_cond.notify_one ();
+    }
+
+  {
+    std::lock_guard<std::mutex> lock (pending_lock);
+    done = true;
+    pending_cond.notify_all ();
+  }
+
+  for (auto &thread : workers)
+    thread.join ();
+
+  pthread_sigmask (SIG_SETMASK, &old_mask, 0);
+  sigaction (SIGINT, &old_int_action, 0);
+  sigaction (SIGTERM, &old_term_action, 0);
+  sigaction (SIGPIPE, &old_pipe_action, 0);
+
+  interrupted = 0;
+
+  if (accept_errno)
+    {
+      errno = accept_errno;
+      throw socket_error (_socket_name, "Error accepting connection");
+    }
+}
+
+
+// Read a request from the connection CONN_FD, handle it, and send the
+// reply.  CONN_FD is closed when we're done.
+//
+void
+RequestServer::handle_connection (int conn_fd)
+{
+  std::string packet (MAX_PACKET_SIZE, '\0');
+
+  union
+  {
+    cmsghdr align;
+    char buf[CMSG_SPACE (NUM_REQUEST_FDS * sizeof (int))];
+  } control;
+
+  iovec iov { &packet[0], packet.size () };
+  msghdr msg;
+  memset (&msg, 0, sizeof msg);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof control.buf;
+
+  ssize_t len;
+  do
+    len = recvmsg (conn_fd, &msg, MSG_CMSG_CLOEXEC);
+  while (len < 0 && errno == EINTR);
+
+  // Collect any passed file descriptors, so they're always closed.
+  //
+  std::vector<int> fds;
+  if (len >= 0)
+    for (cmsghdr *cmsg = CMSG_FIRSTHDR (&msg); cmsg;
+	 cmsg = CMSG_NXTHDR (&msg, cmsg))
+      if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+	{
+	  unsigned num_fds = (cmsg->cmsg_len - CMSG_LEN (0)) / sizeof (int);
+	  for (unsigned i = 0; i < num_fds; i++)
+	    {
+	      int fd;
+	      memcpy (&fd, CMSG_DATA (cmsg) + i * sizeof fd, sizeof fd);
+	      fds.push_back (fd);
+	    }
+	}
+
+  // Decode the request.
+  //
+  std::vector<std::string> args;
+  bool ok = (len >= 0 && ! (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC))
+	     && fds.size () == NUM_REQUEST_FDS);
+  if (ok)
+    {
+      packet.resize (len);
+
+      std::size_t offs = sizeof REQUEST_MAGIC;
+      std::uint32_t num_args;
+      ok = (packet.size () >= offs
+	    && memcmp (packet.data (), REQUEST_MAGIC, offs) == 0
+	    && get_u32 (packet, offs, num_args));
+
+      while (ok && args.size () < num_args)
+	{
+	  std::uint32_t arg_len;
+	  ok = get_u32 (packet, offs, arg_len) && packet.size () - offs >= arg_len;
+	  if (ok)
+	    {
+	      args.emplace_back (packet, offs, arg_len);
+	      offs += arg_len;
+	    }
+	}
+    }
+
+  if (ok)
+    {
+      int status;
+      std::string errors;
+
+      try
+	{
+	  status = _handler (args, fds[0], fds[1], errors);
+	}
+      catch (std::exception &err)
+	{
+	  errors += err.what ();
+	  errors += '\n';
+	  status = 1;
+	}
+
+      ++requests_handled;
+
+      // Tell the client we're done.  If it's gone away, there's
+      // nobody to tell.
+      //
+      std::size_t max_errors_len
+	= MAX_PACKET_SIZE - sizeof REPLY_MAGIC - 2 * sizeof (std::uint32_t);
+      if (errors.size () > max_errors_len)
+	errors.resize (max_errors_len);
+
+      std::string reply (REPLY_MAGIC, sizeof REPLY_MAGIC);
+      put_u32 (reply, status);
+      put_u32 (reply, errors.size ());
+      reply += errors;
+
+      while (send (conn_fd, reply.data (), reply.size (), MSG_NOSIGNAL) < 0
+	     && errno == EINTR)
+	;
+    }
+  else
+    ++bad_requests;
+
+  for (int fd : fds)
+    close (fd);
+
+  close (conn_fd);
+}
+
+
+// ----------------------------------------------------------------
+// Client
+
+
+// Send a request with the arguments ARGS, input file descriptor
+// SRC_FD, and output file descriptor OUT_FD, to the server listening
+// on the socket named SOCKET_NAME, and wait for the reply.  Store the
+// reply's exit status in STATUS and error messages in ERRORS, and
+// return true.
+//
+// If no server is listening on SOCKET_NAME, return false.  If the
+// server fails while handling the request, an exception is thrown.
+//
+bool
+RequestServer::send_request (const std::string &socket_name,
+			     const std::vector<std::string> &args,
+			     int src_fd, int out_fd,
+			     int &status, std::string &errors)
+{
+  std::string request (REQUEST_MAGIC, sizeof REQUEST_MAGIC);
+  put_u32 (request, args.size ());
+  for (auto &arg : args)
+    {
+      put_u32 (request, arg.size ());
+      request += arg;
+    }
+
+  if (request.size () > MAX_PACKET_SIZE)
+    throw std::runtime_error (socket_name + ": Request too large");
+
+  sockaddr_un addr;
+  make_socket_addr (socket_name, addr);
+
+  int sock_fd = socket (AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (sock_fd < 0)
+    throw socket_error (socket_name, "Cannot create socket");
+
+  if (connect (sock_fd, reinterpret_cast<sockaddr *> (&addr), sizeof addr) < 0)
+    {
+      close (sock_fd);
+      return false;
+    }
+
+  union
+  {
+    cmsghdr align;
+    char buf[CMSG_SPACE (NUM_REQUEST_FDS * sizeof (int))];
+  } control;
+  memset (&control, 0, sizeof control);
+
+  iovec iov { &request[0], request.size () };
+  msghdr msg;
+  memset (&msg, 0, sizeof msg);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof control.buf;
+
+  int fds[NUM_REQUEST_FDS] = { src_fd, out_fd };
+  cmsghdr *cmsg = CMSG_FIRSTHDR (&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN (sizeof fds);
+  memcpy (CMSG_DATA (cmsg), fds, sizeof fds);
+
+  ssize_t rval;
+  do
+    rval = sendmsg (sock_fd, &msg, MSG_NOSIGNAL);
+  while (rval < 0 && errno == EINTR);
+
+  if (rval < 0)
+    {
+      std::runtime_error err = socket_error (socket_name, "Error sending request");
+      close (sock_fd);
+      throw err;
+    }
+
+  std::string reply (MAX_PACKET_SIZE, '\0');
+  do
+    rval = recv (sock_fd, &reply[0], reply.size (), 0);
+  while (rval < 0 && errno == EINTR);
+
+  close (sock_fd);
+
+  std::size_t offs = sizeof REPLY_MAGIC;
+  std::uint32_t reply_status, errors_len;
+  if (rval >= 0)
+    reply.resize (rval);
+  if (rval < 0 || reply.size () < offs
+      || memcmp (reply.data (), REPLY_MAGIC, offs) != 0
+      || ! get_u32 (reply, offs, reply_status)
+      || ! get_u32 (reply, offs, errors_len)
+      || reply.size () - offs != errors_len)
+    throw std::runtime_error (socket_name + ": Server failed to handle request");
+
+  status = reply_status;
+  errors.assign (reply, offs, errors_len);
+
+  return true;
+}
@@ -0,0 +1,109 @@
+// request-server.h -- Server for requests over a Unix-domain socket
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#ifndef __REQUEST_SERVER_H__
+#define __REQUEST_SERVER_H__
+
+#include <functional>
+#include <string>
+#include <vector>
+
+
+// A server which accepts requests from clients over a Unix-domain
+// socket, and handles them on a pool of long-lived worker threads.
+//
+// A request is a list of argument strings, along with two file
+// descriptors passed from the client: one to read input from, and one
+// to write output to.  As the server reads and writes the client's
+// files directly, no data is copied through the socket.  The reply is
+// an exit status and any error messages.
+//
+// Each connection carries a single request and its reply, each of
+// which is a single packet.
+//
+// The round trip only takes tens of microseconds, but a client is
+// still a whole process, and the server does the same work the client
+// would have, so a request takes about as long as doing it locally.
+// What a server gives is a shared limit on how many requests run at
+// once, and a single owner for resources such as a cache.
+//
+class RequestServer
+{
+public:
+
+  // A function which handles a request with the arguments ARGS,
+  // reading input from the file descriptor SRC_FD, and writing output
+  // to OUT_FD.  Error messages should be stored in ERRORS, and the
+  // request's exit status returned.  It may be called on several
+  // threads at once.
+  //
+  typedef std::function<int (const std::vector<std::string> &args,
+			     int src_fd, int out_fd, std::string &errors)>
+    Handler;
+
+
+  // Make a server listening on the socket named SOCKET_NAME, which
+  // uses HANDLER to handle requests.  A stale socket left behind by a
+  // previous server is replaced, but if another server is still
+  // listening on it, an exception is thrown.
+  //
+  RequestServer (const std::string &socket_name, Handler handler);
+
+  // Stop listening, and remove the socket.
+  //
+  ~RequestServer ();
+
+  RequestServer (const RequestServer &) = delete;
+  RequestServer &operator= (const RequestServer &) = delete;
+
+
+  // Handle requests using NUM_WORKERS threads, until interrupted by a
+  // SIGINT or SIGTERM signal.  Requests which have already been
+  // accepted are finished before returning.
+  //
+  void serve (unsigned num_workers);
+
+
+  // Send a request with the arguments ARGS, input file descriptor
+  // SRC_FD, and output file descriptor OUT_FD, to the server listening
+  // on the socket named SOCKET_NAME, and wait for the reply.  Store
+  // the reply's exit status in STATUS and error messages in ERRORS,
+  // and return true.
+  //
+  // If no server is listening on SOCKET_NAME, return false.  If the
+  // server fails while handling the request, an exception is thrown.
+  //
+  static bool send_request (const std::string &socket_name,
+			    const std::vector<std::string> &args,
+			    int src_fd, int out_fd,
+			    int &status, std::string &errors);
+
+
+private:
+
+  // Read a request from the connection CONN_FD, handle it, and send
+  // the reply.  CONN_FD is closed when we're done.
+  //
+  void handle_connection (int conn_fd);
+
+
+  // Name of the socket we're listening on.
+  //
+  std::string _socket_name;
+
+  // Function used to handle requests.
+  //
+  Handler _handler;
+
+  // Listening socket.
+  //
+  int _listen_fd = -1;
+};
+
+
+#endif // __REQUEST_SERVER_H__
@@ -9,6 +9,7 @@
 #ifndef __SRC_CONTEXT_H__
 #define __SRC_CONTEXT_H__
 
+#include <cstdint>
 #include <string>
 
 
@@ -20,7 +21,7 @@ public:
 
   // A source location within this context.
   //
-  typedef unsigned long Loc;
+  typedef std::uint64_t Loc;
 
   // Signal an exception for an error at location LOC within this
   // context with message MSG.
@@ -17,19 +17,18 @@ SrcFileInput::read_unsigned ()
 {
   skip_whitespace ();
 
-  char ch = peek ();
-  if (ch >= '0' && ch <= '9')
-    {
-      unsigned num = 0;
-      do
-	num = num * 10 + (read_char () - '0');
-      while ((ch = peek ()) >= '0' && ch <= '9');
-      return num;
-    }
-  else
-    {
-      error ("Expected unsigned integer");
-    }
+  const char *beg = line_pos ();
+  const char *end = scan_digits (beg, line_end ());
+  if (beg == end)
+    error ("Expected unsigned integer");
+
+  unsigned num = 0;
+  for (const char *p = beg; p != end; p++)
+    num = num * 10 + (*p - '0');
+
+  consume_in_line (end - beg);
+
+  return num;
 }
 
 // Read and return a signed integer, or signal an error if none
@@ -42,65 +41,82 @@ SrcFileInput::read_int ()
 
   bool is_negative = skip ('-');
 
-  char ch = peek ();
-  if (ch >= '0' && ch <= '9')
-    {
-      int num = 0;
+  const char *beg = line_pos ();
+  const char *end = scan_digits (beg, line_end ());
+  if (beg == end)
+    error ("Expected integer");
 
-      do
-	num = num * 10 + (read_char () - '0');
-      while ((ch = peek ()) >= '0' && ch <= '9');
+  int num = 0;
+  for (const char *p = beg; p != end; p++)
+    num = num * 10 + (*p - '0');
 
-      return is_negative ? -num : num;
-    }
-  else
-    {
-      error ("Expected integer");
-    }
+  consume_in_line (end - beg);
+
+  return is_negative ? -num : num;
 }
 
 
 // Read and return an identifier name (/[_a-zA-Z][_a-zA-Z0-9]*/), or
 // signal an error if none.
 //
-std::string
+std::string_view
 SrcFileInput::read_id ()
 {
   skip_whitespace ();
 
-  char ch = peek ();
-  if (is_id_start_char (ch))
-    {
-      std::string id;
-      do
-	id += read_char ();
-      while (is_id_cont_char (peek ()));
-      return id;
-    }
-  else
-    {
-      error ("Expected identifier");
-    }
+  const char *beg = line_pos ();
+  if (beg == line_end () || ! is_id_start_char (*beg))
+    error ("Expected identifier");
+
+  const char *end = scan_id_chars (beg + 1, line_end ());
+
+  consume_in_line (end - beg);
+
+  return std::string_view (beg, end - beg);
+}
+
+
+// Return the identifier name following the current position, or an
+// empty string if there is none, without consuming it.
+//
+std::string_view
+SrcFileInput::peek_id ()
+{
+  skip_whitespace ();
+
+  const char *beg = line_pos ();
+  if (beg == line_end () || ! is_id_start_char (*beg))
+    return std::string_view ();
+
+  const char *end = scan_id_chars (beg + 1, line_end ());
+
+  return std::string_view (beg, end - beg);
 }
 
 
-// Read and return a string terminated by TERMINATOR.
-// TERMINATOR is consumed, but not put into the returned string.
+// Read and return a string terminated by TERMINATOR, which must
+// occur in the current line.  TERMINATOR is consumed, but not put
+// into the returned string, and any whitespace surrounding the
+// string is ignored.
 //
-std::string
+std::string_view
 SrcFileInput::read_delimited_string (char terminator)
 {
-  std::string value;
+  skip_whitespace ();
 
-  while (! skip (terminator))
-    {
-      if (at_eof ())
-	error (std::string ("Missing terminator '") + terminator + "'");
+  const char *beg = line_pos ();
+  const char *term
+    = static_cast<const char *> (memchr (beg, terminator, line_end () - beg));
+  if (! term)
+    error (std::string ("Missing terminator '") + terminator + "'");
 
-      value += read_char ();
-    }
+  const char *end = term;
+  while (end != beg && is_whitespace (end[-1]))
+    end--;
+
+  consume_in_line (term + 1 - beg);
 
-  return value;
+  return std::string_view (beg, end - beg);
 }
 
 
@@ -144,22 +160,15 @@ SrcFileInput::skip (char ch)
     }
 }
 
-// If the keyword KEYW follows the current position, skip it, and
-// return true, otherwise return false.
-//
-// KEYW does not actually have to be a real keyword; that is, it
-// doesn't have to begin with a valid identifier character.  The
-// only difference in the way non-keywords are handled is that they
-// can be immediately (without any whitespace) followed by an
-// identifier.
+// If the keyword KEYW, which is KEYW_LEN characters long, follows
+// the current position, skip it, and return true, otherwise return
+// false.
 //
 bool
-SrcFileInput::skip (const char *keyw)
+SrcFileInput::skip (const char *keyw, unsigned keyw_len)
 {
   skip_whitespace ();
 
-  unsigned keyw_len = strlen (keyw);
-
   if (! avail_in_line (keyw_len))
     return false;
 
@@ -170,9 +179,8 @@ SrcFileInput::skip (const char *keyw)
   if (is_id_start_char (*keyw) && is_id_cont_char (peek_in_line (keyw_len)))
     return false;
 
-  for (unsigned i = 0; i < keyw_len; i++)
-    if (peek_in_line (i) != keyw[i])
-      return false;
+  if (memcmp (line_pos (), keyw, keyw_len) != 0)
+    return false;
 
   consume_in_line (keyw_len);
 
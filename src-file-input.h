@@ -11,6 +11,9 @@
 
 #include <cstring>
 #include <string>
+#include <string_view>
+
+#include "char-scan.h"
 
 #include "file-input.h"
 
@@ -18,6 +21,10 @@
 // A text input source, adds somewhat higher-level methods on top of a
 // file stream for source-code input.
 //
+// Tokens are recognized by scanning the current line buffer directly
+// (see char-scan.h), and string results are returned as views into
+// the line buffer, which are valid until the next line is read.
+//
 class SrcFileInput : public FileInput
 {
 public:
@@ -34,6 +41,26 @@ public:
     : FileInput (file_name, src_context, line_oriented)
   { }
 
+  // Make a new source-file stream reading CONTENTS, which are the
+  // contents of the file named FILE_NAME, in the source context
+  // SRC_CONTEXT.  LINE_ORIENTED is as for the previous constructor.
+  //
+  SrcFileInput (std::unique_ptr<FileContents> contents,
+		const std::string &file_name, FileSrcContext &src_context,
+		bool line_oriented = false)
+    : FileInput (std::move (contents), file_name, src_context, line_oriented)
+  { }
+
+  // Make a new source-file stream reading only the part of PARENT's
+  // file in the byte range [BEG_OFFS, END_OFFS); see the corresponding
+  // FileInput constructor.
+  //
+  SrcFileInput (const SrcFileInput &parent,
+		std::size_t beg_offs, std::size_t end_offs,
+		bool line_oriented = false)
+    : FileInput (parent, beg_offs, end_offs, line_oriented)
+  { }
+
 
   // Read and return an unsigned integer, or signal an error if none
   // can be read.
@@ -48,13 +75,20 @@ public:
   // Read and return an identifier name (/[_a-zA-Z][_a-zA-Z0-9]*/), or
   // signal an error if none.
   //
-  std::string read_id ();
+  std::string_view read_id ();
 
+  // Return the identifier name following the current position, or an
+  // empty string if there is none, without consuming it.
+  //
+  std::string_view peek_id ();
 
-  // Read and return a string terminated by TERMINATOR.
-  // TERMINATOR is consumed, but not put into the returned string.
+
+  // Read and return a string terminated by TERMINATOR, which must
+  // occur in the current line.  TERMINATOR is consumed, but not put
+  // into the returned string, and any whitespace surrounding the
+  // string is ignored.
   //
-  std::string read_delimited_string (char terminator);
+  std::string_view read_delimited_string (char terminator);
 
 
   // If the character CH is the next unread character, do nothing,
@@ -88,14 +122,28 @@ public:
   // can be immediately (without any whitespace) followed by an
   // identifier.
   //
-  bool skip (const char *keyw);
+  bool skip (const char *keyw) { return skip (keyw, strlen (keyw)); }
+
+  // Like SrcFileInput::skip (const char *), but KEYW is KEYW_LEN
+  // characters long.
+  //
+  bool skip (const char *keyw, unsigned keyw_len);
 
   // Skip any whitespace characters at the current position.
   //
   void skip_whitespace ()
   {
-    while (is_whitespace (peek ()))
-      read_char ();
+    for (;;)
+      {
+	const char *pos = line_pos ();
+	consume_in_line (scan_whitespace (pos, line_end ()) - pos);
+
+	// In non-line-oriented mode, whitespace may continue on
+	// following lines, and peeking will read the next line.
+	//
+	if (! at_eol () || ! peek ())
+	  break;
+      }
   }
 
 
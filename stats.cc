@@ -0,0 +1,189 @@
+// stats.cc -- Named statistics counters
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+#include "stats.h"
+
+
+namespace {
+
+struct StatThreadCounts;
+
+// All registered statistics, most recent first, and how many there
+// are.  These are constant-initialized, so stats can be registered
+// during static initialization without any other setup.
+//
+std::atomic<Stat *> all_stats { 0 };
+std::atomic<unsigned> num_stats { 0 };
+
+// Global counting state.  This is allocated on first use, and never
+// freed, so that it's valid during thread exit (when per-thread
+// counts are merged).
+//
+struct StatRegistry
+{
+  std::mutex lock;
+
+  // Counts merged from threads which have exited.
+  //
+  std::vector<std::uint64_t> merged_counts;
+
+  // Counts for all threads which are still running.
+  //
+  std::unordered_set<StatThreadCounts *> live_threads;
+};
+
+StatRegistry &
+registry ()
+{
+  static StatRegistry *reg = new StatRegistry;
+  return *reg;
+}
+
+
+// Per-thread counts.  These are registered in the global registry so
+// that a report can see them, and merged into the registry's totals
+// when the thread exits.
+//
+struct StatThreadCounts
+{
+  StatThreadCounts ()
+  {
+    StatRegistry &reg = registry ();
+    std::lock_guard<std::mutex> guard (reg.lock);
+    reg.live_threads.insert (this);
+  }
+
+  ~StatThreadCounts ()
+  {
+    StatRegistry &reg = registry ();
+    std::lock_guard<std::mutex> guard (reg.lock);
+
+    if (reg.merged_counts.size () < num_counts)
+      reg.merged_counts.resize (num_counts);
+    for (unsigned i = 0; i < num_counts; i++)
+      reg.merged_counts[i] += counts[i].load (std::memory_order_relaxed);
+
+    reg.live_threads.erase (this);
+  }
+
+  // Counts, indexed by Stat::_index.  Only the owning thread changes
+  // them, but a report may read them at any time, so they are atomic;
+  // relaxed loads and stores are enough, and cost the same as plain
+  // ones.  The array is only replaced while holding the registry
+  // lock.
+  //
+  std::unique_ptr<std::atomic<std::uint64_t>[]> counts;
+  unsigned num_counts = 0;
+};
+
+thread_local StatThreadCounts thread_counts;
+
+} // namespace
+
+
+// Register a new statistic called NAME in the group GROUP (usually
+// the name of the source file defining it), with the description
+// DESC.  All arguments must be strings with static storage duration.
+//
+Stat::Stat (const char *group, const char *name, const char *desc)
+  : _group (group), _name (name), _desc (desc),
+    _index (num_stats.fetch_add (1)),
+    _next (all_stats.load ())
+{
+  while (! all_stats.compare_exchange_weak (_next, this))
+    ;
+}
+
+
+// Add COUNT to this statistic.
+//
+void
+Stat::add (std::uint64_t count)
+{
+  StatThreadCounts &thread = thread_counts;
+
+  if (thread.num_counts <= _index)
+    {
+      // Only the owning thread ever changes its counts, so they can
+      // be copied without the lock, but a report may be reading the
+      // old array concurrently.
+      //
+      unsigned num_counts = num_stats.load ();
+      std::unique_ptr<std::atomic<std::uint64_t>[]> counts
+	(new std::atomic<std::uint64_t>[num_counts] ());
+      for (unsigned i = 0; i < thread.num_counts; i++)
+	counts[i].store (thread.counts[i].load (std::memory_order_relaxed),
+			 std::memory_order_relaxed);
+
+      StatRegistry &reg = registry ();
+      std::lock_guard<std::mutex> guard (reg.lock);
+      thread.counts.swap (counts);
+      thread.num_counts = num_counts;
+    }
+
+  std::atomic<std::uint64_t> &slot = thread.counts[_index];
+  slot.store (slot.load (std::memory_order_relaxed) + count,
+	      std::memory_order_relaxed);
+}
+
+
+// Return the total count for this statistic, over all threads.
+//
+std::uint64_t
+Stat::total () const
+{
+  StatRegistry &reg = registry ();
+  std::lock_guard<std::mutex> guard (reg.lock);
+
+  std::uint64_t sum = 0;
+  if (_index < reg.merged_counts.size ())
+    sum += reg.merged_counts[_index];
+  for (auto thread : reg.live_threads)
+    if (_index < thread->num_counts)
+      sum += thread->counts[_index].load (std::memory_order_relaxed);
+
+  return sum;
+}
+
+
+// Write a report of all non-zero statistics to OUT.
+//
+void
+Stat::report (std::ostream &out)
+{
+  std::vector<Stat *> stats;
+  for (Stat *stat = all_stats.load (); stat; stat = stat->_next)
+    stats.push_back (stat);
+
+  std::sort (stats.begin (), stats.end (),
+	     [] (Stat *a, Stat *b)
+	     {
+	       int cmp = strcmp (a->group (), b->group ());
+	       return cmp ? cmp < 0 : strcmp (a->name (), b->name ()) < 0;
+	     });
+
+  out << "Statistics:\n";
+
+  for (auto stat : stats)
+    if (std::uint64_t total = stat->total ())
+      out << std::setw (12) << total << ' '
+	  << std::left
+	  << std::setw (18) << stat->group () << ' '
+	  << std::setw (28) << stat->name ()
+	  << std::right
+	  << " - " << stat->desc () << '\n';
+}
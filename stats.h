@@ -0,0 +1,81 @@
+// stats.h -- Named statistics counters
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <cstdint>
+#include <ostream>
+
+
+// A named statistics counter, which code can bump to record how often
+// something happened (for instance, how many copies a pass removed).
+//
+// Stats are intended to be static objects, defined in the source file
+// which bumps them.  Registering one just links it into a list, so
+// they cost nothing at startup.  Counting is done in thread-local
+// storage, so bumping a stat never takes a lock; per-thread counts
+// are merged into global totals when a thread exits, or when a report
+// is made.
+//
+class Stat
+{
+public:
+
+  // Register a new statistic called NAME in the group GROUP (usually
+  // the name of the source file defining it), with the description
+  // DESC.  All arguments must be strings with static storage duration.
+  //
+  Stat (const char *group, const char *name, const char *desc);
+
+  Stat (const Stat &) = delete;
+  Stat &operator= (const Stat &) = delete;
+
+
+  // Add COUNT to this statistic.
+  //
+  void add (std::uint64_t count);
+
+  Stat &operator++ () { add (1); return *this; }
+  Stat &operator+= (std::uint64_t count) { add (count); return *this; }
+
+
+  // Return the total count for this statistic, over all threads.
+  //
+  std::uint64_t total () const;
+
+
+  // Return the name / group / description of this statistic.
+  //
+  const char *name () const { return _name; }
+  const char *group () const { return _group; }
+  const char *desc () const { return _desc; }
+
+
+  // Write a report of all non-zero statistics to OUT.
+  //
+  static void report (std::ostream &out);
+
+
+private:
+
+  // Group, name, and description of this statistic.
+  //
+  const char *_group, *_name, *_desc;
+
+  // Index of this statistic in per-thread counter vectors.
+  //
+  unsigned _index;
+
+  // The next statistic in the list of all statistics.
+  //
+  Stat *_next;
+};
+
+
+#endif // __STATS_H__
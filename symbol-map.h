@@ -0,0 +1,149 @@
+// symbol-map.h -- Hash tables keyed by symbols
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#ifndef __SYMBOL_MAP_H__
+#define __SYMBOL_MAP_H__
+
+#include <cstdint>
+#include <vector>
+
+#include "symbol.h"
+
+
+// A map from symbols to values of type T, implemented as an
+// open-addressing hash table keyed by symbol ID.  Because symbol IDs
+// are already unique, lookups never need to look at names.
+//
+// T must be default-constructible, and a default-constructed T is
+// used as the value of newly added entries.
+//
+template<typename T>
+class SymbolMap
+{
+public:
+
+  // Return a pointer to the value for KEY, or zero if KEY isn't in
+  // this map.
+  //
+  T *find (Symbol key)
+  {
+    if (_used.empty ())
+      return 0;
+
+    Entry &entry = lookup (key.id ());
+    return entry.id == key.id () ? &entry.value : 0;
+  }
+
+  // Return a reference to the value for KEY, adding a new entry if
+  // KEY isn't in this map.
+  //
+  T &operator[] (Symbol key)
+  {
+    if ((_used.size () + 1) * 2 > _entries.size ())
+      grow ();
+
+    Entry &entry = lookup (key.id ());
+    if (entry.id != key.id ())
+      {
+	entry.id = key.id ();
+	_used.push_back (&entry - _entries.data ());
+      }
+
+    return entry.value;
+  }
+
+
+  // Remove all entries from this map.  The table's storage is kept
+  // for reuse, and only the entries actually used are reset, so this
+  // takes time proportional to the number of entries, not to the
+  // size of the table.
+  //
+  void clear ()
+  {
+    for (auto idx : _used)
+      _entries[idx] = Entry ();
+    _used.clear ();
+  }
+
+
+  // Return the number of entries in this map.
+  //
+  unsigned size () const { return _used.size (); }
+
+
+private:
+
+  // ID used in unused entries.  This isn't a valid symbol ID.
+  //
+  static constexpr unsigned NO_ID = ~0u;
+
+  struct Entry
+  {
+    unsigned id = NO_ID;
+    T value = T ();
+  };
+
+
+  // Return the entry for symbol ID ID, or the unused entry where it
+  // should be added if there is none.  The table must not be full.
+  //
+  Entry &lookup (unsigned id)
+  {
+    // Symbol IDs are allocated sequentially, so scramble them with
+    // Fibonacci hashing (multiplying by 2^32 / phi and keeping the
+    // top bits of the 32-bit product) to spread nearby IDs around
+    // the table.
+    //
+    std::size_t mask = _entries.size () - 1;
+    std::size_t idx = std::uint32_t (id * 2654435769u) >> _hash_shift;
+
+    while (_entries[idx].id != id && _entries[idx].id != NO_ID)
+      idx = (idx + 1) & mask;
+
+    return _entries[idx];
+  }
+
+  // Double the size of the table.
+  //
+  void grow ()
+  {
+    std::vector<Entry> old_entries;
+    old_entries.swap (_entries);
+
+    _entries.resize (old_entries.empty () ? 16 : old_entries.size () * 2);
+    _hash_shift = old_entries.empty () ? 32 - 4 : _hash_shift - 1;
+
+    std::vector<unsigned> old_used;
+    old_used.swap (_used);
+    _used.reserve (old_used.size ());
+
+    for (auto old_idx : old_used)
+      {
+	Entry &entry = lookup (old_entries[old_idx].id);
+	entry = old_entries[old_idx];
+	_used.push_back (&entry - _entries.data ());
+      }
+  }
+
+
+  // Hash table entries.  The size is always zero or a power of two.
+  //
+  std::vector<Entry> _entries;
+
+  // Bits to shift a 32-bit hash right to get an index into _entries,
+  // i.e., 32 - log2 of its size.
+  //
+  unsigned _hash_shift = 32;
+
+  // Indices of the used entries in _entries, in the order added.
+  //
+  std::vector<unsigned> _used;
+};
+
+
+#endif // __SYMBOL_MAP_H__
@@ -0,0 +1,226 @@
+// symbol.cc -- Interned names
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include "mem-account.h"
+
+#include "symbol.h"
+
+
+// Interned data for the empty symbol.
+//
+const Symbol::Data Symbol::_empty_data = { std::string_view (), 0 };
+
+
+// The global table of interned names.
+//
+// The table is split into independently locked shards, selected by
+// hash value, so that threads interning different names rarely
+// contend.  Each shard is an open-addressing hash table of pointers
+// to symbol data, which (along with the name characters) is allocated
+// in a per-shard arena.
+//
+class SymbolTable
+{
+public:
+
+  // Return the interned data for the name NAME.
+  //
+  const Symbol::Data *intern (std::string_view name);
+
+
+private:
+
+  static constexpr unsigned NUM_SHARDS = 16;
+
+  // Size of each arena block, unless an individual name needs more.
+  //
+  static constexpr std::size_t ARENA_BLOCK_SIZE = 64 * 1024;
+
+  struct Shard
+  {
+    std::mutex lock;
+
+    // Hash table of interned symbols, with a size that's a power of
+    // two; unused entries are zero.
+    //
+    std::vector<const Symbol::Data *> table;
+
+    // Number of symbols in TABLE.
+    //
+    unsigned count = 0;
+
+    // Unused part of the current arena block.
+    //
+    char *arena_pos = 0, *arena_end = 0;
+
+    // All arena blocks allocated for this shard.
+    //
+    std::vector<std::unique_ptr<char[]>> arena_blocks;
+  };
+
+
+  // Return a new symbol data object for NAME with id ID, allocated in
+  // the arena of SHARD.
+  //
+  static const Symbol::Data *make_data (Shard &shard,
+					std::string_view name, unsigned id);
+
+  // Double the size of SHARD's hash table.
+  //
+  static void grow (Shard &shard);
+
+
+  Shard _shards[NUM_SHARDS];
+
+  // ID of the next symbol to be interned.  ID 0 is reserved for the
+  // empty symbol.
+  //
+  std::atomic<unsigned> _next_id { 1 };
+};
+
+
+// Return the hash of NAME (FNV-1a).
+//
+static inline std::uint64_t
+symbol_hash (std::string_view name)
+{
+  std::uint64_t hash = 14695981039346656037ull;
+  for (char ch : name)
+    {
+      hash ^= static_cast<unsigned char> (ch);
+      hash *= 1099511628211ull;
+    }
+  return hash;
+}
+
+
+// Return the interned data for the name NAME.
+//
+const Symbol::Data *
+SymbolTable::intern (std::string_view name)
+{
+  std::uint64_t hash = symbol_hash (name);
+
+  // The shard is chosen using the high bits of the hash, and the
+  // position within the shard's table using the low bits.
+  //
+  Shard &shard = _shards[hash >> 60];
+
+  std::lock_guard<std::mutex> guard (shard.lock);
+
+  // The table and arenas are shared by everything, and never freed,
+  // so they are kept out of memory accounting.
+  //
+  MemAccount::Pause pause;
+
+  if ((shard.count + 1) * 4 > shard.table.size () * 3)
+    grow (shard);
+
+  std::size_t mask = shard.table.size () - 1;
+  for (std::size_t idx = hash & mask; ; idx = (idx + 1) & mask)
+    {
+      const Symbol::Data *data = shard.table[idx];
+
+      if (! data)
+	{
+	  data = make_data (shard, name, _next_id++);
+	  shard.table[idx] = data;
+	  shard.count++;
+	  return data;
+	}
+
+      if (data->name == name)
+	return data;
+    }
+}
+
+
+// Return a new symbol data object for NAME with id ID, allocated in
+// the arena of SHARD.
+//
+const Symbol::Data *
+SymbolTable::make_data (Shard &shard, std::string_view name, unsigned id)
+{
+  static const std::size_t ALIGN = alignof (Symbol::Data);
+
+  std::size_t size = sizeof (Symbol::Data) + name.size ();
+  size = (size + ALIGN - 1) & ~(ALIGN - 1);
+
+  if (static_cast<std::size_t> (shard.arena_end - shard.arena_pos) < size)
+    {
+      std::size_t block_size = std::max (size, ARENA_BLOCK_SIZE);
+      shard.arena_blocks.emplace_back (new char[block_size]);
+      shard.arena_pos = shard.arena_blocks.back ().get ();
+      shard.arena_end = shard.arena_pos + block_size;
+    }
+
+  char *mem = shard.arena_pos;
+  shard.arena_pos += size;
+
+  char *chars = mem + sizeof (Symbol::Data);
+  memcpy (chars, name.data (), name.size ());
+
+  return new (mem) Symbol::Data { std::string_view (chars, name.size ()), id };
+}
+
+
+// Double the size of SHARD's hash table.
+//
+void
+SymbolTable::grow (Shard &shard)
+{
+  std::vector<const Symbol::Data *> old_table;
+  old_table.swap (shard.table);
+
+  shard.table.resize (old_table.empty () ? 64 : old_table.size () * 2);
+
+  std::size_t mask = shard.table.size () - 1;
+  for (auto data : old_table)
+    if (data)
+      {
+	std::size_t idx = symbol_hash (data->name) & mask;
+	while (shard.table[idx])
+	  idx = (idx + 1) & mask;
+	shard.table[idx] = data;
+      }
+}
+
+
+// Return the symbol whose name is NAME, interning NAME if it hasn't
+// been seen before.  NAME is only copied the first time.
+//
+Symbol::Symbol (std::string_view name)
+{
+  if (name.empty ())
+    {
+      _data = &_empty_data;
+    }
+  else
+    {
+      // The table is allocated on first use, and never freed, so that
+      // symbols may be used during static initialization and
+      // destruction.
+      //
+      static SymbolTable *table = [] ()
+	{
+	  MemAccount::Pause pause;
+	  return new SymbolTable;
+	} ();
+
+      _data = table->intern (name);
+    }
+}
@@ -0,0 +1,82 @@
+// symbol.h -- Interned names
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#ifndef __SYMBOL_H__
+#define __SYMBOL_H__
+
+#include <string_view>
+
+
+// An interned name.  All symbols with the same name share a single
+// copy of it, so symbols are cheap to copy and compare, and each has
+// a small integer ID which can be used as a hash key.
+//
+// Interned names are stored in a global arena, and never freed, so
+// names which are made up in bulk during processing (such as SSA
+// value names) shouldn't be interned, or a long-running process will
+// grow without bound.  Interning may be done concurrently from
+// multiple threads.
+//
+class Symbol
+{
+public:
+
+  // Return the empty symbol, whose name is "" and whose ID is 0.
+  //
+  Symbol () : _data (&_empty_data) { }
+
+  // Return the symbol whose name is NAME, interning NAME if it hasn't
+  // been seen before.  NAME is only copied the first time.
+  //
+  explicit Symbol (std::string_view name);
+
+
+  // Return this symbol's name.  The returned string is valid for the
+  // rest of program execution.
+  //
+  std::string_view name () const { return _data->name; }
+
+  // Return this symbol's ID, which is unique to its name.  The empty
+  // symbol has ID 0, and all others have small positive IDs.
+  //
+  unsigned id () const { return _data->id; }
+
+  // Return true if this is the empty symbol.
+  //
+  bool empty () const { return _data->id == 0; }
+
+
+  bool operator== (Symbol other) const { return _data == other._data; }
+  bool operator!= (Symbol other) const { return _data != other._data; }
+
+
+private:
+
+  // The interned data for a symbol, allocated in the global arena.
+  //
+  struct Data
+  {
+    std::string_view name;
+    unsigned id;
+  };
+
+  friend class SymbolTable;
+
+
+  // Interned data for the empty symbol.
+  //
+  static const Data _empty_data;
+
+
+  // This symbol's interned data.
+  //
+  const Data *_data;
+};
+
+
+#endif // __SYMBOL_H__
@@ -0,0 +1,622 @@
+// trace.cc -- Low-overhead execution tracing
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#include "trace.h"
+
+
+std::atomic<bool> Trace::_enabled (false);
+
+
+namespace {
+
+// A single recorded region.
+//
+struct TraceEvent
+{
+  const char *name;
+  std::string detail;
+  bool detail_inherited;
+  Trace::Time beg, end;
+  PerfCounters::Counts counts;
+
+  // Change in memory use, if it was being accounted.
+  //
+  std::unique_ptr<MemAccount::Usage> mem;
+};
+
+// Events recorded by a single thread.  These are only ever appended
+// to by their owning thread, so no locking is needed for recording.
+//
+struct TraceThreadBuf
+{
+  TraceThreadBuf (unsigned _tid) : tid (_tid) { }
+
+  // Small sequential thread number, used as the trace "tid".
+  //
+  unsigned tid;
+
+  std::vector<TraceEvent> events;
+};
+
+// Global registry of per-thread buffers.  Buffers are owned here
+// rather than by their thread, so that events recorded by threads
+// which have since exited are still available for output.
+//
+std::mutex thread_bufs_lock;
+std::vector<std::unique_ptr<TraceThreadBuf>> thread_bufs;
+
+// The time origin for Trace::now.
+//
+std::chrono::steady_clock::time_point trace_epoch;
+
+// This thread's event buffer, or zero if it hasn't recorded anything
+// yet.
+//
+thread_local TraceThreadBuf *cur_thread_buf = 0;
+
+// The innermost traced region currently active in this thread, if
+// any.
+//
+thread_local TraceSpan *cur_span = 0;
+
+
+// Return this thread's event buffer, registering it if necessary.
+//
+TraceThreadBuf *
+thread_buf ()
+{
+  if (! cur_thread_buf)
+    {
+      std::lock_guard<std::mutex> guard (thread_bufs_lock);
+      thread_bufs.emplace_back (new TraceThreadBuf (thread_bufs.size () + 1));
+      cur_thread_buf = thread_bufs.back ().get ();
+    }
+
+  return cur_thread_buf;
+}
+
+
+// Totals for a set of recorded regions.
+//
+struct TraceTotals
+{
+  void add (const TraceEvent &event)
+  {
+    if (calls++ == 0)
+      counts = event.counts;
+    else
+      counts += event.counts;
+    time += event.end - event.beg;
+
+    if (event.mem)
+      {
+	mem_net += event.mem->total_bytes;
+	mem_peak = std::max (mem_peak, event.mem->peak_bytes);
+      }
+  }
+
+  unsigned calls = 0;
+  Trace::Time time = 0;
+  PerfCounters::Counts counts;
+
+  // Net memory allocated, and the highest high-water mark.
+  //
+  std::int64_t mem_net = 0, mem_peak = 0;
+};
+
+// Return a short printable form of COUNT, with a suffix such as "M"
+// for large numbers.
+//
+std::string
+format_count (std::uint64_t count)
+{
+  static const char suffixes[] = " KMGT";
+
+  double val = count;
+  unsigned suffix = 0;
+  while (val >= 1000 && suffixes[suffix + 1])
+    {
+      val /= 1000;
+      suffix++;
+    }
+
+  std::ostringstream out;
+  if (suffix == 0)
+    out << count;
+  else
+    out << std::fixed << std::setprecision (val < 10 ? 2 : 1)
+	<< val << suffixes[suffix];
+  return out.str ();
+}
+
+// Return a printable form of the time TIME, in nanoseconds.
+//
+std::string
+format_time (Trace::Time time)
+{
+  std::ostringstream out;
+  out << std::fixed << std::setprecision (2);
+  if (time >= 1000000000)
+    out << time / 1e9 << " s";
+  else if (time >= 1000000)
+    out << time / 1e6 << " ms";
+  else
+    out << time / 1e3 << " us";
+  return out.str ();
+}
+
+// Write the headings for a summary table to OUT, with the label
+// column headed LABEL, and LABEL_WIDTH wide.
+//
+void
+write_summary_headings (std::ostream &out, const char *label, int label_width)
+{
+  out << std::left << std::setw (label_width) << label << std::right
+      << std::setw (8) << "calls" << std::setw (12) << "time";
+
+  if (PerfCounters::enabled ())
+    {
+      for (unsigned i = 0; i < PerfCounters::NUM_COUNTERS; i++)
+	{
+	  auto counter = PerfCounters::Counter (i);
+	  out << std::setw (10) << PerfCounters::name (counter);
+	  if (counter == PerfCounters::INSTRUCTIONS)
+	    out << std::setw (6) << "IPC";
+	}
+    }
+
+  if (MemAccount::enabled ())
+    out << std::setw (10) << "net mem" << std::setw (10) << "peak mem";
+
+  out << '\n';
+}
+
+// Write a row of a summary table to OUT, with label LABEL in a column
+// LABEL_WIDTH wide, and values from TOTALS.
+//
+void
+write_summary_row (std::ostream &out, const std::string &label,
+		   int label_width, const TraceTotals &totals)
+{
+  out << std::left << std::setw (label_width) << label << std::right
+      << std::setw (8) << totals.calls
+      << std::setw (12) << format_time (totals.time);
+
+  if (PerfCounters::enabled ())
+    {
+      const PerfCounters::Counts &counts = totals.counts;
+
+      for (unsigned i = 0; i < PerfCounters::NUM_COUNTERS; i++)
+	{
+	  auto counter = PerfCounters::Counter (i);
+
+	  out << std::setw (10)
+	      << (counts.has (counter)
+		  ? format_count (counts.counts[counter]) : "-");
+
+	  if (counter == PerfCounters::INSTRUCTIONS)
+	    {
+	      std::uint64_t cycles = counts.counts[PerfCounters::CYCLES];
+	      std::uint64_t insns = counts.counts[PerfCounters::INSTRUCTIONS];
+
+	      std::ostringstream ipc;
+	      if (counts.has (PerfCounters::CYCLES)
+		  && counts.has (PerfCounters::INSTRUCTIONS) && cycles != 0)
+		ipc << std::fixed << std::setprecision (2)
+		    << double (insns) / cycles;
+	      else
+		ipc << '-';
+
+	      out << std::setw (6) << ipc.str ();
+	    }
+	}
+    }
+
+  if (MemAccount::enabled ())
+    out << std::setw (10) << MemAccount::format_bytes (totals.mem_net)
+	<< std::setw (10) << MemAccount::format_bytes (totals.mem_peak);
+
+  out << '\n';
+}
+
+// Write a summary table to OUT, with the label column headed LABEL,
+// and a row for each entry in TOTALS, most time-consuming first.  If
+// TOTAL is non-zero, a final row shows it.
+//
+void
+write_summary_table (std::ostream &out, const std::string &label,
+		     const std::map<std::string, TraceTotals> &totals,
+		     const TraceTotals *total = 0)
+{
+  static const char total_label[] = "(total)";
+
+  std::size_t label_width = std::max (label.size (), sizeof total_label);
+
+  std::vector<const std::pair<const std::string, TraceTotals> *> rows;
+  for (auto &entry : totals)
+    {
+      rows.push_back (&entry);
+      label_width = std::max (label_width, entry.first.size ());
+    }
+
+  label_width += 2;
+
+  std::stable_sort (rows.begin (), rows.end (),
+		    [] (auto *row1, auto *row2)
+		    {
+		      return row1->second.time > row2->second.time;
+		    });
+
+  write_summary_headings (out, label.c_str (), label_width);
+  for (auto row : rows)
+    write_summary_row (out, row->first, label_width, row->second);
+  if (total)
+    write_summary_row (out, total_label, label_width, *total);
+}
+
+// Write a table to OUT, with the label column headed LABEL, of the
+// net number of objects and bytes in each account in USAGE which has
+// any, largest first.
+//
+void
+write_mem_table (std::ostream &out, const std::string &label,
+		 const MemAccount::Usage &usage)
+{
+  std::size_t label_width = label.size ();
+
+  std::vector<unsigned> rows;
+  for (unsigned num = 0; num < MemAccount::num_accounts (); num++)
+    if (usage.counts[num] != 0 || usage.bytes[num] != 0)
+      if (const MemAccount *account = MemAccount::account (num))
+	{
+	  rows.push_back (num);
+	  label_width = std::max (label_width, strlen (account->name ()));
+	}
+
+  label_width += 2;
+
+  std::stable_sort (rows.begin (), rows.end (),
+		    [&usage] (unsigned num1, unsigned num2)
+		    {
+		      return usage.bytes[num1] > usage.bytes[num2];
+		    });
+
+  out << std::left << std::setw (label_width) << label << std::right
+      << std::setw (10) << "objects" << std::setw (10) << "bytes" << '\n';
+
+  for (unsigned num : rows)
+    out << std::left << std::setw (label_width)
+	<< MemAccount::account (num)->name () << std::right
+	<< std::setw (10) << usage.counts[num]
+	<< std::setw (10) << MemAccount::format_bytes (usage.bytes[num])
+	<< '\n';
+}
+
+
+// Write STR to OUT as a JSON string literal.
+//
+void
+write_json_string (std::ostream &out, const char *str)
+{
+  static const char hex_digits[] = "0123456789abcdef";
+
+  out << '"';
+  for (const char *p = str; *p; p++)
+    {
+      unsigned char ch = *p;
+      if (ch == '"' || ch == '\\')
+	out << '\\' << ch;
+      else if (ch < 0x20)
+	out << "\\u00" << hex_digits[ch >> 4] << hex_digits[ch & 0xF];
+      else
+	out << ch;
+    }
+  out << '"';
+}
+
+// Write the time TIME, in nanoseconds, to OUT as fractional
+// microseconds, which is the unit used by the trace-event format.
+//
+void
+write_json_usecs (std::ostream &out, Trace::Time time)
+{
+  unsigned frac = time % 1000;
+  out << (time / 1000) << '.'
+      << char ('0' + frac / 100)
+      << char ('0' + frac / 10 % 10)
+      << char ('0' + frac % 10);
+}
+
+} // namespace
+
+
+// Start recording trace events.
+//
+void
+Trace::enable ()
+{
+  if (! enabled ())
+    {
+      trace_epoch = std::chrono::steady_clock::now ();
+      _enabled.store (true);
+    }
+}
+
+
+// Return the current time.
+//
+Trace::Time
+Trace::now ()
+{
+  auto since_epoch = std::chrono::steady_clock::now () - trace_epoch;
+  return std::chrono::duration_cast<std::chrono::nanoseconds> (since_epoch).count ();
+}
+
+
+// Record a completed region called NAME, with optional details
+// DETAIL, which started at time BEG and ended at time END, and had
+// hardware counter deltas COUNTS.  If DETAIL_INHERITED is true,
+// DETAIL came from an enclosing region.  NAME must be a string with
+// static storage duration.
+//
+void
+Trace::record (const char *name, const std::string &detail,
+	       bool detail_inherited, Time beg, Time end,
+	       const PerfCounters::Counts &counts,
+	       const MemAccount::Usage *mem)
+{
+  // Trace buffers shouldn't show up in the regions they describe.
+  //
+  MemAccount::Pause pause;
+
+  std::unique_ptr<MemAccount::Usage> mem_copy;
+  if (mem)
+    mem_copy.reset (new MemAccount::Usage (*mem));
+
+  thread_buf ()->events.push_back
+    (TraceEvent { name, detail, detail_inherited, beg, end, counts,
+		  std::move (mem_copy) });
+}
+
+
+// Start recording this region.
+//
+void
+TraceSpan::start ()
+{
+  _outer = cur_span;
+  cur_span = this;
+
+  // Counters are read before the time, and after it at the end, so
+  // reading them isn't included in the region's time.
+  //
+  if (PerfCounters::enabled ())
+    PerfCounters::read (_beg_counts);
+
+  if (MemAccount::enabled ())
+    {
+      _outer_peak = MemAccount::start_peak ();
+      MemAccount::read (_beg_mem);
+    }
+
+  _beg = Trace::now ();
+}
+
+// Finish recording this region.
+//
+void
+TraceSpan::finish ()
+{
+  Trace::Time end = Trace::now ();
+
+  PerfCounters::Counts counts;
+  if (PerfCounters::enabled ())
+    {
+      PerfCounters::read (counts);
+      counts -= _beg_counts;
+    }
+
+  // As the high-water mark was reset to the current use at the
+  // start, subtracting the starting usage also makes the peak
+  // relative to it.
+  //
+  MemAccount::Usage mem;
+  bool have_mem = MemAccount::enabled ();
+  if (have_mem)
+    {
+      MemAccount::read (mem);
+      mem -= _beg_mem;
+      MemAccount::end_peak (_outer_peak);
+    }
+
+  cur_span = _outer;
+
+  // A region without details of its own gets those of the innermost
+  // enclosing region which has some.
+  //
+  const TraceSpan *detail_span = this;
+  while (detail_span && detail_span->_detail.empty ())
+    detail_span = detail_span->_outer;
+
+  if (detail_span)
+    Trace::record (_name, detail_span->_detail, detail_span != this,
+		   _beg, end, counts, have_mem ? &mem : 0);
+  else
+    Trace::record (_name, _detail, false, _beg, end, counts,
+		   have_mem ? &mem : 0);
+
+  MemAccount::Pause pause;
+  std::string ().swap (_detail);
+}
+
+
+// Write all events recorded so far, from all threads, to OUT in
+// Chrome trace-event JSON format.
+//
+void
+Trace::write_json (std::ostream &out)
+{
+  std::lock_guard<std::mutex> guard (thread_bufs_lock);
+
+  out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+
+  bool first = true;
+  for (auto &buf : thread_bufs)
+    {
+      if (first)
+	first = false;
+      else
+	out << ",\n";
+
+      out << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":"
+	  << buf->tid
+	  << ",\"args\":{\"name\":\"thread " << buf->tid << "\"}}";
+
+      for (auto &event : buf->events)
+	{
+	  out << ",\n{\"ph\":\"X\",\"cat\":\"compcat\",\"pid\":1,\"tid\":"
+	      << buf->tid << ",\"name\":";
+	  write_json_string (out, event.name);
+	  out << ",\"ts\":";
+	  write_json_usecs (out, event.beg);
+	  out << ",\"dur\":";
+	  write_json_usecs (out, event.end - event.beg);
+	  if (! event.detail.empty () || event.counts.valid || event.mem)
+	    {
+	      const char *sep = "";
+
+	      out << ",\"args\":{";
+	      if (! event.detail.empty ())
+		{
+		  out << "\"detail\":";
+		  write_json_string (out, event.detail.c_str ());
+		  sep = ",";
+		}
+	      for (unsigned i = 0; i < PerfCounters::NUM_COUNTERS; i++)
+		{
+		  auto counter = PerfCounters::Counter (i);
+		  if (event.counts.has (counter))
+		    {
+		      out << sep;
+		      write_json_string (out, PerfCounters::name (counter));
+		      out << ':' << event.counts.counts[counter];
+		      sep = ",";
+		    }
+		}
+	      if (event.mem)
+		out << sep << "\"net_mem\":" << event.mem->total_bytes
+		    << ",\"peak_mem\":" << event.mem->peak_bytes;
+	      out << '}';
+	    }
+	  out << '}';
+	}
+    }
+
+  out << "\n]}\n";
+}
+
+
+// Write a summary of all events recorded so far to OUT, as a table of
+// total times and counter values for each region name, followed by
+// similar tables for the MAX_DETAILS most time-consuming details (for
+// instance, function names), broken down by the regions within them.
+//
+void
+Trace::write_summary (std::ostream &out, unsigned max_details)
+{
+  MemAccount::Pause pause;
+
+  std::lock_guard<std::mutex> guard (thread_bufs_lock);
+
+  // Totals for each region name.
+  //
+  std::map<std::string, TraceTotals> region_totals;
+
+  // For each detail, totals for the regions which specified it, and
+  // for each region name within them.
+  //
+  struct DetailTotals
+  {
+    TraceTotals total;
+    std::map<std::string, TraceTotals> regions;
+
+    // Net memory by account over the regions which specified it.
+    //
+    MemAccount::Usage mem;
+  };
+  std::map<std::string, DetailTotals> detail_totals;
+
+  for (auto &buf : thread_bufs)
+    for (auto &event : buf->events)
+      {
+	region_totals[event.name].add (event);
+
+	if (! event.detail.empty ())
+	  {
+	    DetailTotals &totals = detail_totals[event.detail];
+	    if (event.detail_inherited)
+	      totals.regions[event.name].add (event);
+	    else
+	      {
+		totals.total.add (event);
+
+		if (event.mem)
+		  for (unsigned num = 0; num < MemAccount::MAX_ACCOUNTS; num++)
+		    {
+		      totals.mem.counts[num] += event.mem->counts[num];
+		      totals.mem.bytes[num] += event.mem->bytes[num];
+		    }
+	      }
+	  }
+      }
+
+  write_summary_table (out, "Region", region_totals);
+
+  std::vector<const std::pair<const std::string, DetailTotals> *> details;
+  for (auto &entry : detail_totals)
+    details.push_back (&entry);
+
+  bool by_mem = MemAccount::enabled ();
+  std::stable_sort (details.begin (), details.end (),
+		    [by_mem] (auto *detail1, auto *detail2)
+		    {
+		      const TraceTotals &total1 = detail1->second.total;
+		      const TraceTotals &total2 = detail2->second.total;
+		      if (by_mem)
+			return total1.mem_peak > total2.mem_peak;
+		      else
+			return total1.time > total2.time;
+		    });
+
+  if (details.size () > max_details)
+    details.resize (max_details);
+
+  for (auto detail : details)
+    {
+      out << '\n';
+      write_summary_table (out, detail->first, detail->second.regions,
+			   &detail->second.total);
+
+      if (by_mem)
+	{
+	  out << '\n';
+	  write_mem_table (out, detail->first + " by type",
+			   detail->second.mem);
+	}
+    }
+}
@@ -0,0 +1,198 @@
+// trace.h -- Low-overhead execution tracing
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "perf-counters.h"
+#include "mem-account.h"
+
+
+// Global tracing state.  Traced regions are recorded into per-thread
+// buffers (so recording never takes a lock), and may be written out
+// at the end of execution as Chrome trace-event JSON, which can be
+// loaded into Perfetto or chrome://tracing.
+//
+// Tracing is off until Trace::enable is called; while off, a traced
+// region costs a single relaxed atomic load.  Tracing can also be
+// removed entirely at compile time by defining NO_TRACE.
+//
+// If PerfCounters are enabled as well, each region also records the
+// hardware counter deltas over it, and if MemAccount is enabled, the
+// memory allocated by its thread during it.
+//
+class Trace
+{
+public:
+
+  // A time, in nanoseconds since tracing was enabled.
+  //
+  typedef std::uint64_t Time;
+
+
+  // Return true if tracing is currently enabled.
+  //
+  static bool enabled ()
+  {
+    return _enabled.load (std::memory_order_relaxed);
+  }
+
+  // Start recording trace events.
+  //
+  static void enable ();
+
+
+  // Return the current time.
+  //
+  static Time now ();
+
+
+  // Record a completed region called NAME, with optional details
+  // DETAIL, which started at time BEG and ended at time END, and had
+  // hardware counter deltas COUNTS.  If DETAIL_INHERITED is true,
+  // DETAIL came from an enclosing region.  NAME must be a string with
+  // static storage duration.  If MEM is non-zero, it is the change in
+  // memory use over the region, with MEM->peak_bytes being the
+  // high-water mark relative to the start.
+  //
+  static void record (const char *name, const std::string &detail,
+		      bool detail_inherited, Time beg, Time end,
+		      const PerfCounters::Counts &counts,
+		      const MemAccount::Usage *mem = 0);
+
+
+  // Write all events recorded so far, from all threads, to OUT in
+  // Chrome trace-event JSON format.
+  //
+  static void write_json (std::ostream &out);
+
+  // Write a summary of all events recorded so far to OUT, as a table
+  // of total times and counter values for each region name, followed
+  // by similar tables for the MAX_DETAILS most time-consuming details
+  // (for instance, function names), broken down by the regions within
+  // them.
+  //
+  // If memory accounting is enabled, the tables also show the net
+  // memory allocated and the highest high-water mark in each region,
+  // details are chosen by their high-water mark rather than time, and
+  // each detail's table is followed by its net memory by account.
+  //
+  static void write_summary (std::ostream &out, unsigned max_details);
+
+
+private:
+
+  // True if tracing is enabled.
+  //
+  static std::atomic<bool> _enabled;
+};
+
+
+// A traced region, which starts when this object is constructed, and
+// ends when it is destroyed.
+//
+class TraceSpan
+{
+public:
+
+  // Start a traced region called NAME.  NAME must be a string with
+  // static storage duration.
+  //
+  TraceSpan (const char *name)
+    : _name (Trace::enabled () ? name : 0)
+  {
+    if (_name)
+      start ();
+  }
+
+  // Start a traced region called NAME, with additional details
+  // DETAIL (for instance, the name of the function being processed).
+  // Regions within this one which have no details of their own use
+  // DETAIL too.
+  //
+  TraceSpan (const char *name, const std::string &detail)
+    : _name (Trace::enabled () ? name : 0)
+  {
+    if (_name)
+      {
+	{
+	  MemAccount::Pause pause;
+	  _detail = detail;
+	}
+	start ();
+      }
+  }
+
+  ~TraceSpan ()
+  {
+    if (_name)
+      finish ();
+  }
+
+  TraceSpan (const TraceSpan &) = delete;
+  TraceSpan &operator= (const TraceSpan &) = delete;
+
+
+private:
+
+  // Start / finish recording this region.
+  //
+  void start ();
+  void finish ();
+
+
+  // Name of this region, or zero if tracing was disabled when it
+  // started.
+  //
+  const char *_name;
+
+  // Optional additional details.  This is tracing bookkeeping, so it
+  // is allocated and freed with memory accounting paused.
+  //
+  std::string _detail;
+
+  // Time when this region started.
+  //
+  Trace::Time _beg = 0;
+
+  // Hardware counter values when this region started.
+  //
+  PerfCounters::Counts _beg_counts;
+
+  // Memory use when this region started, and the enclosing high-water
+  // mark, to be restored at the end.
+  //
+  MemAccount::Usage _beg_mem;
+  std::int64_t _outer_peak = 0;
+
+  // The innermost region in this thread enclosing this one, or zero
+  // if none.
+  //
+  TraceSpan *_outer = 0;
+};
+
+
+// Trace the rest of the enclosing scope as a region.  The arguments
+// are the same as for the TraceSpan constructor.
+//
+#ifdef NO_TRACE
+# define TRACE_SPAN(...) ((void)0)
+#else
+# define TRACE_SPAN(...) \
+  TraceSpan TRACE_SPAN_VAR (__LINE__) (__VA_ARGS__)
+# define TRACE_SPAN_VAR(line) TRACE_SPAN_VAR_1 (line)
+# define TRACE_SPAN_VAR_1(line) trace_span_ ## line
+#endif
+
+
+#endif // __TRACE_H__
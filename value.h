@@ -9,6 +9,8 @@
 #ifndef __VALUE_H__
 #define __VALUE_H__
 
+#include "mem-account.h"
+
 
 class Fun;
 class Value;
@@ -22,6 +24,8 @@ class Value
 {
 public:
 
+  MEM_ACCOUNTED (Value);
+
   // Return a new value with integer value INT_VALUE.
   // If FUN is non-NULL, the new value is added to FUN.
   //
@@ -0,0 +1,193 @@
+// work-pool.cc -- Work-stealing pool of tasks
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#include <thread>
+
+#include "work-pool.h"
+
+
+// The pool and worker index of the task running in this thread, if
+// any.
+//
+static thread_local WorkPool *cur_pool = 0;
+static thread_local unsigned cur_worker_idx = 0;
+
+
+// Make a pool which runs tasks on NUM_THREADS threads, one of which
+// is the thread calling WorkPool::run.
+//
+WorkPool::WorkPool (unsigned num_threads)
+{
+  if (num_threads == 0)
+    num_threads = 1;
+
+  for (unsigned i = 0; i < num_threads; i++)
+    _queues.emplace_back (new Queue);
+}
+
+
+// Add TASK to the pool.  This may be called before WorkPool::run, or
+// by a running task.
+//
+void
+WorkPool::submit (Task task)
+{
+  // Tasks from outside are spread over all the queues, so workers
+  // don't all start by stealing from the same one.
+  //
+  unsigned queue_idx;
+  if (cur_pool == this)
+    queue_idx = cur_worker_idx;
+  else
+    {
+      queue_idx = _next_outside_queue;
+      _next_outside_queue = (queue_idx + 1) % _queues.size ();
+    }
+
+  ++_num_unfinished;
+
+  {
+    Queue &queue = *_queues[queue_idx];
+    std::lock_guard<std::mutex> lock (queue.lock);
+    queue.tasks.push_back (std::move (task));
+  }
+
+  std::lock_guard<std::mutex> lock (_idle_lock);
+  ++_num_queued;
+  if (_num_waiting > 0)
+    _work_cond.notify_one ();
+}
+
+
+// Run tasks until every task, including any submitted while running,
+// has finished.
+//
+// If a task throws an exception, other tasks are still run, and once
+// they're all finished, the first exception thrown is rethrown.
+//
+void
+WorkPool::run ()
+{
+  std::vector<std::thread> threads;
+  for (unsigned i = 1; i < _queues.size (); i++)
+    threads.emplace_back ([this, i] () { work (i); });
+
+  work (0);
+
+  for (auto &thread : threads)
+    thread.join ();
+
+  if (_first_exception)
+    {
+      std::exception_ptr exception = _first_exception;
+      _first_exception = nullptr;
+      std::rethrow_exception (exception);
+    }
+}
+
+
+// Worker loop for the worker with index WORKER_IDX.
+//
+void
+WorkPool::work (unsigned worker_idx)
+{
+  WorkPool *old_pool = cur_pool;
+  unsigned old_worker_idx = cur_worker_idx;
+
+  cur_pool = this;
+  cur_worker_idx = worker_idx;
+
+  for (;;)
+    {
+      Task task;
+
+      if (find_task (worker_idx, task))
+	{
+	  try
+	    {
+	      task ();
+	    }
+	  catch (...)
+	    {
+	      std::lock_guard<std::mutex> lock (_exception_lock);
+	      if (! _first_exception)
+		_first_exception = std::current_exception ();
+	    }
+
+	  // Destroy anything the task holds before it counts as
+	  // finished.
+	  //
+	  task = nullptr;
+
+	  if (--_num_unfinished == 0)
+	    {
+	      std::lock_guard<std::mutex> lock (_idle_lock);
+	      _work_cond.notify_all ();
+	    }
+
+	  continue;
+	}
+
+      // Nothing to do, so wait until there's a new task, or
+      // everything is finished.  As _NUM_QUEUED is only incremented
+      // while holding _IDLE_LOCK, no wakeup can be missed.
+      //
+      std::unique_lock<std::mutex> lock (_idle_lock);
+      if (_num_unfinished == 0)
+	break;
+
+      ++_num_waiting;
+      _work_cond.wait (lock, [this] ()
+	{
+	  return _num_queued > 0 || _num_unfinished == 0;
+	});
+      --_num_waiting;
+    }
+
+  cur_pool = old_pool;
+  cur_worker_idx = old_worker_idx;
+}
+
+
+// Try to find a task for the worker with index WORKER_IDX, first from
+// its own queue, and then by stealing from others.  If one is found,
+// store it in TASK and return true.
+//
+bool
+WorkPool::find_task (unsigned worker_idx, Task &task)
+{
+  unsigned num_queues = _queues.size ();
+
+  for (unsigned offs = 0; offs < num_queues; offs++)
+    {
+      Queue &queue = *_queues[(worker_idx + offs) % num_queues];
+      std::lock_guard<std::mutex> lock (queue.lock);
+
+      if (queue.tasks.empty ())
+	continue;
+
+      // Our own newest task, or someone else's oldest.
+      //
+      if (offs == 0)
+	{
+	  task = std::move (queue.tasks.back ());
+	  queue.tasks.pop_back ();
+	}
+      else
+	{
+	  task = std::move (queue.tasks.front ());
+	  queue.tasks.pop_front ();
+	}
+
+      --_num_queued;
+
+      return true;
+    }
+
+  return false;
+}
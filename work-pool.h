@@ -0,0 +1,119 @@
+// work-pool.h -- Work-stealing pool of tasks
+//
+// Copyright © 2026  Miles Bader
+//
+// Author: Miles Bader <snogglethorpe@gmail.com>
+// Created: 2026-10-18
+//
+
+#ifndef __WORK_POOL_H__
+#define __WORK_POOL_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+// A pool of tasks, run by a set of worker threads.
+//
+// Each worker has its own queue of tasks.  A task submitted by a
+// running task goes on its worker's queue, and workers take their own
+// most recently submitted task first, which keeps related work
+// together.  A worker whose queue is empty steals the oldest task
+// from another worker's queue, so all workers stay busy even when
+// tasks vary greatly in size.
+//
+// Tasks shouldn't block waiting for other tasks; instead, a task which
+// depends on others should be submitted by whichever of them finishes
+// last.
+//
+class WorkPool
+{
+public:
+
+  typedef std::function<void ()> Task;
+
+
+  // Make a pool which runs tasks on NUM_THREADS threads, one of which
+  // is the thread calling WorkPool::run.
+  //
+  WorkPool (unsigned num_threads);
+
+  WorkPool (const WorkPool &) = delete;
+  WorkPool &operator= (const WorkPool &) = delete;
+
+
+  // Add TASK to the pool.  This may be called before WorkPool::run,
+  // or by a running task.
+  //
+  void submit (Task task);
+
+
+  // Run tasks until every task, including any submitted while running,
+  // has finished.
+  //
+  // If a task throws an exception, other tasks are still run, and
+  // once they're all finished, the first exception thrown is rethrown.
+  //
+  void run ();
+
+
+private:
+
+  // A worker's queue of tasks.
+  //
+  struct Queue
+  {
+    std::mutex lock;
+    std::deque<Task> tasks;
+  };
+
+
+  // Worker loop for the worker with index WORKER_IDX.
+  //
+  void work (unsigned worker_idx);
+
+  // Try to find a task for the worker with index WORKER_IDX, first
+  // from its own queue, and then by stealing from others.  If one is
+  // found, store it in TASK and return true.
+  //
+  bool find_task (unsigned worker_idx, Task &task);
+
+
+  // Queues, one per worker.
+  //
+  std::vector<std::unique_ptr<Queue>> _queues;
+
+  // Queue used for the next task submitted from outside the pool.
+  //
+  unsigned _next_outside_queue = 0;
+
+  // Number of tasks submitted but not yet finished.
+  //
+  std::atomic<unsigned> _num_unfinished { 0 };
+
+  // Number of tasks sitting in queues.  This is incremented after a
+  // task is queued, so may briefly be negative.
+  //
+  std::atomic<int> _num_queued { 0 };
+
+  // Idle workers wait on _WORK_COND for new tasks, or for all work to
+  // be finished.  _NUM_WAITING is the number waiting.
+  //
+  std::mutex _idle_lock;
+  std::condition_variable _work_cond;
+  unsigned _num_waiting = 0;
+
+  // First exception thrown by a task.
+  //
+  std::exception_ptr _first_exception;
+  std::mutex _exception_lock;
+};
+
+
+#endif // __WORK_POOL_H__